@@ -0,0 +1,760 @@
+/*
+MIT License
+
+Copyright (c) 2017-2019 Nefarius Software Solutions e.U. and Contributors
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+//
+// WinAPI
+// 
+#include <Windows.h>
+#include <SetupAPI.h>
+#include <hidsdi.h>
+#include <Xinput.h>
+#include <timeapi.h>
+
+//
+// Driver shared
+// 
+#include "ViGEm/Client.h"
+
+//
+// STL
+// 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+//
+// Report counter values wrap at 16 bits, one submit timestamp slot per value
+// 
+#define BENCH_COUNTER_SLOTS         0x10000
+
+//
+// Marks DS4 reports sent by this benchmark (in bThumbLY)
+// 
+#define BENCH_DS4_MARKER            0x5A
+
+#define BENCH_DS4_VENDOR_ID         0x054C
+#define BENCH_DS4_PRODUCT_ID        0x05C4
+
+//
+// Command line settings of a benchmark run.
+// 
+typedef struct _BENCH_OPTIONS
+{
+    ULONG X360Targets = 1;
+    ULONG Ds4Targets = 0;
+    ULONG Threads = 1;
+    ULONG RateHz = 1000; // 0 submits as fast as possible
+    ULONG DurationSeconds = 10;
+    ULONG WarmupMilliseconds = 1000;
+    const char* CsvPath = nullptr;
+
+} BENCH_OPTIONS, *PBENCH_OPTIONS;
+
+//
+// State of a single emulated device under test.
+// 
+typedef struct _BENCH_TARGET
+{
+    PVIGEM_TARGET Target = nullptr;
+    VIGEM_TARGET_TYPE Type = Xbox360Wired;
+
+    //
+    // Index among targets of the same type
+    // 
+    ULONG Index = 0;
+
+    //
+    // XInput slot of an X360 target, XUSER_MAX_COUNT if it can't be read back
+    // 
+    ULONG UserIndex = XUSER_MAX_COUNT;
+
+    //
+    // Owned by the submitting thread
+    // 
+    USHORT Counter = 0;
+    ULONGLONG Submitted = 0;
+    ULONGLONG SubmitFailed = 0;
+
+    //
+    // QueryPerformanceCounter value each counter value has been submitted at
+    // 
+    std::unique_ptr<std::atomic<LONGLONG>[]> SubmitTicks;
+
+    //
+    // Owned by the reading thread
+    // 
+    ULONGLONG Delivered = 0;
+    std::vector<LONGLONG> Samples;
+
+    VIGEM_TARGET_STATISTICS Statistics{};
+
+} BENCH_TARGET, *PBENCH_TARGET;
+
+//
+// Shared state of a benchmark run.
+// 
+typedef struct _BENCH_CONTEXT
+{
+    BENCH_OPTIONS Options;
+    PVIGEM_CLIENT Client = nullptr;
+    LARGE_INTEGER Frequency{};
+
+    std::vector<std::unique_ptr<BENCH_TARGET>> Targets;
+
+    std::atomic<bool> Measuring{ false };
+    std::atomic<bool> Stop{ false };
+
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static LONGLONG bench_now()
+{
+    LARGE_INTEGER now;
+    (void)QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static void bench_usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --x360 <count>      X360 targets to plug in (default 1)\n"
+        "  --ds4 <count>       DS4 targets to plug in (default 0)\n"
+        "  --threads <count>   Submitting threads (default 1)\n"
+        "  --rate <hz>         Reports per second per target, 0 for unthrottled (default 1000)\n"
+        "  --duration <s>      Measurement duration in seconds (default 10)\n"
+        "  --warmup <ms>       Time before measurement starts (default 1000)\n"
+        "  --csv <path>        Write results to file instead of stdout\n",
+        name);
+}
+
+static bool bench_parse_options(int argc, char* argv[], PBENCH_OPTIONS options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char* value = argv[++i];
+
+        if (arg == "--csv")
+        {
+            options->CsvPath = value;
+            continue;
+        }
+
+        char* end = nullptr;
+        const auto number = strtoul(value, &end, 10);
+
+        if (end == value || *end != '\0')
+            return false;
+
+        if (arg == "--x360")
+            options->X360Targets = number;
+        else if (arg == "--ds4")
+            options->Ds4Targets = number;
+        else if (arg == "--threads")
+            options->Threads = number;
+        else if (arg == "--rate")
+            options->RateHz = number;
+        else if (arg == "--duration")
+            options->DurationSeconds = number;
+        else if (arg == "--warmup")
+            options->WarmupMilliseconds = number;
+        else
+            return false;
+    }
+
+    //
+    // DS4 targets are told apart by a single report byte
+    // 
+    return (options->X360Targets + options->Ds4Targets) > 0
+        && options->Ds4Targets <= UCHAR_MAX
+        && options->Threads > 0
+        && options->DurationSeconds > 0;
+}
+
+//
+// Matches a report read back from the host against its submission.
+// 
+static void bench_record_delivery(PBENCH_CONTEXT ctx, PBENCH_TARGET target, USHORT counter, LONGLONG now)
+{
+    //
+    // Clearing the slot keeps repeated reads of the same state from counting twice
+    // 
+    const auto submitted = target->SubmitTicks[counter].exchange(0, std::memory_order_acquire);
+
+    if (submitted == 0 || !ctx->Measuring.load(std::memory_order_relaxed))
+        return;
+
+    target->Delivered++;
+    target->Samples.push_back(now - submitted);
+}
+
+static VIGEM_ERROR bench_submit(PBENCH_CONTEXT ctx, PBENCH_TARGET target)
+{
+    //
+    // Zero is the neutral state, don't use it as a counter value
+    // 
+    if (++target->Counter == 0)
+        target->Counter = 1;
+
+    LARGE_INTEGER timestamp;
+    timestamp.QuadPart = bench_now();
+
+    target->SubmitTicks[target->Counter].store(timestamp.QuadPart, std::memory_order_release);
+
+    if (target->Type == Xbox360Wired)
+    {
+        XUSB_REPORT report;
+        XUSB_REPORT_INIT(&report);
+
+        report.sThumbLX = static_cast<SHORT>(target->Counter);
+
+        return vigem_target_x360_update_timed(ctx->Client, target->Target, report, timestamp);
+    }
+
+    DS4_REPORT base;
+    DS4_REPORT_INIT(&base);
+
+    base.bThumbLX = static_cast<BYTE>(target->Index);
+    base.bThumbLY = BENCH_DS4_MARKER;
+    base.bThumbRX = LOBYTE(target->Counter);
+    base.bThumbRY = HIBYTE(target->Counter);
+
+    DS4_REPORT_EX report;
+    memset(&report, 0, sizeof(DS4_REPORT_EX));
+    memcpy(report.ReportBuffer, &base, sizeof(DS4_REPORT));
+
+    report.Report.sCurrentTouch.bIsUpTrackingNum1 = 0x80;
+    report.Report.sCurrentTouch.bIsUpTrackingNum2 = 0x80;
+
+    return vigem_target_ds4_update_timed(ctx->Client, target->Target, report, timestamp, FALSE);
+}
+
+//
+// Drives the targets assigned to one thread at the configured rate.
+// 
+static void bench_submit_worker(PBENCH_CONTEXT ctx, std::vector<PBENCH_TARGET> targets)
+{
+    const auto period = (ctx->Options.RateHz > 0)
+        ? ctx->Frequency.QuadPart / ctx->Options.RateHz
+        : 0;
+    const auto sleepThreshold = ctx->Frequency.QuadPart / 500; // 2ms
+
+    auto next = bench_now();
+
+    while (!ctx->Stop.load(std::memory_order_relaxed))
+    {
+        const auto measuring = ctx->Measuring.load(std::memory_order_relaxed);
+
+        for (const auto target : targets)
+        {
+            const auto error = bench_submit(ctx, target);
+
+            if (!measuring)
+                continue;
+
+            target->Submitted++;
+
+            if (!VIGEM_SUCCESS(error))
+                target->SubmitFailed++;
+        }
+
+        if (period == 0)
+            continue;
+
+        next += period;
+
+        //
+        // Sleep granularity is too coarse for short periods, spin the remainder
+        // 
+        for (auto now = bench_now(); now < next; now = bench_now())
+        {
+            if (next - now > sleepThreshold)
+                Sleep(1);
+            else
+                YieldProcessor();
+        }
+    }
+}
+
+//
+// Polls the XInput slots of all X360 targets for state changes.
+// 
+static void bench_xinput_reader(PBENCH_CONTEXT ctx, std::vector<PBENCH_TARGET> targets)
+{
+    DWORD packets[XUSER_MAX_COUNT] = { 0 };
+
+    while (!ctx->Stop.load(std::memory_order_relaxed))
+    {
+        for (const auto target : targets)
+        {
+            XINPUT_STATE state;
+
+            if (XInputGetState(target->UserIndex, &state) != ERROR_SUCCESS)
+                continue;
+
+            const auto now = bench_now();
+
+            if (state.dwPacketNumber == packets[target->UserIndex])
+                continue;
+
+            packets[target->UserIndex] = state.dwPacketNumber;
+
+            bench_record_delivery(ctx, target, static_cast<USHORT>(state.Gamepad.sThumbLX), now);
+        }
+    }
+}
+
+//
+// Reads input reports of a single DS4 HID device.
+// 
+static void bench_hid_reader(PBENCH_CONTEXT ctx, HANDLE device, ULONG reportLength)
+{
+    std::vector<BYTE> buffer(reportLength);
+    OVERLAPPED overlapped = { 0 };
+    overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+    while (!ctx->Stop.load(std::memory_order_relaxed))
+    {
+        DWORD transferred = 0;
+
+        ResetEvent(overlapped.hEvent);
+
+        if (!ReadFile(device, buffer.data(), reportLength, &transferred, &overlapped))
+        {
+            if (GetLastError() != ERROR_IO_PENDING)
+                break;
+
+            //
+            // Wake up periodically to check for shutdown
+            // 
+            if (WaitForSingleObject(overlapped.hEvent, 100) == WAIT_TIMEOUT)
+            {
+                CancelIoEx(device, &overlapped);
+                (void)GetOverlappedResult(device, &overlapped, &transferred, TRUE);
+                continue;
+            }
+
+            if (!GetOverlappedResult(device, &overlapped, &transferred, FALSE))
+                break;
+        }
+
+        const auto now = bench_now();
+
+        //
+        // Report ID, LX (target index), LY (marker), RX/RY (counter)
+        // 
+        if (transferred < 5 || buffer[0] != 0x01 || buffer[2] != BENCH_DS4_MARKER)
+            continue;
+
+        const auto index = buffer[1];
+        const auto counter = static_cast<USHORT>(MAKEWORD(buffer[3], buffer[4]));
+
+        for (const auto& target : ctx->Targets)
+        {
+            if (target->Type == DualShock4Wired && target->Index == index)
+            {
+                bench_record_delivery(ctx, target.get(), counter, now);
+                break;
+            }
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+}
+
+//
+// Opens all HID devices matching the emulated DS4 hardware IDs.
+// 
+static std::vector<std::pair<HANDLE, ULONG>> bench_open_ds4_devices()
+{
+    std::vector<std::pair<HANDLE, ULONG>> devices;
+    GUID hidGuid;
+
+    HidD_GetHidGuid(&hidGuid);
+
+    const auto deviceInfoSet = SetupDiGetClassDevs(&hidGuid, nullptr, nullptr, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+
+    if (deviceInfoSet == INVALID_HANDLE_VALUE)
+        return devices;
+
+    SP_DEVICE_INTERFACE_DATA interfaceData;
+    interfaceData.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+
+    for (DWORD member = 0; SetupDiEnumDeviceInterfaces(deviceInfoSet, nullptr, &hidGuid, member, &interfaceData); member++)
+    {
+        DWORD required = 0;
+
+        (void)SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &interfaceData, nullptr, 0, &required, nullptr);
+
+        std::vector<BYTE> detailBuffer(required);
+        const auto detail = reinterpret_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA>(detailBuffer.data());
+        detail->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+
+        if (!SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &interfaceData, detail, required, nullptr, nullptr))
+            continue;
+
+        const auto device = CreateFile(
+            detail->DevicePath,
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_OVERLAPPED,
+            nullptr
+        );
+
+        if (device == INVALID_HANDLE_VALUE)
+            continue;
+
+        HIDD_ATTRIBUTES attributes;
+        attributes.Size = sizeof(HIDD_ATTRIBUTES);
+
+        PHIDP_PREPARSED_DATA preparsed = nullptr;
+        HIDP_CAPS caps;
+
+        if (HidD_GetAttributes(device, &attributes)
+            && attributes.VendorID == BENCH_DS4_VENDOR_ID
+            && attributes.ProductID == BENCH_DS4_PRODUCT_ID
+            && HidD_GetPreparsedData(device, &preparsed))
+        {
+            const auto status = HidP_GetCaps(preparsed, &caps);
+            HidD_FreePreparsedData(preparsed);
+
+            if (status == HIDP_STATUS_SUCCESS && caps.InputReportByteLength > 0)
+            {
+                devices.emplace_back(device, caps.InputReportByteLength);
+                continue;
+            }
+        }
+
+        CloseHandle(device);
+    }
+
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+
+    return devices;
+}
+
+static bool bench_plug_targets(PBENCH_CONTEXT ctx)
+{
+    for (ULONG i = 0; i < ctx->Options.X360Targets + ctx->Options.Ds4Targets; i++)
+    {
+        auto target = std::make_unique<BENCH_TARGET>();
+
+        target->Type = (i < ctx->Options.X360Targets) ? Xbox360Wired : DualShock4Wired;
+        target->Index = (target->Type == Xbox360Wired) ? i : i - ctx->Options.X360Targets;
+        target->Target = (target->Type == Xbox360Wired) ? vigem_target_x360_alloc() : vigem_target_ds4_alloc();
+        target->SubmitTicks = std::make_unique<std::atomic<LONGLONG>[]>(BENCH_COUNTER_SLOTS);
+
+        if (!target->Target)
+            return false;
+
+        const auto error = vigem_target_add(ctx->Client, target->Target);
+
+        if (!VIGEM_SUCCESS(error))
+        {
+            fprintf(stderr, "Adding target failed with error code 0x%X\n", error);
+            vigem_target_free(target->Target);
+            return false;
+        }
+
+        if (target->Type == Xbox360Wired)
+        {
+            ULONG userIndex;
+
+            if (VIGEM_SUCCESS(vigem_target_x360_get_user_index(ctx->Client, target->Target, &userIndex))
+                && userIndex < XUSER_MAX_COUNT)
+                target->UserIndex = userIndex;
+            else
+                fprintf(stderr, "X360 target %lu has no XInput slot, not reading it back\n", target->Index);
+        }
+
+        ctx->Targets.push_back(std::move(target));
+    }
+
+    return true;
+}
+
+static void bench_unplug_targets(PBENCH_CONTEXT ctx)
+{
+    for (const auto& target : ctx->Targets)
+    {
+        (void)vigem_target_remove(ctx->Client, target->Target);
+        vigem_target_free(target->Target);
+    }
+
+    ctx->Targets.clear();
+}
+
+static double bench_ticks_to_us(PBENCH_CONTEXT ctx, LONGLONG ticks)
+{
+    return static_cast<double>(ticks) * 1000000.0 / static_cast<double>(ctx->Frequency.QuadPart);
+}
+
+static LONGLONG bench_percentile(const std::vector<LONGLONG>& sorted, double percentile)
+{
+    if (sorted.empty())
+        return 0;
+
+    const auto index = static_cast<size_t>(percentile * static_cast<double>(sorted.size()));
+
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void bench_write_row(
+    PBENCH_CONTEXT ctx,
+    FILE* out,
+    const char* type,
+    const char* index,
+    ULONGLONG submitted,
+    ULONGLONG failed,
+    ULONGLONG delivered,
+    std::vector<LONGLONG>& samples,
+    const VIGEM_TARGET_STATISTICS& statistics
+)
+{
+    std::sort(samples.begin(), samples.end());
+
+    ULONGLONG busSamples = 0;
+
+    for (const auto bucket : statistics.LatencyHistogram)
+        busSamples += bucket;
+
+    const auto duration = static_cast<double>(ctx->Options.DurationSeconds);
+
+    fprintf(out, "%s,%s,%lu,%lu,%lu,%llu,%llu,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%llu,%llu,%.1f\n",
+        type,
+        index,
+        ctx->Options.Threads,
+        ctx->Options.RateHz,
+        ctx->Options.DurationSeconds,
+        submitted,
+        failed,
+        delivered,
+        static_cast<double>(submitted) / duration,
+        static_cast<double>(delivered) / duration,
+        bench_ticks_to_us(ctx, bench_percentile(samples, 0.50)),
+        bench_ticks_to_us(ctx, bench_percentile(samples, 0.90)),
+        bench_ticks_to_us(ctx, bench_percentile(samples, 0.99)),
+        bench_ticks_to_us(ctx, bench_percentile(samples, 0.999)),
+        bench_ticks_to_us(ctx, samples.empty() ? 0 : samples.back()),
+        statistics.ReportsSkipped,
+        statistics.ReportsWithoutPendingRequest,
+        (busSamples > 0) ? static_cast<double>(statistics.LatencyTotalMicroseconds) / busSamples : 0.0
+    );
+}
+
+//
+// One row per target plus one aggregated row per target type.
+// 
+static void bench_write_results(PBENCH_CONTEXT ctx, FILE* out)
+{
+    fprintf(out,
+        "type,index,threads,rate_hz,duration_s,submitted,submit_failed,delivered,"
+        "submit_rate_hz,delivery_rate_hz,latency_p50_us,latency_p90_us,latency_p99_us,"
+        "latency_p999_us,latency_max_us,bus_reports_skipped,bus_reports_without_pending_request,"
+        "bus_latency_avg_us\n");
+
+    for (const auto type : { Xbox360Wired, DualShock4Wired })
+    {
+        const auto name = (type == Xbox360Wired) ? "x360" : "ds4";
+
+        ULONGLONG submitted = 0, failed = 0, delivered = 0;
+        std::vector<LONGLONG> samples;
+        VIGEM_TARGET_STATISTICS total{};
+        ULONG count = 0;
+
+        for (const auto& target : ctx->Targets)
+        {
+            if (target->Type != type)
+                continue;
+
+            count++;
+            submitted += target->Submitted;
+            failed += target->SubmitFailed;
+            delivered += target->Delivered;
+            samples.insert(samples.end(), target->Samples.begin(), target->Samples.end());
+
+            total.ReportsSkipped += target->Statistics.ReportsSkipped;
+            total.ReportsWithoutPendingRequest += target->Statistics.ReportsWithoutPendingRequest;
+            total.LatencyTotalMicroseconds += target->Statistics.LatencyTotalMicroseconds;
+
+            for (ULONG i = 0; i < VIGEM_TARGET_LATENCY_BUCKET_COUNT; i++)
+                total.LatencyHistogram[i] += target->Statistics.LatencyHistogram[i];
+
+            const auto index = std::to_string(target->Index);
+
+            bench_write_row(ctx, out, name, index.c_str(), target->Submitted, target->SubmitFailed,
+                target->Delivered, target->Samples, target->Statistics);
+        }
+
+        if (count > 1)
+            bench_write_row(ctx, out, name, "all", submitted, failed, delivered, samples, total);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BENCH_CONTEXT ctx;
+
+    if (!bench_parse_options(argc, argv, &ctx.Options))
+    {
+        bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    (void)QueryPerformanceFrequency(&ctx.Frequency);
+
+    //
+    // Keeps Sleep(1) in the pacing loop close to a millisecond
+    // 
+    (void)timeBeginPeriod(1);
+
+    ctx.Client = vigem_alloc();
+
+    if (!ctx.Client)
+        return EXIT_FAILURE;
+
+    const auto error = vigem_connect(ctx.Client);
+
+    if (!VIGEM_SUCCESS(error))
+    {
+        fprintf(stderr, "Connecting to the bus failed with error code 0x%X\n", error);
+        vigem_free(ctx.Client);
+        return EXIT_FAILURE;
+    }
+
+    if (!bench_plug_targets(&ctx))
+    {
+        bench_unplug_targets(&ctx);
+        vigem_disconnect(ctx.Client);
+        vigem_free(ctx.Client);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::thread> readers;
+    std::vector<std::thread> submitters;
+    std::vector<std::pair<HANDLE, ULONG>> hidDevices;
+
+    //
+    // HID stack of freshly added DS4 targets might still be starting up
+    // 
+    for (ULONG attempt = 0; ctx.Options.Ds4Targets > 0 && attempt < 50; attempt++)
+    {
+        for (const auto& device : hidDevices)
+            CloseHandle(device.first);
+
+        hidDevices = bench_open_ds4_devices();
+
+        if (hidDevices.size() >= ctx.Options.Ds4Targets)
+            break;
+
+        Sleep(100);
+    }
+
+    for (const auto& device : hidDevices)
+        readers.emplace_back(bench_hid_reader, &ctx, device.first, device.second);
+
+    std::vector<PBENCH_TARGET> xinputTargets;
+
+    for (const auto& target : ctx.Targets)
+    {
+        if (target->Type == Xbox360Wired && target->UserIndex < XUSER_MAX_COUNT)
+            xinputTargets.push_back(target.get());
+    }
+
+    if (!xinputTargets.empty())
+        readers.emplace_back(bench_xinput_reader, &ctx, xinputTargets);
+
+    //
+    // Distribute targets round-robin across the submitting threads
+    // 
+    const auto threads = std::min<size_t>(ctx.Options.Threads, ctx.Targets.size());
+    std::vector<std::vector<PBENCH_TARGET>> assignments(threads);
+
+    for (size_t i = 0; i < ctx.Targets.size(); i++)
+        assignments[i % threads].push_back(ctx.Targets[i].get());
+
+    for (const auto& assignment : assignments)
+        submitters.emplace_back(bench_submit_worker, &ctx, assignment);
+
+    fprintf(stderr, "Running %lu X360 and %lu DS4 targets (%zu HID devices found) for %lu seconds\n",
+        ctx.Options.X360Targets, ctx.Options.Ds4Targets, hidDevices.size(), ctx.Options.DurationSeconds);
+
+    Sleep(ctx.Options.WarmupMilliseconds);
+    ctx.Measuring = true;
+
+    Sleep(ctx.Options.DurationSeconds * 1000);
+    ctx.Measuring = false;
+
+    ctx.Stop = true;
+
+    for (auto& thread : submitters)
+        thread.join();
+
+    for (auto& thread : readers)
+        thread.join();
+
+    for (const auto& device : hidDevices)
+        CloseHandle(device.first);
+
+    //
+    // Bus side counters are cumulative since the target has been added
+    // 
+    for (const auto& target : ctx.Targets)
+        (void)vigem_target_get_statistics(ctx.Client, target->Target, &target->Statistics);
+
+    FILE* out = stdout;
+
+    if (ctx.Options.CsvPath && fopen_s(&out, ctx.Options.CsvPath, "w") != 0)
+    {
+        fprintf(stderr, "Opening %s failed\n", ctx.Options.CsvPath);
+        out = stdout;
+    }
+
+    bench_write_results(&ctx, out);
+
+    if (out != stdout)
+        fclose(out);
+
+    bench_unplug_targets(&ctx);
+    vigem_disconnect(ctx.Client);
+    vigem_free(ctx.Client);
+
+    (void)timeEndPeriod(1);
+
+    return EXIT_SUCCESS;
+}
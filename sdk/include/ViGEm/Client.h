@@ -61,7 +61,9 @@ extern "C" {
         VIGEM_ERROR_BUS_INVALID_HANDLE = 0xE0000013,
         VIGEM_ERROR_XUSB_USERINDEX_OUT_OF_RANGE = 0xE0000014,
 		VIGEM_ERROR_INVALID_PARAMETER = 0xE0000015,
-    	VIGEM_ERROR_NOT_SUPPORTED = 0xE0000016
+    	VIGEM_ERROR_NOT_SUPPORTED = 0xE0000016,
+        VIGEM_ERROR_TIMED_OUT = 0xE0000017,
+        VIGEM_ERROR_OPERATION_ABORTED = 0xE0000018
 
     } VIGEM_ERROR;
 
@@ -75,6 +77,14 @@ extern "C" {
  */
 #define VIGEM_SUCCESS(_val_) (_val_ == VIGEM_ERROR_NONE)
 
+/**
+ * User index of wired Xbox 360 devices which haven't been assigned an XInput slot (yet)
+ *
+ * @author	Benjamin "Nefarius" Hglinger-Stelzer
+ * @date	14.10.2026
+ */
+#define VIGEM_X360_USER_INDEX_NONE 0xFFFFFFFF
+
     /** Defines an alias representing a driver connection object */
     typedef struct _VIGEM_CLIENT_T *PVIGEM_CLIENT;
 
@@ -92,6 +102,17 @@ extern "C" {
 
     typedef EVT_VIGEM_TARGET_ADD_RESULT *PFN_VIGEM_TARGET_ADD_RESULT;
 
+    typedef
+        _Function_class_(EVT_VIGEM_TARGET_REMOVE_RESULT)
+        VOID CALLBACK
+        EVT_VIGEM_TARGET_REMOVE_RESULT(
+            PVIGEM_CLIENT Client,
+            PVIGEM_TARGET Target,
+            VIGEM_ERROR Result
+        );
+
+    typedef EVT_VIGEM_TARGET_REMOVE_RESULT *PFN_VIGEM_TARGET_REMOVE_RESULT;
+
     typedef
         _Function_class_(EVT_VIGEM_X360_NOTIFICATION)
         VOID CALLBACK
@@ -120,6 +141,40 @@ extern "C" {
 
     typedef EVT_VIGEM_DS4_NOTIFICATION *PFN_VIGEM_DS4_NOTIFICATION;
 
+    /** Describes a single target report update within a batch, see vigem_target_update_batch */
+    typedef struct _VIGEM_TARGET_BATCH_UPDATE
+    {
+        /** The target device object to update */
+        PVIGEM_TARGET Target;
+
+        /** The new report, the member matching the target type is used */
+        union
+        {
+            XUSB_REPORT X360;
+
+            DS4_REPORT_EX Ds4;
+
+        } Report;
+
+        /** Receives the outcome of this particular update */
+        VIGEM_ERROR Result;
+
+    } VIGEM_TARGET_BATCH_UPDATE, *PVIGEM_TARGET_BATCH_UPDATE;
+
+    /** Describes a single target removal or addition within a change set, see vigem_target_apply_changes */
+    typedef struct _VIGEM_TARGET_CHANGE
+    {
+        /** The target device object to add or remove */
+        PVIGEM_TARGET Target;
+
+        /** TRUE to remove the (connected) target, FALSE to add it */
+        BOOL Remove;
+
+        /** Receives the outcome of this particular change */
+        VIGEM_ERROR Result;
+
+    } VIGEM_TARGET_CHANGE, *PVIGEM_TARGET_CHANGE;
+
     /**
      *  Allocates an object representing a driver connection
      *
@@ -210,7 +265,8 @@ extern "C" {
      * @param 	vigem 	The driver connection object.
      * @param 	target	The target device object.
      *
-     * @returns	A VIGEM_ERROR.
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support the target
+     * 			options set.
      */
     VIGEM_API VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
 
@@ -218,7 +274,10 @@ extern "C" {
      * Adds a provided target device to the bus driver, which is equal to a device plug-in
      *          event of a physical hardware device. This function immediately returns. An optional
      *          callback may be registered which gets called on error or if the target device has
-     *          become fully operational.
+     *          become fully operational. The plug-in is carried out with overlapped requests, the
+     *          callback is invoked from an I/O completion pump worker thread. Operations cut short
+     *          by vigem_disconnect report VIGEM_ERROR_OPERATION_ABORTED, target options the bus
+     *          doesn't support VIGEM_ERROR_NOT_SUPPORTED.
      *
      * @author	Benjamin "Nefarius" Hglinger-Stelzer
      * @date	28.08.2017
@@ -231,6 +290,23 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_ADD_RESULT result);
 
+    /**
+     * Removes a provided target device from the bus driver without waiting for the outcome.
+     *          An optional callback gets invoked from an I/O completion pump worker thread once
+     *          the removal request has completed, with VIGEM_ERROR_OPERATION_ABORTED if
+     *          vigem_disconnect cut it short.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     * @param 	result	An optional function getting called when the removal has completed.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_remove_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_REMOVE_RESULT result);
+
     /**
      * Removes a provided target device from the bus driver, which is equal to a device
      *           unplug event of a physical hardware device. The target device object may be reused
@@ -347,6 +423,98 @@ extern "C" {
      */
     VIGEM_API USHORT vigem_target_get_pid(PVIGEM_TARGET target);
 
+    /**
+     * Overrides the default interrupt IN polling interval and input report period of the
+     *                provided target device object, e.g. 1 for 1000 Hz or 16 for ~60 Hz. Zero
+     *                restores the default of the emulated device. The advertised polling
+     *                interval is rounded down to a power of two (1, 2, 4 ... 128 ms) as the
+     *                emulated devices are high speed. Must be set before the target is added;
+     *                adding it fails on bus versions not supporting this option.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target			The target device object.
+     * @param 	milliseconds	The interval in milliseconds (1 to 255) or zero.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_report_interval(PVIGEM_TARGET target, ULONG milliseconds);
+
+    /**
+     * Returns the report interval of the provided target device object.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target	The target device object.
+     *
+     * @returns	The interval in milliseconds, zero if the default is used.
+     */
+    VIGEM_API ULONG vigem_target_get_report_interval(PVIGEM_TARGET target);
+
+    /**
+     * Assigns a stable identity to the provided target device object. Targets added with the
+     *                same non-zero key share the instance ID (and for DualShock 4 the MAC address),
+     *                so replugging reuses the device node the host already knows instead of
+     *                installing a new one. Only one target may hold a key at a time; while a
+     *                previous holder is still being removed, adding (also asynchronously or with
+     *                a change set) retries for a short while, then fails with
+     *                VIGEM_ERROR_ALREADY_CONNECTED. Must be set before the target is added; adding
+     *                it fails on bus versions not supporting this option.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target	The target device object.
+     * @param 	key   	The identity key, zero to derive the identity from the serial number.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_ALREADY_CONNECTED if the target is added.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_identity(PVIGEM_TARGET target, ULONG key);
+
+    /**
+     * Returns the stable identity key of the provided target device object.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target	The target device object.
+     *
+     * @returns	The identity key, zero if none is set.
+     */
+    VIGEM_API ULONG vigem_target_get_identity(PVIGEM_TARGET target);
+
+    /**
+     * Limits the rate at which the update functions hand reports of the provided target
+     *                device object to the bus. Reports arriving too early are held back and only
+     *                the latest of them gets submitted once the interval elapsed, so the final
+     *                state is never lost. Independent of this setting, updates identical to the
+     *                last submitted report are always skipped without calling into the bus.
+     *                Timed, batched and report ring updates bypass the limit.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target	The target device object.
+     * @param 	rate  	The maximum number of reports per second (1 to 1000) or zero for no limit.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_max_report_rate(PVIGEM_TARGET target, ULONG rate);
+
+    /**
+     * Returns the report rate limit of the provided target device object.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target	The target device object.
+     *
+     * @returns	The maximum number of reports per second, zero if unlimited.
+     */
+    VIGEM_API ULONG vigem_target_get_max_report_rate(PVIGEM_TARGET target);
+
     /**
      * Sends a state report to the provided target device.
      *
@@ -449,6 +617,216 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_x360_get_user_index(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONG index);
 
+    /**
+     * Maps a shared report ring for the provided target device object. While mapped, the
+     *                vigem_target_*_update functions publish reports into shared memory the bus
+     *                picks up on its own instead of issuing one I/O request per report.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support report rings.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_map_report_ring(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
+
+    /**
+     * Unmaps the report ring of the provided target device object and reverts to submitting
+     *                reports via I/O requests. Called implicitly by vigem_target_remove.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_unmap_report_ring(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
+
+    /**
+     * Sends new input reports to multiple target devices at once, using a single request to
+     *                the bus. The outcome of each update is stored in its Result member.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem  	The driver connection object.
+     * @param 	updates	Array of report updates.
+     * @param 	count  	The number of elements in updates.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support batched updates.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_update_batch(PVIGEM_CLIENT vigem, PVIGEM_TARGET_BATCH_UPDATE updates, ULONG count);
+
+    /**
+     * Retrieves report counters and the submit-to-completion latency histogram the bus
+     *                collected for the provided target device object.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem	  	The driver connection object.
+     * @param 	target	  	The target device object.
+     * @param 	statistics	Pointer to a VIGEM_TARGET_STATISTICS receiving the snapshot.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't collect statistics.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_get_statistics(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_TARGET_STATISTICS statistics);
+
+    /**
+     * Sets the number of worker threads dispatching notification callbacks and asynchronous
+     *                add/remove results of the driver connection object. Takes effect when the
+     *                first asynchronous request is made after connecting; notification callbacks
+     *                of one target never run concurrently.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem	The driver connection object.
+     * @param 	count	The number of worker threads (1 to 16, default 2).
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_set_notification_workers(PVIGEM_CLIENT vigem, ULONG count);
+
+    /**
+     * Enables or disables fire-and-forget report updates on the provided target device
+     *                object. When enabled, the update functions return as soon as the report has
+     *                been handed to the bus; use vigem_target_wait_update to retrieve the outcome.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target 	The target device object.
+     * @param 	enabled	TRUE to not wait for the completion of report updates.
+     */
+    VIGEM_API void vigem_target_set_async_updates(PVIGEM_TARGET target, BOOL enabled);
+
+    /**
+     * Waits for the last report update of the provided target device object to complete
+     *                and returns its outcome.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem 	The driver connection object.
+     * @param 	target	The target device object.
+     *
+     * @returns	A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_wait_update(PVIGEM_CLIENT vigem, PVIGEM_TARGET target);
+
+    /**
+     * Enables or disables coalescing of output reports (rumble, LED, lightbar) on the provided
+     *                target device object. When enabled, the bus keeps only the latest state
+     *                instead of queuing every report, so slow notification callbacks always see
+     *                current values. Must be set before the target is added; adding it fails on
+     *                bus versions not supporting this option.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	target 	The target device object.
+     * @param 	enabled	TRUE to only receive the latest output report state.
+     */
+    VIGEM_API void vigem_target_set_notification_coalescing(PVIGEM_TARGET target, BOOL enabled);
+
+    /**
+     * Removes and adds multiple target devices with a single request to the bus, which
+     *                hands the whole set to PnP at once. All removals are applied before the
+     *                additions. The outcome of each change is stored in its Result member, added
+     *                targets are operational once this function returns.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem  	The driver connection object.
+     * @param 	changes	Array of target changes.
+     * @param 	count  	The number of elements in changes.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support change sets.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_apply_changes(PVIGEM_CLIENT vigem, PVIGEM_TARGET_CHANGE changes, ULONG count);
+
+    /**
+     * Sends a state update to a wired Xbox 360 device carrying a host timestamp and a
+     *                sequence number. The bus measures latency from the provided timestamp and
+     *                counts intermediate reports the host never picked up. Reports published
+     *                through a mapped report ring are sent without timing information.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem    	The driver connection object.
+     * @param 	target   	The target device object.
+     * @param 	report   	The report to send to the target device.
+     * @param 	timestamp	QueryPerformanceCounter value the report state originates from, zero
+     * 						to use the current counter value.
+     *
+     * @returns	A VIGEM_ERROR. Bus versions not supporting timed reports might silently ignore
+     * 			the update.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_x360_update_timed(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, XUSB_REPORT report, LARGE_INTEGER timestamp);
+
+    /**
+     * Sends a full size state update to a wired DualShock 4 device carrying a host timestamp
+     *                and a sequence number. The bus measures latency from the provided timestamp
+     *                and counts intermediate reports the host never picked up. Reports published
+     *                through a mapped report ring are sent without timing information.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem      	The driver connection object.
+     * @param 	target     	The target device object.
+     * @param 	report     	The report buffer.
+     * @param 	timestamp  	QueryPerformanceCounter value the report state originates from, zero
+     * 						to use the current counter value.
+     * @param 	stampReport	TRUE to have the bus derive the report timestamp field from timestamp.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support timed reports.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_ds4_update_timed(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, DS4_REPORT_EX report, LARGE_INTEGER timestamp, BOOL stampReport);
+
+    /**
+     * Waits for the emulated Xenon device to get assigned a user index by the host. Returns
+     *                right away if the index is already known, replacing repeated calls to
+     *                vigem_target_x360_get_user_index while the device is starting up.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem       	The driver connection object.
+     * @param 	target      	The target device object.
+     * @param 	index       	The (zero-based) user index of the Xenon device.
+     * @param 	milliseconds	The time to wait for in milliseconds, INFINITE to wait until the
+     * 							index is known.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_TIMED_OUT if no index got assigned in time,
+     * 			VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support waiting.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_x360_wait_user_index(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONG index, DWORD milliseconds);
+
+    /**
+     * Retrieves the user indices of multiple emulated Xenon devices added through this driver
+     *                connection object with a single request to the bus. Devices without an
+     *                assigned index (e.g. beyond XUSER_MAX_COUNT) report VIGEM_X360_USER_INDEX_NONE.
+     *
+     * @author	Benjamin "Nefarius" Hglinger-Stelzer
+     * @date	14.10.2026
+     *
+     * @param 	vigem  	The driver connection object.
+     * @param 	targets	Array of target device objects.
+     * @param 	indices	Array receiving the user index of each target device object.
+     * @param 	count  	The number of elements in targets and indices.
+     *
+     * @returns	A VIGEM_ERROR. VIGEM_ERROR_NOT_SUPPORTED if the bus doesn't support this request.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_x360_get_user_indices(PVIGEM_CLIENT vigem, PVIGEM_TARGET* targets, PULONG indices, ULONG count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,73 @@ typedef enum _VIGEM_TARGET_TYPE
 
 } VIGEM_TARGET_TYPE, *PVIGEM_TARGET_TYPE;
 
+//
+// Number of buckets in the report latency histogram.
+// 
+#define VIGEM_TARGET_LATENCY_BUCKET_COUNT   20
+
+//
+// Counters collected by the bus driver for each emulated device.
+// 
+typedef struct _VIGEM_TARGET_STATISTICS
+{
+    //
+    // Reports accepted from the owner process (including report ring)
+    // 
+    ULONGLONG ReportsSubmitted;
+
+    //
+    // Reports dropped because they didn't differ from the previous one
+    // 
+    ULONGLONG ReportsUnchanged;
+
+    //
+    // Part of ReportsUnchanged which only differed in bytes changing on their
+    // own (like the DS4 timestamp and packet counters)
+    // 
+    ULONGLONG ReportsUnchangedMasked;
+
+    //
+    // Reports which found no pending interrupt IN request to complete
+    // 
+    ULONGLONG ReportsWithoutPendingRequest;
+
+    //
+    // Intermediate reports never delivered to the host, derived from gaps in
+    // the sequence numbers of timed submissions
+    // 
+    ULONGLONG ReportsSkipped;
+
+    //
+    // Sum of all latency samples in microseconds
+    // 
+    ULONGLONG LatencyTotalMicroseconds;
+
+    //
+    // Submit-to-completion latency (measured from the client timestamp for timed
+    // submissions); bucket 0 counts samples below one microsecond,
+    // bucket N those in [2^(N-1), 2^N) microseconds, the last bucket is open-ended
+    // 
+    ULONGLONG LatencyHistogram[VIGEM_TARGET_LATENCY_BUCKET_COUNT];
+
+    //
+    // Interrupt IN requests currently pending at the time of the query
+    // 
+    ULONG PendingUsbInRequests;
+
+    //
+    // Non-zero if nothing got submitted within the idle timeout configured on
+    // the bus; periodic interrupt IN delivery is paused until the next report
+    // 
+    ULONG Idle;
+
+    //
+    // Idle periods ended by a report submission
+    // 
+    ULONGLONG IdleResumes;
+
+} VIGEM_TARGET_STATISTICS, *PVIGEM_TARGET_STATISTICS;
+
 //
 // Possible XUSB report buttons.
 // 
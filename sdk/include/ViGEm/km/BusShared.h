@@ -53,6 +53,7 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 #define BUSENUM_W_IOCTL(_index_)        CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_WRITE_DATA)
 #define BUSENUM_R_IOCTL(_index_)        CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_READ_DATA)
 #define BUSENUM_RW_IOCTL(_index_)       CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_BUFFERED, FILE_WRITE_DATA | FILE_READ_DATA)
+#define BUSENUM_RW_DIRECT_IOCTL(_index_) CTL_CODE(FILE_DEVICE_BUSENUM, _index_, METHOD_OUT_DIRECT, FILE_WRITE_DATA | FILE_READ_DATA)
 
 #define IOCTL_VIGEM_BASE 0x801
 
@@ -63,6 +64,12 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 #define IOCTL_VIGEM_UNPLUG_TARGET       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x001)
 #define IOCTL_VIGEM_CHECK_VERSION       BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x002)
 #define IOCTL_VIGEM_WAIT_DEVICE_READY   BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x003)
+#define IOCTL_VIGEM_MAP_REPORT_RING     BUSENUM_RW_DIRECT_IOCTL(IOCTL_VIGEM_BASE + 0x004)
+#define IOCTL_VIGEM_SIGNAL_REPORT_RING  BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x005)
+#define IOCTL_VIGEM_SUBMIT_REPORT_BATCH BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x006)
+#define IOCTL_VIGEM_QUERY_TARGET_STATS  BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x007)
+#define IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x008)
+#define IOCTL_VIGEM_APPLY_TARGET_CHANGES BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x009)
 
 #define IOCTL_XUSB_REQUEST_NOTIFICATION BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x200)
 #define IOCTL_XUSB_SUBMIT_REPORT        BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x201)
@@ -71,6 +78,8 @@ DEFINE_GUID(GUID_DEVINTERFACE_BUSENUM_VIGEM,
 //#define IOCTL_XGIP_SUBMIT_REPORT        BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x204)
 //#define IOCTL_XGIP_SUBMIT_INTERRUPT     BUSENUM_W_IOCTL (IOCTL_VIGEM_BASE + 0x205)
 #define IOCTL_XUSB_GET_USER_INDEX       BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x206)
+#define IOCTL_XUSB_WAIT_USER_INDEX      BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x207)
+#define IOCTL_XUSB_GET_SESSION_USER_INDICES BUSENUM_RW_IOCTL(IOCTL_VIGEM_BASE + 0x208)
 
 
 //
@@ -90,9 +99,10 @@ typedef struct _VIGEM_PLUGIN_TARGET
     IN ULONG Size;
 
     //
-    // Serial number of target device.
+    // Serial number of target device. If zero, the bus assigns the next
+    // free serial number and returns it in the output buffer.
     // 
-    IN ULONG SerialNo;
+    IN OUT ULONG SerialNo;
 
     // 
     // Type of the target device to emulate.
@@ -127,6 +137,217 @@ VOID FORCEINLINE VIGEM_PLUGIN_TARGET_INIT(
     PlugIn->TargetType = TargetType;
 }
 
+//
+// Collapse pending output reports into the latest state of the target
+// instead of queuing every single one.
+// 
+#define VIGEM_TARGET_FLAG_COALESCE_OUTPUT_REPORTS   0x00000001
+
+//
+// Extended data structure used in IOCTL_VIGEM_PLUGIN_TARGET requests.
+// 
+// Shares the layout of VIGEM_PLUGIN_TARGET, the bus tells both apart by Size.
+// 
+typedef struct _VIGEM_PLUGIN_TARGET_EX
+{
+    //
+    // sizeof (struct _VIGEM_PLUGIN_TARGET_EX)
+    //
+    IN ULONG Size;
+
+    //
+    // Serial number of target device. If zero, the bus assigns the next
+    // free serial number and returns it in the output buffer.
+    // 
+    IN OUT ULONG SerialNo;
+
+    // 
+    // Type of the target device to emulate.
+    // 
+    VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // If set, the vendor ID the emulated device is reporting
+    // 
+    USHORT VendorId;
+
+    //
+    // If set, the product ID the emulated device is reporting
+    // 
+    USHORT ProductId;
+
+    //
+    // Combination of VIGEM_TARGET_FLAG_* values
+    // 
+    IN ULONG Flags;
+
+} VIGEM_PLUGIN_TARGET_EX, *PVIGEM_PLUGIN_TARGET_EX;
+
+//
+// Initializes a VIGEM_PLUGIN_TARGET_EX structure.
+// 
+VOID FORCEINLINE VIGEM_PLUGIN_TARGET_EX_INIT(
+    _Out_ PVIGEM_PLUGIN_TARGET_EX PlugIn,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Flags
+)
+{
+    RtlZeroMemory(PlugIn, sizeof(VIGEM_PLUGIN_TARGET_EX));
+
+    PlugIn->Size = sizeof(VIGEM_PLUGIN_TARGET_EX);
+    PlugIn->SerialNo = SerialNo;
+    PlugIn->TargetType = TargetType;
+    PlugIn->Flags = Flags;
+}
+
+//
+// Bounds of the per-target report interval in milliseconds (1000 Hz to ~4 Hz)
+// 
+#define VIGEM_REPORT_INTERVAL_MIN   1
+#define VIGEM_REPORT_INTERVAL_MAX   255
+
+//
+// Versioned data structure used in IOCTL_VIGEM_PLUGIN_TARGET requests.
+// 
+// Extends the layout of VIGEM_PLUGIN_TARGET_EX, the bus tells all of them apart by Size.
+// 
+typedef struct _VIGEM_PLUGIN_TARGET_EX2
+{
+    //
+    // sizeof (struct _VIGEM_PLUGIN_TARGET_EX2)
+    //
+    IN ULONG Size;
+
+    //
+    // Serial number of target device. If zero, the bus assigns the next
+    // free serial number and returns it in the output buffer.
+    // 
+    IN OUT ULONG SerialNo;
+
+    // 
+    // Type of the target device to emulate.
+    // 
+    VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // If set, the vendor ID the emulated device is reporting
+    // 
+    USHORT VendorId;
+
+    //
+    // If set, the product ID the emulated device is reporting
+    // 
+    USHORT ProductId;
+
+    //
+    // Combination of VIGEM_TARGET_FLAG_* values
+    // 
+    IN ULONG Flags;
+
+    //
+    // If set, the interrupt IN endpoint polling interval and input report
+    // period in milliseconds (VIGEM_REPORT_INTERVAL_MIN to _MAX)
+    // 
+    IN ULONG ReportInterval;
+
+} VIGEM_PLUGIN_TARGET_EX2, *PVIGEM_PLUGIN_TARGET_EX2;
+
+//
+// Initializes a VIGEM_PLUGIN_TARGET_EX2 structure.
+// 
+VOID FORCEINLINE VIGEM_PLUGIN_TARGET_EX2_INIT(
+    _Out_ PVIGEM_PLUGIN_TARGET_EX2 PlugIn,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Flags,
+    _In_ ULONG ReportInterval
+)
+{
+    RtlZeroMemory(PlugIn, sizeof(VIGEM_PLUGIN_TARGET_EX2));
+
+    PlugIn->Size = sizeof(VIGEM_PLUGIN_TARGET_EX2);
+    PlugIn->SerialNo = SerialNo;
+    PlugIn->TargetType = TargetType;
+    PlugIn->Flags = Flags;
+    PlugIn->ReportInterval = ReportInterval;
+}
+
+//
+// Data structure used in IOCTL_VIGEM_PLUGIN_TARGET requests requesting a
+// stable device identity.
+// 
+typedef struct _VIGEM_PLUGIN_TARGET_EX3
+{
+    //
+    // sizeof (struct _VIGEM_PLUGIN_TARGET_EX3)
+    //
+    IN ULONG Size;
+
+    //
+    // Serial number of target device. If zero, the bus assigns the next
+    // free serial number and returns it in the output buffer.
+    // 
+    IN OUT ULONG SerialNo;
+
+    // 
+    // Type of the target device to emulate.
+    // 
+    VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // If set, the vendor ID the emulated device is reporting
+    // 
+    USHORT VendorId;
+
+    //
+    // If set, the product ID the emulated device is reporting
+    // 
+    USHORT ProductId;
+
+    //
+    // Combination of VIGEM_TARGET_FLAG_* values
+    // 
+    IN ULONG Flags;
+
+    //
+    // If set, the interrupt IN endpoint polling interval and input report
+    // period in milliseconds (VIGEM_REPORT_INTERVAL_MIN to _MAX)
+    // 
+    IN ULONG ReportInterval;
+
+    //
+    // If set, the instance ID (and DS4 MAC address) is derived from this key
+    // instead of the serial number, so replugging with the same key reuses
+    // the existing device node. Plug-in fails with STATUS_DEVICE_ALREADY_ATTACHED
+    // while a target holding the key still exists.
+    // 
+    IN ULONG IdentityKey;
+
+} VIGEM_PLUGIN_TARGET_EX3, *PVIGEM_PLUGIN_TARGET_EX3;
+
+//
+// Initializes a VIGEM_PLUGIN_TARGET_EX3 structure.
+// 
+VOID FORCEINLINE VIGEM_PLUGIN_TARGET_EX3_INIT(
+    _Out_ PVIGEM_PLUGIN_TARGET_EX3 PlugIn,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Flags,
+    _In_ ULONG ReportInterval,
+    _In_ ULONG IdentityKey
+)
+{
+    RtlZeroMemory(PlugIn, sizeof(VIGEM_PLUGIN_TARGET_EX3));
+
+    PlugIn->Size = sizeof(VIGEM_PLUGIN_TARGET_EX3);
+    PlugIn->SerialNo = SerialNo;
+    PlugIn->TargetType = TargetType;
+    PlugIn->Flags = Flags;
+    PlugIn->ReportInterval = ReportInterval;
+    PlugIn->IdentityKey = IdentityKey;
+}
+
 #pragma endregion 
 
 #pragma region Unplug
@@ -210,180 +431,559 @@ VOID FORCEINLINE VIGEM_WAIT_DEVICE_READY_INIT(
 
 #pragma endregion 
 
-#pragma region XUSB (aka Xbox 360 device) section
+#pragma region Report ring
 
 //
-// Data structure used in IOCTL_XUSB_REQUEST_NOTIFICATION requests.
+// Number of slots in a report ring (must be a power of two)
 // 
-typedef struct _XUSB_REQUEST_NOTIFICATION
+#define VIGEM_REPORT_RING_SLOT_COUNT    8
+
+//
+// Maximum report size a ring slot can carry
+// 
+#define VIGEM_REPORT_RING_SLOT_SIZE     64
+
+//
+// A single report published through the ring.
+// 
+typedef struct _VIGEM_REPORT_RING_SLOT
 {
     //
-    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // Valid byte count in Buffer (sizeof(XUSB_REPORT), sizeof(DS4_REPORT) or sizeof(DS4_REPORT_EX))
+    // 
+    ULONG Length;
+
+    //
+    // Report content
+    // 
+    UCHAR Buffer[VIGEM_REPORT_RING_SLOT_SIZE];
+
+} VIGEM_REPORT_RING_SLOT, *PVIGEM_REPORT_RING_SLOT;
+
+//
+// Single-producer ring shared between the client library and the bus.
+// 
+// The client writes the report for sequence N into Slots[N % VIGEM_REPORT_RING_SLOT_COUNT]
+// and publishes it by storing N into WriteSequence. The bus only ever consumes the
+// most recently published slot, intermediate reports are superseded.
+// 
+typedef struct _VIGEM_REPORT_RING
+{
+    //
+    // sizeof(struct _VIGEM_REPORT_RING)
     // 
     ULONG Size;
 
     //
-    // Serial number of target device.
+    // VIGEM_REPORT_RING_SLOT_COUNT
     // 
-    ULONG SerialNo;
+    ULONG SlotCount;
 
     //
-    // Vibration intensity value of the large motor (0-255).
+    // Sequence number of the last published slot, written by the client only
     // 
-    UCHAR LargeMotor;
+    volatile LONG WriteSequence;
 
     //
-    // Vibration intensity value of the small motor (0-255).
+    // Set by the bus if it holds a pending input request and found the ring empty;
+    // the client clears it and sends IOCTL_VIGEM_SIGNAL_REPORT_RING in that case
     // 
-    UCHAR SmallMotor;
+    volatile LONG ConsumerWaiting;
 
     //
-    // Index number of the slot/LED that XUSB.sys has assigned.
+    // Report slots
     // 
-    UCHAR LedNumber;
+    VIGEM_REPORT_RING_SLOT Slots[VIGEM_REPORT_RING_SLOT_COUNT];
 
-} XUSB_REQUEST_NOTIFICATION, *PXUSB_REQUEST_NOTIFICATION;
+} VIGEM_REPORT_RING, *PVIGEM_REPORT_RING;
 
 //
-// Initializes a XUSB_REQUEST_NOTIFICATION structure.
+// Initializes a VIGEM_REPORT_RING structure.
 // 
-VOID FORCEINLINE XUSB_REQUEST_NOTIFICATION_INIT(
-    _Out_ PXUSB_REQUEST_NOTIFICATION Request,
-          _In_ ULONG SerialNo
+VOID FORCEINLINE VIGEM_REPORT_RING_INIT(
+    _Out_ PVIGEM_REPORT_RING Ring
 )
 {
-    RtlZeroMemory(Request, sizeof(XUSB_REQUEST_NOTIFICATION));
+    RtlZeroMemory(Ring, sizeof(VIGEM_REPORT_RING));
 
-    Request->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
-    Request->SerialNo = SerialNo;
+    Ring->Size = sizeof(VIGEM_REPORT_RING);
+    Ring->SlotCount = VIGEM_REPORT_RING_SLOT_COUNT;
 }
 
 //
-// Data structure used in IOCTL_XUSB_SUBMIT_REPORT requests.
+// Data structure used in IOCTL_VIGEM_MAP_REPORT_RING requests.
 // 
-typedef struct _XUSB_SUBMIT_REPORT
+// The output buffer of the request is the VIGEM_REPORT_RING, the request
+// is kept pending for as long as the ring stays mapped and gets completed
+// on cancellation or device removal.
+// 
+typedef struct _VIGEM_MAP_REPORT_RING
 {
     //
-    // sizeof(struct _XUSB_SUBMIT_REPORT)
+    // sizeof(struct _VIGEM_MAP_REPORT_RING)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
     // Serial number of target device.
     // 
-    ULONG SerialNo;
+    IN ULONG SerialNo;
 
-    //
-    // Report to submit to the target device.
     // 
-    XUSB_REPORT Report;
+    // Type of the target device.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
 
-} XUSB_SUBMIT_REPORT, *PXUSB_SUBMIT_REPORT;
+} VIGEM_MAP_REPORT_RING, *PVIGEM_MAP_REPORT_RING;
 
 //
-// Initializes an XUSB report.
+// Initializes a VIGEM_MAP_REPORT_RING structure.
 // 
-VOID FORCEINLINE XUSB_SUBMIT_REPORT_INIT(
-    _Out_ PXUSB_SUBMIT_REPORT Report,
-    _In_ ULONG SerialNo
+VOID FORCEINLINE VIGEM_MAP_REPORT_RING_INIT(
+    _Out_ PVIGEM_MAP_REPORT_RING MapRing,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType
 )
 {
-    RtlZeroMemory(Report, sizeof(XUSB_SUBMIT_REPORT));
+    RtlZeroMemory(MapRing, sizeof(VIGEM_MAP_REPORT_RING));
 
-    Report->Size = sizeof(XUSB_SUBMIT_REPORT);
-    Report->SerialNo = SerialNo;
+    MapRing->Size = sizeof(VIGEM_MAP_REPORT_RING);
+    MapRing->SerialNo = SerialNo;
+    MapRing->TargetType = TargetType;
 }
 
-typedef struct _XUSB_GET_USER_INDEX
+//
+// Data structure used in IOCTL_VIGEM_SIGNAL_REPORT_RING requests.
+// 
+typedef struct _VIGEM_SIGNAL_REPORT_RING
 {
     //
-    // sizeof(struct _XUSB_GET_USER_INDEX)
+    // sizeof(struct _VIGEM_SIGNAL_REPORT_RING)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
     // Serial number of target device.
     // 
-    ULONG SerialNo;
+    IN ULONG SerialNo;
 
-    //
-    // User index of target device.
     // 
-    OUT ULONG UserIndex;
+    // Type of the target device.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
 
-} XUSB_GET_USER_INDEX, *PXUSB_GET_USER_INDEX;
+} VIGEM_SIGNAL_REPORT_RING, *PVIGEM_SIGNAL_REPORT_RING;
 
 //
-// Initializes XUSB_GET_USER_INDEX structure.
+// Initializes a VIGEM_SIGNAL_REPORT_RING structure.
 // 
-VOID FORCEINLINE XUSB_GET_USER_INDEX_INIT(
-    _Out_ PXUSB_GET_USER_INDEX GetRequest,
-    _In_ ULONG SerialNo
+VOID FORCEINLINE VIGEM_SIGNAL_REPORT_RING_INIT(
+    _Out_ PVIGEM_SIGNAL_REPORT_RING Signal,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType
 )
 {
-    RtlZeroMemory(GetRequest, sizeof(XUSB_GET_USER_INDEX));
+    RtlZeroMemory(Signal, sizeof(VIGEM_SIGNAL_REPORT_RING));
 
-    GetRequest->Size = sizeof(XUSB_GET_USER_INDEX);
-    GetRequest->SerialNo = SerialNo;
+    Signal->Size = sizeof(VIGEM_SIGNAL_REPORT_RING);
+    Signal->SerialNo = SerialNo;
+    Signal->TargetType = TargetType;
 }
 
 #pragma endregion
 
-#pragma region DualShock 4 section
+#pragma region Batch submit
 
-typedef struct _DS4_OUTPUT_REPORT
+//
+// Upper limit of entries accepted in a single IOCTL_VIGEM_SUBMIT_REPORT_BATCH request
+// 
+#define VIGEM_SUBMIT_REPORT_BATCH_MAX_ENTRIES   1024
+
+//
+// Report update of a single target within a batch.
+// 
+typedef struct _VIGEM_SUBMIT_REPORT_BATCH_ENTRY
 {
     //
-    // Vibration intensity value of the small motor (0-255).
+    // Serial number of target device.
     // 
-    UCHAR SmallMotor;
+    IN ULONG SerialNo;
+
+    // 
+    // Type of the target device.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
 
     //
-    // Vibration intensity value of the large motor (0-255).
+    // Valid byte count in Report (sizeof(XUSB_REPORT), sizeof(DS4_REPORT) or sizeof(DS4_REPORT_EX))
     // 
-    UCHAR LargeMotor;
+    IN ULONG ReportSize;
 
     //
-    // Color values of the Lightbar.
+    // NTSTATUS of the report submission of this entry
+    // 
+    OUT LONG Status;
+
     //
-    DS4_LIGHTBAR_COLOR LightbarColor;
+    // Report content
+    // 
+    IN union
+    {
+        XUSB_REPORT Xusb;
 
-} DS4_OUTPUT_REPORT, *PDS4_OUTPUT_REPORT;
+        DS4_REPORT Ds4;
+
+        DS4_REPORT_EX Ds4Ex;
+
+    } Report;
+
+} VIGEM_SUBMIT_REPORT_BATCH_ENTRY, *PVIGEM_SUBMIT_REPORT_BATCH_ENTRY;
 
 //
-// Data structure used in IOCTL_DS4_REQUEST_NOTIFICATION requests.
+// Data structure used in IOCTL_VIGEM_SUBMIT_REPORT_BATCH requests.
 // 
-typedef struct _DS4_REQUEST_NOTIFICATION
+// The same buffer is used for in- and output, the bus fills in the
+// Status field of every entry.
+// 
+typedef struct _VIGEM_SUBMIT_REPORT_BATCH
 {
     //
-    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // sizeof(struct _VIGEM_SUBMIT_REPORT_BATCH)
     // 
-    ULONG Size;
+    IN ULONG Size;
 
     //
-    // Serial number of target device.
+    // Number of elements in Entries
     // 
-    ULONG SerialNo;
+    IN ULONG Count;
 
     //
-    // The HID output report
+    // Report updates
     // 
-    DS4_OUTPUT_REPORT Report;
+    IN OUT VIGEM_SUBMIT_REPORT_BATCH_ENTRY Entries[ANYSIZE_ARRAY];
 
-} DS4_REQUEST_NOTIFICATION, *PDS4_REQUEST_NOTIFICATION;
+} VIGEM_SUBMIT_REPORT_BATCH, *PVIGEM_SUBMIT_REPORT_BATCH;
 
 //
-// Initializes a DS4_REQUEST_NOTIFICATION structure.
+// Byte count of a VIGEM_SUBMIT_REPORT_BATCH holding Count entries.
 // 
-VOID FORCEINLINE DS4_REQUEST_NOTIFICATION_INIT(
-    _Out_ PDS4_REQUEST_NOTIFICATION Request,
-    _In_ ULONG SerialNo
+#define VIGEM_SUBMIT_REPORT_BATCH_LENGTH(_count_) \
+    (FIELD_OFFSET(VIGEM_SUBMIT_REPORT_BATCH, Entries) + ((_count_) * sizeof(VIGEM_SUBMIT_REPORT_BATCH_ENTRY)))
+
+//
+// Initializes a VIGEM_SUBMIT_REPORT_BATCH structure.
+// 
+VOID FORCEINLINE VIGEM_SUBMIT_REPORT_BATCH_INIT(
+    _Out_ PVIGEM_SUBMIT_REPORT_BATCH Batch,
+    _In_ ULONG Count
 )
 {
-    RtlZeroMemory(Request, sizeof(DS4_REQUEST_NOTIFICATION));
+    RtlZeroMemory(Batch, VIGEM_SUBMIT_REPORT_BATCH_LENGTH(Count));
 
-    Request->Size = sizeof(DS4_REQUEST_NOTIFICATION);
-    Request->SerialNo = SerialNo;
+    Batch->Size = sizeof(VIGEM_SUBMIT_REPORT_BATCH);
+    Batch->Count = Count;
+}
+
+#pragma endregion
+
+#pragma region Target statistics
+
+//
+// Data structure used in IOCTL_VIGEM_QUERY_TARGET_STATS requests.
+// 
+typedef struct _VIGEM_QUERY_TARGET_STATS
+{
+    //
+    // sizeof(struct _VIGEM_QUERY_TARGET_STATS)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    // 
+    // Type of the target device.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // Statistics snapshot of the target device.
+    // 
+    OUT VIGEM_TARGET_STATISTICS Statistics;
+
+} VIGEM_QUERY_TARGET_STATS, *PVIGEM_QUERY_TARGET_STATS;
+
+//
+// Initializes a VIGEM_QUERY_TARGET_STATS structure.
+// 
+VOID FORCEINLINE VIGEM_QUERY_TARGET_STATS_INIT(
+    _Out_ PVIGEM_QUERY_TARGET_STATS Query,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType
+)
+{
+    RtlZeroMemory(Query, sizeof(VIGEM_QUERY_TARGET_STATS));
+
+    Query->Size = sizeof(VIGEM_QUERY_TARGET_STATS);
+    Query->SerialNo = SerialNo;
+    Query->TargetType = TargetType;
+}
+
+#pragma endregion
+
+#pragma region XUSB (aka Xbox 360 device) section
+
+//
+// Data structure used in IOCTL_XUSB_REQUEST_NOTIFICATION requests.
+// 
+typedef struct _XUSB_REQUEST_NOTIFICATION
+{
+    //
+    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // Vibration intensity value of the large motor (0-255).
+    // 
+    UCHAR LargeMotor;
+
+    //
+    // Vibration intensity value of the small motor (0-255).
+    // 
+    UCHAR SmallMotor;
+
+    //
+    // Index number of the slot/LED that XUSB.sys has assigned.
+    // 
+    UCHAR LedNumber;
+
+} XUSB_REQUEST_NOTIFICATION, *PXUSB_REQUEST_NOTIFICATION;
+
+//
+// Initializes a XUSB_REQUEST_NOTIFICATION structure.
+// 
+VOID FORCEINLINE XUSB_REQUEST_NOTIFICATION_INIT(
+    _Out_ PXUSB_REQUEST_NOTIFICATION Request,
+          _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Request, sizeof(XUSB_REQUEST_NOTIFICATION));
+
+    Request->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
+    Request->SerialNo = SerialNo;
+}
+
+//
+// Data structure used in IOCTL_XUSB_SUBMIT_REPORT requests.
+// 
+typedef struct _XUSB_SUBMIT_REPORT
+{
+    //
+    // sizeof(struct _XUSB_SUBMIT_REPORT)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // Report to submit to the target device.
+    // 
+    XUSB_REPORT Report;
+
+} XUSB_SUBMIT_REPORT, *PXUSB_SUBMIT_REPORT;
+
+//
+// Initializes an XUSB report.
+// 
+VOID FORCEINLINE XUSB_SUBMIT_REPORT_INIT(
+    _Out_ PXUSB_SUBMIT_REPORT Report,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Report, sizeof(XUSB_SUBMIT_REPORT));
+
+    Report->Size = sizeof(XUSB_SUBMIT_REPORT);
+    Report->SerialNo = SerialNo;
+}
+
+typedef struct _XUSB_GET_USER_INDEX
+{
+    //
+    // sizeof(struct _XUSB_GET_USER_INDEX)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // User index of target device.
+    // 
+    OUT ULONG UserIndex;
+
+} XUSB_GET_USER_INDEX, *PXUSB_GET_USER_INDEX;
+
+//
+// Initializes XUSB_GET_USER_INDEX structure.
+// 
+VOID FORCEINLINE XUSB_GET_USER_INDEX_INIT(
+    _Out_ PXUSB_GET_USER_INDEX GetRequest,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(GetRequest, sizeof(XUSB_GET_USER_INDEX));
+
+    GetRequest->Size = sizeof(XUSB_GET_USER_INDEX);
+    GetRequest->SerialNo = SerialNo;
+}
+
+//
+// User index of targets without an XInput slot assigned (yet)
+// 
+#define XUSB_USER_INDEX_NONE                    0xFFFFFFFF
+
+//
+// Upper limit of entries returned by a single IOCTL_XUSB_GET_SESSION_USER_INDICES request
+// 
+#define XUSB_SESSION_USER_INDICES_MAX_ENTRIES   64
+
+//
+// User index of a single target of the session.
+// 
+typedef struct _XUSB_USER_INDEX_ENTRY
+{
+    //
+    // Serial number of target device.
+    // 
+    OUT ULONG SerialNo;
+
+    //
+    // User index of target device or XUSB_USER_INDEX_NONE.
+    // 
+    OUT ULONG UserIndex;
+
+} XUSB_USER_INDEX_ENTRY, *PXUSB_USER_INDEX_ENTRY;
+
+//
+// Data structure used in IOCTL_XUSB_GET_SESSION_USER_INDICES requests.
+// 
+// Reports the user index of every wired Xbox 360 target plugged in
+// through the file handle the request is sent on.
+// 
+typedef struct _XUSB_GET_SESSION_USER_INDICES
+{
+    //
+    // sizeof(struct _XUSB_GET_SESSION_USER_INDICES)
+    // 
+    IN ULONG Size;
+
+    //
+    // Number of elements Entries can hold
+    // 
+    IN ULONG Capacity;
+
+    //
+    // Number of elements filled in by the bus
+    // 
+    OUT ULONG Count;
+
+    //
+    // User index of each target
+    // 
+    OUT XUSB_USER_INDEX_ENTRY Entries[ANYSIZE_ARRAY];
+
+} XUSB_GET_SESSION_USER_INDICES, *PXUSB_GET_SESSION_USER_INDICES;
+
+//
+// Byte count of a XUSB_GET_SESSION_USER_INDICES holding Capacity entries.
+// 
+#define XUSB_GET_SESSION_USER_INDICES_LENGTH(_capacity_) \
+    (FIELD_OFFSET(XUSB_GET_SESSION_USER_INDICES, Entries) + ((_capacity_) * sizeof(XUSB_USER_INDEX_ENTRY)))
+
+//
+// Initializes a XUSB_GET_SESSION_USER_INDICES structure.
+// 
+VOID FORCEINLINE XUSB_GET_SESSION_USER_INDICES_INIT(
+    _Out_ PXUSB_GET_SESSION_USER_INDICES GetRequest,
+    _In_ ULONG Capacity
+)
+{
+    RtlZeroMemory(GetRequest, XUSB_GET_SESSION_USER_INDICES_LENGTH(Capacity));
+
+    GetRequest->Size = sizeof(XUSB_GET_SESSION_USER_INDICES);
+    GetRequest->Capacity = Capacity;
+}
+
+#pragma endregion
+
+#pragma region DualShock 4 section
+
+typedef struct _DS4_OUTPUT_REPORT
+{
+    //
+    // Vibration intensity value of the small motor (0-255).
+    // 
+    UCHAR SmallMotor;
+
+    //
+    // Vibration intensity value of the large motor (0-255).
+    // 
+    UCHAR LargeMotor;
+
+    //
+    // Color values of the Lightbar.
+    //
+    DS4_LIGHTBAR_COLOR LightbarColor;
+
+} DS4_OUTPUT_REPORT, *PDS4_OUTPUT_REPORT;
+
+//
+// Data structure used in IOCTL_DS4_REQUEST_NOTIFICATION requests.
+// 
+typedef struct _DS4_REQUEST_NOTIFICATION
+{
+    //
+    // sizeof(struct _XUSB_REQUEST_NOTIFICATION)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // The HID output report
+    // 
+    DS4_OUTPUT_REPORT Report;
+
+} DS4_REQUEST_NOTIFICATION, *PDS4_REQUEST_NOTIFICATION;
+
+//
+// Initializes a DS4_REQUEST_NOTIFICATION structure.
+// 
+VOID FORCEINLINE DS4_REQUEST_NOTIFICATION_INIT(
+    _Out_ PDS4_REQUEST_NOTIFICATION Request,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Request, sizeof(DS4_REQUEST_NOTIFICATION));
+
+    Request->Size = sizeof(DS4_REQUEST_NOTIFICATION);
+    Request->SerialNo = SerialNo;
 }
 
 //
@@ -465,3 +1065,361 @@ VOID FORCEINLINE DS4_SUBMIT_REPORT_EX_INIT(
 }
 
 #pragma endregion
+
+#pragma region Notification batch
+
+//
+// Upper limit of entries returned by a single IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH request
+// 
+#define VIGEM_REQUEST_NOTIFICATION_BATCH_MAX_ENTRIES    64
+
+//
+// Output report received from the host, decoded per target type.
+// 
+typedef struct _VIGEM_NOTIFICATION_ENTRY
+{
+    //
+    // Performance counter value (KeQueryPerformanceCounter/QueryPerformanceCounter)
+    // of when the host sent the output report.
+    // 
+    LARGE_INTEGER Timestamp;
+
+    //
+    // Running number of output reports received from the host. Gaps between
+    // consecutive entries count the reports that got coalesced or dropped.
+    // 
+    ULONG Sequence;
+
+    //
+    // Decoded output report
+    // 
+    union
+    {
+        struct
+        {
+            //
+            // Vibration intensity value of the large motor (0-255).
+            // 
+            UCHAR LargeMotor;
+
+            //
+            // Vibration intensity value of the small motor (0-255).
+            // 
+            UCHAR SmallMotor;
+
+            //
+            // Index number of the slot/LED that XUSB.sys has assigned.
+            // 
+            UCHAR LedNumber;
+
+        } Xusb;
+
+        DS4_OUTPUT_REPORT Ds4;
+
+    } Report;
+
+} VIGEM_NOTIFICATION_ENTRY, *PVIGEM_NOTIFICATION_ENTRY;
+
+//
+// Data structure used in IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH requests.
+// 
+// The request stays pending until at least one output report is queued,
+// then gets completed with every queued report up to MaxCount at once.
+// 
+typedef struct _VIGEM_REQUEST_NOTIFICATION_BATCH
+{
+    //
+    // sizeof(struct _VIGEM_REQUEST_NOTIFICATION_BATCH)
+    // 
+    IN ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    IN ULONG SerialNo;
+
+    // 
+    // Type of the target device.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // Number of elements the output buffer can hold
+    // 
+    IN ULONG MaxCount;
+
+    //
+    // Number of valid elements in Entries
+    // 
+    OUT ULONG Count;
+
+    //
+    // Queued output reports, oldest first
+    // 
+    OUT VIGEM_NOTIFICATION_ENTRY Entries[ANYSIZE_ARRAY];
+
+} VIGEM_REQUEST_NOTIFICATION_BATCH, *PVIGEM_REQUEST_NOTIFICATION_BATCH;
+
+//
+// Byte count of a VIGEM_REQUEST_NOTIFICATION_BATCH holding Count entries.
+// 
+#define VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(_count_) \
+    (FIELD_OFFSET(VIGEM_REQUEST_NOTIFICATION_BATCH, Entries) + ((_count_) * sizeof(VIGEM_NOTIFICATION_ENTRY)))
+
+//
+// Initializes a VIGEM_REQUEST_NOTIFICATION_BATCH structure.
+// 
+VOID FORCEINLINE VIGEM_REQUEST_NOTIFICATION_BATCH_INIT(
+    _Out_ PVIGEM_REQUEST_NOTIFICATION_BATCH Request,
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG MaxCount
+)
+{
+    RtlZeroMemory(Request, VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(MaxCount));
+
+    Request->Size = sizeof(VIGEM_REQUEST_NOTIFICATION_BATCH);
+    Request->SerialNo = SerialNo;
+    Request->TargetType = TargetType;
+    Request->MaxCount = MaxCount;
+}
+
+#pragma endregion
+
+#pragma region Target change set
+
+//
+// Upper limit of entries accepted in a single IOCTL_VIGEM_APPLY_TARGET_CHANGES request
+// 
+#define VIGEM_TARGET_CHANGE_SET_MAX_ENTRIES     64
+
+//
+// Unplug the target identified by SerialNo (all of the session if zero)
+// 
+#define VIGEM_TARGET_CHANGE_REMOVE              0x00000001
+
+//
+// Plug in a new target described by TargetType, VendorId, ProductId, Flags, ReportInterval
+// and IdentityKey
+// 
+#define VIGEM_TARGET_CHANGE_ADD                 0x00000002
+
+//
+// Single removal or addition within a change set.
+// 
+typedef struct _VIGEM_TARGET_CHANGE_ENTRY
+{
+    //
+    // VIGEM_TARGET_CHANGE_REMOVE or VIGEM_TARGET_CHANGE_ADD
+    // 
+    IN ULONG Operation;
+
+    //
+    // Serial number of target device. If zero on addition, the bus assigns
+    // the next free serial number and returns it here.
+    // 
+    IN OUT ULONG SerialNo;
+
+    // 
+    // Type of the target device to emulate.
+    // 
+    IN VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // If set, the vendor ID the emulated device is reporting
+    // 
+    IN USHORT VendorId;
+
+    //
+    // If set, the product ID the emulated device is reporting
+    // 
+    IN USHORT ProductId;
+
+    //
+    // Combination of VIGEM_TARGET_FLAG_* values
+    // 
+    IN ULONG Flags;
+
+    //
+    // If set, the report interval in milliseconds, see VIGEM_PLUGIN_TARGET_EX2
+    // 
+    IN ULONG ReportInterval;
+
+    //
+    // If set, the stable identity key, see VIGEM_PLUGIN_TARGET_EX3
+    // 
+    IN ULONG IdentityKey;
+
+    //
+    // NTSTATUS of this entry
+    // 
+    OUT LONG Status;
+
+} VIGEM_TARGET_CHANGE_ENTRY, *PVIGEM_TARGET_CHANGE_ENTRY;
+
+//
+// Data structure used in IOCTL_VIGEM_APPLY_TARGET_CHANGES requests.
+// 
+// All removals are applied before the additions and PnP gets notified
+// about the complete set at once. The same buffer is used for in- and
+// output, the bus fills in the Status field of every entry.
+// 
+typedef struct _VIGEM_TARGET_CHANGE_SET
+{
+    //
+    // sizeof(struct _VIGEM_TARGET_CHANGE_SET)
+    // 
+    IN ULONG Size;
+
+    //
+    // Number of elements in Entries
+    // 
+    IN ULONG Count;
+
+    //
+    // Removals and additions
+    // 
+    IN OUT VIGEM_TARGET_CHANGE_ENTRY Entries[ANYSIZE_ARRAY];
+
+} VIGEM_TARGET_CHANGE_SET, *PVIGEM_TARGET_CHANGE_SET;
+
+//
+// Byte count of a VIGEM_TARGET_CHANGE_SET holding Count entries.
+// 
+#define VIGEM_TARGET_CHANGE_SET_LENGTH(_count_) \
+    (FIELD_OFFSET(VIGEM_TARGET_CHANGE_SET, Entries) + ((_count_) * sizeof(VIGEM_TARGET_CHANGE_ENTRY)))
+
+//
+// Initializes a VIGEM_TARGET_CHANGE_SET structure.
+// 
+VOID FORCEINLINE VIGEM_TARGET_CHANGE_SET_INIT(
+    _Out_ PVIGEM_TARGET_CHANGE_SET ChangeSet,
+    _In_ ULONG Count
+)
+{
+    RtlZeroMemory(ChangeSet, VIGEM_TARGET_CHANGE_SET_LENGTH(Count));
+
+    ChangeSet->Size = sizeof(VIGEM_TARGET_CHANGE_SET);
+    ChangeSet->Count = Count;
+}
+
+#pragma endregion
+
+#pragma region Timed submit
+
+//
+// Sets the DS4 report timestamp from Timing.Timestamp instead of trusting the report
+// 
+#define VIGEM_REPORT_TIMING_FLAG_STAMP_DS4_TIMESTAMP    0x00000001
+
+//
+// Client-side timing information accompanying a submitted report.
+// 
+typedef struct _VIGEM_REPORT_TIMING
+{
+    //
+    // Combination of VIGEM_REPORT_TIMING_FLAG_* values
+    // 
+    ULONG Flags;
+
+    //
+    // Running number of reports submitted to this target, zero if not tracked.
+    // Gaps observed on delivery get counted as skipped reports.
+    // 
+    ULONG Sequence;
+
+    //
+    // Performance counter value (QueryPerformanceCounter/KeQueryPerformanceCounter)
+    // of when the client produced the report.
+    // 
+    LARGE_INTEGER Timestamp;
+
+} VIGEM_REPORT_TIMING, *PVIGEM_REPORT_TIMING;
+
+//
+// Data structure used in IOCTL_XUSB_SUBMIT_REPORT requests carrying timing information.
+// 
+typedef struct _XUSB_SUBMIT_REPORT_TIMED
+{
+    //
+    // sizeof(struct _XUSB_SUBMIT_REPORT_TIMED)
+    // 
+    ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    ULONG SerialNo;
+
+    //
+    // Report to submit to the target device.
+    // 
+    XUSB_REPORT Report;
+
+    //
+    // Client timing of the report.
+    // 
+    VIGEM_REPORT_TIMING Timing;
+
+} XUSB_SUBMIT_REPORT_TIMED, *PXUSB_SUBMIT_REPORT_TIMED;
+
+//
+// Initializes a timed XUSB report.
+// 
+VOID FORCEINLINE XUSB_SUBMIT_REPORT_TIMED_INIT(
+    _Out_ PXUSB_SUBMIT_REPORT_TIMED Report,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Report, sizeof(XUSB_SUBMIT_REPORT_TIMED));
+
+    Report->Size = sizeof(XUSB_SUBMIT_REPORT_TIMED);
+    Report->SerialNo = SerialNo;
+}
+
+#include <pshpack1.h>
+
+//
+// Data structure used in IOCTL_DS4_SUBMIT_REPORT requests carrying timing information.
+// 
+typedef struct _DS4_SUBMIT_REPORT_TIMED
+{
+    //
+    // sizeof(struct _DS4_SUBMIT_REPORT_TIMED)
+    // 
+    _In_ ULONG Size;
+
+    //
+    // Serial number of target device.
+    // 
+    _In_ ULONG SerialNo;
+
+    //
+    // Full size HID report excluding fixed Report ID.
+    // 
+    _In_ DS4_REPORT_EX Report;
+
+    //
+    // Client timing of the report.
+    // 
+    _In_ VIGEM_REPORT_TIMING Timing;
+
+} DS4_SUBMIT_REPORT_TIMED, *PDS4_SUBMIT_REPORT_TIMED;
+
+#include <poppack.h>
+
+//
+// Initializes a timed DualShock 4 report.
+// 
+VOID FORCEINLINE DS4_SUBMIT_REPORT_TIMED_INIT(
+    _Out_ PDS4_SUBMIT_REPORT_TIMED Report,
+    _In_ ULONG SerialNo
+)
+{
+    RtlZeroMemory(Report, sizeof(DS4_SUBMIT_REPORT_TIMED));
+
+    Report->Size = sizeof(DS4_SUBMIT_REPORT_TIMED);
+    Report->SerialNo = SerialNo;
+}
+
+#pragma endregion
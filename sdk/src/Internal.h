@@ -30,6 +30,33 @@ SOFTWARE.
 // 
 #define VIGEM_TARGETS_MAX   USHRT_MAX
 
+//
+// Upper limit and default of I/O completion pump worker threads
+// 
+#define VIGEM_PUMP_WORKERS_MAX                  16
+#define VIGEM_PUMP_WORKERS_DEFAULT              2
+
+//
+// Notification requests kept in flight for every target
+// 
+#define VIGEM_NOTIFICATION_REQUESTS_PER_TARGET  4
+
+//
+// Output reports fetched at once by a batched notification request
+// 
+#define VIGEM_NOTIFICATION_BATCH_ENTRIES        16
+
+//
+// Upper limit of the client-side report rate of a target, in reports per second
+// 
+#define VIGEM_REPORT_RATE_MAX                   1000
+
+//
+// Plug-in retries while a previous holder of a target's identity key is being removed
+// 
+#define VIGEM_IDENTITY_RETRIES                  10
+#define VIGEM_IDENTITY_RETRY_INTERVAL_MS        50
+
 
 //
 // Represents a driver connection object.
@@ -38,8 +65,184 @@ typedef struct _VIGEM_CLIENT_T
 {
     HANDLE hBusDevice;
 
+    //
+    // Guards starting the I/O completion pump
+    // 
+    SRWLOCK PumpLock;
+
+    //
+    // Completion port bound to hBusDevice, created on first asynchronous request
+    // 
+    HANDLE hCompletionPort;
+
+    //
+    // I/O completion pump worker threads
+    // 
+    HANDLE PumpWorkers[VIGEM_PUMP_WORKERS_MAX];
+
+    //
+    // Number of running I/O completion pump worker threads
+    // 
+    ULONG PumpWorkerCount;
+
+    //
+    // Requested number of I/O completion pump worker threads, zero for default
+    // 
+    ULONG PumpPoolSize;
+
+    //
+    // Pump requests in flight across all targets
+    // 
+    volatile LONG PumpRequestsPending;
+
+    //
+    // Set while tearing down the I/O completion pump
+    // 
+    volatile LONG PumpStopping;
+
+    //
+    // Guards PumpRequestsIssued
+    // 
+    SRWLOCK PumpRequestsLock;
+
+    //
+    // Pump requests (VIGEM_PUMP_REQUEST) issued and not yet dequeued from the port
+    // 
+    LIST_ENTRY PumpRequestsIssued;
+
+    //
+    // Guards ReportFlushTargets
+    // 
+    SRWLOCK ReportFlushLock;
+
+    //
+    // Targets holding back a report to be flushed through this client
+    // 
+    LIST_ENTRY ReportFlushTargets;
+
 } VIGEM_CLIENT;
 
+//
+// Kinds of requests completed through the I/O completion pump.
+// 
+typedef enum _VIGEM_PUMP_REQUEST_TYPE
+{
+    VIGEM_PUMP_REQUEST_NOTIFICATION,
+    VIGEM_PUMP_REQUEST_TARGET_OPERATION
+} VIGEM_PUMP_REQUEST_TYPE, *PVIGEM_PUMP_REQUEST_TYPE;
+
+//
+// Common header of requests completed through the I/O completion pump.
+// 
+typedef struct _VIGEM_PUMP_REQUEST
+{
+    OVERLAPPED Overlapped;
+
+    VIGEM_PUMP_REQUEST_TYPE Type;
+
+    //
+    // Entry in VIGEM_CLIENT.PumpRequestsIssued
+    // 
+    LIST_ENTRY Link;
+
+    //
+    // Win32 error of a request that failed to be issued and got posted to the port instead
+    // 
+    DWORD IssueError;
+
+} VIGEM_PUMP_REQUEST, *PVIGEM_PUMP_REQUEST;
+
+//
+// Notification request of a target device object handled by the pump.
+// 
+typedef struct _VIGEM_NOTIFICATION_REQUEST
+{
+    VIGEM_PUMP_REQUEST Header;
+
+    PVIGEM_TARGET Target;
+
+    //
+    // Issued as IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH
+    // 
+    BOOL Batched;
+
+    union
+    {
+        XUSB_REQUEST_NOTIFICATION Xusb;
+
+        DS4_REQUEST_NOTIFICATION Ds4;
+
+        struct
+        {
+            VIGEM_REQUEST_NOTIFICATION_BATCH Request;
+
+            // Continuation of Request.Entries
+            VIGEM_NOTIFICATION_ENTRY Entries[VIGEM_NOTIFICATION_BATCH_ENTRIES - 1];
+
+        } Batch;
+
+    } Payload;
+
+} VIGEM_NOTIFICATION_REQUEST, *PVIGEM_NOTIFICATION_REQUEST;
+
+//
+// Steps of an asynchronous target add or remove operation.
+// 
+typedef enum _VIGEM_TARGET_OPERATION_STATE
+{
+    VIGEM_TARGET_OPERATION_PLUGIN,
+    VIGEM_TARGET_OPERATION_WAIT_DEVICE_READY,
+    VIGEM_TARGET_OPERATION_UNPLUG
+} VIGEM_TARGET_OPERATION_STATE, *PVIGEM_TARGET_OPERATION_STATE;
+
+//
+// Asynchronous target add or remove operation handled by the pump.
+// 
+typedef struct _VIGEM_TARGET_OPERATION
+{
+    VIGEM_PUMP_REQUEST Header;
+
+    PVIGEM_TARGET Target;
+
+    VIGEM_TARGET_OPERATION_STATE State;
+
+    //
+    // Set if the unplug step rolls back a failed add operation
+    // 
+    BOOL Rollback;
+
+    //
+    // PFN_VIGEM_TARGET_ADD_RESULT or PFN_VIGEM_TARGET_REMOVE_RESULT
+    // 
+    FARPROC Result;
+
+    //
+    // Client the operation runs on, for the identity retry timer
+    // 
+    PVIGEM_CLIENT Client;
+
+    //
+    // Plug-in retries spent waiting out a departing holder of the identity key
+    // 
+    ULONG IdentityRetries;
+
+    //
+    // Re-issues the plug-in step after VIGEM_IDENTITY_RETRY_INTERVAL_MS, created on demand
+    // 
+    PTP_TIMER IdentityRetryTimer;
+
+    union
+    {
+        VIGEM_PLUGIN_TARGET_EX3 PlugIn;
+
+        VIGEM_WAIT_DEVICE_READY WaitDeviceReady;
+
+        VIGEM_UNPLUG_TARGET Unplug;
+
+    } Payload;
+
+} VIGEM_TARGET_OPERATION, *PVIGEM_TARGET_OPERATION;
+
 //
 // Represents the (connection) state of a target device object.
 // 
@@ -64,8 +267,39 @@ typedef struct _VIGEM_TARGET_T
     USHORT VendorId;
     USHORT ProductId;
     VIGEM_TARGET_TYPE Type;
+    ULONG Flags;
+    ULONG ReportInterval;
+    ULONG IdentityKey;
     FARPROC Notification;
     LPVOID NotificationUserData;
 
-	HANDLE cancelNotificationThreadEvent;
+    PVIGEM_CLIENT NotificationClient;
+    SRWLOCK NotificationLock;
+    HANDLE NotificationsDrainedEvent;
+    volatile LONG NotificationRequestsPending;
+    volatile LONG NotificationBatchUnsupported;
+    ULONG NotificationSequence;
+    VIGEM_NOTIFICATION_REQUEST NotificationRequests[VIGEM_NOTIFICATION_REQUESTS_PER_TARGET];
+
+    PVIGEM_REPORT_RING ReportRing;
+    OVERLAPPED ReportRingOverlapped;
+
+    SRWLOCK SubmitLock;
+    OVERLAPPED SubmitOverlapped;
+    BOOL SubmitPending;
+    BOOL SubmitAsync;
+    DWORD SubmitResult;
+    volatile LONG SubmitSequence;
+
+    SRWLOCK ReportCacheLock;
+    ULONG CachedReportLength;
+    UCHAR CachedReport[sizeof(DS4_REPORT_EX)];
+    ULONG HeldReportLength;
+    UCHAR HeldReport[sizeof(DS4_REPORT_EX)];
+    ULONG MaxReportRate;
+    LONGLONG ReportSubmitTime;
+    PTP_TIMER ReportFlushTimer;
+    PVIGEM_CLIENT ReportFlushClient;
+    LIST_ENTRY ReportFlushLink;
+    volatile LONG ReportCacheStale;
 } VIGEM_TARGET;
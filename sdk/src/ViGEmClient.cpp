@@ -45,7 +45,6 @@ SOFTWARE.
 #include <climits>
 #include <vector>
 #include <algorithm>
-#include <thread>
 #include <functional>
 
 //
@@ -74,6 +73,23 @@ LONG WINAPI vigem_internal_exception_handler(struct _EXCEPTION_POINTERS* apExcep
 #endif
 
 
+//
+// Creates the event of an OVERLAPPED structure the caller waits on. The set
+// low-order bit keeps the completion from being queued to the notification
+// completion port the bus device handle may be associated with.
+// 
+HANDLE FORCEINLINE VIGEM_SYNC_EVENT_CREATE(
+    _In_ BOOL ManualReset
+)
+{
+    const auto hEvent = CreateEvent(nullptr, ManualReset, FALSE, nullptr);
+
+    if (!hEvent)
+        return nullptr;
+
+    return reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(hEvent) | 1);
+}
+
 //
 // Initializes a virtual gamepad object.
 // 
@@ -91,413 +107,2581 @@ PVIGEM_TARGET FORCEINLINE VIGEM_TARGET_ALLOC_INIT(
     target->Size = sizeof(VIGEM_TARGET);
     target->State = VIGEM_TARGET_INITIALIZED;
     target->Type = Type;
-    return target;
-}
-
-#ifdef VIGEM_USE_CRASH_HANDLER
-LONG WINAPI vigem_internal_exception_handler(struct _EXCEPTION_POINTERS* apExceptionInfo)
-{
-    const auto mhLib = LoadLibrary(L"dbghelp.dll");
-    const auto pDump = reinterpret_cast<MINIDUMPWRITEDUMP>(GetProcAddress(mhLib, "MiniDumpWriteDump"));
-
-    const auto hFile = CreateFile(
-        L"ViGEmClient.dmp",
-        GENERIC_WRITE,
-        FILE_SHARE_WRITE,
-        nullptr,
-        CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL,
-        nullptr
-    );
 
-	const DWORD flags = MiniDumpWithFullMemory | MiniDumpWithHandleData | MiniDumpWithUnloadedModules |
-		MiniDumpWithUnloadedModules | MiniDumpWithProcessThreadData |
-		MiniDumpWithFullMemoryInfo | MiniDumpWithThreadInfo |
-		MiniDumpWithFullAuxiliaryState | MiniDumpIgnoreInaccessibleMemory |
-		MiniDumpWithTokenInformation;
+    //
+    // Reused by every report submission
+    // 
+    target->SubmitOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(TRUE);
 
-    if (hFile != INVALID_HANDLE_VALUE)
+    if (!target->SubmitOverlapped.hEvent)
     {
-        _MINIDUMP_EXCEPTION_INFORMATION ExInfo;
-        ExInfo.ThreadId = GetCurrentThreadId();
-        ExInfo.ExceptionPointers = apExceptionInfo;
-        ExInfo.ClientPointers = FALSE;
-
-        pDump(
-			GetCurrentProcess(), 
-			GetCurrentProcessId(), 
-			hFile, 
-			(MINIDUMP_TYPE)flags,
-			&ExInfo, 
-			nullptr, 
-			nullptr
-		);
-        CloseHandle(hFile);
+        free(target);
+        return nullptr;
     }
 
-    return EXCEPTION_CONTINUE_SEARCH;
+    return target;
 }
-#endif
 
-PVIGEM_CLIENT vigem_alloc()
+//
+// Waits for the outstanding report submission of a target, if any. Must be
+// called with SubmitLock held. Returns the Win32 error code of the submission.
+// 
+DWORD vigem_internal_submit_complete(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 {
-#ifdef VIGEM_USE_CRASH_HANDLER
-    SetUnhandledExceptionFilter(vigem_internal_exception_handler);
-#endif
+    DWORD transferred = 0;
 
-    const auto driver = static_cast<PVIGEM_CLIENT>(malloc(sizeof(VIGEM_CLIENT)));
+    if (!target->SubmitPending)
+        return target->SubmitResult;
 
-    if (!driver)
-        return nullptr;
+    target->SubmitPending = FALSE;
 
-    RtlZeroMemory(driver, sizeof(VIGEM_CLIENT));
-    driver->hBusDevice = INVALID_HANDLE_VALUE;
+    target->SubmitResult = (GetOverlappedResult(vigem->hBusDevice, &target->SubmitOverlapped, &transferred, TRUE) == 0)
+        ? GetLastError()
+        : ERROR_SUCCESS;
 
-    return driver;
-}
+    //
+    // Report never made it to the bus, its repetitions must not be filtered.
+    // The cache lock may already be held further up, so it's flagged only.
+    // 
+    if (target->SubmitResult != ERROR_SUCCESS)
+        InterlockedExchange(&target->ReportCacheStale, TRUE);
 
-void vigem_free(PVIGEM_CLIENT vigem)
-{
-    if (vigem)
-        free(vigem);
+    return target->SubmitResult;
 }
 
-VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
+//
+// Submits a report through the reusable OVERLAPPED context of a target. Returns
+// the Win32 error code of the submission, ERROR_SUCCESS for pending ones in
+// fire-and-forget mode.
+// 
+DWORD vigem_internal_submit_report(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    DWORD ioControlCode,
+    LPVOID report,
+    DWORD length
+)
 {
-    if (!vigem)
-        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+    DWORD transferred = 0;
+    DWORD result = ERROR_SUCCESS;
 
-    SP_DEVICE_INTERFACE_DATA deviceInterfaceData = { 0 };
-    deviceInterfaceData.cbSize = sizeof(deviceInterfaceData);
-    DWORD memberIndex = 0;
-    DWORD requiredSize = 0;
-    auto error = VIGEM_ERROR_BUS_NOT_FOUND;
+    AcquireSRWLockExclusive(&target->SubmitLock);
 
-    // check for already open handle as re-opening accidentally would destroy all live targets
-    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
-    {
-        return VIGEM_ERROR_BUS_ALREADY_CONNECTED;
-    }
+    //
+    // Context might still be in use by a fire-and-forget submission
+    // 
+    (void)vigem_internal_submit_complete(vigem, target);
 
-    const auto deviceInfoSet = SetupDiGetClassDevs(
-        &GUID_DEVINTERFACE_BUSENUM_VIGEM,
-        nullptr,
-        nullptr,
-        DIGCF_PRESENT | DIGCF_DEVICEINTERFACE
-    );
+    const auto hEvent = target->SubmitOverlapped.hEvent;
+    memset(&target->SubmitOverlapped, 0, sizeof(OVERLAPPED));
+    target->SubmitOverlapped.hEvent = hEvent;
 
-    // enumerate device instances
-    while (SetupDiEnumDeviceInterfaces(
-        deviceInfoSet,
+    //
+    // Buffered I/O; the report is captured before DeviceIoControl returns
+    // 
+    if (!DeviceIoControl(
+        vigem->hBusDevice,
+        ioControlCode,
+        report,
+        length,
         nullptr,
-        &GUID_DEVINTERFACE_BUSENUM_VIGEM,
-        memberIndex++,
-        &deviceInterfaceData
-    ))
+        0,
+        &transferred,
+        &target->SubmitOverlapped
+    ) && GetLastError() != ERROR_IO_PENDING)
     {
-        // get required target buffer size
-        SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &deviceInterfaceData, nullptr, 0, &requiredSize, nullptr);
+        result = GetLastError();
+        target->SubmitResult = result;
+    }
+    else
+    {
+        target->SubmitPending = TRUE;
 
-        // allocate target buffer
-        const auto detailDataBuffer = static_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA>(malloc(requiredSize));
-        detailDataBuffer->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+        if (!target->SubmitAsync)
+            result = vigem_internal_submit_complete(vigem, target);
+    }
 
-        // get detail buffer
-        if (!SetupDiGetDeviceInterfaceDetail(
-            deviceInfoSet,
-            &deviceInterfaceData,
-            detailDataBuffer,
-            requiredSize,
-            &requiredSize,
-            nullptr
-        ))
-        {
-            SetupDiDestroyDeviceInfoList(deviceInfoSet);
-            free(detailDataBuffer);
-            error = VIGEM_ERROR_BUS_NOT_FOUND;
-            continue;
-        }
+    ReleaseSRWLockExclusive(&target->SubmitLock);
 
-        // bus found, open it
-        vigem->hBusDevice = CreateFile(
-            detailDataBuffer->DevicePath,
-            GENERIC_READ | GENERIC_WRITE,
-            FILE_SHARE_READ | FILE_SHARE_WRITE,
-            nullptr,
-            OPEN_EXISTING,
-            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_OVERLAPPED,
-            nullptr
-        );
+    return result;
+}
 
-        // check bus open result
-        if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-        {
-            error = VIGEM_ERROR_BUS_ACCESS_FAILED;
-            free(detailDataBuffer);
-            continue;
-        }
+//
+// Publishes a report through the mapped report ring of a target.
+// 
+VIGEM_ERROR vigem_internal_report_ring_publish(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    const void* report,
+    ULONG length
+)
+{
+    const auto ring = target->ReportRing;
+    const auto sequence = static_cast<ULONG>(ring->WriteSequence) + 1;
+    const auto slot = &ring->Slots[sequence % VIGEM_REPORT_RING_SLOT_COUNT];
+
+    slot->Length = length;
+    memcpy(slot->Buffer, report, length);
+
+    //
+    // Full barrier; makes the slot visible before the sequence and orders
+    // the following read of the doorbell flag after the publication
+    // 
+    InterlockedExchange(&ring->WriteSequence, static_cast<LONG>(sequence));
+
+    //
+    // Bus is idle-waiting on us, ring the doorbell
+    // 
+    if (InterlockedExchange(&ring->ConsumerWaiting, FALSE) == FALSE)
+        return VIGEM_ERROR_NONE;
 
-        DWORD transferred = 0;
-        OVERLAPPED lOverlapped = { 0 };
-        lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
-        VIGEM_CHECK_VERSION version;
-        VIGEM_CHECK_VERSION_INIT(&version, VIGEM_COMMON_VERSION);
+    VIGEM_SIGNAL_REPORT_RING signal;
+    VIGEM_SIGNAL_REPORT_RING_INIT(&signal, target->SerialNo, target->Type);
 
-        // send compiled library version to driver to check compatibility
-        DeviceIoControl(
-            vigem->hBusDevice,
-            IOCTL_VIGEM_CHECK_VERSION,
-            &version,
-            version.Size,
-            nullptr,
-            0,
-            &transferred,
-            &lOverlapped
-        );
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_SIGNAL_REPORT_RING,
+        &signal,
+        signal.Size,
+        nullptr,
+        0,
+        &transferred,
+        &lOverlapped
+    );
 
-        // wait for result
-        if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        if (GetLastError() == ERROR_ACCESS_DENIED)
         {
-            error = VIGEM_ERROR_NONE;
-            free(detailDataBuffer);
             CloseHandle(lOverlapped.hEvent);
-            break;
+            return VIGEM_ERROR_INVALID_TARGET;
         }
-
-        error = VIGEM_ERROR_BUS_VERSION_MISMATCH;
-
-        CloseHandle(lOverlapped.hEvent);
-        free(detailDataBuffer);
     }
 
-    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+    CloseHandle(lOverlapped.hEvent);
 
-    return error;
+    return VIGEM_ERROR_NONE;
 }
 
-void vigem_disconnect(PVIGEM_CLIENT vigem)
+//
+// Hands a report to the bus, building the request matching its type and size.
+// 
+DWORD vigem_internal_report_submit(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const void* report, ULONG length)
 {
-    if (!vigem)
-        return;
+    if (target->Type == DualShock4Wired && length == sizeof(DS4_REPORT_EX))
+    {
+        DS4_SUBMIT_REPORT_EX dsr;
+        DS4_SUBMIT_REPORT_EX_INIT(&dsr, target->SerialNo);
 
-    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
+        memcpy(&dsr.Report, report, length);
+
+        return vigem_internal_submit_report(
+            vigem,
+            target,
+            IOCTL_DS4_SUBMIT_REPORT, // Same IOCTL, just different size
+            &dsr,
+            dsr.Size
+        );
+    }
+
+    if (target->Type == DualShock4Wired)
     {
-        CloseHandle(vigem->hBusDevice);
+        DS4_SUBMIT_REPORT dsr;
+        DS4_SUBMIT_REPORT_INIT(&dsr, target->SerialNo);
 
-        RtlZeroMemory(vigem, sizeof(VIGEM_CLIENT));
-        vigem->hBusDevice = INVALID_HANDLE_VALUE;
+        memcpy(&dsr.Report, report, length);
+
+        return vigem_internal_submit_report(vigem, target, IOCTL_DS4_SUBMIT_REPORT, &dsr, dsr.Size);
     }
+
+    XUSB_SUBMIT_REPORT xsr;
+    XUSB_SUBMIT_REPORT_INIT(&xsr, target->SerialNo);
+
+    memcpy(&xsr.Report, report, length);
+
+    return vigem_internal_submit_report(vigem, target, IOCTL_XUSB_SUBMIT_REPORT, &xsr, xsr.Size);
 }
 
-PVIGEM_TARGET vigem_target_x360_alloc(void)
+//
+// Links a target holding back a report to the client its flush submits
+// through. Must be called with ReportCacheLock held.
+// 
+void vigem_internal_report_flush_link(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 {
-    const auto target = VIGEM_TARGET_ALLOC_INIT(Xbox360Wired);
+    if (target->ReportFlushLink.Flink != nullptr)
+        return;
 
-    if (!target)
-        return nullptr;
+    target->ReportFlushClient = vigem;
 
-    target->VendorId = 0x045E;
-    target->ProductId = 0x028E;
+    AcquireSRWLockExclusive(&vigem->ReportFlushLock);
 
-    return target;
+    target->ReportFlushLink.Flink = &vigem->ReportFlushTargets;
+    target->ReportFlushLink.Blink = vigem->ReportFlushTargets.Blink;
+    vigem->ReportFlushTargets.Blink->Flink = &target->ReportFlushLink;
+    vigem->ReportFlushTargets.Blink = &target->ReportFlushLink;
+
+    ReleaseSRWLockExclusive(&vigem->ReportFlushLock);
 }
 
-PVIGEM_TARGET vigem_target_ds4_alloc(void)
+//
+// Unlinks a target from the client its held back report would be flushed
+// through, if linked. Must be called with ReportCacheLock held.
+// 
+void vigem_internal_report_flush_unlink(PVIGEM_TARGET target)
 {
-    const auto target = VIGEM_TARGET_ALLOC_INIT(DualShock4Wired);
+    if (target->ReportFlushLink.Flink == nullptr)
+        return;
 
-    if (!target)
-        return nullptr;
+    const auto vigem = target->ReportFlushClient;
 
-    target->VendorId = 0x054C;
-    target->ProductId = 0x05C4;
+    AcquireSRWLockExclusive(&vigem->ReportFlushLock);
 
-    return target;
-}
+    //
+    // Already taken off by vigem_internal_report_flush_drain if self-linked
+    // 
+    target->ReportFlushLink.Blink->Flink = target->ReportFlushLink.Flink;
+    target->ReportFlushLink.Flink->Blink = target->ReportFlushLink.Blink;
 
-void vigem_target_free(PVIGEM_TARGET target)
-{
-	if (target)
-		free(target);
+    ReleaseSRWLockExclusive(&vigem->ReportFlushLock);
+
+    target->ReportFlushLink.Flink = nullptr;
+    target->ReportFlushLink.Blink = nullptr;
+    target->ReportFlushClient = nullptr;
 }
 
-VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+//
+// Cancels the pending flushes of all targets linked to a client and waits for
+// running ones, so none outlives the handle or the client object.
+// 
+void vigem_internal_report_flush_drain(PVIGEM_CLIENT vigem)
 {
-    VIGEM_ERROR error = VIGEM_ERROR_NO_FREE_SLOT;
-    DWORD transferred = 0;
-    VIGEM_PLUGIN_TARGET plugin;
-    VIGEM_WAIT_DEVICE_READY devReady;
-    OVERLAPPED olPlugIn = { 0 };
-    olPlugIn.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    OVERLAPPED olWait = { 0 };
-    olWait.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    do
+    {
+        PVIGEM_TARGET target = nullptr;
 
-    do {
-        if (!vigem)
+        AcquireSRWLockExclusive(&vigem->ReportFlushLock);
+
+        if (vigem->ReportFlushTargets.Flink != &vigem->ReportFlushTargets
+            && vigem->ReportFlushTargets.Flink != nullptr)
         {
-            error = VIGEM_ERROR_BUS_INVALID_HANDLE;
-        	break;
+            const auto entry = vigem->ReportFlushTargets.Flink;
+
+            target = CONTAINING_RECORD(entry, VIGEM_TARGET, ReportFlushLink);
+
+            // Self-linked, a concurrent unlink leaves the list alone
+            entry->Blink->Flink = entry->Flink;
+            entry->Flink->Blink = entry->Blink;
+            entry->Flink = entry;
+            entry->Blink = entry;
         }
 
+        ReleaseSRWLockExclusive(&vigem->ReportFlushLock);
+
         if (!target)
+            break;
+
+        SetThreadpoolTimer(target->ReportFlushTimer, nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(target->ReportFlushTimer, TRUE);
+
+        AcquireSRWLockExclusive(&target->ReportCacheLock);
+
+        target->HeldReportLength = 0;
+
+        if (target->ReportFlushClient == vigem)
+        {
+            target->ReportFlushLink.Flink = nullptr;
+            target->ReportFlushLink.Blink = nullptr;
+            target->ReportFlushClient = nullptr;
+        }
+
+        ReleaseSRWLockExclusive(&target->ReportCacheLock);
+    }
+    while (TRUE);
+}
+
+//
+// Initializes the list of targets linked to a zeroed client object.
+// 
+void vigem_internal_report_flush_init(PVIGEM_CLIENT vigem)
+{
+    vigem->ReportFlushTargets.Flink = &vigem->ReportFlushTargets;
+    vigem->ReportFlushTargets.Blink = &vigem->ReportFlushTargets;
+}
+
+//
+// Forgets the cached and any held back report of a target. Must be called
+// whenever the state known to the bus changes without going through the cache.
+// 
+void vigem_internal_report_cache_reset(PVIGEM_TARGET target)
+{
+    AcquireSRWLockExclusive(&target->ReportCacheLock);
+
+    target->CachedReportLength = 0;
+    target->HeldReportLength = 0;
+
+    ReleaseSRWLockExclusive(&target->ReportCacheLock);
+}
+
+//
+// Caches and submits a report. Must be called with ReportCacheLock held.
+// 
+DWORD vigem_internal_report_commit(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const void* report, ULONG length)
+{
+    LARGE_INTEGER now;
+
+    memcpy(target->CachedReport, report, length);
+    target->CachedReportLength = length;
+    target->HeldReportLength = 0;
+
+    (void)QueryPerformanceCounter(&now);
+    target->ReportSubmitTime = now.QuadPart;
+
+    const auto result = vigem_internal_report_submit(vigem, target, target->CachedReport, length);
+
+    //
+    // Rejected reports never made it to the bus, don't filter their repetitions
+    // 
+    if (result != ERROR_SUCCESS)
+        target->CachedReportLength = 0;
+
+    return result;
+}
+
+//
+// Submits a report unless it equals the last one handed to the bus, which
+// would discard it anyway. With a rate limit set, reports arriving before the
+// interval elapsed are held back and only the latest one gets flushed.
+// 
+DWORD vigem_internal_report_update(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const void* report, ULONG length)
+{
+    AcquireSRWLockExclusive(&target->ReportCacheLock);
+
+    // A fire-and-forget submission of the cached report failed
+    if (InterlockedExchange(&target->ReportCacheStale, FALSE))
+        target->CachedReportLength = 0;
+
+    //
+    // Also makes any held back state obsolete
+    // 
+    if (target->CachedReportLength == length && memcmp(target->CachedReport, report, length) == 0)
+    {
+        target->HeldReportLength = 0;
+
+        ReleaseSRWLockExclusive(&target->ReportCacheLock);
+
+        return ERROR_SUCCESS;
+    }
+
+    if (target->MaxReportRate != 0)
+    {
+        LARGE_INTEGER now;
+        LARGE_INTEGER frequency;
+
+        (void)QueryPerformanceCounter(&now);
+        (void)QueryPerformanceFrequency(&frequency);
+
+        const auto interval = frequency.QuadPart / target->MaxReportRate;
+        const auto elapsed = now.QuadPart - target->ReportSubmitTime;
+
+        if (elapsed < interval)
+        {
+            //
+            // Flush timer is already armed if a report is held back
+            // 
+            if (target->HeldReportLength == 0)
+            {
+                LARGE_INTEGER dueTime;
+                FILETIME fileTime;
+
+                // Relative, in 100 ns units
+                dueTime.QuadPart = -((interval - elapsed) * 10000000 / frequency.QuadPart);
+
+                fileTime.dwLowDateTime = dueTime.LowPart;
+                fileTime.dwHighDateTime = static_cast<DWORD>(dueTime.HighPart);
+
+                SetThreadpoolTimer(target->ReportFlushTimer, &fileTime, 0, 0);
+            }
+
+            memcpy(target->HeldReport, report, length);
+            target->HeldReportLength = length;
+
+            // Lets vigem_disconnect cancel the flush before closing the handle
+            vigem_internal_report_flush_link(vigem, target);
+
+            ReleaseSRWLockExclusive(&target->ReportCacheLock);
+
+            return ERROR_SUCCESS;
+        }
+    }
+
+    const auto result = vigem_internal_report_commit(vigem, target, report, length);
+
+    ReleaseSRWLockExclusive(&target->ReportCacheLock);
+
+    return result;
+}
+
+//
+// Submits the report held back by the rate limit of a target, if any. Errors
+// are reported by the next call to vigem_target_wait_update.
+// 
+VOID CALLBACK vigem_internal_report_flush(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    UNREFERENCED_PARAMETER(Instance);
+    UNREFERENCED_PARAMETER(Timer);
+
+    const auto target = static_cast<PVIGEM_TARGET>(Context);
+
+    AcquireSRWLockExclusive(&target->ReportCacheLock);
+
+    //
+    // Held back reports always come with a linked client
+    // 
+    if (target->HeldReportLength != 0)
+        (void)vigem_internal_report_commit(
+            target->ReportFlushClient,
+            target,
+            target->HeldReport,
+            target->HeldReportLength
+        );
+
+    vigem_internal_report_flush_unlink(target);
+
+    ReleaseSRWLockExclusive(&target->ReportCacheLock);
+}
+
+//
+// Updates the connection state of a target. The bus-side report state of a
+// (re-)added or removed device is unknown, so the report cache starts over.
+// 
+void vigem_internal_target_set_state(PVIGEM_TARGET target, VIGEM_TARGET_STATE state)
+{
+    target->State = state;
+
+    vigem_internal_report_cache_reset(target);
+}
+
+//
+// Fills the timing information of a timed report submission.
+// 
+void vigem_internal_timing_init(PVIGEM_TARGET target, PVIGEM_REPORT_TIMING timing, LARGE_INTEGER timestamp)
+{
+    //
+    // Zero is reserved for untimed reports, skip it on wrap-around
+    // 
+    auto sequence = static_cast<ULONG>(InterlockedIncrement(&target->SubmitSequence));
+
+    if (sequence == 0)
+        sequence = static_cast<ULONG>(InterlockedIncrement(&target->SubmitSequence));
+
+    //
+    // Same clock the bus uses for its latency measurement
+    // 
+    if (timestamp.QuadPart <= 0)
+        (void)QueryPerformanceCounter(&timestamp);
+
+    timing->Sequence = sequence;
+    timing->Timestamp = timestamp;
+}
+
+//
+// Target whose notification callback the current pump worker is invoking
+// 
+static thread_local PVIGEM_TARGET vigem_internal_dispatching_target = nullptr;
+
+//
+// Remembers a pump request as issued, so shutdown can cancel exactly the
+// pump's own I/O and leave requests of other threads on the handle alone.
+// 
+void vigem_internal_pump_track(PVIGEM_CLIENT vigem, PVIGEM_PUMP_REQUEST request)
+{
+    AcquireSRWLockExclusive(&vigem->PumpRequestsLock);
+
+    request->Link.Flink = &vigem->PumpRequestsIssued;
+    request->Link.Blink = vigem->PumpRequestsIssued.Blink;
+    vigem->PumpRequestsIssued.Blink->Flink = &request->Link;
+    vigem->PumpRequestsIssued.Blink = &request->Link;
+
+    ReleaseSRWLockExclusive(&vigem->PumpRequestsLock);
+}
+
+//
+// Forgets a pump request once its completion got dequeued or it failed to be issued.
+// 
+void vigem_internal_pump_untrack(PVIGEM_CLIENT vigem, PVIGEM_PUMP_REQUEST request)
+{
+    AcquireSRWLockExclusive(&vigem->PumpRequestsLock);
+
+    request->Link.Blink->Flink = request->Link.Flink;
+    request->Link.Flink->Blink = request->Link.Blink;
+
+    ReleaseSRWLockExclusive(&vigem->PumpRequestsLock);
+}
+
+//
+// Hands a request that failed to be issued over to a pump worker, so its
+// outcome gets reported from there like the one of any other completion.
+// 
+BOOL vigem_internal_pump_post_failure(PVIGEM_CLIENT vigem, PVIGEM_PUMP_REQUEST request, DWORD error)
+{
+    request->IssueError = error;
+
+    vigem_internal_pump_track(vigem, request);
+
+    if (PostQueuedCompletionStatus(
+        vigem->hCompletionPort,
+        0,
+        reinterpret_cast<ULONG_PTR>(vigem),
+        &request->Overlapped
+    ))
+        return TRUE;
+
+    vigem_internal_pump_untrack(vigem, request);
+
+    request->IssueError = ERROR_SUCCESS;
+
+    return FALSE;
+}
+
+//
+// Issues a request whose completion gets handled by the I/O completion pump.
+// 
+BOOL vigem_internal_pump_issue(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_PUMP_REQUEST request,
+    DWORD ioControlCode,
+    LPVOID inBuffer,
+    DWORD inBufferSize,
+    LPVOID outBuffer,
+    DWORD outBufferSize
+)
+{
+    memset(&request->Overlapped, 0, sizeof(OVERLAPPED));
+
+    vigem_internal_pump_track(vigem, request);
+
+    //
+    // Completion (also a synchronous one) gets queued to the port
+    // 
+    if (DeviceIoControl(
+        vigem->hBusDevice,
+        ioControlCode,
+        inBuffer,
+        inBufferSize,
+        outBuffer,
+        outBufferSize,
+        nullptr,
+        &request->Overlapped
+    ))
+        return TRUE;
+
+    const auto error = GetLastError();
+
+    if (error == ERROR_IO_PENDING)
+        return TRUE;
+
+    vigem_internal_pump_untrack(vigem, request);
+
+    // Callers report the failure by its error code
+    SetLastError(error);
+
+    return FALSE;
+}
+
+//
+// Fills in a plug-in request for the current serial of the target.
+// 
+void vigem_internal_plugin_init(PVIGEM_PLUGIN_TARGET_EX3 plugin, PVIGEM_TARGET target)
+{
+    VIGEM_PLUGIN_TARGET_EX3_INIT(
+        plugin,
+        target->SerialNo,
+        target->Type,
+        target->Flags,
+        target->ReportInterval,
+        target->IdentityKey
+    );
+
+    plugin->VendorId = target->VendorId;
+    plugin->ProductId = target->ProductId;
+
+    //
+    // Stick to the oldest layout sufficient, older buses reject the extended ones
+    // 
+    if (target->IdentityKey != 0)
+        return;
+
+    if (target->ReportInterval != 0)
+        plugin->Size = sizeof(VIGEM_PLUGIN_TARGET_EX2);
+    else
+        plugin->Size = (target->Flags == 0) ? sizeof(VIGEM_PLUGIN_TARGET) : sizeof(VIGEM_PLUGIN_TARGET_EX);
+}
+
+//
+// Waits out a departing holder of a target's identity key before the plug-in
+// gets retried. Returns FALSE once the bounded number of retries is used up.
+// 
+BOOL vigem_internal_identity_retry_wait(PULONG retries)
+{
+    if (*retries >= VIGEM_IDENTITY_RETRIES)
+        return FALSE;
+
+    (*retries)++;
+
+    Sleep(VIGEM_IDENTITY_RETRY_INTERVAL_MS);
+
+    return TRUE;
+}
+
+//
+// Issues a notification request on behalf of the pump.
+// 
+BOOL vigem_internal_notification_submit(PVIGEM_CLIENT vigem, PVIGEM_NOTIFICATION_REQUEST request)
+{
+    const auto target = request->Target;
+
+    request->Header.Type = VIGEM_PUMP_REQUEST_NOTIFICATION;
+    request->Batched = !InterlockedCompareExchange(&target->NotificationBatchUnsupported, FALSE, FALSE);
+
+    //
+    // Fetches all queued output reports in one round trip
+    // 
+    if (request->Batched)
+    {
+        VIGEM_REQUEST_NOTIFICATION_BATCH_INIT(
+            &request->Payload.Batch.Request,
+            target->SerialNo,
+            target->Type,
+            VIGEM_NOTIFICATION_BATCH_ENTRIES
+        );
+
+        return vigem_internal_pump_issue(
+            vigem,
+            &request->Header,
+            IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH,
+            &request->Payload.Batch.Request,
+            sizeof(VIGEM_REQUEST_NOTIFICATION_BATCH),
+            &request->Payload.Batch.Request,
+            VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(VIGEM_NOTIFICATION_BATCH_ENTRIES)
+        );
+    }
+
+    if (target->Type == DualShock4Wired)
+    {
+        DS4_REQUEST_NOTIFICATION_INIT(&request->Payload.Ds4, target->SerialNo);
+
+        return vigem_internal_pump_issue(
+            vigem,
+            &request->Header,
+            IOCTL_DS4_REQUEST_NOTIFICATION,
+            &request->Payload.Ds4,
+            request->Payload.Ds4.Size,
+            &request->Payload.Ds4,
+            request->Payload.Ds4.Size
+        );
+    }
+
+    XUSB_REQUEST_NOTIFICATION_INIT(&request->Payload.Xusb, target->SerialNo);
+
+    return vigem_internal_pump_issue(
+        vigem,
+        &request->Header,
+        IOCTL_XUSB_REQUEST_NOTIFICATION,
+        &request->Payload.Xusb,
+        request->Payload.Xusb.Size,
+        &request->Payload.Xusb,
+        request->Payload.Xusb.Size
+    );
+}
+
+//
+// Takes a notification request out of circulation.
+// 
+void vigem_internal_notification_retire(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    InterlockedDecrement(&vigem->PumpRequestsPending);
+
+    if (InterlockedDecrement(&target->NotificationRequestsPending) == 0)
+        SetEvent(target->NotificationsDrainedEvent);
+}
+
+//
+// Invokes the callback of a target with a single output report.
+// 
+void vigem_internal_notification_invoke(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, const VIGEM_NOTIFICATION_ENTRY* entry)
+{
+    if (!target->Notification)
+        return;
+
+    if (target->Type == DualShock4Wired)
+    {
+        reinterpret_cast<PFN_VIGEM_DS4_NOTIFICATION>(target->Notification)(
+            vigem, target,
+            entry->Report.Ds4.LargeMotor,
+            entry->Report.Ds4.SmallMotor,
+            entry->Report.Ds4.LightbarColor,
+            target->NotificationUserData
+        );
+    }
+    else
+    {
+        reinterpret_cast<PFN_VIGEM_X360_NOTIFICATION>(target->Notification)(
+            vigem, target,
+            entry->Report.Xusb.LargeMotor,
+            entry->Report.Xusb.SmallMotor,
+            entry->Report.Xusb.LedNumber,
+            target->NotificationUserData
+        );
+    }
+}
+
+//
+// Invokes the callback for a completed notification request and re-issues it.
+// 
+void vigem_internal_notification_complete(PVIGEM_CLIENT vigem, PVIGEM_NOTIFICATION_REQUEST request, DWORD error)
+{
+    const auto target = request->Target;
+
+    //
+    // Bus predates batched notifications, fall back to one report per request
+    // 
+    if (error == ERROR_INVALID_PARAMETER && request->Batched)
+    {
+        InterlockedExchange(&target->NotificationBatchUnsupported, TRUE);
+
+        if (request == &target->NotificationRequests[0]
+            && target->Notification
+            && !vigem->PumpStopping
+            && vigem_internal_notification_submit(vigem, request))
+            return;
+    }
+
+    if (error != ERROR_SUCCESS)
+    {
+        // Cancelled, access denied or device gone
+        vigem_internal_notification_retire(vigem, target);
+        return;
+    }
+
+    //
+    // Callbacks of the same target never run concurrently
+    // 
+    AcquireSRWLockExclusive(&target->NotificationLock);
+    vigem_internal_dispatching_target = target;
+
+    if (request->Batched)
+    {
+        const auto batch = &request->Payload.Batch.Request;
+        const auto count = min(batch->Count, static_cast<ULONG>(VIGEM_NOTIFICATION_BATCH_ENTRIES));
+
+        // Oldest first, same order single requests would have seen them
+        for (ULONG i = 0; i < count; i++)
+        {
+            //
+            // Completions of other requests may be dispatched out of order by
+            // other workers; never let an older state replace a newer one
+            // 
+            if (static_cast<LONG>(batch->Entries[i].Sequence - target->NotificationSequence) <= 0)
+                continue;
+
+            target->NotificationSequence = batch->Entries[i].Sequence;
+
+            vigem_internal_notification_invoke(vigem, target, &batch->Entries[i]);
+        }
+    }
+    else
+    {
+        VIGEM_NOTIFICATION_ENTRY entry = {};
+
+        if (target->Type == DualShock4Wired)
+            entry.Report.Ds4 = request->Payload.Ds4.Report;
+        else
+        {
+            entry.Report.Xusb.LargeMotor = request->Payload.Xusb.LargeMotor;
+            entry.Report.Xusb.SmallMotor = request->Payload.Xusb.SmallMotor;
+            entry.Report.Xusb.LedNumber = request->Payload.Xusb.LedNumber;
+        }
+
+        vigem_internal_notification_invoke(vigem, target, &entry);
+    }
+
+    vigem_internal_dispatching_target = nullptr;
+    ReleaseSRWLockExclusive(&target->NotificationLock);
+
+    //
+    // Single reports carry no sequence number to order them by, so only one
+    // such request stays in circulation; the bus queues reports meanwhile
+    // 
+    if (!request->Batched && request != &target->NotificationRequests[0])
+    {
+        vigem_internal_notification_retire(vigem, target);
+        return;
+    }
+
+    if (target->Notification
+        && !vigem->PumpStopping
+        && vigem_internal_notification_submit(vigem, request))
+        return;
+
+    vigem_internal_notification_retire(vigem, target);
+}
+
+//
+// Ends an asynchronous target operation and reports its outcome.
+// 
+void vigem_internal_target_operation_finish(PVIGEM_CLIENT vigem, PVIGEM_TARGET_OPERATION operation, VIGEM_ERROR error)
+{
+    const auto target = operation->Target;
+
+    // Same signature for add and remove results
+    const auto result = reinterpret_cast<PFN_VIGEM_TARGET_ADD_RESULT>(operation->Result);
+
+    // Never pending here, the retry it armed has already been issued
+    if (operation->IdentityRetryTimer)
+        CloseThreadpoolTimer(operation->IdentityRetryTimer);
+
+    free(operation);
+
+    InterlockedDecrement(&vigem->PumpRequestsPending);
+
+    if (result)
+        result(vigem, target, error);
+}
+
+VOID CALLBACK vigem_internal_target_operation_retry(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer);
+
+//
+// Advances an asynchronous target operation after its current step completed
+// with the provided Win32 error code. Steps failing to be issued are treated
+// like completions with an error.
+// 
+void vigem_internal_target_operation_complete(PVIGEM_CLIENT vigem, PVIGEM_TARGET_OPERATION operation, DWORD error)
+{
+    const auto target = operation->Target;
+
+    do
+    {
+        switch (operation->State)
+        {
+        case VIGEM_TARGET_OPERATION_PLUGIN:
+
+            if (error == ERROR_SUCCESS)
+            {
+                // Bus has filled in the assigned serial
+                target->SerialNo = operation->Payload.PlugIn.SerialNo;
+
+                //
+                // See vigem_target_add for the backwards compatibility considerations
+                // 
+                operation->State = VIGEM_TARGET_OPERATION_WAIT_DEVICE_READY;
+                VIGEM_WAIT_DEVICE_READY_INIT(&operation->Payload.WaitDeviceReady, target->SerialNo);
+
+                if (vigem_internal_pump_issue(
+                    vigem,
+                    &operation->Header,
+                    IOCTL_VIGEM_WAIT_DEVICE_READY,
+                    &operation->Payload.WaitDeviceReady,
+                    operation->Payload.WaitDeviceReady.Size,
+                    nullptr,
+                    0
+                ))
+                    return;
+
+                error = GetLastError();
+                continue;
+            }
+
+            if (error == ERROR_DEVICE_ALREADY_ATTACHED)
+            {
+                //
+                // Same bounded wait for a departing holder as vigem_target_add,
+                // without blocking a pump worker meanwhile
+                // 
+                if (!vigem->PumpStopping && operation->IdentityRetries < VIGEM_IDENTITY_RETRIES)
+                {
+                    if (!operation->IdentityRetryTimer)
+                        operation->IdentityRetryTimer = CreateThreadpoolTimer(
+                            vigem_internal_target_operation_retry,
+                            operation,
+                            nullptr
+                        );
+
+                    if (operation->IdentityRetryTimer)
+                    {
+                        LARGE_INTEGER dueTime;
+                        FILETIME fileTime;
+
+                        operation->IdentityRetries++;
+
+                        // Relative, in 100 ns units
+                        dueTime.QuadPart = -static_cast<LONGLONG>(VIGEM_IDENTITY_RETRY_INTERVAL_MS) * 10000;
+
+                        fileTime.dwLowDateTime = dueTime.LowPart;
+                        fileTime.dwHighDateTime = static_cast<DWORD>(dueTime.HighPart);
+
+                        SetThreadpoolTimer(operation->IdentityRetryTimer, &fileTime, 0, 0);
+                        return;
+                    }
+                }
+
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_ALREADY_CONNECTED);
+                return;
+            }
+
+            if (error == ERROR_OPERATION_ABORTED || vigem->PumpStopping)
+            {
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_OPERATION_ABORTED);
+                return;
+            }
+
+            //
+            // Bus supports assigning serials but couldn't, probing won't help
+            // 
+            if ((target->SerialNo == 0 && error != ERROR_INVALID_PARAMETER)
+                || target->SerialNo >= VIGEM_TARGETS_MAX)
+            {
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_NO_FREE_SLOT);
+                return;
+            }
+
+            //
+            // Buses predating serial assignment reject any extended layout as well,
+            // every probed serial would fail the same way
+            // 
+            if (target->SerialNo == 0 && operation->Payload.PlugIn.Size != sizeof(VIGEM_PLUGIN_TARGET))
+            {
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_NOT_SUPPORTED);
+                return;
+            }
+
+            target->SerialNo++;
+
+            vigem_internal_plugin_init(&operation->Payload.PlugIn, target);
+
+            if (vigem_internal_pump_issue(
+                vigem,
+                &operation->Header,
+                IOCTL_VIGEM_PLUGIN_TARGET,
+                &operation->Payload.PlugIn,
+                operation->Payload.PlugIn.Size,
+                &operation->Payload.PlugIn,
+                operation->Payload.PlugIn.Size
+            ))
+                return;
+
+            error = GetLastError();
+            continue;
+
+        case VIGEM_TARGET_OPERATION_WAIT_DEVICE_READY:
+
+            //
+            // Pre-v1.17 drivers don't know this request
+            // 
+            if (error == ERROR_SUCCESS || error == ERROR_INVALID_PARAMETER)
+            {
+                vigem_internal_target_set_state(target, VIGEM_TARGET_CONNECTED);
+
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_NONE);
+                return;
+            }
+
+            //
+            // Don't leave device connected if the wait call failed
+            // 
+            operation->State = VIGEM_TARGET_OPERATION_UNPLUG;
+            operation->Rollback = TRUE;
+            VIGEM_UNPLUG_TARGET_INIT(&operation->Payload.Unplug, target->SerialNo);
+
+            if (vigem_internal_pump_issue(
+                vigem,
+                &operation->Header,
+                IOCTL_VIGEM_UNPLUG_TARGET,
+                &operation->Payload.Unplug,
+                operation->Payload.Unplug.Size,
+                nullptr,
+                0
+            ))
+                return;
+
+            error = GetLastError();
+            continue;
+
+        case VIGEM_TARGET_OPERATION_UNPLUG:
+
+            if (error == ERROR_SUCCESS)
+                vigem_internal_target_set_state(target, VIGEM_TARGET_DISCONNECTED);
+
+            if (vigem->PumpStopping && (operation->Rollback || error == ERROR_OPERATION_ABORTED))
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_OPERATION_ABORTED);
+            else if (operation->Rollback)
+                vigem_internal_target_operation_finish(vigem, operation, VIGEM_ERROR_TARGET_NOT_PLUGGED_IN);
+            else
+                vigem_internal_target_operation_finish(
+                    vigem,
+                    operation,
+                    (error == ERROR_SUCCESS) ? VIGEM_ERROR_NONE : VIGEM_ERROR_REMOVAL_FAILED
+                );
+
+            return;
+        }
+    }
+    while (TRUE);
+}
+
+//
+// Re-issues the plug-in step of an asynchronous add operation once a departing
+// holder of the identity key had some time to go away.
+// 
+VOID CALLBACK vigem_internal_target_operation_retry(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    UNREFERENCED_PARAMETER(Instance);
+    UNREFERENCED_PARAMETER(Timer);
+
+    const auto operation = static_cast<PVIGEM_TARGET_OPERATION>(Context);
+    const auto vigem = operation->Client;
+    DWORD error = ERROR_OPERATION_ABORTED;
+
+    if (!vigem->PumpStopping)
+    {
+        vigem_internal_plugin_init(&operation->Payload.PlugIn, operation->Target);
+
+        if (vigem_internal_pump_issue(
+            vigem,
+            &operation->Header,
+            IOCTL_VIGEM_PLUGIN_TARGET,
+            &operation->Payload.PlugIn,
+            operation->Payload.PlugIn.Size,
+            &operation->Payload.PlugIn,
+            operation->Payload.PlugIn.Size
+        ))
+            return;
+
+        error = GetLastError();
+    }
+
+    // Not the caller's thread either, so the outcome may be reported from here
+    vigem_internal_target_operation_complete(vigem, operation, error);
+}
+
+//
+// I/O completion pump worker; dispatches completed requests by their type.
+// 
+DWORD WINAPI vigem_internal_pump_worker(LPVOID lpParameter)
+{
+    const auto vigem = static_cast<PVIGEM_CLIENT>(lpParameter);
+    DWORD transferred = 0;
+    ULONG_PTR key = 0;
+    LPOVERLAPPED overlapped = nullptr;
+
+    do
+    {
+        const auto success = GetQueuedCompletionStatus(
+            vigem->hCompletionPort,
+            &transferred,
+            &key,
+            &overlapped,
+            INFINITE
+        );
+
+        //
+        // Shutdown request or port closed
+        // 
+        if (overlapped == nullptr)
+            break;
+
+        auto error = (success) ? ERROR_SUCCESS : GetLastError();
+        const auto request = CONTAINING_RECORD(overlapped, VIGEM_PUMP_REQUEST, Overlapped);
+
+        // May be re-issued or freed from here on
+        vigem_internal_pump_untrack(vigem, request);
+
+        //
+        // Posted by vigem_internal_pump_post_failure
+        // 
+        if (request->IssueError != ERROR_SUCCESS)
+        {
+            error = request->IssueError;
+            request->IssueError = ERROR_SUCCESS;
+        }
+
+        switch (request->Type)
+        {
+        case VIGEM_PUMP_REQUEST_NOTIFICATION:
+            vigem_internal_notification_complete(
+                vigem,
+                CONTAINING_RECORD(request, VIGEM_NOTIFICATION_REQUEST, Header),
+                error
+            );
+            break;
+        case VIGEM_PUMP_REQUEST_TARGET_OPERATION:
+            vigem_internal_target_operation_complete(
+                vigem,
+                CONTAINING_RECORD(request, VIGEM_TARGET_OPERATION, Header),
+                error
+            );
+            break;
+        }
+    }
+    while (TRUE);
+
+    return 0;
+}
+
+//
+// Creates the I/O completion port and its workers, if not done yet.
+// 
+VIGEM_ERROR vigem_internal_pump_start(PVIGEM_CLIENT vigem)
+{
+    auto error = VIGEM_ERROR_NONE;
+
+    AcquireSRWLockExclusive(&vigem->PumpLock);
+
+    do
+    {
+        if (vigem->hCompletionPort)
+            break;
+
+        vigem->PumpRequestsIssued.Flink = &vigem->PumpRequestsIssued;
+        vigem->PumpRequestsIssued.Blink = &vigem->PumpRequestsIssued;
+
+        const auto workers = (vigem->PumpPoolSize)
+            ? vigem->PumpPoolSize
+            : VIGEM_PUMP_WORKERS_DEFAULT;
+
+        //
+        // A handle can be associated only once, the port lives until disconnect
+        // 
+        vigem->hCompletionPort = CreateIoCompletionPort(
+            vigem->hBusDevice,
+            nullptr,
+            reinterpret_cast<ULONG_PTR>(vigem),
+            workers
+        );
+
+        if (!vigem->hCompletionPort)
+        {
+            error = VIGEM_ERROR_BUS_ACCESS_FAILED;
+            break;
+        }
+
+        for (ULONG i = 0; i < workers; i++)
+        {
+            const auto worker = CreateThread(nullptr, 0, vigem_internal_pump_worker, vigem, 0, nullptr);
+
+            if (!worker)
+                break;
+
+            vigem->PumpWorkers[vigem->PumpWorkerCount++] = worker;
+        }
+    }
+    while (false);
+
+    if (error == VIGEM_ERROR_NONE && vigem->PumpWorkerCount == 0)
+        error = VIGEM_ERROR_BUS_ACCESS_FAILED;
+
+    ReleaseSRWLockExclusive(&vigem->PumpLock);
+
+    return error;
+}
+
+//
+// Retires all pump requests and shuts down the workers.
+// 
+void vigem_internal_pump_stop(PVIGEM_CLIENT vigem)
+{
+    if (!vigem->hCompletionPort)
+        return;
+
+    InterlockedExchange(&vigem->PumpStopping, TRUE);
+
+    while (InterlockedCompareExchange(&vigem->PumpRequestsPending, 0, 0) != 0)
+    {
+        //
+        // Other threads' plug-in, wait and submit requests keep running
+        // 
+        AcquireSRWLockShared(&vigem->PumpRequestsLock);
+
+        for (auto entry = vigem->PumpRequestsIssued.Flink; entry != &vigem->PumpRequestsIssued; entry = entry->Flink)
+            CancelIoEx(vigem->hBusDevice, &CONTAINING_RECORD(entry, VIGEM_PUMP_REQUEST, Link)->Overlapped);
+
+        ReleaseSRWLockShared(&vigem->PumpRequestsLock);
+
+        Sleep(1);
+    }
+
+    for (ULONG i = 0; i < vigem->PumpWorkerCount; i++)
+        PostQueuedCompletionStatus(vigem->hCompletionPort, 0, 0, nullptr);
+
+    WaitForMultipleObjects(vigem->PumpWorkerCount, vigem->PumpWorkers, TRUE, INFINITE);
+
+    for (ULONG i = 0; i < vigem->PumpWorkerCount; i++)
+        CloseHandle(vigem->PumpWorkers[i]);
+
+    CloseHandle(vigem->hCompletionPort);
+}
+
+//
+// Common part of the notification registration functions.
+// 
+VIGEM_ERROR vigem_internal_notification_register(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    FARPROC notification,
+    LPVOID userData
+)
+{
+    if (target->Notification == notification)
+        return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+
+    auto error = vigem_internal_pump_start(vigem);
+
+    if (!VIGEM_SUCCESS(error))
+        return error;
+
+    if (!target->NotificationsDrainedEvent)
+    {
+        target->NotificationsDrainedEvent = CreateEvent(nullptr, TRUE, TRUE, nullptr);
+
+        if (!target->NotificationsDrainedEvent)
+            return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    const auto dispatching = (vigem_internal_dispatching_target == target);
+
+    if (!dispatching)
+        AcquireSRWLockExclusive(&target->NotificationLock);
+
+    target->Notification = notification;
+    target->NotificationUserData = userData;
+
+    if (!dispatching)
+        ReleaseSRWLockExclusive(&target->NotificationLock);
+
+    //
+    // Requests still in flight pick up the new callback
+    // 
+    if (InterlockedCompareExchange(&target->NotificationRequestsPending, 0, 0) != 0)
+        return VIGEM_ERROR_NONE;
+
+    target->NotificationClient = vigem;
+
+    // Sequence numbers start over with every device
+    target->NotificationSequence = 0;
+
+    //
+    // Account for all requests up front so early completions can't signal drained
+    // 
+    ResetEvent(target->NotificationsDrainedEvent);
+    InterlockedAdd(&target->NotificationRequestsPending, VIGEM_NOTIFICATION_REQUESTS_PER_TARGET);
+    InterlockedAdd(&vigem->PumpRequestsPending, VIGEM_NOTIFICATION_REQUESTS_PER_TARGET);
+
+    ULONG submitted = 0;
+
+    for (auto& request : target->NotificationRequests)
+    {
+        request.Target = target;
+
+        if (vigem_internal_notification_submit(vigem, &request))
+            submitted++;
+        else
+            vigem_internal_notification_retire(vigem, target);
+    }
+
+    if (submitted == 0)
+    {
+        vigem_target_x360_unregister_notification(target);
+        error = VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    return error;
+}
+
+#ifdef VIGEM_USE_CRASH_HANDLER
+LONG WINAPI vigem_internal_exception_handler(struct _EXCEPTION_POINTERS* apExceptionInfo)
+{
+    const auto mhLib = LoadLibrary(L"dbghelp.dll");
+    const auto pDump = reinterpret_cast<MINIDUMPWRITEDUMP>(GetProcAddress(mhLib, "MiniDumpWriteDump"));
+
+    const auto hFile = CreateFile(
+        L"ViGEmClient.dmp",
+        GENERIC_WRITE,
+        FILE_SHARE_WRITE,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+    );
+
+	const DWORD flags = MiniDumpWithFullMemory | MiniDumpWithHandleData | MiniDumpWithUnloadedModules |
+		MiniDumpWithUnloadedModules | MiniDumpWithProcessThreadData |
+		MiniDumpWithFullMemoryInfo | MiniDumpWithThreadInfo |
+		MiniDumpWithFullAuxiliaryState | MiniDumpIgnoreInaccessibleMemory |
+		MiniDumpWithTokenInformation;
+
+    if (hFile != INVALID_HANDLE_VALUE)
+    {
+        _MINIDUMP_EXCEPTION_INFORMATION ExInfo;
+        ExInfo.ThreadId = GetCurrentThreadId();
+        ExInfo.ExceptionPointers = apExceptionInfo;
+        ExInfo.ClientPointers = FALSE;
+
+        pDump(
+			GetCurrentProcess(), 
+			GetCurrentProcessId(), 
+			hFile, 
+			(MINIDUMP_TYPE)flags,
+			&ExInfo, 
+			nullptr, 
+			nullptr
+		);
+        CloseHandle(hFile);
+    }
+
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+
+PVIGEM_CLIENT vigem_alloc()
+{
+#ifdef VIGEM_USE_CRASH_HANDLER
+    SetUnhandledExceptionFilter(vigem_internal_exception_handler);
+#endif
+
+    const auto driver = static_cast<PVIGEM_CLIENT>(malloc(sizeof(VIGEM_CLIENT)));
+
+    if (!driver)
+        return nullptr;
+
+    RtlZeroMemory(driver, sizeof(VIGEM_CLIENT));
+    driver->hBusDevice = INVALID_HANDLE_VALUE;
+
+    vigem_internal_report_flush_init(driver);
+
+    return driver;
+}
+
+void vigem_free(PVIGEM_CLIENT vigem)
+{
+    if (!vigem)
+        return;
+
+    // Timers of held back reports must not call into freed memory
+    vigem_internal_report_flush_drain(vigem);
+
+    free(vigem);
+}
+
+VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    SP_DEVICE_INTERFACE_DATA deviceInterfaceData = { 0 };
+    deviceInterfaceData.cbSize = sizeof(deviceInterfaceData);
+    DWORD memberIndex = 0;
+    DWORD requiredSize = 0;
+    auto error = VIGEM_ERROR_BUS_NOT_FOUND;
+
+    // check for already open handle as re-opening accidentally would destroy all live targets
+    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
+    {
+        return VIGEM_ERROR_BUS_ALREADY_CONNECTED;
+    }
+
+    const auto deviceInfoSet = SetupDiGetClassDevs(
+        &GUID_DEVINTERFACE_BUSENUM_VIGEM,
+        nullptr,
+        nullptr,
+        DIGCF_PRESENT | DIGCF_DEVICEINTERFACE
+    );
+
+    // enumerate device instances
+    while (SetupDiEnumDeviceInterfaces(
+        deviceInfoSet,
+        nullptr,
+        &GUID_DEVINTERFACE_BUSENUM_VIGEM,
+        memberIndex++,
+        &deviceInterfaceData
+    ))
+    {
+        // get required target buffer size
+        SetupDiGetDeviceInterfaceDetail(deviceInfoSet, &deviceInterfaceData, nullptr, 0, &requiredSize, nullptr);
+
+        // allocate target buffer
+        const auto detailDataBuffer = static_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA>(malloc(requiredSize));
+        detailDataBuffer->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA);
+
+        // get detail buffer
+        if (!SetupDiGetDeviceInterfaceDetail(
+            deviceInfoSet,
+            &deviceInterfaceData,
+            detailDataBuffer,
+            requiredSize,
+            &requiredSize,
+            nullptr
+        ))
+        {
+            SetupDiDestroyDeviceInfoList(deviceInfoSet);
+            free(detailDataBuffer);
+            error = VIGEM_ERROR_BUS_NOT_FOUND;
+            continue;
+        }
+
+        // bus found, open it
+        vigem->hBusDevice = CreateFile(
+            detailDataBuffer->DevicePath,
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_OVERLAPPED,
+            nullptr
+        );
+
+        // check bus open result
+        if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        {
+            error = VIGEM_ERROR_BUS_ACCESS_FAILED;
+            free(detailDataBuffer);
+            continue;
+        }
+
+        DWORD transferred = 0;
+        OVERLAPPED lOverlapped = { 0 };
+        lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
+
+        VIGEM_CHECK_VERSION version;
+        VIGEM_CHECK_VERSION_INIT(&version, VIGEM_COMMON_VERSION);
+
+        // send compiled library version to driver to check compatibility
+        DeviceIoControl(
+            vigem->hBusDevice,
+            IOCTL_VIGEM_CHECK_VERSION,
+            &version,
+            version.Size,
+            nullptr,
+            0,
+            &transferred,
+            &lOverlapped
+        );
+
+        // wait for result
+        if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
+        {
+            error = VIGEM_ERROR_NONE;
+            free(detailDataBuffer);
+            CloseHandle(lOverlapped.hEvent);
+            break;
+        }
+
+        error = VIGEM_ERROR_BUS_VERSION_MISMATCH;
+
+        CloseHandle(lOverlapped.hEvent);
+        free(detailDataBuffer);
+    }
+
+    SetupDiDestroyDeviceInfoList(deviceInfoSet);
+
+    return error;
+}
+
+void vigem_disconnect(PVIGEM_CLIENT vigem)
+{
+    if (!vigem)
+        return;
+
+    if (vigem->hBusDevice != INVALID_HANDLE_VALUE)
+    {
+        const auto poolSize = vigem->PumpPoolSize;
+
+        vigem_internal_pump_stop(vigem);
+
+        // Held back reports would otherwise be flushed through a closed handle
+        vigem_internal_report_flush_drain(vigem);
+
+        CloseHandle(vigem->hBusDevice);
+
+        RtlZeroMemory(vigem, sizeof(VIGEM_CLIENT));
+        vigem->hBusDevice = INVALID_HANDLE_VALUE;
+
+        vigem_internal_report_flush_init(vigem);
+
+        // Configuration survives reconnecting
+        vigem->PumpPoolSize = poolSize;
+    }
+}
+
+VIGEM_ERROR vigem_set_notification_workers(PVIGEM_CLIENT vigem, ULONG count)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (count == 0 || count > VIGEM_PUMP_WORKERS_MAX)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    vigem->PumpPoolSize = count;
+
+    return VIGEM_ERROR_NONE;
+}
+
+PVIGEM_TARGET vigem_target_x360_alloc(void)
+{
+    const auto target = VIGEM_TARGET_ALLOC_INIT(Xbox360Wired);
+
+    if (!target)
+        return nullptr;
+
+    target->VendorId = 0x045E;
+    target->ProductId = 0x028E;
+
+    return target;
+}
+
+PVIGEM_TARGET vigem_target_ds4_alloc(void)
+{
+    const auto target = VIGEM_TARGET_ALLOC_INIT(DualShock4Wired);
+
+    if (!target)
+        return nullptr;
+
+    target->VendorId = 0x054C;
+    target->ProductId = 0x05C4;
+
+    return target;
+}
+
+void vigem_target_free(PVIGEM_TARGET target)
+{
+	if (!target)
+		return;
+
+	// Notification requests must not outlive the object
+	if (target->NotificationRequestsPending)
+		vigem_target_x360_unregister_notification(target);
+
+	if (target->NotificationsDrainedEvent)
+		CloseHandle(target->NotificationsDrainedEvent);
+
+	// Flush of a held back report might be due
+	if (target->ReportFlushTimer)
+	{
+		SetThreadpoolTimer(target->ReportFlushTimer, nullptr, 0, 0);
+		WaitForThreadpoolTimerCallbacks(target->ReportFlushTimer, TRUE);
+		CloseThreadpoolTimer(target->ReportFlushTimer);
+
+		AcquireSRWLockExclusive(&target->ReportCacheLock);
+		vigem_internal_report_flush_unlink(target);
+		ReleaseSRWLockExclusive(&target->ReportCacheLock);
+	}
+
+	// Fire-and-forget submission might still be in flight
+	if (target->SubmitPending)
+		WaitForSingleObject(target->SubmitOverlapped.hEvent, INFINITE);
+
+	CloseHandle(target->SubmitOverlapped.hEvent);
+
+	free(target);
+}
+
+VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    VIGEM_ERROR error = VIGEM_ERROR_NO_FREE_SLOT;
+    DWORD transferred = 0;
+    ULONG identityRetries = 0;
+    VIGEM_PLUGIN_TARGET_EX3 plugin;
+    VIGEM_WAIT_DEVICE_READY devReady;
+    OVERLAPPED olPlugIn = { 0 };
+    olPlugIn.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
+    OVERLAPPED olWait = { 0 };
+    olWait.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
+
+    do {
+        if (!vigem)
+        {
+            error = VIGEM_ERROR_BUS_INVALID_HANDLE;
+        	break;
+        }
+
+        if (!target)
+        {
+            error = VIGEM_ERROR_INVALID_TARGET;
+        	break;
+        }
+
+        if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        {
+            error = VIGEM_ERROR_BUS_NOT_FOUND;
+        	break;
+        }
+
+        if (target->State == VIGEM_TARGET_NEW)
+        {
+            error = VIGEM_ERROR_TARGET_UNINITIALIZED;
+        	break;
+        }
+
+        if (target->State == VIGEM_TARGET_CONNECTED)
+        {
+            error = VIGEM_ERROR_ALREADY_CONNECTED;
+        	break;
+        }       
+
+    	//
+    	// Serial 0 asks the bus to assign the next free one. Older drivers reject
+    	// it as invalid, in which case we fall back to probing for a free slot.
+    	// 
+        for (target->SerialNo = 0; target->SerialNo <= VIGEM_TARGETS_MAX; target->SerialNo++)
+        {
+	        vigem_internal_plugin_init(&plugin, target);
+
+        	/*
+        	 * Request plugin of device. This is an inherently asynchronous operation,
+        	 * which is addressed differently through the history of the driver design.
+        	 * Pre-v1.17 this request was kept pending until the child was deemed operational
+        	 * which unfortunately causes synchronization issues on some systems.
+        	 * Starting with v1.17 "waiting" for full power-up is done with an additional 
+        	 * IOCTL that is sent immediately after and kept pending until the driver
+        	 * reports that the device can receive report updates. The following section
+        	 * and error handling is designed to achieve transparent backwards compatibility
+        	 * to not break applications using the pre-v1.17 client SDK. This is not a 100%
+        	 * perfect and can cause other functions to fail if called too soon but
+        	 * hopefully the applications will just ignore these errors and retry ;)
+        	 */
+	        DeviceIoControl(
+		        vigem->hBusDevice,
+		        IOCTL_VIGEM_PLUGIN_TARGET,
+		        &plugin,
+		        plugin.Size,
+		        &plugin,
+		        plugin.Size,
+		        &transferred,
+		        &olPlugIn
+	        );
+
+        	//
+        	// This should return fairly immediately >=v1.17
+        	// 
+	        if (GetOverlappedResult(vigem->hBusDevice, &olPlugIn, &transferred, TRUE) != 0)
+	        {
+		        // Bus has filled in the assigned serial
+		        target->SerialNo = plugin.SerialNo;
+
+	        	/*
+	        	 * This function is announced to be blocking/synchronous, a concept that 
+	        	 * doesn't reflect the way the bus driver/PNP manager bring child devices
+	        	 * to life. Therefore, we send another IOCTL which will be kept pending 
+	        	 * until the bus driver has been notified that the child device has
+	        	 * reached a state that is deemed operational. This request is only 
+	        	 * supported on drivers v1.17 or higher, so gracefully cause errors
+	        	 * of this call as a potential success and keep the device plugged in.
+	        	 */
+		        VIGEM_WAIT_DEVICE_READY_INIT(&devReady, plugin.SerialNo);
+
+		        DeviceIoControl(
+			        vigem->hBusDevice,
+			        IOCTL_VIGEM_WAIT_DEVICE_READY,
+			        &devReady,
+			        devReady.Size,
+			        nullptr,
+			        0,
+			        &transferred,
+			        &olWait
+		        );
+
+		        if (GetOverlappedResult(vigem->hBusDevice, &olWait, &transferred, TRUE) != 0)
+		        {
+			        vigem_internal_target_set_state(target, VIGEM_TARGET_CONNECTED);
+
+			        error = VIGEM_ERROR_NONE;
+			        break;
+		        }
+	        	
+		        //
+		        // Backwards compatibility with version pre-1.17, where this IOCTL doesn't exist
+		        // 
+		        if (GetLastError() == ERROR_INVALID_PARAMETER)
+		        {
+			        vigem_internal_target_set_state(target, VIGEM_TARGET_CONNECTED);
+
+			        error = VIGEM_ERROR_NONE;
+			        break;
+		        }
+
+		        //
+		        // Don't leave device connected if the wait call failed
+		        // 
+		        error = vigem_target_remove(vigem, target);
+		        break;
+	        }
+
+	        //
+	        // Stable identity is still held by another (or a departing) target
+	        // 
+	        if (GetLastError() == ERROR_DEVICE_ALREADY_ATTACHED)
+	        {
+		        //
+		        // A removed holder's PDO lingers until PnP tore it down, give it a moment
+		        // 
+		        if (vigem_internal_identity_retry_wait(&identityRetries))
+		        {
+			        // Retry with the same serial
+			        target->SerialNo--;
+			        continue;
+		        }
+
+		        error = VIGEM_ERROR_ALREADY_CONNECTED;
+		        break;
+	        }
+
+	        //
+	        // Bus supports assigning serials but couldn't, probing won't help
+	        // 
+	        if (target->SerialNo == 0 && GetLastError() != ERROR_INVALID_PARAMETER)
+		        break;
+
+	        //
+	        // Buses predating serial assignment reject any extended layout as well,
+	        // every probed serial would fail the same way
+	        // 
+	        if (target->SerialNo == 0 && plugin.Size != sizeof(VIGEM_PLUGIN_TARGET))
+	        {
+		        error = VIGEM_ERROR_NOT_SUPPORTED;
+		        break;
+	        }
+        }
+    } while (false);
+
+    if (olPlugIn.hEvent)
+	    CloseHandle(olPlugIn.hEvent);
+
+    if (olWait.hEvent)
+	    CloseHandle(olWait.hEvent);
+
+    return error;
+}
+
+VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_ADD_RESULT result)
+{
+	if (!vigem)
+		return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+	if (!target)
+		return VIGEM_ERROR_INVALID_TARGET;
+
+	if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+		return VIGEM_ERROR_BUS_NOT_FOUND;
+
+	if (target->State == VIGEM_TARGET_NEW)
+		return VIGEM_ERROR_TARGET_UNINITIALIZED;
+
+	if (target->State == VIGEM_TARGET_CONNECTED)
+		return VIGEM_ERROR_ALREADY_CONNECTED;
+
+	const auto error = vigem_internal_pump_start(vigem);
+
+	if (!VIGEM_SUCCESS(error))
+		return error;
+
+	const auto operation = static_cast<PVIGEM_TARGET_OPERATION>(malloc(sizeof(VIGEM_TARGET_OPERATION)));
+
+	if (!operation)
+		return VIGEM_ERROR_BUS_ACCESS_FAILED;
+
+	memset(operation, 0, sizeof(VIGEM_TARGET_OPERATION));
+
+	operation->Header.Type = VIGEM_PUMP_REQUEST_TARGET_OPERATION;
+	operation->Target = target;
+	operation->Client = vigem;
+	operation->State = VIGEM_TARGET_OPERATION_PLUGIN;
+	operation->Result = reinterpret_cast<FARPROC>(result);
+
+	//
+	// Serial 0 asks the bus to assign one, the state machine falls back to probing
+	// 
+	target->SerialNo = 0;
+
+	vigem_internal_plugin_init(&operation->Payload.PlugIn, target);
+
+	InterlockedIncrement(&vigem->PumpRequestsPending);
+
+	//
+	// Result gets reported from the pump from here on, a request failing to
+	// be issued goes there too, as older buses reject serial 0 that way
+	// 
+	if (!vigem_internal_pump_issue(
+		vigem,
+		&operation->Header,
+		IOCTL_VIGEM_PLUGIN_TARGET,
+		&operation->Payload.PlugIn,
+		operation->Payload.PlugIn.Size,
+		&operation->Payload.PlugIn,
+		operation->Payload.PlugIn.Size
+	) && !vigem_internal_pump_post_failure(vigem, &operation->Header, GetLastError()))
+	{
+		free(operation);
+		InterlockedDecrement(&vigem->PumpRequestsPending);
+
+		return VIGEM_ERROR_BUS_ACCESS_FAILED;
+	}
+
+	return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->State == VIGEM_TARGET_NEW)
+        return VIGEM_ERROR_TARGET_UNINITIALIZED;
+
+    if (target->State != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+    if (target->ReportRing)
+        vigem_target_unmap_report_ring(vigem, target);
+
+    DWORD transfered = 0;
+    VIGEM_UNPLUG_TARGET unplug;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
+
+    VIGEM_UNPLUG_TARGET_INIT(&unplug, target->SerialNo);
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_UNPLUG_TARGET,
+        &unplug,
+        unplug.Size,
+        nullptr,
+        0,
+        &transfered,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transfered, TRUE) != 0)
+    {
+        vigem_internal_target_set_state(target, VIGEM_TARGET_DISCONNECTED);
+        CloseHandle(lOverlapped.hEvent);
+
+        return VIGEM_ERROR_NONE;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    return VIGEM_ERROR_REMOVAL_FAILED;
+}
+
+VIGEM_ERROR vigem_target_remove_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_REMOVE_RESULT result)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->State == VIGEM_TARGET_NEW)
+        return VIGEM_ERROR_TARGET_UNINITIALIZED;
+
+    if (target->State != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+    const auto error = vigem_internal_pump_start(vigem);
+
+    if (!VIGEM_SUCCESS(error))
+        return error;
+
+    const auto operation = static_cast<PVIGEM_TARGET_OPERATION>(malloc(sizeof(VIGEM_TARGET_OPERATION)));
+
+    if (!operation)
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+
+    if (target->ReportRing)
+        vigem_target_unmap_report_ring(vigem, target);
+
+    memset(operation, 0, sizeof(VIGEM_TARGET_OPERATION));
+
+    operation->Header.Type = VIGEM_PUMP_REQUEST_TARGET_OPERATION;
+    operation->Target = target;
+    operation->State = VIGEM_TARGET_OPERATION_UNPLUG;
+    operation->Result = reinterpret_cast<FARPROC>(result);
+
+    VIGEM_UNPLUG_TARGET_INIT(&operation->Payload.Unplug, target->SerialNo);
+
+    InterlockedIncrement(&vigem->PumpRequestsPending);
+
+    //
+    // Result is never reported on the calling thread
+    // 
+    if (!vigem_internal_pump_issue(
+        vigem,
+        &operation->Header,
+        IOCTL_VIGEM_UNPLUG_TARGET,
+        &operation->Payload.Unplug,
+        operation->Payload.Unplug.Size,
+        nullptr,
+        0
+    ) && !vigem_internal_pump_post_failure(vigem, &operation->Header, GetLastError()))
+    {
+        free(operation);
+        InterlockedDecrement(&vigem->PumpRequestsPending);
+
+        return VIGEM_ERROR_REMOVAL_FAILED;
+    }
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_x360_register_notification(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PFN_VIGEM_X360_NOTIFICATION notification,
+    LPVOID userData
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || notification == nullptr)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    return vigem_internal_notification_register(
+        vigem,
+        target,
+        reinterpret_cast<FARPROC>(notification),
+        userData
+    );
+}
+
+VIGEM_ERROR vigem_target_ds4_register_notification(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PFN_VIGEM_DS4_NOTIFICATION notification,
+    LPVOID userData
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || notification == nullptr)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    return vigem_internal_notification_register(
+        vigem,
+        target,
+        reinterpret_cast<FARPROC>(notification),
+        userData
+    );
+}
+
+void vigem_target_x360_unregister_notification(PVIGEM_TARGET target)
+{
+    const auto dispatching = (vigem_internal_dispatching_target == target);
+
+    //
+    // Once the lock is acquired no callback is running and none will be invoked
+    // anymore; skipped if called from within the callback of this target
+    // 
+    if (!dispatching)
+        AcquireSRWLockExclusive(&target->NotificationLock);
+
+    target->Notification = nullptr;
+    target->NotificationUserData = nullptr;
+
+    if (!dispatching)
+        ReleaseSRWLockExclusive(&target->NotificationLock);
+
+    if (InterlockedCompareExchange(&target->NotificationRequestsPending, 0, 0) == 0)
+        return;
+
+    const auto vigem = target->NotificationClient;
+
+    //
+    // Requests completing in between might get re-issued, cancel until all are retired;
+    // the dispatching worker retires its own request after the callback returned
+    // 
+    do
+    {
+        for (auto& request : target->NotificationRequests)
+            CancelIoEx(vigem->hBusDevice, &request.Header.Overlapped);
+    }
+    while (!dispatching && WaitForSingleObject(target->NotificationsDrainedEvent, 10) == WAIT_TIMEOUT);
+}
+
+void vigem_target_ds4_unregister_notification(PVIGEM_TARGET target)
+{
+	vigem_target_x360_unregister_notification(target); // The same x360_unregister handler works for DS4_unregister also
+}
+
+void vigem_target_set_vid(PVIGEM_TARGET target, USHORT vid)
+{
+    target->VendorId = vid;
+}
+
+void vigem_target_set_pid(PVIGEM_TARGET target, USHORT pid)
+{
+    target->ProductId = pid;
+}
+
+USHORT vigem_target_get_vid(PVIGEM_TARGET target)
+{
+    return target->VendorId;
+}
+
+USHORT vigem_target_get_pid(PVIGEM_TARGET target)
+{
+    return target->ProductId;
+}
+
+VIGEM_ERROR vigem_target_set_report_interval(PVIGEM_TARGET target, ULONG milliseconds)
+{
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (milliseconds != 0
+        && (milliseconds < VIGEM_REPORT_INTERVAL_MIN || milliseconds > VIGEM_REPORT_INTERVAL_MAX))
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    target->ReportInterval = milliseconds;
+
+    return VIGEM_ERROR_NONE;
+}
+
+ULONG vigem_target_get_report_interval(PVIGEM_TARGET target)
+{
+    return target->ReportInterval;
+}
+
+VIGEM_ERROR vigem_target_set_identity(PVIGEM_TARGET target, ULONG key)
+{
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    // Instance ID is fixed once the PDO exists
+    if (target->State == VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_ALREADY_CONNECTED;
+
+    target->IdentityKey = key;
+
+    return VIGEM_ERROR_NONE;
+}
+
+ULONG vigem_target_get_identity(PVIGEM_TARGET target)
+{
+    return target->IdentityKey;
+}
+
+VIGEM_ERROR vigem_target_set_max_report_rate(PVIGEM_TARGET target, ULONG rate)
+{
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (rate > VIGEM_REPORT_RATE_MAX)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    AcquireSRWLockExclusive(&target->ReportCacheLock);
+
+    //
+    // Kept once created; a report still held back gets flushed after disabling
+    // 
+    if (rate != 0 && !target->ReportFlushTimer)
+        target->ReportFlushTimer = CreateThreadpoolTimer(vigem_internal_report_flush, target, nullptr);
+
+    if (rate != 0 && !target->ReportFlushTimer)
+    {
+        ReleaseSRWLockExclusive(&target->ReportCacheLock);
+        return VIGEM_ERROR_INVALID_PARAMETER;
+    }
+
+    target->MaxReportRate = rate;
+
+    ReleaseSRWLockExclusive(&target->ReportCacheLock);
+
+    return VIGEM_ERROR_NONE;
+}
+
+ULONG vigem_target_get_max_report_rate(PVIGEM_TARGET target)
+{
+    return target->MaxReportRate;
+}
+
+VIGEM_ERROR vigem_target_x360_update(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    XUSB_REPORT report
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (target->ReportRing)
+        return vigem_internal_report_ring_publish(vigem, target, &report, sizeof(XUSB_REPORT));
+
+    if (vigem_internal_report_update(vigem, target, &report, sizeof(XUSB_REPORT)) == ERROR_ACCESS_DENIED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_ds4_update(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    DS4_REPORT report
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (target->ReportRing)
+        return vigem_internal_report_ring_publish(vigem, target, &report, sizeof(DS4_REPORT));
+
+    if (vigem_internal_report_update(vigem, target, &report, sizeof(DS4_REPORT)) == ERROR_ACCESS_DENIED)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, DS4_REPORT_EX report)
+{
+	if (!vigem)
+		return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+	if (!target)
+		return VIGEM_ERROR_INVALID_TARGET;
+
+	if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+		return VIGEM_ERROR_BUS_NOT_FOUND;
+
+	if (target->SerialNo == 0)
+		return VIGEM_ERROR_INVALID_TARGET;
+
+	if (target->ReportRing)
+		return vigem_internal_report_ring_publish(vigem, target, &report, sizeof(DS4_REPORT_EX));
+
+	const auto result = vigem_internal_report_update(vigem, target, &report, sizeof(DS4_REPORT_EX));
+
+	if (result != ERROR_SUCCESS)
+	{
+		if (result == ERROR_ACCESS_DENIED)
+			return VIGEM_ERROR_INVALID_TARGET;
+
+		/*
+		 * NOTE: this will not happen on v1.16 due to NTSTATUS accidentally been set
+		 * as STATUS_SUCCESS when the submitted buffer size wasn't the expected one.
+		 * For backwards compatibility this function will silently fail (not cause
+		 * report updates) when run with the v1.16 driver. This API was introduced 
+		 * with v1.17 so it won't affect existing applications built before.
+		 */
+		if (result == ERROR_INVALID_PARAMETER)
+			return VIGEM_ERROR_NOT_SUPPORTED;
+	}
+
+	return VIGEM_ERROR_NONE;
+}
+
+ULONG vigem_target_get_index(PVIGEM_TARGET target)
+{
+    return target->SerialNo;
+}
+
+VIGEM_TARGET_TYPE vigem_target_get_type(PVIGEM_TARGET target)
+{
+    return target->Type;
+}
+
+BOOL vigem_target_is_attached(PVIGEM_TARGET target)
+{
+    return (target->State == VIGEM_TARGET_CONNECTED);
+}
+
+VIGEM_ERROR vigem_target_x360_get_user_index(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PULONG index
+)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || target->Type != Xbox360Wired)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+	if (!index)
+		return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
+
+    XUSB_GET_USER_INDEX gui;
+    XUSB_GET_USER_INDEX_INIT(&gui, target->SerialNo);
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_XUSB_GET_USER_INDEX,
+        &gui,
+        gui.Size,
+        &gui,
+        gui.Size,
+        &transferred,
+        &lOverlapped
+    );
+
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        if (error == ERROR_ACCESS_DENIED)
         {
-            error = VIGEM_ERROR_INVALID_TARGET;
-        	break;
+            CloseHandle(lOverlapped.hEvent);
+            return VIGEM_ERROR_INVALID_TARGET;
+        }
+
+        if (error == ERROR_INVALID_DEVICE_OBJECT_PARAMETER)
+        {
+            CloseHandle(lOverlapped.hEvent);
+            return VIGEM_ERROR_XUSB_USERINDEX_OUT_OF_RANGE;
         }
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    *index = gui.UserIndex;
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_map_report_ring(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (target->SerialNo == 0 || target->State != VIGEM_TARGET_CONNECTED)
+        return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+
+    if (target->ReportRing)
+        return VIGEM_ERROR_ALREADY_CONNECTED;
+
+    //
+    // Page-aligned, gets locked down by the bus for the lifetime of the mapping
+    // 
+    const auto ring = static_cast<PVIGEM_REPORT_RING>(VirtualAlloc(
+        nullptr,
+        sizeof(VIGEM_REPORT_RING),
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE
+    ));
+
+    if (!ring)
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+
+    VIGEM_REPORT_RING_INIT(ring);
+
+    DWORD transferred = 0;
+    VIGEM_MAP_REPORT_RING map;
+    VIGEM_MAP_REPORT_RING_INIT(&map, target->SerialNo, target->Type);
+
+    memset(&target->ReportRingOverlapped, 0, sizeof(OVERLAPPED));
+    target->ReportRingOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(TRUE);
+
+    //
+    // The request stays pending on success and keeps the ring mapped
+    // 
+    if (DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_MAP_REPORT_RING,
+        &map,
+        map.Size,
+        ring,
+        ring->Size,
+        &transferred,
+        &target->ReportRingOverlapped
+    ) || GetLastError() != ERROR_IO_PENDING)
+    {
+        const auto error = GetLastError();
+
+        GetOverlappedResult(vigem->hBusDevice, &target->ReportRingOverlapped, &transferred, TRUE);
+        CloseHandle(target->ReportRingOverlapped.hEvent);
+        VirtualFree(ring, 0, MEM_RELEASE);
+
+        if (error == ERROR_ACCESS_DENIED)
+            return VIGEM_ERROR_INVALID_TARGET;
+
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    target->ReportRing = ring;
+
+    // Ring publications bypass the report cache
+    vigem_internal_report_cache_reset(target);
+
+    return VIGEM_ERROR_NONE;
+}
+
+VIGEM_ERROR vigem_target_unmap_report_ring(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (!target->ReportRing)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    DWORD transferred = 0;
+
+    //
+    // Bus drops the mapping on cancellation, wait for it before freeing the memory
+    // 
+    CancelIoEx(vigem->hBusDevice, &target->ReportRingOverlapped);
+    GetOverlappedResult(vigem->hBusDevice, &target->ReportRingOverlapped, &transferred, TRUE);
+
+    CloseHandle(target->ReportRingOverlapped.hEvent);
+    VirtualFree(target->ReportRing, 0, MEM_RELEASE);
+
+    target->ReportRing = nullptr;
+
+    return VIGEM_ERROR_NONE;
+}
 
-        if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-        {
-            error = VIGEM_ERROR_BUS_NOT_FOUND;
-        	break;
-        }
+VIGEM_ERROR vigem_target_update_batch(PVIGEM_CLIENT vigem, PVIGEM_TARGET_BATCH_UPDATE updates, ULONG count)
+{
+    //
+    // NTSTATUS values reported per entry by the bus
+    // 
+    constexpr LONG statusAccessDenied = static_cast<LONG>(0xC0000022L);        // STATUS_ACCESS_DENIED
+    constexpr LONG statusDeviceDoesNotExist = static_cast<LONG>(0xC00000C0L);  // STATUS_DEVICE_DOES_NOT_EXIST
+    constexpr LONG statusInvalidParameter = static_cast<LONG>(0xC000000DL);    // STATUS_INVALID_PARAMETER
 
-        if (target->State == VIGEM_TARGET_NEW)
-        {
-            error = VIGEM_ERROR_TARGET_UNINITIALIZED;
-        	break;
-        }
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
 
-        if (target->State == VIGEM_TARGET_CONNECTED)
-        {
-            error = VIGEM_ERROR_ALREADY_CONNECTED;
-        	break;
-        }       
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    	//
-    	// TODO: this is mad stupid, redesign, so that the bus fills the assigned slot
-    	// 
-        for (target->SerialNo = 1; target->SerialNo <= VIGEM_TARGETS_MAX; target->SerialNo++)
-        {
-	        VIGEM_PLUGIN_TARGET_INIT(&plugin, target->SerialNo, target->Type);
+    if (!updates || count == 0 || count > VIGEM_SUBMIT_REPORT_BATCH_MAX_ENTRIES)
+        return VIGEM_ERROR_INVALID_PARAMETER;
 
-	        plugin.VendorId = target->VendorId;
-	        plugin.ProductId = target->ProductId;
+    const auto length = static_cast<DWORD>(VIGEM_SUBMIT_REPORT_BATCH_LENGTH(count));
+    const auto batch = static_cast<PVIGEM_SUBMIT_REPORT_BATCH>(malloc(length));
 
-        	/*
-        	 * Request plugin of device. This is an inherently asynchronous operation,
-        	 * which is addressed differently through the history of the driver design.
-        	 * Pre-v1.17 this request was kept pending until the child was deemed operational
-        	 * which unfortunately causes synchronization issues on some systems.
-        	 * Starting with v1.17 "waiting" for full power-up is done with an additional 
-        	 * IOCTL that is sent immediately after and kept pending until the driver
-        	 * reports that the device can receive report updates. The following section
-        	 * and error handling is designed to achieve transparent backwards compatibility
-        	 * to not break applications using the pre-v1.17 client SDK. This is not a 100%
-        	 * perfect and can cause other functions to fail if called too soon but
-        	 * hopefully the applications will just ignore these errors and retry ;)
-        	 */
-	        DeviceIoControl(
-		        vigem->hBusDevice,
-		        IOCTL_VIGEM_PLUGIN_TARGET,
-		        &plugin,
-		        plugin.Size,
-		        nullptr,
-		        0,
-		        &transferred,
-		        &olPlugIn
-	        );
+    if (!batch)
+        return VIGEM_ERROR_INVALID_PARAMETER;
 
-        	//
-        	// This should return fairly immediately >=v1.17
-        	// 
-	        if (GetOverlappedResult(vigem->hBusDevice, &olPlugIn, &transferred, TRUE) != 0)
-	        {
-	        	/*
-	        	 * This function is announced to be blocking/synchronous, a concept that 
-	        	 * doesn't reflect the way the bus driver/PNP manager bring child devices
-	        	 * to life. Therefore, we send another IOCTL which will be kept pending 
-	        	 * until the bus driver has been notified that the child device has
-	        	 * reached a state that is deemed operational. This request is only 
-	        	 * supported on drivers v1.17 or higher, so gracefully cause errors
-	        	 * of this call as a potential success and keep the device plugged in.
-	        	 */
-		        VIGEM_WAIT_DEVICE_READY_INIT(&devReady, plugin.SerialNo);
+    VIGEM_SUBMIT_REPORT_BATCH_INIT(batch, count);
 
-		        DeviceIoControl(
-			        vigem->hBusDevice,
-			        IOCTL_VIGEM_WAIT_DEVICE_READY,
-			        &devReady,
-			        devReady.Size,
-			        nullptr,
-			        0,
-			        &transferred,
-			        &olWait
-		        );
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = updates[i].Target;
+        const auto entry = &batch->Entries[i];
 
-		        if (GetOverlappedResult(vigem->hBusDevice, &olWait, &transferred, TRUE) != 0)
-		        {
-			        target->State = VIGEM_TARGET_CONNECTED;
+        // Invalid targets get rejected by the bus via serial 0
+        if (!target || target->SerialNo == 0)
+            continue;
 
-			        error = VIGEM_ERROR_NONE;
-			        break;
-		        }
-	        	
-		        //
-		        // Backwards compatibility with version pre-1.17, where this IOCTL doesn't exist
-		        // 
-		        if (GetLastError() == ERROR_INVALID_PARAMETER)
-		        {
-			        target->State = VIGEM_TARGET_CONNECTED;
+        entry->SerialNo = target->SerialNo;
+        entry->TargetType = target->Type;
 
-			        error = VIGEM_ERROR_NONE;
-			        break;
-		        }
+        // Bypasses the report cache
+        vigem_internal_report_cache_reset(target);
 
-		        //
-		        // Don't leave device connected if the wait call failed
-		        // 
-		        error = vigem_target_remove(vigem, target);
-		        break;
-	        }
+        if (target->Type == DualShock4Wired)
+        {
+            entry->ReportSize = sizeof(DS4_REPORT_EX);
+            entry->Report.Ds4Ex = updates[i].Report.Ds4;
         }
-    } while (false);
+        else
+        {
+            entry->ReportSize = sizeof(XUSB_REPORT);
+            entry->Report.Xusb = updates[i].Report.X360;
+        }
+    }
 
-    if (olPlugIn.hEvent)
-	    CloseHandle(olPlugIn.hEvent);
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
-    if (olWait.hEvent)
-	    CloseHandle(olWait.hEvent);
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_SUBMIT_REPORT_BATCH,
+        batch,
+        length,
+        batch,
+        length,
+        &transferred,
+        &lOverlapped
+    );
 
-    return error;
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+        free(batch);
+
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = updates[i].Target;
+        const auto status = batch->Entries[i].Status;
+
+        //
+        // Mirror the per-target update functions which only report ownership issues
+        // 
+        if (!target || target->SerialNo == 0
+            || status == statusAccessDenied
+            || status == statusDeviceDoesNotExist)
+            updates[i].Result = VIGEM_ERROR_INVALID_TARGET;
+        else if (status == statusInvalidParameter)
+            updates[i].Result = VIGEM_ERROR_INVALID_PARAMETER;
+        else
+            updates[i].Result = VIGEM_ERROR_NONE;
+    }
+
+    free(batch);
+
+    return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_ADD_RESULT result)
+VIGEM_ERROR vigem_target_get_statistics(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PVIGEM_TARGET_STATISTICS statistics)
 {
-	if (!vigem)
-		return VIGEM_ERROR_BUS_INVALID_HANDLE;
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
 
-	if (!target)
-		return VIGEM_ERROR_INVALID_TARGET;
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-	if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-		return VIGEM_ERROR_BUS_NOT_FOUND;
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
 
-	if (target->State == VIGEM_TARGET_NEW)
-		return VIGEM_ERROR_TARGET_UNINITIALIZED;
+    if (target->SerialNo == 0)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-	if (target->State == VIGEM_TARGET_CONNECTED)
-		return VIGEM_ERROR_ALREADY_CONNECTED;
+    if (!statistics)
+        return VIGEM_ERROR_INVALID_PARAMETER;
 
-	std::thread _async{
-		[](
-		PVIGEM_TARGET _Target,
-		PVIGEM_CLIENT _Client,
-		PFN_VIGEM_TARGET_ADD_RESULT _Result)
-		{
-			const auto error = vigem_target_add(_Client, _Target);
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
-			_Result(_Client, _Target, error);
-		},
-		target, vigem, result
-	};
+    VIGEM_QUERY_TARGET_STATS query;
+    VIGEM_QUERY_TARGET_STATS_INIT(&query, target->SerialNo, target->Type);
 
-	_async.detach();
+    DeviceIoControl(
+        vigem->hBusDevice,
+        IOCTL_VIGEM_QUERY_TARGET_STATS,
+        &query,
+        query.Size,
+        &query,
+        query.Size,
+        &transferred,
+        &lOverlapped
+    );
 
-	return VIGEM_ERROR_NONE;
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
+
+        CloseHandle(lOverlapped.hEvent);
+
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        if (error == ERROR_DEV_NOT_EXIST)
+            return VIGEM_ERROR_INVALID_TARGET;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    CloseHandle(lOverlapped.hEvent);
+
+    *statistics = query.Statistics;
+
+    return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+void vigem_target_set_async_updates(PVIGEM_TARGET target, BOOL enabled)
+{
+    AcquireSRWLockExclusive(&target->SubmitLock);
+
+    target->SubmitAsync = enabled;
+
+    ReleaseSRWLockExclusive(&target->SubmitLock);
+}
+
+VIGEM_ERROR vigem_target_wait_update(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
 {
     if (!vigem)
         return VIGEM_ERROR_BUS_INVALID_HANDLE;
@@ -508,273 +2692,308 @@ VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
         return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    if (target->State == VIGEM_TARGET_NEW)
-        return VIGEM_ERROR_TARGET_UNINITIALIZED;
+    AcquireSRWLockExclusive(&target->SubmitLock);
 
-    if (target->State != VIGEM_TARGET_CONNECTED)
-        return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+    const auto result = vigem_internal_submit_complete(vigem, target);
 
-    DWORD transfered = 0;
-    VIGEM_UNPLUG_TARGET unplug;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    ReleaseSRWLockExclusive(&target->SubmitLock);
 
-    VIGEM_UNPLUG_TARGET_INIT(&unplug, target->SerialNo);
+    switch (result)
+    {
+    case ERROR_SUCCESS:
+        return VIGEM_ERROR_NONE;
+    case ERROR_ACCESS_DENIED:
+        return VIGEM_ERROR_INVALID_TARGET;
+    case ERROR_INVALID_PARAMETER:
+        return VIGEM_ERROR_INVALID_PARAMETER;
+    default:
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+}
+
+void vigem_target_set_notification_coalescing(PVIGEM_TARGET target, BOOL enabled)
+{
+    if (enabled)
+        target->Flags |= VIGEM_TARGET_FLAG_COALESCE_OUTPUT_REPORTS;
+    else
+        target->Flags &= ~VIGEM_TARGET_FLAG_COALESCE_OUTPUT_REPORTS;
+}
+
+VIGEM_ERROR vigem_target_apply_changes(PVIGEM_CLIENT vigem, PVIGEM_TARGET_CHANGE changes, ULONG count)
+{
+    //
+    // Device readiness is awaited for all additions concurrently
+    // 
+    typedef struct _VIGEM_TARGET_CHANGE_WAIT
+    {
+        VIGEM_WAIT_DEVICE_READY Request;
+
+        OVERLAPPED Overlapped;
+
+    } VIGEM_TARGET_CHANGE_WAIT, *PVIGEM_TARGET_CHANGE_WAIT;
+
+    // NTSTATUS reported by the bus for stable identities still in use
+    constexpr LONG statusDeviceAlreadyAttached = static_cast<LONG>(0xC0000038L);  // STATUS_DEVICE_ALREADY_ATTACHED
+
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
+
+    if (!changes || count == 0 || count > VIGEM_TARGET_CHANGE_SET_MAX_ENTRIES)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    const auto length = static_cast<DWORD>(VIGEM_TARGET_CHANGE_SET_LENGTH(count));
+    const auto changeSet = static_cast<PVIGEM_TARGET_CHANGE_SET>(malloc(length));
+    const auto waits = static_cast<PVIGEM_TARGET_CHANGE_WAIT>(calloc(count, sizeof(VIGEM_TARGET_CHANGE_WAIT)));
+
+    if (!changeSet || !waits)
+    {
+        free(changeSet);
+        free(waits);
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    VIGEM_TARGET_CHANGE_SET_INIT(changeSet, count);
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = changes[i].Target;
+        const auto entry = &changeSet->Entries[i];
+
+        // Entries left without operation get rejected by the bus and are skipped below
+        changes[i].Result = VIGEM_ERROR_NONE;
+
+        if (!target)
+        {
+            changes[i].Result = VIGEM_ERROR_INVALID_TARGET;
+            continue;
+        }
+
+        if (target->State == VIGEM_TARGET_NEW)
+        {
+            changes[i].Result = VIGEM_ERROR_TARGET_UNINITIALIZED;
+            continue;
+        }
+
+        if (changes[i].Remove)
+        {
+            if (target->State != VIGEM_TARGET_CONNECTED)
+            {
+                changes[i].Result = VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
+                continue;
+            }
+
+            entry->Operation = VIGEM_TARGET_CHANGE_REMOVE;
+            entry->SerialNo = target->SerialNo;
+            entry->TargetType = target->Type;
+        }
+        else
+        {
+            if (target->State == VIGEM_TARGET_CONNECTED)
+            {
+                changes[i].Result = VIGEM_ERROR_ALREADY_CONNECTED;
+                continue;
+            }
+
+            entry->Operation = VIGEM_TARGET_CHANGE_ADD;
+            entry->SerialNo = 0;
+            entry->TargetType = target->Type;
+            entry->VendorId = target->VendorId;
+            entry->ProductId = target->ProductId;
+            entry->Flags = target->Flags;
+            entry->ReportInterval = target->ReportInterval;
+            entry->IdentityKey = target->IdentityKey;
+        }
+    }
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
     DeviceIoControl(
         vigem->hBusDevice,
-        IOCTL_VIGEM_UNPLUG_TARGET,
-        &unplug,
-        unplug.Size,
-        nullptr,
-        0,
-        &transfered,
+        IOCTL_VIGEM_APPLY_TARGET_CHANGES,
+        changeSet,
+        length,
+        changeSet,
+        length,
+        &transferred,
         &lOverlapped
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transfered, TRUE) != 0)
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
     {
-        target->State = VIGEM_TARGET_DISCONNECTED;
+        const auto error = GetLastError();
+
         CloseHandle(lOverlapped.hEvent);
+        free(changeSet);
+        free(waits);
+
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
+
+    //
+    // Additions whose identity is still held by a departing device get retried
+    // on their own, the same way vigem_target_add does
+    // 
+    ULONG identityRetries = 0;
+    PVIGEM_TARGET_CHANGE_SET retrySet = nullptr;
+
+    do
+    {
+        BOOL retry = FALSE;
+
+        for (ULONG i = 0; i < count; i++)
+        {
+            const auto entry = &changeSet->Entries[i];
+
+            if (entry->Operation == VIGEM_TARGET_CHANGE_ADD && entry->Status == statusDeviceAlreadyAttached)
+                retry = TRUE;
+        }
+
+        if (!retry)
+            break;
+
+        if (!retrySet)
+            retrySet = static_cast<PVIGEM_TARGET_CHANGE_SET>(malloc(length));
+
+        if (!retrySet || !vigem_internal_identity_retry_wait(&identityRetries))
+            break;
 
-        return VIGEM_ERROR_NONE;
-    }
+        // Entries without operation get rejected by the bus and left alone
+        memcpy(retrySet, changeSet, length);
 
-    CloseHandle(lOverlapped.hEvent);
+        for (ULONG i = 0; i < count; i++)
+        {
+            const auto entry = &retrySet->Entries[i];
 
-    return VIGEM_ERROR_REMOVAL_FAILED;
-}
+            if (entry->Operation != VIGEM_TARGET_CHANGE_ADD || entry->Status != statusDeviceAlreadyAttached)
+                entry->Operation = 0;
+        }
 
-VIGEM_ERROR vigem_target_x360_register_notification(
-    PVIGEM_CLIENT vigem,
-    PVIGEM_TARGET target,
-    PFN_VIGEM_X360_NOTIFICATION notification,
-    LPVOID userData
-)
-{
-    if (!vigem)
-        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+        DeviceIoControl(
+            vigem->hBusDevice,
+            IOCTL_VIGEM_APPLY_TARGET_CHANGES,
+            retrySet,
+            length,
+            retrySet,
+            length,
+            &transferred,
+            &lOverlapped
+        );
 
-    if (!target)
-        return VIGEM_ERROR_INVALID_TARGET;
+        if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+            break;
 
-    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-        return VIGEM_ERROR_BUS_NOT_FOUND;
+        for (ULONG i = 0; i < count; i++)
+        {
+            if (retrySet->Entries[i].Operation == 0)
+                continue;
 
-    if (target->SerialNo == 0 || notification == nullptr)
-        return VIGEM_ERROR_INVALID_TARGET;
+            changeSet->Entries[i].Status = retrySet->Entries[i].Status;
+            changeSet->Entries[i].SerialNo = retrySet->Entries[i].SerialNo;
+        }
+    }
+    while (TRUE);
 
-    if (target->Notification == reinterpret_cast<FARPROC>(notification))
-        return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+    free(retrySet);
 
-    target->Notification = reinterpret_cast<FARPROC>(notification);
-    target->NotificationUserData = userData;
+    CloseHandle(lOverlapped.hEvent);
 
-    if (target->cancelNotificationThreadEvent == nullptr)
-	    target->cancelNotificationThreadEvent = CreateEvent(
-            nullptr, 
-            TRUE, 
-            FALSE, 
-            nullptr
-        );
-    else
-	    ResetEvent(target->cancelNotificationThreadEvent);
-
-    std::thread _async{
-	    [](
-	    PVIGEM_TARGET _Target,
-	    PVIGEM_CLIENT _Client,
-	    LPVOID _UserData)
-	    {
-		    DWORD transferred = 0;
-		    OVERLAPPED lOverlapped = {0};
-		    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
-		    XUSB_REQUEST_NOTIFICATION xrn;
-		    XUSB_REQUEST_NOTIFICATION_INIT(&xrn, _Target->SerialNo);
-
-		    do
-		    {
-			    DeviceIoControl(
-				    _Client->hBusDevice,
-				    IOCTL_XUSB_REQUEST_NOTIFICATION,
-				    &xrn,
-				    xrn.Size,
-				    &xrn,
-				    xrn.Size,
-				    &transferred,
-				    &lOverlapped
-			    );
-
-			    if (GetOverlappedResult(_Client->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
-			    {
-				    if (_Target->Notification == nullptr)
-				    {
-					    CloseHandle(lOverlapped.hEvent);
-					    return;
-				    }
-
-				    reinterpret_cast<PFN_VIGEM_X360_NOTIFICATION>(_Target->Notification)(
-					    _Client, _Target, xrn.LargeMotor, xrn.SmallMotor, xrn.LedNumber, _UserData
-				    );
-
-				    continue;
-			    }
-
-			    if (GetLastError() == ERROR_ACCESS_DENIED || GetLastError() == ERROR_OPERATION_ABORTED)
-			    {
-				    CloseHandle(lOverlapped.hEvent);
-				    return;
-			    }
-		    }
-		    while (TRUE);
-	    },
-	    target, vigem, userData
-    };
-
-    _async.detach();
-	
-    return VIGEM_ERROR_NONE;
-}
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = changes[i].Target;
+        const auto entry = &changeSet->Entries[i];
 
-VIGEM_ERROR vigem_target_ds4_register_notification(
-    PVIGEM_CLIENT vigem,
-    PVIGEM_TARGET target,
-    PFN_VIGEM_DS4_NOTIFICATION notification,
-    LPVOID userData
-)
-{
-    if (!vigem)
-        return VIGEM_ERROR_BUS_INVALID_HANDLE;
+        if (entry->Operation == 0)
+            continue;
 
-    if (!target)
-        return VIGEM_ERROR_INVALID_TARGET;
+        if (entry->Operation == VIGEM_TARGET_CHANGE_REMOVE)
+        {
+            if (entry->Status >= 0)
+            {
+                //
+                // Unmapped only now, a target the bus didn't remove keeps its ring
+                // 
+                if (target->ReportRing)
+                    vigem_target_unmap_report_ring(vigem, target);
+
+                vigem_internal_target_set_state(target, VIGEM_TARGET_DISCONNECTED);
+            }
+            else
+                changes[i].Result = VIGEM_ERROR_REMOVAL_FAILED;
 
-    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-        return VIGEM_ERROR_BUS_NOT_FOUND;
+            continue;
+        }
 
-    if (target->SerialNo == 0 || notification == nullptr)
-        return VIGEM_ERROR_INVALID_TARGET;
+        if (entry->Status < 0)
+        {
+            changes[i].Result = (entry->Status == statusDeviceAlreadyAttached)
+                ? VIGEM_ERROR_ALREADY_CONNECTED
+                : VIGEM_ERROR_NO_FREE_SLOT;
+            continue;
+        }
 
-    if (target->Notification == reinterpret_cast<FARPROC>(notification))
-        return VIGEM_ERROR_CALLBACK_ALREADY_REGISTERED;
+        // Bus has filled in the assigned serial
+        target->SerialNo = entry->SerialNo;
 
-    target->Notification = reinterpret_cast<FARPROC>(notification);
-    target->NotificationUserData = userData;
+        VIGEM_WAIT_DEVICE_READY_INIT(&waits[i].Request, entry->SerialNo);
+        waits[i].Overlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
-	if (target->cancelNotificationThreadEvent == 0)
-		target->cancelNotificationThreadEvent = CreateEvent(
-            nullptr, 
-            TRUE, 
-            FALSE,
-            nullptr
+        DeviceIoControl(
+            vigem->hBusDevice,
+            IOCTL_VIGEM_WAIT_DEVICE_READY,
+            &waits[i].Request,
+            waits[i].Request.Size,
+            nullptr,
+            0,
+            &transferred,
+            &waits[i].Overlapped
         );
-	else
-		ResetEvent(target->cancelNotificationThreadEvent);
-
-    std::thread _async{
-	    [](
-	    PVIGEM_TARGET _Target,
-	    PVIGEM_CLIENT _Client,
-	    LPVOID _UserData)
-	    {
-		    DWORD transferred = 0;
-		    OVERLAPPED lOverlapped = {0};
-		    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
-		    DS4_REQUEST_NOTIFICATION ds4rn;
-		    DS4_REQUEST_NOTIFICATION_INIT(&ds4rn, _Target->SerialNo);
-
-		    do
-		    {
-			    DeviceIoControl(
-				    _Client->hBusDevice,
-				    IOCTL_DS4_REQUEST_NOTIFICATION,
-				    &ds4rn,
-				    ds4rn.Size,
-				    &ds4rn,
-				    ds4rn.Size,
-				    &transferred,
-				    &lOverlapped
-			    );
-
-			    if (GetOverlappedResult(_Client->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
-			    {
-				    if (_Target->Notification == nullptr)
-				    {
-					    CloseHandle(lOverlapped.hEvent);
-					    return;
-				    }
-
-				    reinterpret_cast<PFN_VIGEM_DS4_NOTIFICATION>(_Target->Notification)(
-					    _Client, _Target, ds4rn.Report.LargeMotor,
-					    ds4rn.Report.SmallMotor,
-					    ds4rn.Report.LightbarColor, _UserData
-				    );
-
-				    continue;
-			    }
-
-			    if (GetLastError() == ERROR_ACCESS_DENIED || GetLastError() == ERROR_OPERATION_ABORTED)
-			    {
-				    CloseHandle(lOverlapped.hEvent);
-				    return;
-			    }
-		    }
-		    while (TRUE);
-	    },
-	    target, vigem, userData
-    };
-
-    _async.detach();
-	
-    return VIGEM_ERROR_NONE;
-}
+    }
 
-void vigem_target_x360_unregister_notification(PVIGEM_TARGET target)
-{	
-	if (target->cancelNotificationThreadEvent != 0)
-		SetEvent(target->cancelNotificationThreadEvent);
-    
-	if (target->cancelNotificationThreadEvent != nullptr)
-	{
-		CloseHandle(target->cancelNotificationThreadEvent);
-		target->cancelNotificationThreadEvent = nullptr;
-	}
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = changes[i].Target;
 
-	target->Notification = nullptr;
-	target->NotificationUserData = nullptr;
-}
+        if (!waits[i].Overlapped.hEvent)
+            continue;
 
-void vigem_target_ds4_unregister_notification(PVIGEM_TARGET target)
-{
-	vigem_target_x360_unregister_notification(target); // The same x360_unregister handler works for DS4_unregister also
-}
+        const auto ready = GetOverlappedResult(vigem->hBusDevice, &waits[i].Overlapped, &transferred, TRUE) != 0;
+        const auto error = GetLastError();
 
-void vigem_target_set_vid(PVIGEM_TARGET target, USHORT vid)
-{
-    target->VendorId = vid;
-}
+        CloseHandle(waits[i].Overlapped.hEvent);
 
-void vigem_target_set_pid(PVIGEM_TARGET target, USHORT pid)
-{
-    target->ProductId = pid;
-}
+        vigem_internal_target_set_state(target, VIGEM_TARGET_CONNECTED);
 
-USHORT vigem_target_get_vid(PVIGEM_TARGET target)
-{
-    return target->VendorId;
-}
+        //
+        // Same semantics as vigem_target_add, don't leave the device connected if
+        // the wait failed for reasons other than an older bus not supporting it
+        // 
+        if (!ready && error != ERROR_INVALID_PARAMETER)
+        {
+            vigem_target_remove(vigem, target);
+            changes[i].Result = VIGEM_ERROR_NO_FREE_SLOT;
+        }
+    }
 
-USHORT vigem_target_get_pid(PVIGEM_TARGET target)
-{
-    return target->ProductId;
+    free(changeSet);
+    free(waits);
+
+    return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_x360_update(
+VIGEM_ERROR vigem_target_x360_update_timed(
     PVIGEM_CLIENT vigem,
     PVIGEM_TARGET target,
-    XUSB_REPORT report
+    XUSB_REPORT report,
+    LARGE_INTEGER timestamp
 )
 {
     if (!vigem)
@@ -789,44 +3008,46 @@ VIGEM_ERROR vigem_target_x360_update(
     if (target->SerialNo == 0)
         return VIGEM_ERROR_INVALID_TARGET;
 
-    DWORD transferred = 0;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    //
+    // Ring slots carry no timing information
+    // 
+    if (target->ReportRing)
+        return vigem_internal_report_ring_publish(vigem, target, &report, sizeof(XUSB_REPORT));
 
-    XUSB_SUBMIT_REPORT xsr;
-    XUSB_SUBMIT_REPORT_INIT(&xsr, target->SerialNo);
+    //
+    // Bypasses the report cache, so it no longer reflects the bus-side state
+    // 
+    vigem_internal_report_cache_reset(target);
+
+    XUSB_SUBMIT_REPORT_TIMED xsr;
+    XUSB_SUBMIT_REPORT_TIMED_INIT(&xsr, target->SerialNo);
 
     xsr.Report = report;
+    vigem_internal_timing_init(target, &xsr.Timing, timestamp);
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_XUSB_SUBMIT_REPORT,
+    const auto result = vigem_internal_submit_report(
+        vigem,
+        target,
+        IOCTL_XUSB_SUBMIT_REPORT, // Same IOCTL, just different size
         &xsr,
-        xsr.Size,
-        nullptr,
-        0,
-        &transferred,
-        &lOverlapped
+        xsr.Size
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
-    {
-        if (GetLastError() == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
-            return VIGEM_ERROR_INVALID_TARGET;
-        }
-    }
+    if (result == ERROR_ACCESS_DENIED)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-    CloseHandle(lOverlapped.hEvent);
+    if (result == ERROR_INVALID_PARAMETER || result == ERROR_INVALID_USER_BUFFER)
+        return VIGEM_ERROR_NOT_SUPPORTED;
 
     return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_ds4_update(
+VIGEM_ERROR vigem_target_ds4_update_timed(
     PVIGEM_CLIENT vigem,
     PVIGEM_TARGET target,
-    DS4_REPORT report
+    DS4_REPORT_EX report,
+    LARGE_INTEGER timestamp,
+    BOOL stampReport
 )
 {
     if (!vigem)
@@ -841,151 +3062,158 @@ VIGEM_ERROR vigem_target_ds4_update(
     if (target->SerialNo == 0)
         return VIGEM_ERROR_INVALID_TARGET;
 
-    DWORD transferred = 0;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    //
+    // Ring slots carry no timing information
+    // 
+    if (target->ReportRing)
+        return vigem_internal_report_ring_publish(vigem, target, &report, sizeof(DS4_REPORT_EX));
+
+    //
+    // Bypasses the report cache, so it no longer reflects the bus-side state
+    // 
+    vigem_internal_report_cache_reset(target);
 
-    DS4_SUBMIT_REPORT dsr;
-    DS4_SUBMIT_REPORT_INIT(&dsr, target->SerialNo);
+    DS4_SUBMIT_REPORT_TIMED dsr;
+    DS4_SUBMIT_REPORT_TIMED_INIT(&dsr, target->SerialNo);
 
     dsr.Report = report;
+    vigem_internal_timing_init(target, &dsr.Timing, timestamp);
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_DS4_SUBMIT_REPORT,
+    if (stampReport)
+        dsr.Timing.Flags |= VIGEM_REPORT_TIMING_FLAG_STAMP_DS4_TIMESTAMP;
+
+    const auto result = vigem_internal_submit_report(
+        vigem,
+        target,
+        IOCTL_DS4_SUBMIT_REPORT, // Same IOCTL, just different size
         &dsr,
-        dsr.Size,
-        nullptr,
-        0,
-        &transferred,
-        &lOverlapped
+        dsr.Size
     );
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
-    {
-        if (GetLastError() == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
-            return VIGEM_ERROR_INVALID_TARGET;
-        }
-    }
+    if (result == ERROR_ACCESS_DENIED)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-    CloseHandle(lOverlapped.hEvent);
+    //
+    // Older bus versions reject the unknown buffer size
+    // 
+    if (result == ERROR_INVALID_PARAMETER || result == ERROR_INVALID_USER_BUFFER)
+        return VIGEM_ERROR_NOT_SUPPORTED;
 
     return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_ds4_update_ex(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, DS4_REPORT_EX report)
+VIGEM_ERROR vigem_target_x360_wait_user_index(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    PULONG index,
+    DWORD milliseconds
+)
 {
-	if (!vigem)
-		return VIGEM_ERROR_BUS_INVALID_HANDLE;
+    if (!vigem)
+        return VIGEM_ERROR_BUS_INVALID_HANDLE;
 
-	if (!target)
-		return VIGEM_ERROR_INVALID_TARGET;
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-	if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
-		return VIGEM_ERROR_BUS_NOT_FOUND;
+    if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
+        return VIGEM_ERROR_BUS_NOT_FOUND;
 
-	if (target->SerialNo == 0)
-		return VIGEM_ERROR_INVALID_TARGET;
+    if (target->SerialNo == 0 || target->Type != Xbox360Wired)
+        return VIGEM_ERROR_INVALID_TARGET;
 
-	DWORD transferred = 0;
-	OVERLAPPED lOverlapped = {0};
-	lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (!index)
+        return VIGEM_ERROR_INVALID_PARAMETER;
 
-	DS4_SUBMIT_REPORT_EX dsr;
-	DS4_SUBMIT_REPORT_EX_INIT(&dsr, target->SerialNo);
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(TRUE);
 
-	dsr.Report = report;
+    XUSB_GET_USER_INDEX gui;
+    XUSB_GET_USER_INDEX_INIT(&gui, target->SerialNo);
 
-	DeviceIoControl(
-		vigem->hBusDevice,
-		IOCTL_DS4_SUBMIT_REPORT, // Same IOCTL, just different size
-		&dsr,
-		dsr.Size,
-		nullptr,
-		0,
-		&transferred,
-		&lOverlapped
-	);
+    //
+    // Request stays pending on the bus until the host assigned a slot
+    // 
+    if (!DeviceIoControl(
+            vigem->hBusDevice,
+            IOCTL_XUSB_WAIT_USER_INDEX,
+            &gui,
+            gui.Size,
+            &gui,
+            gui.Size,
+            &transferred,
+            &lOverlapped
+        )
+        && GetLastError() == ERROR_IO_PENDING
+        && WaitForSingleObject(lOverlapped.hEvent, milliseconds) == WAIT_TIMEOUT)
+    {
+        CancelIoEx(vigem->hBusDevice, &lOverlapped);
+    }
 
-	if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
-	{
-		if (GetLastError() == ERROR_ACCESS_DENIED)
-		{
-			CloseHandle(lOverlapped.hEvent);
-			return VIGEM_ERROR_INVALID_TARGET;
-		}
+    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    {
+        const auto error = GetLastError();
 
-		/*
-		 * NOTE: this will not happen on v1.16 due to NTSTATUS accidentally been set
-		 * as STATUS_SUCCESS when the submitted buffer size wasn't the expected one.
-		 * For backwards compatibility this function will silently fail (not cause
-		 * report updates) when run with the v1.16 driver. This API was introduced 
-		 * with v1.17 so it won't affect existing applications built before.
-		 */
-		if (GetLastError() == ERROR_INVALID_PARAMETER)
-		{
-			CloseHandle(lOverlapped.hEvent);
-			return VIGEM_ERROR_NOT_SUPPORTED;
-		}
-	}
+        CloseHandle(lOverlapped.hEvent);
 
-	CloseHandle(lOverlapped.hEvent);
+        if (error == ERROR_OPERATION_ABORTED)
+            return VIGEM_ERROR_TIMED_OUT;
 
-	return VIGEM_ERROR_NONE;
-}
+        if (error == ERROR_ACCESS_DENIED)
+            return VIGEM_ERROR_INVALID_TARGET;
 
-ULONG vigem_target_get_index(PVIGEM_TARGET target)
-{
-    return target->SerialNo;
-}
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
 
-VIGEM_TARGET_TYPE vigem_target_get_type(PVIGEM_TARGET target)
-{
-    return target->Type;
-}
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
+    }
 
-BOOL vigem_target_is_attached(PVIGEM_TARGET target)
-{
-    return (target->State == VIGEM_TARGET_CONNECTED);
+    CloseHandle(lOverlapped.hEvent);
+
+    *index = gui.UserIndex;
+
+    return VIGEM_ERROR_NONE;
 }
 
-VIGEM_ERROR vigem_target_x360_get_user_index(
+VIGEM_ERROR vigem_target_x360_get_user_indices(
     PVIGEM_CLIENT vigem,
-    PVIGEM_TARGET target,
-    PULONG index
+    PVIGEM_TARGET* targets,
+    PULONG indices,
+    ULONG count
 )
 {
     if (!vigem)
         return VIGEM_ERROR_BUS_INVALID_HANDLE;
 
-    if (!target)
-        return VIGEM_ERROR_INVALID_TARGET;
-
     if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
         return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    if (target->SerialNo == 0 || target->Type != Xbox360Wired)
-        return VIGEM_ERROR_INVALID_TARGET;
+    if (!targets || !indices || count == 0)
+        return VIGEM_ERROR_INVALID_PARAMETER;
 
-	if (!index)
-		return VIGEM_ERROR_INVALID_PARAMETER;
+    //
+    // Bus reports all targets of this connection, match them up below
+    // 
+    const auto length = static_cast<DWORD>(XUSB_GET_SESSION_USER_INDICES_LENGTH(XUSB_SESSION_USER_INDICES_MAX_ENTRIES));
+    const auto getIndices = static_cast<PXUSB_GET_SESSION_USER_INDICES>(malloc(length));
+
+    if (!getIndices)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    XUSB_GET_SESSION_USER_INDICES_INIT(getIndices, XUSB_SESSION_USER_INDICES_MAX_ENTRIES);
 
     DWORD transferred = 0;
     OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
-    XUSB_GET_USER_INDEX gui;
-    XUSB_GET_USER_INDEX_INIT(&gui, target->SerialNo);
+    lOverlapped.hEvent = VIGEM_SYNC_EVENT_CREATE(FALSE);
 
     DeviceIoControl(
         vigem->hBusDevice,
-        IOCTL_XUSB_GET_USER_INDEX,
-        &gui,
-        gui.Size,
-        &gui,
-        gui.Size,
+        IOCTL_XUSB_GET_SESSION_USER_INDICES,
+        getIndices,
+        length,
+        getIndices,
+        length,
         &transferred,
         &lOverlapped
     );
@@ -994,22 +3222,38 @@ VIGEM_ERROR vigem_target_x360_get_user_index(
     {
         const auto error = GetLastError();
 
-        if (error == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
-            return VIGEM_ERROR_INVALID_TARGET;
-        }
+        CloseHandle(lOverlapped.hEvent);
+        free(getIndices);
 
-        if (error == ERROR_INVALID_DEVICE_OBJECT_PARAMETER)
-        {
-            CloseHandle(lOverlapped.hEvent);
-            return VIGEM_ERROR_XUSB_USERINDEX_OUT_OF_RANGE;
-        }
+        // Older bus versions don't know the request
+        if (error == ERROR_INVALID_PARAMETER)
+            return VIGEM_ERROR_NOT_SUPPORTED;
+
+        return VIGEM_ERROR_BUS_ACCESS_FAILED;
     }
 
     CloseHandle(lOverlapped.hEvent);
 
-    *index = gui.UserIndex;
+    for (ULONG i = 0; i < count; i++)
+    {
+        const auto target = targets[i];
+
+        indices[i] = VIGEM_X360_USER_INDEX_NONE;
+
+        if (!target || target->SerialNo == 0 || target->Type != Xbox360Wired)
+            continue;
+
+        for (ULONG j = 0; j < getIndices->Count; j++)
+        {
+            if (getIndices->Entries[j].SerialNo == target->SerialNo)
+            {
+                indices[i] = getIndices->Entries[j].UserIndex;
+                break;
+            }
+        }
+    }
+
+    free(getIndices);
 
     return VIGEM_ERROR_NONE;
 }
@@ -0,0 +1,885 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus stress driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <wdmsec.h>
+#define NTSTRSAFE_LIB
+#include <ntstrsafe.h>
+#include <stdlib.h>
+#include <initguid.h>
+#include <ViGEm/Common.h>
+#include <ViGEm/km/BusShared.h>
+
+
+#pragma region Macros
+
+#define DRIVERNAME                      "ViGEmStress: "
+
+#define STRESS_POOL_TAG                 'SGiV'
+
+//
+// Upper limits of the configurable workload
+//
+#define STRESS_THREADS_MAX              64
+#define STRESS_TARGETS_MAX              1024
+
+//
+// Plug-ins measured by the single-threaded baseline run
+//
+#define STRESS_BASELINE_TARGETS         16
+
+#define StressPrint(_fmt_, ...)         DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_INFO_LEVEL, DRIVERNAME _fmt_ "\n", __VA_ARGS__)
+
+#pragma endregion
+
+//
+// Settings read from the Parameters key of the service.
+//
+typedef struct _STRESS_OPTIONS
+{
+	ULONG X360Targets;
+
+	ULONG Ds4Targets;
+
+	ULONG Threads;
+
+	ULONG ReportsPerTarget;
+
+} STRESS_OPTIONS, *PSTRESS_OPTIONS;
+
+//
+// Target plugged in by a worker.
+//
+typedef struct _STRESS_TARGET
+{
+	VIGEM_TARGET_TYPE Type;
+
+	ULONG SerialNo;
+
+	//
+	// QPC ticks spent in the plug-in request, until device ready and in the unplug request
+	//
+	LONGLONG PlugInTicks;
+
+	LONGLONG ReadyTicks;
+
+	LONGLONG UnplugTicks;
+
+} STRESS_TARGET, *PSTRESS_TARGET;
+
+typedef enum _STRESS_PHASE
+{
+	StressPhasePlugIn,
+	StressPhaseSubmit,
+	StressPhaseUnplug
+
+} STRESS_PHASE;
+
+//
+// Per-thread state, every worker talks to the bus through its own session.
+//
+typedef struct _STRESS_WORKER
+{
+	ULONG Index;
+
+	WDFIOTARGET IoTarget;
+
+	PSTRESS_TARGET Targets;
+
+	ULONG TargetCount;
+
+	STRESS_PHASE Phase;
+
+	PKEVENT StartEvent;
+
+	ULONG ReportsPerTarget;
+
+	ULONGLONG ReportsSubmitted;
+
+	ULONGLONG ReportsFailed;
+
+	//
+	// Thread cycles and QPC ticks spent in the submit phase
+	//
+	ULONG64 SubmitCycles;
+
+	LONGLONG SubmitTicks;
+
+} STRESS_WORKER, *PSTRESS_WORKER;
+
+//
+// Driver-global state.
+//
+typedef struct _STRESS_CONTEXT
+{
+	WDFDEVICE ControlDevice;
+
+	UNICODE_STRING BusPath;
+
+	PWSTR BusPathList;
+
+	STRESS_OPTIONS Options;
+
+	LARGE_INTEGER Frequency;
+
+	PKTHREAD ControlThread;
+
+	volatile LONG Cancel;
+
+} STRESS_CONTEXT, *PSTRESS_CONTEXT;
+
+static STRESS_CONTEXT G_Stress;
+
+EXTERN_C DRIVER_INITIALIZE DriverEntry;
+
+static EVT_WDF_DRIVER_UNLOAD Stress_EvtDriverUnload;
+
+static KSTART_ROUTINE Stress_ControlThread;
+
+static KSTART_ROUTINE Stress_WorkerThread;
+
+
+//
+// Reads the workload settings, missing values keep their defaults.
+//
+static VOID Stress_ReadOptions(
+	_In_ WDFDRIVER Driver,
+	_Out_ PSTRESS_OPTIONS Options
+)
+{
+	WDFKEY keyParams;
+	UNICODE_STRING valueName;
+
+	Options->X360Targets = 128;
+	Options->Ds4Targets = 128;
+	Options->Threads = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+	Options->ReportsPerTarget = 1000;
+
+	if (NT_SUCCESS(WdfDriverOpenParametersRegistryKey(Driver, KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &keyParams)))
+	{
+		RtlUnicodeStringInit(&valueName, L"X360Targets");
+		(void)WdfRegistryQueryULong(keyParams, &valueName, &Options->X360Targets);
+
+		RtlUnicodeStringInit(&valueName, L"Ds4Targets");
+		(void)WdfRegistryQueryULong(keyParams, &valueName, &Options->Ds4Targets);
+
+		RtlUnicodeStringInit(&valueName, L"Threads");
+		(void)WdfRegistryQueryULong(keyParams, &valueName, &Options->Threads);
+
+		RtlUnicodeStringInit(&valueName, L"ReportsPerTarget");
+		(void)WdfRegistryQueryULong(keyParams, &valueName, &Options->ReportsPerTarget);
+
+		WdfRegistryClose(keyParams);
+	}
+
+	Options->X360Targets = min(Options->X360Targets, STRESS_TARGETS_MAX);
+	Options->Ds4Targets = min(Options->Ds4Targets, STRESS_TARGETS_MAX - Options->X360Targets);
+	Options->Threads = max(1, min(Options->Threads, STRESS_THREADS_MAX));
+}
+
+//
+// Looks up the symbolic link of the first bus instance.
+//
+static NTSTATUS Stress_FindBus(_Inout_ PSTRESS_CONTEXT Context)
+{
+	const auto status = IoGetDeviceInterfaces(&GUID_DEVINTERFACE_BUSENUM_VIGEM, nullptr, 0, &Context->BusPathList);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	if (*Context->BusPathList == UNICODE_NULL)
+	{
+		ExFreePool(Context->BusPathList);
+		Context->BusPathList = nullptr;
+		return STATUS_NO_SUCH_DEVICE;
+	}
+
+	RtlInitUnicodeString(&Context->BusPath, Context->BusPathList);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Opens a new bus session for a worker.
+//
+static NTSTATUS Stress_OpenSession(_In_ PSTRESS_CONTEXT Context, _Out_ WDFIOTARGET* IoTarget)
+{
+	NTSTATUS status;
+	WDF_IO_TARGET_OPEN_PARAMS openParams;
+
+	status = WdfIoTargetCreate(Context->ControlDevice, WDF_NO_OBJECT_ATTRIBUTES, IoTarget);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	WDF_IO_TARGET_OPEN_PARAMS_INIT_OPEN_BY_NAME(
+		&openParams,
+		&Context->BusPath,
+		GENERIC_READ | GENERIC_WRITE
+	);
+
+	status = WdfIoTargetOpen(*IoTarget, &openParams);
+
+	if (!NT_SUCCESS(status))
+	{
+		WdfObjectDelete(*IoTarget);
+		*IoTarget = nullptr;
+	}
+
+	return status;
+}
+
+//
+// Sends a buffered internal I/O control request and waits for its completion.
+//
+static NTSTATUS Stress_SendInternal(
+	_In_ WDFIOTARGET IoTarget,
+	_In_ ULONG IoControlCode,
+	_In_ PVOID InputBuffer,
+	_In_ ULONG InputLength,
+	_In_opt_ PVOID OutputBuffer,
+	_In_ ULONG OutputLength
+)
+{
+	WDF_MEMORY_DESCRIPTOR input;
+	WDF_MEMORY_DESCRIPTOR output;
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&input, InputBuffer, InputLength);
+
+	if (OutputBuffer != nullptr)
+		WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&output, OutputBuffer, OutputLength);
+
+	return WdfIoTargetSendInternalIoctlSynchronously(
+		IoTarget,
+		WDF_NO_HANDLE,
+		IoControlCode,
+		&input,
+		(OutputBuffer != nullptr) ? &output : nullptr,
+		nullptr,
+		nullptr
+	);
+}
+
+static VOID Stress_PlugIn(_In_ PSTRESS_WORKER Worker, _Inout_ PSTRESS_TARGET Target)
+{
+	VIGEM_PLUGIN_TARGET plugIn;
+	VIGEM_PLUGIN_TARGET plugInOut;
+	VIGEM_WAIT_DEVICE_READY waitReady;
+
+	VIGEM_PLUGIN_TARGET_INIT(&plugIn, 0, Target->Type);
+	RtlZeroMemory(&plugInOut, sizeof(VIGEM_PLUGIN_TARGET));
+
+	const auto start = KeQueryPerformanceCounter(nullptr).QuadPart;
+
+	auto status = Stress_SendInternal(
+		Worker->IoTarget,
+		IOCTL_VIGEM_PLUGIN_TARGET,
+		&plugIn,
+		sizeof(VIGEM_PLUGIN_TARGET),
+		&plugInOut,
+		sizeof(VIGEM_PLUGIN_TARGET)
+	);
+
+	const auto plugged = KeQueryPerformanceCounter(nullptr).QuadPart;
+
+	if (!NT_SUCCESS(status))
+	{
+		StressPrint("Plug-in failed with status 0x%08X", status);
+		return;
+	}
+
+	Target->SerialNo = plugInOut.SerialNo;
+	Target->PlugInTicks = plugged - start;
+
+	VIGEM_WAIT_DEVICE_READY_INIT(&waitReady, Target->SerialNo);
+
+	status = Stress_SendInternal(
+		Worker->IoTarget,
+		IOCTL_VIGEM_WAIT_DEVICE_READY,
+		&waitReady,
+		sizeof(VIGEM_WAIT_DEVICE_READY),
+		nullptr,
+		0
+	);
+
+	if (NT_SUCCESS(status))
+		Target->ReadyTicks = KeQueryPerformanceCounter(nullptr).QuadPart - start;
+}
+
+static VOID Stress_Unplug(_In_ PSTRESS_WORKER Worker, _Inout_ PSTRESS_TARGET Target)
+{
+	VIGEM_UNPLUG_TARGET unplug;
+
+	if (Target->SerialNo == 0)
+		return;
+
+	VIGEM_UNPLUG_TARGET_INIT(&unplug, Target->SerialNo);
+
+	const auto start = KeQueryPerformanceCounter(nullptr).QuadPart;
+
+	const auto status = Stress_SendInternal(
+		Worker->IoTarget,
+		IOCTL_VIGEM_UNPLUG_TARGET,
+		&unplug,
+		sizeof(VIGEM_UNPLUG_TARGET),
+		nullptr,
+		0
+	);
+
+	if (NT_SUCCESS(status))
+		Target->UnplugTicks = KeQueryPerformanceCounter(nullptr).QuadPart - start;
+
+	Target->SerialNo = 0;
+}
+
+//
+// Submits a report differing from the previous one so none gets filtered.
+//
+static NTSTATUS Stress_Submit(_In_ PSTRESS_WORKER Worker, _In_ PSTRESS_TARGET Target, _In_ ULONG Round)
+{
+	if (Target->Type == Xbox360Wired)
+	{
+		XUSB_SUBMIT_REPORT report;
+
+		XUSB_SUBMIT_REPORT_INIT(&report, Target->SerialNo);
+		report.Report.sThumbLX = static_cast<SHORT>(Round);
+
+		return Stress_SendInternal(
+			Worker->IoTarget,
+			IOCTL_XUSB_SUBMIT_REPORT,
+			&report,
+			sizeof(XUSB_SUBMIT_REPORT),
+			nullptr,
+			0
+		);
+	}
+
+	DS4_SUBMIT_REPORT report;
+
+	DS4_SUBMIT_REPORT_INIT(&report, Target->SerialNo);
+	report.Report.bThumbLX = static_cast<BYTE>(Round);
+	report.Report.bThumbRX = static_cast<BYTE>(Round >> 8);
+
+	return Stress_SendInternal(
+		Worker->IoTarget,
+		IOCTL_DS4_SUBMIT_REPORT,
+		&report,
+		sizeof(DS4_SUBMIT_REPORT),
+		nullptr,
+		0
+	);
+}
+
+static VOID Stress_WorkerThread(_In_ PVOID StartContext)
+{
+	const auto worker = static_cast<PSTRESS_WORKER>(StartContext);
+	PROCESSOR_NUMBER processor;
+	GROUP_AFFINITY affinity;
+	GROUP_AFFINITY previousAffinity;
+
+	//
+	// One worker per core, spread across processor groups
+	//
+	if (NT_SUCCESS(KeGetProcessorNumberFromIndex(
+		worker->Index % KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS), &processor)))
+	{
+		RtlZeroMemory(&affinity, sizeof(GROUP_AFFINITY));
+		affinity.Group = processor.Group;
+		affinity.Mask = AFFINITY_MASK(processor.Number);
+
+		KeSetSystemGroupAffinityThread(&affinity, &previousAffinity);
+	}
+
+	// All workers of a phase start at once to provoke contention
+	(void)KeWaitForSingleObject(worker->StartEvent, Executive, KernelMode, FALSE, nullptr);
+
+	switch (worker->Phase)
+	{
+	case StressPhasePlugIn:
+
+		for (ULONG i = 0; i < worker->TargetCount && !G_Stress.Cancel; i++)
+			Stress_PlugIn(worker, &worker->Targets[i]);
+
+		break;
+
+	case StressPhaseSubmit:
+	{
+		ULONG64 cyclesStart;
+		ULONG64 cyclesEnd;
+
+		(void)KeQueryTotalCycleTimeThread(KeGetCurrentThread(), &cyclesStart);
+		const auto start = KeQueryPerformanceCounter(nullptr).QuadPart;
+
+		for (ULONG round = 1; round <= worker->ReportsPerTarget && !G_Stress.Cancel; round++)
+		{
+			for (ULONG i = 0; i < worker->TargetCount; i++)
+			{
+				if (worker->Targets[i].SerialNo == 0)
+					continue;
+
+				if (NT_SUCCESS(Stress_Submit(worker, &worker->Targets[i], round)))
+					worker->ReportsSubmitted++;
+				else
+					worker->ReportsFailed++;
+			}
+		}
+
+		worker->SubmitTicks = KeQueryPerformanceCounter(nullptr).QuadPart - start;
+		worker->SubmitCycles = KeQueryTotalCycleTimeThread(KeGetCurrentThread(), &cyclesEnd) - cyclesStart;
+
+		break;
+	}
+	case StressPhaseUnplug:
+
+		for (ULONG i = 0; i < worker->TargetCount; i++)
+			Stress_Unplug(worker, &worker->Targets[i]);
+
+		break;
+	}
+
+	PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+//
+// Runs one phase on all workers in parallel and waits for them to finish.
+//
+static VOID Stress_RunPhase(
+	_In_reads_(Count) PSTRESS_WORKER Workers,
+	_In_ ULONG Count,
+	_In_ STRESS_PHASE Phase
+)
+{
+	KEVENT startEvent;
+	PKTHREAD threads[STRESS_THREADS_MAX] = {};
+
+	KeInitializeEvent(&startEvent, NotificationEvent, FALSE);
+
+	for (ULONG i = 0; i < Count; i++)
+	{
+		HANDLE hThread;
+
+		Workers[i].Phase = Phase;
+		Workers[i].StartEvent = &startEvent;
+
+		if (!NT_SUCCESS(PsCreateSystemThread(
+			&hThread,
+			THREAD_ALL_ACCESS,
+			nullptr,
+			nullptr,
+			nullptr,
+			Stress_WorkerThread,
+			&Workers[i])))
+			continue;
+
+		(void)ObReferenceObjectByHandle(
+			hThread,
+			THREAD_ALL_ACCESS,
+			*PsThreadType,
+			KernelMode,
+			reinterpret_cast<PVOID*>(&threads[i]),
+			nullptr
+		);
+
+		ZwClose(hThread);
+	}
+
+	KeSetEvent(&startEvent, IO_NO_INCREMENT, FALSE);
+
+	for (ULONG i = 0; i < Count; i++)
+	{
+		if (threads[i] == nullptr)
+			continue;
+
+		(void)KeWaitForSingleObject(threads[i], Executive, KernelMode, FALSE, nullptr);
+		ObDereferenceObject(threads[i]);
+	}
+}
+
+static int __cdecl Stress_CompareTicks(const void* Left, const void* Right)
+{
+	const auto left = *static_cast<const LONGLONG*>(Left);
+	const auto right = *static_cast<const LONGLONG*>(Right);
+
+	return (left < right) ? -1 : (left > right) ? 1 : 0;
+}
+
+static ULONG Stress_TicksToMicroseconds(_In_ LONGLONG Ticks)
+{
+	return static_cast<ULONG>((Ticks * 1000000) / G_Stress.Frequency.QuadPart);
+}
+
+//
+// Sorts the samples in place and returns the given percentile in microseconds.
+//
+static ULONG Stress_Percentile(_Inout_updates_(Count) PLONGLONG Samples, _In_ ULONG Count, _In_ ULONG Permille)
+{
+	if (Count == 0)
+		return 0;
+
+	qsort(Samples, Count, sizeof(LONGLONG), Stress_CompareTicks);
+
+	return Stress_TicksToMicroseconds(Samples[min(Count - 1, (Count * Permille) / 1000)]);
+}
+
+static ULONG Stress_Mean(_In_reads_(Count) const LONGLONG* Samples, _In_ ULONG Count)
+{
+	LONGLONG total = 0;
+
+	if (Count == 0)
+		return 0;
+
+	for (ULONG i = 0; i < Count; i++)
+		total += Samples[i];
+
+	return Stress_TicksToMicroseconds(total / Count);
+}
+
+//
+// Publishes results to the debugger and the Results subkey of the service.
+//
+static VOID Stress_Report(_In_ WDFKEY Results, _In_ PCWSTR Name, _In_ ULONG Value)
+{
+	UNICODE_STRING valueName;
+
+	DbgPrintEx(DPFLTR_IHVDRIVER_ID, DPFLTR_INFO_LEVEL, DRIVERNAME "%ws = %lu\n", Name, Value);
+
+	if (Results == nullptr)
+		return;
+
+	RtlUnicodeStringInit(&valueName, Name);
+	(void)WdfRegistryAssignULong(Results, &valueName, Value);
+}
+
+//
+// Collects the latency samples of one kind, only successful requests count.
+//
+static ULONG Stress_CollectSamples(
+	_In_reads_(WorkerCount) const STRESS_WORKER* Workers,
+	_In_ ULONG WorkerCount,
+	_In_ SIZE_T FieldOffset,
+	_Out_writes_(Capacity) PLONGLONG Samples,
+	_In_ ULONG Capacity
+)
+{
+	ULONG count = 0;
+
+	for (ULONG w = 0; w < WorkerCount; w++)
+	{
+		for (ULONG i = 0; i < Workers[w].TargetCount && count < Capacity; i++)
+		{
+			const auto value = *reinterpret_cast<const LONGLONG*>(
+				reinterpret_cast<const UCHAR*>(&Workers[w].Targets[i]) + FieldOffset);
+
+			if (value > 0)
+				Samples[count++] = value;
+		}
+	}
+
+	return count;
+}
+
+static VOID Stress_Run(_In_ PSTRESS_CONTEXT Context)
+{
+	const auto options = &Context->Options;
+	const auto total = options->X360Targets + options->Ds4Targets;
+	PSTRESS_WORKER workers = nullptr;
+	PSTRESS_TARGET targets = nullptr;
+	PLONGLONG samples = nullptr;
+	WDFKEY keyParams = nullptr;
+	WDFKEY keyResults = nullptr;
+	UNICODE_STRING keyName;
+	ULONG baselineMean = 0;
+	ULONG count;
+
+	if (total == 0)
+		return;
+
+	workers = static_cast<PSTRESS_WORKER>(ExAllocatePoolWithTag(
+		NonPagedPoolNx, sizeof(STRESS_WORKER) * options->Threads, STRESS_POOL_TAG));
+	targets = static_cast<PSTRESS_TARGET>(ExAllocatePoolWithTag(
+		NonPagedPoolNx, sizeof(STRESS_TARGET) * total, STRESS_POOL_TAG));
+	samples = static_cast<PLONGLONG>(ExAllocatePoolWithTag(
+		NonPagedPoolNx, sizeof(LONGLONG) * total, STRESS_POOL_TAG));
+
+	if (!workers || !targets || !samples)
+		goto runEnd;
+
+	RtlZeroMemory(workers, sizeof(STRESS_WORKER) * options->Threads);
+	RtlZeroMemory(targets, sizeof(STRESS_TARGET) * total);
+
+	for (ULONG i = 0; i < total; i++)
+		targets[i].Type = (i < options->X360Targets) ? Xbox360Wired : DualShock4Wired;
+
+	//
+	// Contiguous slice of the target table per worker
+	//
+	for (ULONG w = 0, first = 0; w < options->Threads; w++)
+	{
+		const auto slice = total / options->Threads + ((w < total % options->Threads) ? 1 : 0);
+
+		workers[w].Index = w;
+		workers[w].Targets = &targets[first];
+		workers[w].TargetCount = slice;
+		workers[w].ReportsPerTarget = options->ReportsPerTarget;
+
+		first += slice;
+
+		if (!NT_SUCCESS(Stress_OpenSession(Context, &workers[w].IoTarget)))
+		{
+			StressPrint("Failed to open bus session for worker %lu", w);
+			workers[w].TargetCount = 0;
+		}
+	}
+
+	if (NT_SUCCESS(WdfDriverOpenParametersRegistryKey(WdfGetDriver(), KEY_WRITE, WDF_NO_OBJECT_ATTRIBUTES, &keyParams)))
+	{
+		RtlUnicodeStringInit(&keyName, L"Results");
+
+		if (!NT_SUCCESS(WdfRegistryCreateKey(keyParams, &keyName, KEY_WRITE, REG_OPTION_VOLATILE, nullptr,
+			WDF_NO_OBJECT_ATTRIBUTES, &keyResults)))
+			keyResults = nullptr;
+	}
+
+	StressPrint("%lu X360 and %lu DS4 targets, %lu threads, %lu reports per target",
+		options->X360Targets, options->Ds4Targets, options->Threads, options->ReportsPerTarget);
+
+	//
+	// Single-threaded baseline, the difference to the concurrent run is time
+	// spent waiting on the serialized plug-in path and the child list
+	//
+	if (workers[0].TargetCount > 0)
+	{
+		const auto sliceCount = workers[0].TargetCount;
+
+		workers[0].TargetCount = min(sliceCount, STRESS_BASELINE_TARGETS);
+
+		Stress_RunPhase(workers, 1, StressPhasePlugIn);
+		Stress_RunPhase(workers, 1, StressPhaseUnplug);
+
+		count = Stress_CollectSamples(workers, 1, FIELD_OFFSET(STRESS_TARGET, PlugInTicks), samples, total);
+		baselineMean = Stress_Mean(samples, count);
+
+		Stress_Report(keyResults, L"BaselinePlugInMeanUs", baselineMean);
+		Stress_Report(keyResults, L"BaselinePlugInP50Us", Stress_Percentile(samples, count, 500));
+
+		// The first slice starts at the beginning of the table
+		for (ULONG i = 0; i < workers[0].TargetCount; i++)
+		{
+			RtlZeroMemory(&targets[i], sizeof(STRESS_TARGET));
+			targets[i].Type = (i < options->X360Targets) ? Xbox360Wired : DualShock4Wired;
+		}
+
+		workers[0].TargetCount = sliceCount;
+	}
+
+	Stress_RunPhase(workers, options->Threads, StressPhasePlugIn);
+
+	count = Stress_CollectSamples(workers, options->Threads, FIELD_OFFSET(STRESS_TARGET, PlugInTicks), samples, total);
+	const auto plugInMean = Stress_Mean(samples, count);
+
+	Stress_Report(keyResults, L"TargetsPluggedIn", count);
+	Stress_Report(keyResults, L"PlugInMeanUs", plugInMean);
+	Stress_Report(keyResults, L"PlugInP50Us", Stress_Percentile(samples, count, 500));
+	Stress_Report(keyResults, L"PlugInP99Us", Stress_Percentile(samples, count, 990));
+	Stress_Report(keyResults, L"PlugInMaxUs", Stress_Percentile(samples, count, 1000));
+	Stress_Report(keyResults, L"ChildListContentionUs", (plugInMean > baselineMean) ? plugInMean - baselineMean : 0);
+
+	count = Stress_CollectSamples(workers, options->Threads, FIELD_OFFSET(STRESS_TARGET, ReadyTicks), samples, total);
+
+	Stress_Report(keyResults, L"DeviceReadyP50Us", Stress_Percentile(samples, count, 500));
+	Stress_Report(keyResults, L"DeviceReadyP99Us", Stress_Percentile(samples, count, 990));
+
+	Stress_RunPhase(workers, options->Threads, StressPhaseSubmit);
+
+	{
+		ULONGLONG submitted = 0;
+		ULONGLONG failed = 0;
+		ULONG64 cycles = 0;
+		LONGLONG ticks = 0;
+
+		for (ULONG w = 0; w < options->Threads; w++)
+		{
+			submitted += workers[w].ReportsSubmitted;
+			failed += workers[w].ReportsFailed;
+			cycles += workers[w].SubmitCycles;
+			ticks = max(ticks, workers[w].SubmitTicks);
+		}
+
+		Stress_Report(keyResults, L"ReportsSubmitted", static_cast<ULONG>(submitted));
+		Stress_Report(keyResults, L"ReportsFailed", static_cast<ULONG>(failed));
+		Stress_Report(keyResults, L"CyclesPerReport", submitted ? static_cast<ULONG>(cycles / submitted) : 0);
+		Stress_Report(keyResults, L"NanosecondsPerReport", submitted
+			? static_cast<ULONG>((static_cast<ULONGLONG>(ticks) * 1000000000 / G_Stress.Frequency.QuadPart)
+				* options->Threads / submitted)
+			: 0);
+	}
+
+	Stress_RunPhase(workers, options->Threads, StressPhaseUnplug);
+
+	count = Stress_CollectSamples(workers, options->Threads, FIELD_OFFSET(STRESS_TARGET, UnplugTicks), samples, total);
+
+	Stress_Report(keyResults, L"UnplugP50Us", Stress_Percentile(samples, count, 500));
+	Stress_Report(keyResults, L"UnplugP99Us", Stress_Percentile(samples, count, 990));
+
+runEnd:
+
+	if (keyResults)
+		WdfRegistryClose(keyResults);
+
+	if (keyParams)
+		WdfRegistryClose(keyParams);
+
+	if (workers)
+	{
+		for (ULONG w = 0; w < options->Threads; w++)
+		{
+			// Closing the session unplugs anything left behind
+			if (workers[w].IoTarget)
+				WdfObjectDelete(workers[w].IoTarget);
+		}
+
+		ExFreePoolWithTag(workers, STRESS_POOL_TAG);
+	}
+
+	if (targets)
+		ExFreePoolWithTag(targets, STRESS_POOL_TAG);
+
+	if (samples)
+		ExFreePoolWithTag(samples, STRESS_POOL_TAG);
+}
+
+static VOID Stress_ControlThread(_In_ PVOID StartContext)
+{
+	const auto context = static_cast<PSTRESS_CONTEXT>(StartContext);
+
+	const auto status = Stress_FindBus(context);
+
+	if (NT_SUCCESS(status))
+	{
+		Stress_Run(context);
+
+		ExFreePool(context->BusPathList);
+		context->BusPathList = nullptr;
+	}
+	else
+	{
+		StressPrint("Bus device not found (0x%08X)", status);
+	}
+
+	StressPrint("Run finished");
+
+	PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+_Use_decl_annotations_
+NTSTATUS DriverEntry(
+	PDRIVER_OBJECT DriverObject,
+	PUNICODE_STRING RegistryPath
+)
+{
+	NTSTATUS status;
+	WDF_DRIVER_CONFIG config;
+	WDFDRIVER driver;
+	PWDFDEVICE_INIT deviceInit;
+	HANDLE hThread;
+
+	WDF_DRIVER_CONFIG_INIT(&config, WDF_NO_EVENT_CALLBACK);
+	config.DriverInitFlags |= WdfDriverInitNonPnpDriver;
+	config.EvtDriverUnload = Stress_EvtDriverUnload;
+
+	status = WdfDriverCreate(DriverObject, RegistryPath, WDF_NO_OBJECT_ATTRIBUTES, &config, &driver);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	RtlZeroMemory(&G_Stress, sizeof(STRESS_CONTEXT));
+
+	Stress_ReadOptions(driver, &G_Stress.Options);
+	KeQueryPerformanceCounter(&G_Stress.Frequency);
+
+	//
+	// I/O targets need a device to be parented to
+	//
+	deviceInit = WdfControlDeviceInitAllocate(driver, &SDDL_DEVOBJ_SYS_ALL_ADM_ALL);
+
+	if (deviceInit == nullptr)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	status = WdfDeviceCreate(&deviceInit, WDF_NO_OBJECT_ATTRIBUTES, &G_Stress.ControlDevice);
+
+	if (!NT_SUCCESS(status))
+	{
+		WdfDeviceInitFree(deviceInit);
+		return status;
+	}
+
+	WdfControlFinishInitializing(G_Stress.ControlDevice);
+
+	status = PsCreateSystemThread(&hThread, THREAD_ALL_ACCESS, nullptr, nullptr, nullptr, Stress_ControlThread, &G_Stress);
+
+	if (!NT_SUCCESS(status))
+	{
+		WdfObjectDelete(G_Stress.ControlDevice);
+		return status;
+	}
+
+	(void)ObReferenceObjectByHandle(
+		hThread,
+		THREAD_ALL_ACCESS,
+		*PsThreadType,
+		KernelMode,
+		reinterpret_cast<PVOID*>(&G_Stress.ControlThread),
+		nullptr
+	);
+
+	ZwClose(hThread);
+
+	return STATUS_SUCCESS;
+}
+
+_Use_decl_annotations_
+VOID Stress_EvtDriverUnload(WDFDRIVER Driver)
+{
+	UNREFERENCED_PARAMETER(Driver);
+
+	InterlockedExchange(&G_Stress.Cancel, TRUE);
+
+	if (G_Stress.ControlThread)
+	{
+		(void)KeWaitForSingleObject(G_Stress.ControlThread, Executive, KernelMode, FALSE, nullptr);
+		ObDereferenceObject(G_Stress.ControlThread);
+	}
+}
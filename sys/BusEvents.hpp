@@ -0,0 +1,144 @@
+/*
+* Virtual Gamepad Emulation Framework - Windows kernel-mode bus driver
+*
+* BSD 3-Clause License
+*
+* Copyright (c) 2018-2020, Nefarius Software Solutions e.U. and Contributors
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* 3. Neither the name of the copyright holder nor the names of its
+*    contributors may be used to endorse or promote products derived from
+*    this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <TraceLoggingProvider.h>
+#include <evntrace.h>
+
+//
+// Lean TraceLogging events on the report and PnP paths, meant to stay enabled
+// in production sessions (e.g. WPA) unlike the WPP debug tracing in trace.h
+// 
+TRACELOGGING_DECLARE_PROVIDER(ViGEmBusEventProvider);
+
+//
+// Event keywords to filter sessions by path
+// 
+#define BUS_EVENT_KEYWORD_REPORT            0x0000000000000001ULL
+#define BUS_EVENT_KEYWORD_URB               0x0000000000000002ULL
+#define BUS_EVENT_KEYWORD_NOTIFICATION      0x0000000000000004ULL
+#define BUS_EVENT_KEYWORD_PNP               0x0000000000000008ULL
+
+//
+// Report submitted by the owner process; Timestamp is the QPC value latency
+// gets measured from (client-provided for timed submissions)
+// 
+FORCEINLINE VOID BusEvent_ReportSubmitted(
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Sequence,
+    _In_ LONGLONG Timestamp
+)
+{
+    TraceLoggingWrite(
+        ViGEmBusEventProvider,
+        "ReportSubmitted",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(BUS_EVENT_KEYWORD_REPORT),
+        TraceLoggingUInt32(SerialNo, "SerialNo"),
+        TraceLoggingUInt32(static_cast<UINT32>(TargetType), "TargetType"),
+        TraceLoggingUInt32(Sequence, "Sequence"),
+        TraceLoggingInt64(Timestamp, "Timestamp")
+    );
+}
+
+//
+// Interrupt IN request completed with a new report state
+// 
+FORCEINLINE VOID BusEvent_UsbInCompleted(
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Sequence,
+    _In_ LONGLONG Timestamp,
+    _In_ ULONGLONG LatencyMicroseconds
+)
+{
+    TraceLoggingWrite(
+        ViGEmBusEventProvider,
+        "UsbInCompleted",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(BUS_EVENT_KEYWORD_URB),
+        TraceLoggingUInt32(SerialNo, "SerialNo"),
+        TraceLoggingUInt32(static_cast<UINT32>(TargetType), "TargetType"),
+        TraceLoggingUInt32(Sequence, "Sequence"),
+        TraceLoggingInt64(Timestamp, "Timestamp"),
+        TraceLoggingUInt64(LatencyMicroseconds, "LatencyMicroseconds")
+    );
+}
+
+//
+// Notification request completed with Count output reports
+// 
+FORCEINLINE VOID BusEvent_NotificationCompleted(
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_ ULONG Count
+)
+{
+    TraceLoggingWrite(
+        ViGEmBusEventProvider,
+        "NotificationCompleted",
+        TraceLoggingLevel(TRACE_LEVEL_VERBOSE),
+        TraceLoggingKeyword(BUS_EVENT_KEYWORD_NOTIFICATION),
+        TraceLoggingUInt32(SerialNo, "SerialNo"),
+        TraceLoggingUInt32(static_cast<UINT32>(TargetType), "TargetType"),
+        TraceLoggingUInt32(Count, "Count"),
+        TraceLoggingInt64(KeQueryPerformanceCounter(nullptr).QuadPart, "Timestamp")
+    );
+}
+
+//
+// Target passed a plug-in or removal phase
+// 
+FORCEINLINE VOID BusEvent_TargetPhase(
+    _In_ ULONG SerialNo,
+    _In_ VIGEM_TARGET_TYPE TargetType,
+    _In_z_ PCSTR Phase,
+    _In_ NTSTATUS Status
+)
+{
+    TraceLoggingWrite(
+        ViGEmBusEventProvider,
+        "TargetPhase",
+        TraceLoggingLevel(TRACE_LEVEL_INFORMATION),
+        TraceLoggingKeyword(BUS_EVENT_KEYWORD_PNP),
+        TraceLoggingUInt32(SerialNo, "SerialNo"),
+        TraceLoggingUInt32(static_cast<UINT32>(TargetType), "TargetType"),
+        TraceLoggingString(Phase, "Phase"),
+        TraceLoggingNTStatus(Status, "Status"),
+        TraceLoggingInt64(KeQueryPerformanceCounter(nullptr).QuadPart, "Timestamp")
+    );
+}
@@ -1,7 +1,7 @@
 //
 // Don't compile in verbose tracing on release builds
 // 
-#ifndef DBG
+#if !DBG
 #ifdef TraceDbg
 #undef TraceDbg
 #define TraceDbg(...) { /* nothing to see here :) */ };
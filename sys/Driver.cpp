@@ -52,6 +52,16 @@
 #include "Ds4Pdo.hpp"
 
 #include "Debugging.hpp"
+#include "BusEvents.hpp"
+
+//
+// Provider GUID - 7e8d3488-fe89-44c2-ae53-8a5f2023580d
+// 
+TRACELOGGING_DEFINE_PROVIDER(
+    ViGEmBusEventProvider,
+    "Nefarius.ViGEm.Bus",
+    (0x7e8d3488, 0xfe89, 0x44c2, 0xae, 0x53, 0x8a, 0x5f, 0x20, 0x23, 0x58, 0x0d)
+);
 
 using ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION;
 using ViGEm::Bus::Core::EmulationTargetPDO;
@@ -78,6 +88,11 @@ NTSTATUS DriverEntry(IN PDRIVER_OBJECT DriverObject, IN PUNICODE_STRING Registry
     //
     WPP_INIT_TRACING(DriverObject, RegistryPath);
 
+    //
+    // Hot path events, failing to register just leaves them disabled
+    // 
+    (void)TraceLoggingRegister(ViGEmBusEventProvider);
+
     TraceEvents(TRACE_LEVEL_INFORMATION,
         TRACE_DRIVER,
         "Loading Virtual Gamepad Emulation Bus Driver"
@@ -95,8 +110,29 @@ NTSTATUS DriverEntry(IN PDRIVER_OBJECT DriverObject, IN PUNICODE_STRING Registry
 
     if (!NT_SUCCESS(status))
     {
+        TraceLoggingUnregister(ViGEmBusEventProvider);
         WPP_CLEANUP(DriverObject);
         KdPrint((DRIVERNAME "WdfDriverCreate failed with status 0x%x\n", status));
+        return status;
+    }
+
+    //
+    // Target objects come from lookaside lists, plain pool is used if this fails
+    // 
+    if (!NT_SUCCESS(EmulationTargetXUSB::InitializeLookasideList()))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING,
+            TRACE_DRIVER,
+            "Failed to initialize XUSB lookaside list"
+        );
+    }
+
+    if (!NT_SUCCESS(EmulationTargetDS4::InitializeLookasideList()))
+    {
+        TraceEvents(TRACE_LEVEL_WARNING,
+            TRACE_DRIVER,
+            "Failed to initialize DS4 lookaside list"
+        );
     }
 
     return status;
@@ -116,8 +152,11 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     WDF_FILEOBJECT_CONFIG       foConfig;
     WDF_OBJECT_ATTRIBUTES       fdoAttributes;
     WDF_OBJECT_ATTRIBUTES       fileHandleAttributes;
+    WDF_OBJECT_ATTRIBUTES       queueAttributes;
     PFDO_DEVICE_DATA            pFDOData;
     PWSTR                       pSymbolicNameList;
+    WDFKEY                      keyParams;
+    UNICODE_STRING              valueName;
 
     UNREFERENCED_PARAMETER(Driver);
 
@@ -217,6 +256,45 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 
     pFDOData->InterfaceReferenceCounter = 0;
     pFDOData->NextSessionId = FDO_FIRST_SESSION_ID;
+    pFDOData->TargetTableLock = 0;
+    RtlZeroMemory(pFDOData->TargetTable, sizeof(pFDOData->TargetTable));
+
+    KeInitializeSpinLock(&pFDOData->SerialBitmapLock);
+    RtlInitializeBitMap(&pFDOData->SerialBitmap, pFDOData->SerialBitmapBuffer, FDO_TARGET_TABLE_CAPACITY);
+    RtlClearAllBits(&pFDOData->SerialBitmap);
+    // Serial 0 is reserved
+    RtlSetBit(&pFDOData->SerialBitmap, 0);
+    pFDOData->NextSerialHint = 1;
+
+    KeInitializeSpinLock(&pFDOData->IdentityKeysLock);
+    InitializeListHead(&pFDOData->IdentityKeys);
+
+    KeInitializeSpinLock(&pFDOData->SessionsLock);
+    InitializeListHead(&pFDOData->Sessions);
+
+    //
+    // Optional, targets never go idle unless configured
+    // 
+    pFDOData->IdleTimeout = 0;
+
+    status = WdfDriverOpenParametersRegistryKey(
+        WdfGetDriver(),
+        KEY_READ,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &keyParams
+    );
+    if (NT_SUCCESS(status))
+    {
+        RtlUnicodeStringInit(&valueName, L"IdleTimeout");
+        (void)WdfRegistryQueryULong(keyParams, &valueName, &pFDOData->IdleTimeout);
+
+        WdfRegistryClose(keyParams);
+    }
+
+    TraceEvents(TRACE_LEVEL_INFORMATION,
+        TRACE_DRIVER,
+        "Target idle timeout: %d ms",
+        pFDOData->IdleTimeout);
 
 #pragma endregion
 
@@ -225,9 +303,16 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
     WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchParallel);
 
     queueConfig.EvtIoDeviceControl = Bus_EvtIoDeviceControl;
+    queueConfig.EvtIoInternalDeviceControl = Bus_EvtIoInternalDeviceControl;
+
+    //
+    // Report submission is only synchronized per target, never by the framework
+    // 
+    WDF_OBJECT_ATTRIBUTES_INIT(&queueAttributes);
+    queueAttributes.SynchronizationScope = WdfSynchronizationScopeNone;
 
     __analysis_assume(queueConfig.EvtIoStop != 0);
-    status = WdfIoQueueCreate(device, &queueConfig, WDF_NO_OBJECT_ATTRIBUTES, &queue);
+    status = WdfIoQueueCreate(device, &queueConfig, &queueAttributes, &queue);
     __analysis_assume(queueConfig.EvtIoStop == 0);
 
     if (!NT_SUCCESS(status))
@@ -241,6 +326,35 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 
 #pragma endregion
 
+#pragma region Create PnP I/O queue for FDO
+
+    WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchSequential);
+
+    queueConfig.EvtIoDeviceControl = Bus_EvtIoPnpDeviceControl;
+    queueConfig.EvtIoInternalDeviceControl = Bus_EvtIoPnpInternalDeviceControl;
+
+    //
+    // Plug-in and unplug handlers are pageable
+    // 
+    WDF_OBJECT_ATTRIBUTES_INIT(&queueAttributes);
+    queueAttributes.SynchronizationScope = WdfSynchronizationScopeNone;
+    queueAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+    __analysis_assume(queueConfig.EvtIoStop != 0);
+    status = WdfIoQueueCreate(device, &queueConfig, &queueAttributes, &pFDOData->PnpQueue);
+    __analysis_assume(queueConfig.EvtIoStop == 0);
+
+    if (!NT_SUCCESS(status))
+    {
+        TraceEvents(TRACE_LEVEL_ERROR,
+            TRACE_DRIVER,
+            "WdfIoQueueCreate (PnP) failed with status %!STATUS!",
+            status);
+        return status;
+    }
+
+#pragma endregion
+
 #pragma region Expose FDO interface
 
     status = WdfDeviceCreateDeviceInterface(device, &GUID_DEVINTERFACE_BUSENUM_VIGEM, NULL);
@@ -264,6 +378,15 @@ NTSTATUS Bus_EvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceInit)
 
     WdfDeviceSetBusInformationForChildren(device, &busInfo);
 
+#pragma endregion
+
+#pragma region Create standby targets
+
+    //
+    // Optional warm pool, plug-in falls back to creating new targets
+    // 
+    Bus_CreateStandbyTargets(device);
+
 #pragma endregion
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit with status %!STATUS!", status);
@@ -287,6 +410,7 @@ Bus_DeviceFileCreate(
     PFDO_DEVICE_DATA pFDOData = NULL;
     LONG             refCount = 0;
     LONG             sessionId = 0;
+    KIRQL            irql;
 
     UNREFERENCED_PARAMETER(Request);
 
@@ -305,6 +429,10 @@ Bus_DeviceFileCreate(
     }
     else
     {
+        KeInitializeSpinLock(&pFileData->TargetsLock);
+        InitializeListHead(&pFileData->Targets);
+        InitializeListHead(&pFileData->Link);
+
         pFDOData = FdoGetData(Device);
         if (pFDOData == NULL)
         {
@@ -321,6 +449,10 @@ Bus_DeviceFileCreate(
             pFileData->SessionId = sessionId;
             status = STATUS_SUCCESS;
 
+            KeAcquireSpinLock(&pFDOData->SessionsLock, &irql);
+            InsertTailList(&pFDOData->Sessions, &pFileData->Link);
+            KeReleaseSpinLock(&pFDOData->SessionsLock, irql);
+
             TraceEvents(TRACE_LEVEL_INFORMATION,
                 TRACE_DRIVER,
                 "File/session id = %d, device ref. count = %d",
@@ -343,15 +475,11 @@ Bus_FileClose(
 )
 {
     WDFDEVICE                      device;
-    WDFDEVICE                      hChild;
-    NTSTATUS                       status;
-    WDFCHILDLIST                   list;
-    WDF_CHILD_LIST_ITERATOR        iterator;
-    WDF_CHILD_RETRIEVE_INFO        childInfo;
-    PDO_IDENTIFICATION_DESCRIPTION description;
+    NTSTATUS                       status = STATUS_SUCCESS;
     PFDO_FILE_DATA                 pFileData = NULL;
     PFDO_DEVICE_DATA               pFDOData = NULL;
     LONG                           refCount = 0;
+    KIRQL                          irql;
 
     PAGED_CODE();
 
@@ -389,57 +517,22 @@ Bus_FileClose(
             (int)refCount);
     }
 
-    list = WdfFdoGetDefaultChildList(device);
-
-    WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
-
-    WdfChildListBeginIteration(list, &iterator);
+    //
+    // Only this session's targets are touched, others don't contend
+    // 
+    (void)Bus_UnPlugSessionTargets(device, pFileData, 0);
 
-    for (;;)
+    //
+    // Leaves the registry last so internal unplugs keep finding entries until now
+    // 
+    if (pFDOData != NULL)
     {
-        WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
-        WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
-
-        status = WdfChildListRetrieveNextDevice(list, &iterator, &hChild, &childInfo);
-        if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
-        {
-            break;
-        }
-
-        //TraceEvents(TRACE_LEVEL_VERBOSE,
-        //    TRACE_DRIVER,
-        //    "PDO properties: status = %!STATUS!, pdoPID = %d, curPID = %d, pdoSID = %d, curSID = %d, internal = %d",
-        //    (int)childInfo.Status,
-        //    (int)description.OwnerProcessId,
-        //    (int)CURRENT_PROCESS_ID(),
-        //    (int)description.SessionId,
-        //    (int)pFileData->SessionId,
-        //    (int)description.OwnerIsDriver
-        //);
-
-        // Only unplug devices with matching session id
-        if (childInfo.Status == WdfChildListRetrieveDeviceSuccess
-            && description.SessionId == pFileData->SessionId)
-        {
-            TraceEvents(TRACE_LEVEL_INFORMATION,
-                TRACE_DRIVER,
-                "Unplugging device with serial %d",
-                description.SerialNo);
-
-            // "Unplug" child
-            status = WdfChildListUpdateChildDescriptionAsMissing(list, &description.Header);
-            if (!NT_SUCCESS(status))
-            {
-                TraceEvents(TRACE_LEVEL_ERROR,
-                    TRACE_DRIVER,
-                    "WdfChildListUpdateChildDescriptionAsMissing failed with status %!STATUS!",
-                    status);
-            }
-        }
+        KeAcquireSpinLock(&pFDOData->SessionsLock, &irql);
+        RemoveEntryList(&pFileData->Link);
+        InitializeListHead(&pFileData->Link);
+        KeReleaseSpinLock(&pFDOData->SessionsLock, irql);
     }
 
-    WdfChildListEndIteration(list, &iterator);
-
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
@@ -468,6 +561,14 @@ Return Value:
 
     TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DRIVER, "%!FUNC! Entry");
 
+    //
+    // All target objects are gone by now
+    // 
+    EmulationTargetXUSB::DeleteLookasideList();
+    EmulationTargetDS4::DeleteLookasideList();
+
+    TraceLoggingUnregister(ViGEmBusEventProvider);
+
     //
     // Stop WPP Tracing
     //
@@ -42,14 +42,25 @@
 #include <wdf.h>
 #define NTSTRSAFE_LIB
 #include <ntstrsafe.h>
+#include <ViGEm/Common.h>
 
 
 #pragma region Macros
 
 #define DRIVERNAME                      "ViGEm: "
 
+#define SESSION_TARGET_POOL_TAG         'SSiV'
+#define IDENTITY_KEY_POOL_TAG           'KIiV'
+
 #pragma endregion
 
+//
+// Serial-to-target lookup table geometry (covers serials 0 to 0xFFFF)
+// 
+#define FDO_TARGET_TABLE_PAGE_SIZE      0x100
+#define FDO_TARGET_TABLE_DIRECTORY_SIZE 0x100
+#define FDO_TARGET_TABLE_CAPACITY       (FDO_TARGET_TABLE_PAGE_SIZE * FDO_TARGET_TABLE_DIRECTORY_SIZE)
+
 //
 // FDO (bus device) context data
 // 
@@ -65,12 +76,126 @@ typedef struct _FDO_DEVICE_DATA
     // 
     LONG NextSessionId;
 
+    //
+    // Guards TargetTable; readers share it, only plug-in and removal take it exclusively
+    // 
+    EX_SPIN_LOCK TargetTableLock;
+
+    //
+    // Serial-indexed table of target objects, pages allocated on demand
+    // 
+    PVOID* TargetTable[FDO_TARGET_TABLE_DIRECTORY_SIZE];
+
+    //
+    // Guards SerialBitmap and NextSerialHint
+    // 
+    KSPIN_LOCK SerialBitmapLock;
+
+    //
+    // Tracks serial numbers in use (covers the same range as TargetTable)
+    // 
+    RTL_BITMAP SerialBitmap;
+
+    //
+    // Storage of SerialBitmap
+    // 
+    ULONG SerialBitmapBuffer[FDO_TARGET_TABLE_CAPACITY / (sizeof(ULONG) * 8)];
+
+    //
+    // Bitmap position to start searching for the next free serial number
+    // 
+    ULONG NextSerialHint;
+
+    //
+    // Guards IdentityKeys
+    // 
+    KSPIN_LOCK IdentityKeysLock;
+
+    //
+    // Stable identity keys (FDO_IDENTITY_KEY) claimed from plug-in until the PDO is gone
+    // 
+    LIST_ENTRY IdentityKeys;
+
+    //
+    // Guards Sessions; taken before any session's TargetsLock
+    // 
+    KSPIN_LOCK SessionsLock;
+
+    //
+    // Open file handles (FDO_FILE_DATA), lets internal unplug find a target's owner
+    // 
+    LIST_ENTRY Sessions;
+
+    //
+    // Sequential queue serving plug-in and unplug requests
+    // 
+    WDFQUEUE PnpQueue;
+
+    //
+    // Quiet period (ms) after which targets pause their periodic work, zero if disabled
+    // 
+    ULONG IdleTimeout;
+
 } FDO_DEVICE_DATA, * PFDO_DEVICE_DATA;
 
 #define FDO_FIRST_SESSION_ID 100
 
+//
+// Session ID of parked standby targets not bound to any file handle
+// 
+#define FDO_STANDBY_SESSION_ID 0
+
+//
+// Upper limit of standby targets kept per target type
+// 
+#define FDO_STANDBY_TARGETS_MAX 16
+
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_DEVICE_DATA, FdoGetData)
 
+//
+// Target plugged in through a file handle
+// 
+typedef struct _FDO_SESSION_TARGET
+{
+    //
+    // Entry in FDO_FILE_DATA.Targets
+    // 
+    LIST_ENTRY Link;
+
+    //
+    // Serial number of the target
+    // 
+    ULONG SerialNo;
+
+    //
+    // Type of the target, used for lookup table access
+    // 
+    VIGEM_TARGET_TYPE TargetType;
+
+    //
+    // Bound standby target, gets parked instead of unplugged
+    // 
+    BOOLEAN IsStandby;
+
+} FDO_SESSION_TARGET, * PFDO_SESSION_TARGET;
+
+//
+// Stable identity key claimed by a target
+// 
+typedef struct _FDO_IDENTITY_KEY
+{
+    //
+    // Entry in FDO_DEVICE_DATA.IdentityKeys
+    // 
+    LIST_ENTRY Link;
+
+    //
+    // Key the instance ID (and DS4 MAC address) is derived from
+    // 
+    ULONG Key;
+
+} FDO_IDENTITY_KEY, * PFDO_IDENTITY_KEY;
+
 // 
 // Context data associated with file objects created by user mode applications
 // 
@@ -81,6 +206,21 @@ typedef struct _FDO_FILE_DATA
     // 
     LONG SessionId;
 
+    //
+    // Guards Targets; only taken by requests of this session
+    // 
+    KSPIN_LOCK TargetsLock;
+
+    //
+    // Targets owned by this session (FDO_SESSION_TARGET entries)
+    // 
+    LIST_ENTRY Targets;
+
+    //
+    // Entry in FDO_DEVICE_DATA.Sessions
+    // 
+    LIST_ENTRY Link;
+
 } FDO_FILE_DATA, * PFDO_FILE_DATA;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FDO_FILE_DATA, FileObjectGetData)
@@ -122,6 +262,56 @@ Bus_UnPlugDevice(
     _Out_ size_t* Transferred
 );
 
+NTSTATUS
+Bus_ApplyTargetChanges(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request,
+    _Out_ size_t* Transferred
+);
+
+NTSTATUS
+Bus_GetSessionUserIndices(
+    _In_ WDFDEVICE Device,
+    _In_ WDFREQUEST Request,
+    _Out_ size_t* Transferred
+);
+
+NTSTATUS
+Bus_AcquireSerial(
+    _In_ WDFDEVICE Device,
+    _Inout_ PULONG SerialNo
+);
+
+VOID
+Bus_ReleaseSerial(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG SerialNo
+);
+
+NTSTATUS
+Bus_AcquireIdentityKey(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG Key
+);
+
+VOID
+Bus_ReleaseIdentityKey(
+    _In_ WDFDEVICE Device,
+    _In_ ULONG Key
+);
+
+VOID
+Bus_CreateStandbyTargets(
+    _In_ WDFDEVICE Device
+);
+
+NTSTATUS
+Bus_UnPlugSessionTargets(
+    _In_ WDFDEVICE Device,
+    _In_ PFDO_FILE_DATA FileData,
+    _In_ ULONG SerialNo
+);
+
 #pragma endregion
 
 EXTERN_C_END
@@ -41,10 +41,366 @@
 #include <ntstrsafe.h>
 
 #include "Debugging.hpp"
+#include "BusEvents.hpp"
 
 
 PCWSTR ViGEm::Bus::Targets::EmulationTargetDS4::_deviceDescription = L"Virtual DualShock 4 Controller";
 
+#pragma region Descriptor tables
+
+//
+// Device descriptor template, VID and PID get patched in per instance
+// 
+const USB_DEVICE_DESCRIPTOR ViGEm::Bus::Targets::EmulationTargetDS4::_DeviceDescriptor =
+{
+	0x12,                       // bLength
+	USB_DEVICE_DESCRIPTOR_TYPE, // bDescriptorType
+	0x0200,                     // bcdUSB USB v2.0
+	0x00,                       // bDeviceClass (per Interface)
+	0x00,                       // bDeviceSubClass
+	0x00,                       // bDeviceProtocol
+	0x40,                       // bMaxPacketSize0
+	0x054C,                     // idVendor
+	0x05C4,                     // idProduct
+	0x0100,                     // bcdDevice
+	0x01,                       // iManufacturer
+	0x02,                       // iProduct
+	0x00,                       // iSerialNumber
+	0x01                        // bNumConfigurations
+};
+
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_ConfigurationDescriptor[DS4_DESCRIPTOR_SIZE] =
+{
+	0x09,        // bLength
+	0x02,        // bDescriptorType (Configuration)
+	0x29, 0x00,  // wTotalLength 41
+	0x01,        // bNumInterfaces 1
+	0x01,        // bConfigurationValue
+	0x00,        // iConfiguration (String Index)
+	0xC0,        // bmAttributes Self Powered
+	0xFA,        // bMaxPower 500mA
+
+	0x09,        // bLength
+	0x04,        // bDescriptorType (Interface)
+	0x00,        // bInterfaceNumber 0
+	0x00,        // bAlternateSetting
+	0x02,        // bNumEndpoints 2
+	0x03,        // bInterfaceClass
+	0x00,        // bInterfaceSubClass
+	0x00,        // bInterfaceProtocol
+	0x00,        // iInterface (String Index)
+
+	0x09,        // bLength
+	0x21,        // bDescriptorType (HID)
+	0x11, 0x01,  // bcdHID 1.11
+	0x00,        // bCountryCode
+	0x01,        // bNumDescriptors
+	0x22,        // bDescriptorType[0] (HID)
+	0xD3, 0x01,  // wDescriptorLength[0] 467
+
+	0x07,        // bLength
+	0x05,        // bDescriptorType (Endpoint)
+	0x84,        // bEndpointAddress (IN/D2H)
+	0x03,        // bmAttributes (Interrupt)
+	0x40, 0x00,  // wMaxPacketSize 64
+	0x05,        // bInterval 5 (unit depends on device speed)
+
+	0x07,        // bLength
+	0x05,        // bDescriptorType (Endpoint)
+	0x03,        // bEndpointAddress (OUT/H2D)
+	0x03,        // bmAttributes (Interrupt)
+	0x40, 0x00,  // wMaxPacketSize 64
+	0x05,        // bInterval 5 (unit depends on device speed)
+
+	// 41 bytes
+
+	// best guess: USB Standard Descriptor
+};
+
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_HidReportDescriptor[DS4_HID_REPORT_DESCRIPTOR_SIZE] =
+{
+	0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
+	0x09, 0x05,        // Usage (Game Pad)
+	0xA1, 0x01,        // Collection (Application)
+	0x85, 0x01,        //   Report ID (1)
+	0x09, 0x30,        //   Usage (X)
+	0x09, 0x31,        //   Usage (Y)
+	0x09, 0x32,        //   Usage (Z)
+	0x09, 0x35,        //   Usage (Rz)
+	0x15, 0x00,        //   Logical Minimum (0)
+	0x26, 0xFF, 0x00,  //   Logical Maximum (255)
+	0x75, 0x08,        //   Report Size (8)
+	0x95, 0x04,        //   Report Count (4)
+	0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+	0x09, 0x39,        //   Usage (Hat switch)
+	0x15, 0x00,        //   Logical Minimum (0)
+	0x25, 0x07,        //   Logical Maximum (7)
+	0x35, 0x00,        //   Physical Minimum (0)
+	0x46, 0x3B, 0x01,  //   Physical Maximum (315)
+	0x65, 0x14,        //   Unit (System: English Rotation, Length: Centimeter)
+	0x75, 0x04,        //   Report Size (4)
+	0x95, 0x01,        //   Report Count (1)
+	0x81, 0x42,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,Null State)
+	0x65, 0x00,        //   Unit (None)
+	0x05, 0x09,        //   Usage Page (Button)
+	0x19, 0x01,        //   Usage Minimum (0x01)
+	0x29, 0x0E,        //   Usage Maximum (0x0E)
+	0x15, 0x00,        //   Logical Minimum (0)
+	0x25, 0x01,        //   Logical Maximum (1)
+	0x75, 0x01,        //   Report Size (1)
+	0x95, 0x0E,        //   Report Count (14)
+	0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+	0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
+	0x09, 0x20,        //   Usage (0x20)
+	0x75, 0x06,        //   Report Size (6)
+	0x95, 0x01,        //   Report Count (1)
+	0x15, 0x00,        //   Logical Minimum (0)
+	0x25, 0x7F,        //   Logical Maximum (127)
+	0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+	0x05, 0x01,        //   Usage Page (Generic Desktop Ctrls)
+	0x09, 0x33,        //   Usage (Rx)
+	0x09, 0x34,        //   Usage (Ry)
+	0x15, 0x00,        //   Logical Minimum (0)
+	0x26, 0xFF, 0x00,  //   Logical Maximum (255)
+	0x75, 0x08,        //   Report Size (8)
+	0x95, 0x02,        //   Report Count (2)
+	0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+	0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
+	0x09, 0x21,        //   Usage (0x21)
+	0x95, 0x36,        //   Report Count (54)
+	0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+	0x85, 0x05,        //   Report ID (5)
+	0x09, 0x22,        //   Usage (0x22)
+	0x95, 0x1F,        //   Report Count (31)
+	0x91, 0x02,        //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x04,        //   Report ID (4)
+	0x09, 0x23,        //   Usage (0x23)
+	0x95, 0x24,        //   Report Count (36)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x02,        //   Report ID (2)
+	0x09, 0x24,        //   Usage (0x24)
+	0x95, 0x24,        //   Report Count (36)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x08,        //   Report ID (8)
+	0x09, 0x25,        //   Usage (0x25)
+	0x95, 0x03,        //   Report Count (3)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x10,        //   Report ID (16)
+	0x09, 0x26,        //   Usage (0x26)
+	0x95, 0x04,        //   Report Count (4)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x11,        //   Report ID (17)
+	0x09, 0x27,        //   Usage (0x27)
+	0x95, 0x02,        //   Report Count (2)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x12,        //   Report ID (18)
+	0x06, 0x02, 0xFF,  //   Usage Page (Vendor Defined 0xFF02)
+	0x09, 0x21,        //   Usage (0x21)
+	0x95, 0x0F,        //   Report Count (15)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x13,        //   Report ID (19)
+	0x09, 0x22,        //   Usage (0x22)
+	0x95, 0x16,        //   Report Count (22)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x14,        //   Report ID (20)
+	0x06, 0x05, 0xFF,  //   Usage Page (Vendor Defined 0xFF05)
+	0x09, 0x20,        //   Usage (0x20)
+	0x95, 0x10,        //   Report Count (16)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x15,        //   Report ID (21)
+	0x09, 0x21,        //   Usage (0x21)
+	0x95, 0x2C,        //   Report Count (44)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x06, 0x80, 0xFF,  //   Usage Page (Vendor Defined 0xFF80)
+	0x85, 0x80,        //   Report ID (128)
+	0x09, 0x20,        //   Usage (0x20)
+	0x95, 0x06,        //   Report Count (6)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x81,        //   Report ID (129)
+	0x09, 0x21,        //   Usage (0x21)
+	0x95, 0x06,        //   Report Count (6)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x82,        //   Report ID (130)
+	0x09, 0x22,        //   Usage (0x22)
+	0x95, 0x05,        //   Report Count (5)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x83,        //   Report ID (131)
+	0x09, 0x23,        //   Usage (0x23)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x84,        //   Report ID (132)
+	0x09, 0x24,        //   Usage (0x24)
+	0x95, 0x04,        //   Report Count (4)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x85,        //   Report ID (133)
+	0x09, 0x25,        //   Usage (0x25)
+	0x95, 0x06,        //   Report Count (6)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x86,        //   Report ID (134)
+	0x09, 0x26,        //   Usage (0x26)
+	0x95, 0x06,        //   Report Count (6)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x87,        //   Report ID (135)
+	0x09, 0x27,        //   Usage (0x27)
+	0x95, 0x23,        //   Report Count (35)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x88,        //   Report ID (136)
+	0x09, 0x28,        //   Usage (0x28)
+	0x95, 0x22,        //   Report Count (34)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x89,        //   Report ID (137)
+	0x09, 0x29,        //   Usage (0x29)
+	0x95, 0x02,        //   Report Count (2)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x90,        //   Report ID (144)
+	0x09, 0x30,        //   Usage (0x30)
+	0x95, 0x05,        //   Report Count (5)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x91,        //   Report ID (145)
+	0x09, 0x31,        //   Usage (0x31)
+	0x95, 0x03,        //   Report Count (3)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x92,        //   Report ID (146)
+	0x09, 0x32,        //   Usage (0x32)
+	0x95, 0x03,        //   Report Count (3)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0x93,        //   Report ID (147)
+	0x09, 0x33,        //   Usage (0x33)
+	0x95, 0x0C,        //   Report Count (12)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA0,        //   Report ID (160)
+	0x09, 0x40,        //   Usage (0x40)
+	0x95, 0x06,        //   Report Count (6)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA1,        //   Report ID (161)
+	0x09, 0x41,        //   Usage (0x41)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA2,        //   Report ID (162)
+	0x09, 0x42,        //   Usage (0x42)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA3,        //   Report ID (163)
+	0x09, 0x43,        //   Usage (0x43)
+	0x95, 0x30,        //   Report Count (48)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA4,        //   Report ID (164)
+	0x09, 0x44,        //   Usage (0x44)
+	0x95, 0x0D,        //   Report Count (13)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA5,        //   Report ID (165)
+	0x09, 0x45,        //   Usage (0x45)
+	0x95, 0x15,        //   Report Count (21)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA6,        //   Report ID (166)
+	0x09, 0x46,        //   Usage (0x46)
+	0x95, 0x15,        //   Report Count (21)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xF0,        //   Report ID (240)
+	0x09, 0x47,        //   Usage (0x47)
+	0x95, 0x3F,        //   Report Count (63)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xF1,        //   Report ID (241)
+	0x09, 0x48,        //   Usage (0x48)
+	0x95, 0x3F,        //   Report Count (63)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xF2,        //   Report ID (242)
+	0x09, 0x49,        //   Usage (0x49)
+	0x95, 0x0F,        //   Report Count (15)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA7,        //   Report ID (167)
+	0x09, 0x4A,        //   Usage (0x4A)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA8,        //   Report ID (168)
+	0x09, 0x4B,        //   Usage (0x4B)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xA9,        //   Report ID (169)
+	0x09, 0x4C,        //   Usage (0x4C)
+	0x95, 0x08,        //   Report Count (8)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAA,        //   Report ID (170)
+	0x09, 0x4E,        //   Usage (0x4E)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAB,        //   Report ID (171)
+	0x09, 0x4F,        //   Usage (0x4F)
+	0x95, 0x39,        //   Report Count (57)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAC,        //   Report ID (172)
+	0x09, 0x50,        //   Usage (0x50)
+	0x95, 0x39,        //   Report Count (57)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAD,        //   Report ID (173)
+	0x09, 0x51,        //   Usage (0x51)
+	0x95, 0x0B,        //   Report Count (11)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAE,        //   Report ID (174)
+	0x09, 0x52,        //   Usage (0x52)
+	0x95, 0x01,        //   Report Count (1)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xAF,        //   Report ID (175)
+	0x09, 0x53,        //   Usage (0x53)
+	0x95, 0x02,        //   Report Count (2)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0x85, 0xB0,        //   Report ID (176)
+	0x09, 0x54,        //   Usage (0x54)
+	0x95, 0x3F,        //   Report Count (63)
+	0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+	0xC0,              // End Collection
+};
+
+// "American English"
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_LanguageIdDescriptor[DS4_LANGUAGE_ID_LENGTH] =
+{
+	0x04, 0x03, 0x09, 0x04
+};
+
+// "Sony Computer Entertainment"
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_ManufacturerStringDescriptor[DS4_MANUFACTURER_NAME_LENGTH] =
+{
+	0x38, 0x03, 0x53, 0x00, 0x6F, 0x00, 0x6E, 0x00,
+	0x79, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
+	0x6D, 0x00, 0x70, 0x00, 0x75, 0x00, 0x74, 0x00,
+	0x65, 0x00, 0x72, 0x00, 0x20, 0x00, 0x45, 0x00,
+	0x6E, 0x00, 0x74, 0x00, 0x65, 0x00, 0x72, 0x00,
+	0x74, 0x00, 0x61, 0x00, 0x69, 0x00, 0x6E, 0x00,
+	0x6D, 0x00, 0x65, 0x00, 0x6E, 0x00, 0x74, 0x00
+};
+
+// "Wireless Controller"
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_ProductStringDescriptor[DS4_PRODUCT_NAME_LENGTH] =
+{
+	0x28, 0x03, 0x57, 0x00, 0x69, 0x00, 0x72, 0x00,
+	0x65, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x73, 0x00,
+	0x73, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
+	0x6E, 0x00, 0x74, 0x00, 0x72, 0x00, 0x6F, 0x00,
+	0x6C, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x72, 0x00
+};
+
+#pragma endregion
+
+//
+// Masks out the parts of the input report which change with every report
+// regardless of user input (offsets include the leading report ID)
+// 
+const UCHAR ViGEm::Bus::Targets::EmulationTargetDS4::_ReportChangeMask[DS4_REPORT_SIZE] =
+{
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x03,       // [7] PS/touchpad click, upper 6 bits are the report counter
+	0xFF, 0xFF,
+	0x00, 0x00, // [10..11] timestamp
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00,       // [34] current touch packet counter
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00,       // [43] previous touch packet counter
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00,       // [52] previous touch packet counter
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
 ViGEm::Bus::Targets::EmulationTargetDS4::EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId,
                                                             USHORT ProductId) : EmulationTargetPDO(
 	Serial, SessionId, VendorId, ProductId)
@@ -166,11 +522,13 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareHardware()
 	};
 
 	// Initialize HID reports to defaults
-	RtlCopyBytes(this->_Report, DefaultHidReport, DS4_REPORT_SIZE);
+	RtlCopyBytes(this->_Report.BeginWrite(), DefaultHidReport, DS4_REPORT_SIZE);
+	this->_Report.EndWrite();
 	RtlZeroMemory(&this->_OutputReport, sizeof(DS4_OUTPUT_REPORT));
 
-	// Start pending IRP queue flush timer
-	WdfTimerStart(this->_PendingUsbInRequestsTimer, DS4_QUEUE_FLUSH_PERIOD);
+	// Start pending IRP queue flush (or keep-alive) timer
+	if (this->_PendingUsbInRequestsTimerPeriod > 0)
+		WdfTimerStart(this->_PendingUsbInRequestsTimer, this->_PendingUsbInRequestsTimerPeriod);
 
 	return STATUS_SUCCESS;
 }
@@ -178,36 +536,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoPrepareHardware()
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 {
 	NTSTATUS status;
-
-	// Initialize periodic timer
-	WDF_TIMER_CONFIG timerConfig;
-	WDF_TIMER_CONFIG_INIT_PERIODIC(
-		&timerConfig,
-		PendingUsbRequestsTimerFunc,
-		DS4_QUEUE_FLUSH_PERIOD
-	);
-
-	// Timer object attributes
-	WDF_OBJECT_ATTRIBUTES timerAttribs;
-	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttribs);
-
-	// PDO is parent
-	timerAttribs.ParentObject = this->_PdoDevice;
-
-	// Create timer
-	status = WdfTimerCreate(
-		&timerConfig,
-		&timerAttribs,
-		&this->_PendingUsbInRequestsTimer
-	);
-	if (!NT_SUCCESS(status))
-	{
-		TraceEvents(TRACE_LEVEL_ERROR,
-		            TRACE_DS4,
-		            "WdfTimerCreate failed with status %!STATUS!",
-		            status);
-		return status;
-	}
+	ULONG value;
 
 	// Load/generate MAC address
 
@@ -273,8 +602,48 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 		return status;
 	}
 
-	DECLARE_UNICODE_STRING_SIZE(serialPath, 4);
-	RtlUnicodeStringPrintf(&serialPath, L"%04d", this->_SerialNo);
+	//
+	// Input delivery mode, shared by all DualShock targets
+	// 
+	RtlUnicodeStringInit(&valueName, L"EventDrivenInput");
+
+	if (NT_SUCCESS(WdfRegistryQueryULong(keyDS, &valueName, &value)))
+	{
+		this->_EventDrivenInput = (value != 0);
+	}
+
+	//
+	// Input is flushed at the polling interval the endpoint advertises
+	// 
+	this->_PendingUsbInRequestsTimerPeriod = this->GetReportInterval(DS4_QUEUE_FLUSH_PERIOD);
+
+	if (this->_EventDrivenInput)
+	{
+		this->_PendingUsbInRequestsTimerPeriod = DS4_DEFAULT_KEEP_ALIVE_INTERVAL;
+
+		RtlUnicodeStringInit(&valueName, L"KeepAliveInterval");
+
+		if (NT_SUCCESS(WdfRegistryQueryULong(keyDS, &valueName, &value)))
+		{
+			this->_PendingUsbInRequestsTimerPeriod = value;
+		}
+	}
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+	            TRACE_DS4,
+	            "Event-driven input: %d, timer period: %d ms",
+	            this->_EventDrivenInput,
+	            this->_PendingUsbInRequestsTimerPeriod);
+
+	//
+	// Stable identities keep their MAC address no matter the serial they get
+	// 
+	DECLARE_UNICODE_STRING_SIZE(serialPath, 11);
+
+	if (this->GetIdentityKey() != 0)
+		RtlUnicodeStringPrintf(&serialPath, L"ID%08X", this->GetIdentityKey());
+	else
+		RtlUnicodeStringPrintf(&serialPath, L"%04d", this->_SerialNo);
 
 	status = WdfRegistryCreateKey(
 		keyDS,
@@ -349,78 +718,64 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::PdoInitContext()
 	WdfRegistryClose(keyTargets);
 	WdfRegistryClose(keyParams);
 
+	// Initialize periodic timer
+	WDF_TIMER_CONFIG timerConfig;
+	WDF_TIMER_CONFIG_INIT_PERIODIC(
+		&timerConfig,
+		PendingUsbRequestsTimerFunc,
+		this->_PendingUsbInRequestsTimerPeriod
+	);
+
+	// Keep-alive isn't time critical, let the system coalesce it
+	if (this->_EventDrivenInput)
+		timerConfig.TolerableDelay = this->_PendingUsbInRequestsTimerPeriod / 4;
+	//
+	// An explicitly requested period below the clock tick (100ns units)
+	// would otherwise get rounded up to it, e.g. 1 ms to ~15.6 ms
+	// 
+	else if (this->GetReportInterval(0) != 0
+		&& this->_PendingUsbInRequestsTimerPeriod * 10000 < KeQueryTimeIncrement())
+		timerConfig.UseHighResolutionTimer = WdfTrue;
+
+	// Timer object attributes
+	WDF_OBJECT_ATTRIBUTES timerAttribs;
+	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttribs);
+
+	// PDO is parent
+	timerAttribs.ParentObject = this->_PdoDevice;
+
+	// Create timer
+	status = WdfTimerCreate(
+		&timerConfig,
+		&timerAttribs,
+		&this->_PendingUsbInRequestsTimer
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_DS4,
+		            "WdfTimerCreate failed with status %!STATUS!",
+		            status);
+		return status;
+	}
+
 	return STATUS_SUCCESS;
 }
 
 VOID ViGEm::Bus::Targets::EmulationTargetDS4::GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length)
 {
-	UCHAR Ds4DescriptorData[DS4_DESCRIPTOR_SIZE] =
-	{
-		0x09,        // bLength
-		0x02,        // bDescriptorType (Configuration)
-		0x29, 0x00,  // wTotalLength 41
-		0x01,        // bNumInterfaces 1
-		0x01,        // bConfigurationValue
-		0x00,        // iConfiguration (String Index)
-		0xC0,        // bmAttributes Self Powered
-		0xFA,        // bMaxPower 500mA
-
-		0x09,        // bLength
-		0x04,        // bDescriptorType (Interface)
-		0x00,        // bInterfaceNumber 0
-		0x00,        // bAlternateSetting
-		0x02,        // bNumEndpoints 2
-		0x03,        // bInterfaceClass
-		0x00,        // bInterfaceSubClass
-		0x00,        // bInterfaceProtocol
-		0x00,        // iInterface (String Index)
-
-		0x09,        // bLength
-		0x21,        // bDescriptorType (HID)
-		0x11, 0x01,  // bcdHID 1.11
-		0x00,        // bCountryCode
-		0x01,        // bNumDescriptors
-		0x22,        // bDescriptorType[0] (HID)
-		0xD3, 0x01,  // wDescriptorLength[0] 467
-
-		0x07,        // bLength
-		0x05,        // bDescriptorType (Endpoint)
-		0x84,        // bEndpointAddress (IN/D2H)
-		0x03,        // bmAttributes (Interrupt)
-		0x40, 0x00,  // wMaxPacketSize 64
-		0x05,        // bInterval 5 (unit depends on device speed)
-
-		0x07,        // bLength
-		0x05,        // bDescriptorType (Endpoint)
-		0x03,        // bEndpointAddress (OUT/H2D)
-		0x03,        // bmAttributes (Interrupt)
-		0x40, 0x00,  // wMaxPacketSize 64
-		0x05,        // bInterval 5 (unit depends on device speed)
-
-					 // 41 bytes
-
-					 // best guess: USB Standard Descriptor
-	};
+	RtlCopyMemory(Buffer, _ConfigurationDescriptor, min(Length, sizeof(_ConfigurationDescriptor)));
 
-	RtlCopyBytes(Buffer, Ds4DescriptorData, Length);
+	// Interrupt IN bInterval may be overridden per target
+	if (Length > DS4_INTERRUPT_IN_INTERVAL_OFFSET)
+		Buffer[DS4_INTERRUPT_IN_INTERVAL_OFFSET] = this->GetInterruptInInterval(DS4_QUEUE_FLUSH_PERIOD);
 }
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor)
 {
-	pDescriptor->bLength = 0x12;
-	pDescriptor->bDescriptorType = USB_DEVICE_DESCRIPTOR_TYPE;
-	pDescriptor->bcdUSB = 0x0200; // USB v2.0
-	pDescriptor->bDeviceClass = 0x00; // per Interface
-	pDescriptor->bDeviceSubClass = 0x00;
-	pDescriptor->bDeviceProtocol = 0x00;
-	pDescriptor->bMaxPacketSize0 = 0x40;
+	*pDescriptor = _DeviceDescriptor;
 	pDescriptor->idVendor = this->_VendorId;
 	pDescriptor->idProduct = this->_ProductId;
-	pDescriptor->bcdDevice = 0x0100;
-	pDescriptor->iManufacturer = 0x01;
-	pDescriptor->iProduct = 0x02;
-	pDescriptor->iSerialNumber = 0x00;
-	pDescriptor->bNumConfigurations = 0x01;
 
 	return STATUS_SUCCESS;
 }
@@ -454,7 +809,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SelectConfiguration(PURB Urb)
 	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
 	pInfo->Pipes[0].MaximumPacketSize = 0x40;
 	pInfo->Pipes[0].EndpointAddress = 0x84;
-	pInfo->Pipes[0].Interval = 0x05;
+	pInfo->Pipes[0].Interval = this->GetInterruptInInterval(DS4_QUEUE_FLUSH_PERIOD);
 	pInfo->Pipes[0].PipeType = static_cast<USBD_PIPE_TYPE>(0x03);
 	pInfo->Pipes[0].PipeHandle = reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0084);
 	pInfo->Pipes[0].PipeFlags = 0x00;
@@ -467,6 +822,9 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SelectConfiguration(PURB Urb)
 	pInfo->Pipes[1].PipeHandle = reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0003);
 	pInfo->Pipes[1].PipeFlags = 0x00;
 
+	// Interrupt IN transfers on this pipe take the fast path from now on
+	this->_UsbInDataPipe = pInfo->Pipes[0].PipeHandle;
+
 	return STATUS_SUCCESS;
 }
 
@@ -648,240 +1006,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbClassInterface(PURB Urb)
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDescriptorFromInterface(PURB Urb)
 {
 	NTSTATUS status = STATUS_INVALID_PARAMETER;
-	UCHAR Ds4HidReportDescriptor[] =
-	{
-		0x05, 0x01,        // Usage Page (Generic Desktop Ctrls)
-		0x09, 0x05,        // Usage (Game Pad)
-		0xA1, 0x01,        // Collection (Application)
-		0x85, 0x01,        //   Report ID (1)
-		0x09, 0x30,        //   Usage (X)
-		0x09, 0x31,        //   Usage (Y)
-		0x09, 0x32,        //   Usage (Z)
-		0x09, 0x35,        //   Usage (Rz)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x26, 0xFF, 0x00,  //   Logical Maximum (255)
-		0x75, 0x08,        //   Report Size (8)
-		0x95, 0x04,        //   Report Count (4)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x09, 0x39,        //   Usage (Hat switch)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x07,        //   Logical Maximum (7)
-		0x35, 0x00,        //   Physical Minimum (0)
-		0x46, 0x3B, 0x01,  //   Physical Maximum (315)
-		0x65, 0x14,        //   Unit (System: English Rotation, Length: Centimeter)
-		0x75, 0x04,        //   Report Size (4)
-		0x95, 0x01,        //   Report Count (1)
-		0x81, 0x42,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,Null State)
-		0x65, 0x00,        //   Unit (None)
-		0x05, 0x09,        //   Usage Page (Button)
-		0x19, 0x01,        //   Usage Minimum (0x01)
-		0x29, 0x0E,        //   Usage Maximum (0x0E)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x01,        //   Logical Maximum (1)
-		0x75, 0x01,        //   Report Size (1)
-		0x95, 0x0E,        //   Report Count (14)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
-		0x09, 0x20,        //   Usage (0x20)
-		0x75, 0x06,        //   Report Size (6)
-		0x95, 0x01,        //   Report Count (1)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x25, 0x7F,        //   Logical Maximum (127)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x05, 0x01,        //   Usage Page (Generic Desktop Ctrls)
-		0x09, 0x33,        //   Usage (Rx)
-		0x09, 0x34,        //   Usage (Ry)
-		0x15, 0x00,        //   Logical Minimum (0)
-		0x26, 0xFF, 0x00,  //   Logical Maximum (255)
-		0x75, 0x08,        //   Report Size (8)
-		0x95, 0x02,        //   Report Count (2)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x36,        //   Report Count (54)
-		0x81, 0x02,        //   Input (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
-		0x85, 0x05,        //   Report ID (5)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x1F,        //   Report Count (31)
-		0x91, 0x02,        //   Output (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x04,        //   Report ID (4)
-		0x09, 0x23,        //   Usage (0x23)
-		0x95, 0x24,        //   Report Count (36)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x02,        //   Report ID (2)
-		0x09, 0x24,        //   Usage (0x24)
-		0x95, 0x24,        //   Report Count (36)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x08,        //   Report ID (8)
-		0x09, 0x25,        //   Usage (0x25)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x10,        //   Report ID (16)
-		0x09, 0x26,        //   Usage (0x26)
-		0x95, 0x04,        //   Report Count (4)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x11,        //   Report ID (17)
-		0x09, 0x27,        //   Usage (0x27)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x12,        //   Report ID (18)
-		0x06, 0x02, 0xFF,  //   Usage Page (Vendor Defined 0xFF02)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x0F,        //   Report Count (15)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x13,        //   Report ID (19)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x16,        //   Report Count (22)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x14,        //   Report ID (20)
-		0x06, 0x05, 0xFF,  //   Usage Page (Vendor Defined 0xFF05)
-		0x09, 0x20,        //   Usage (0x20)
-		0x95, 0x10,        //   Report Count (16)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x15,        //   Report ID (21)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x2C,        //   Report Count (44)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x06, 0x80, 0xFF,  //   Usage Page (Vendor Defined 0xFF80)
-		0x85, 0x80,        //   Report ID (128)
-		0x09, 0x20,        //   Usage (0x20)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x81,        //   Report ID (129)
-		0x09, 0x21,        //   Usage (0x21)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x82,        //   Report ID (130)
-		0x09, 0x22,        //   Usage (0x22)
-		0x95, 0x05,        //   Report Count (5)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x83,        //   Report ID (131)
-		0x09, 0x23,        //   Usage (0x23)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x84,        //   Report ID (132)
-		0x09, 0x24,        //   Usage (0x24)
-		0x95, 0x04,        //   Report Count (4)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x85,        //   Report ID (133)
-		0x09, 0x25,        //   Usage (0x25)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x86,        //   Report ID (134)
-		0x09, 0x26,        //   Usage (0x26)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x87,        //   Report ID (135)
-		0x09, 0x27,        //   Usage (0x27)
-		0x95, 0x23,        //   Report Count (35)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x88,        //   Report ID (136)
-		0x09, 0x28,        //   Usage (0x28)
-		0x95, 0x22,        //   Report Count (34)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x89,        //   Report ID (137)
-		0x09, 0x29,        //   Usage (0x29)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x90,        //   Report ID (144)
-		0x09, 0x30,        //   Usage (0x30)
-		0x95, 0x05,        //   Report Count (5)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x91,        //   Report ID (145)
-		0x09, 0x31,        //   Usage (0x31)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x92,        //   Report ID (146)
-		0x09, 0x32,        //   Usage (0x32)
-		0x95, 0x03,        //   Report Count (3)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0x93,        //   Report ID (147)
-		0x09, 0x33,        //   Usage (0x33)
-		0x95, 0x0C,        //   Report Count (12)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA0,        //   Report ID (160)
-		0x09, 0x40,        //   Usage (0x40)
-		0x95, 0x06,        //   Report Count (6)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA1,        //   Report ID (161)
-		0x09, 0x41,        //   Usage (0x41)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA2,        //   Report ID (162)
-		0x09, 0x42,        //   Usage (0x42)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA3,        //   Report ID (163)
-		0x09, 0x43,        //   Usage (0x43)
-		0x95, 0x30,        //   Report Count (48)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA4,        //   Report ID (164)
-		0x09, 0x44,        //   Usage (0x44)
-		0x95, 0x0D,        //   Report Count (13)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA5,        //   Report ID (165)
-		0x09, 0x45,        //   Usage (0x45)
-		0x95, 0x15,        //   Report Count (21)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA6,        //   Report ID (166)
-		0x09, 0x46,        //   Usage (0x46)
-		0x95, 0x15,        //   Report Count (21)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF0,        //   Report ID (240)
-		0x09, 0x47,        //   Usage (0x47)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF1,        //   Report ID (241)
-		0x09, 0x48,        //   Usage (0x48)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xF2,        //   Report ID (242)
-		0x09, 0x49,        //   Usage (0x49)
-		0x95, 0x0F,        //   Report Count (15)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA7,        //   Report ID (167)
-		0x09, 0x4A,        //   Usage (0x4A)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA8,        //   Report ID (168)
-		0x09, 0x4B,        //   Usage (0x4B)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xA9,        //   Report ID (169)
-		0x09, 0x4C,        //   Usage (0x4C)
-		0x95, 0x08,        //   Report Count (8)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAA,        //   Report ID (170)
-		0x09, 0x4E,        //   Usage (0x4E)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAB,        //   Report ID (171)
-		0x09, 0x4F,        //   Usage (0x4F)
-		0x95, 0x39,        //   Report Count (57)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAC,        //   Report ID (172)
-		0x09, 0x50,        //   Usage (0x50)
-		0x95, 0x39,        //   Report Count (57)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAD,        //   Report ID (173)
-		0x09, 0x51,        //   Usage (0x51)
-		0x95, 0x0B,        //   Report Count (11)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAE,        //   Report ID (174)
-		0x09, 0x52,        //   Usage (0x52)
-		0x95, 0x01,        //   Report Count (1)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xAF,        //   Report ID (175)
-		0x09, 0x53,        //   Usage (0x53)
-		0x95, 0x02,        //   Report Count (2)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0x85, 0xB0,        //   Report ID (176)
-		0x09, 0x54,        //   Usage (0x54)
-		0x95, 0x3F,        //   Report Count (63)
-		0xB1, 0x02,        //   Feature (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
-		0xC0,              // End Collection
-	};
-
 	struct _URB_CONTROL_DESCRIPTOR_REQUEST* pRequest = &Urb->UrbControlDescriptorRequest;
 
 	TraceEvents(TRACE_LEVEL_VERBOSE,
@@ -889,15 +1013,15 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetDescriptorFromInterface(
 		">> >> >> _URB_CONTROL_DESCRIPTOR_REQUEST: Buffer Length %d",
 		pRequest->TransferBufferLength);
 
-	if (pRequest->TransferBufferLength >= ARRAYSIZE(Ds4HidReportDescriptor))
+	if (pRequest->TransferBufferLength >= sizeof(_HidReportDescriptor))
 	{
-		RtlCopyMemory(pRequest->TransferBuffer, Ds4HidReportDescriptor, ARRAYSIZE(Ds4HidReportDescriptor));
+		RtlCopyMemory(pRequest->TransferBuffer, _HidReportDescriptor, sizeof(_HidReportDescriptor));
 		status = STATUS_SUCCESS;
 
 		//
 		// Notify client library that PDO is ready
 		// 
-		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
+		this->SignalDeviceReady();
 	}
 
 	return status;
@@ -921,14 +1045,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 	{
 	case 0:
 	{
-		// "American English"
-		UCHAR LangId[] =
-		{
-			0x04, 0x03, 0x09, 0x04
-		};
-
-		Urb->UrbControlDescriptorRequest.TransferBufferLength = ARRAYSIZE(LangId);
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, LangId, ARRAYSIZE(LangId));
+		Urb->UrbControlDescriptorRequest.TransferBufferLength = sizeof(_LanguageIdDescriptor);
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, _LanguageIdDescriptor, sizeof(_LanguageIdDescriptor));
 
 		break;
 	}
@@ -946,20 +1064,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 			break;
 		}
 
-		// "Sony Computer Entertainment"
-		UCHAR ManufacturerString[DS4_MANUFACTURER_NAME_LENGTH] =
-		{
-			0x38, 0x03, 0x53, 0x00, 0x6F, 0x00, 0x6E, 0x00,
-			0x79, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
-			0x6D, 0x00, 0x70, 0x00, 0x75, 0x00, 0x74, 0x00,
-			0x65, 0x00, 0x72, 0x00, 0x20, 0x00, 0x45, 0x00,
-			0x6E, 0x00, 0x74, 0x00, 0x65, 0x00, 0x72, 0x00,
-			0x74, 0x00, 0x61, 0x00, 0x69, 0x00, 0x6E, 0x00,
-			0x6D, 0x00, 0x65, 0x00, 0x6E, 0x00, 0x74, 0x00
-		};
-
 		Urb->UrbControlDescriptorRequest.TransferBufferLength = DS4_MANUFACTURER_NAME_LENGTH;
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, ManufacturerString, DS4_MANUFACTURER_NAME_LENGTH);
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, _ManufacturerStringDescriptor, DS4_MANUFACTURER_NAME_LENGTH);
 
 		break;
 	}
@@ -977,18 +1083,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbGetStringDescriptorType(PUR
 			break;
 		}
 
-		// "Wireless Controller"
-		UCHAR ProductString[DS4_PRODUCT_NAME_LENGTH] =
-		{
-			0x28, 0x03, 0x57, 0x00, 0x69, 0x00, 0x72, 0x00,
-			0x65, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x73, 0x00,
-			0x73, 0x00, 0x20, 0x00, 0x43, 0x00, 0x6F, 0x00,
-			0x6E, 0x00, 0x74, 0x00, 0x72, 0x00, 0x6F, 0x00,
-			0x6C, 0x00, 0x6C, 0x00, 0x65, 0x00, 0x72, 0x00
-		};
-
 		Urb->UrbControlDescriptorRequest.TransferBufferLength = DS4_PRODUCT_NAME_LENGTH;
-		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, ProductString, DS4_PRODUCT_NAME_LENGTH);
+		RtlCopyBytes(Urb->UrbControlDescriptorRequest.TransferBuffer, _ProductStringDescriptor, DS4_PRODUCT_NAME_LENGTH);
 
 		break;
 	}
@@ -1012,25 +1108,59 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 			TRACE_USBPDO,
 			">> >> >> Incoming request, queuing...");
 
-		/* This request is sent periodically and relies on data the "feeder"
-		   has to supply, so we queue this request and return with STATUS_PENDING.
-		   The request gets completed as soon as the "feeder" sent an update. */
-		status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
-
-		return (NT_SUCCESS(status)) ? STATUS_PENDING : status;
+		return this->QueueUsbInRequest(Request);
 	}
 
-	// Store relevant bytes of buffer in PDO context
-	RtlCopyBytes(&this->_OutputReport,
+	OUT_BUFFER_CONTEXT report;
+	DS4_OUTPUT_REPORT outputReport;
+	KIRQL irql;
+
+	RtlCopyBytes(&outputReport,
 		static_cast<PUCHAR>(pTransfer->TransferBuffer) + DS4_OUTPUT_BUFFER_OFFSET,
 		DS4_OUTPUT_BUFFER_LENGTH);
 
+	//
+	// Store relevant bytes of buffer in PDO context, coalescing consumers
+	// read it together with its timestamp under the same lock
+	// 
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+
+	this->_OutputReport = outputReport;
+
+	this->RecordOutputReport(&report, DS4_OUTPUT_BUFFER_LENGTH);
+
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+
+	//
+	// Only the latest output report gets handed out
+	// 
+	if (this->_CoalesceOutputReports)
+	{
+		this->ProcessCoalescedNotification();
+
+		return status;
+	}
+
 	if (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
 		this->_PendingNotificationRequests,
 		&notifyRequest)))
 	{
 		PDS4_REQUEST_NOTIFICATION notify = nullptr;
 
+		//
+		// Batch requests take this report along with anything still queued
+		// 
+		if (IsNotificationBatchRequest(notifyRequest))
+		{
+			this->CompleteNotificationBatch(
+				notifyRequest,
+				&outputReport,
+				&report
+			);
+
+			return status;
+		}
+
 		status = WdfRequestRetrieveOutputBuffer(
 			notifyRequest,
 			sizeof(DS4_REQUEST_NOTIFICATION),
@@ -1043,13 +1173,15 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 			// Assign values to output buffer
 			notify->Size = sizeof(DS4_REQUEST_NOTIFICATION);
 			notify->SerialNo = this->_SerialNo;
-			notify->Report = this->_OutputReport;
+			notify->Report = outputReport;
 
 			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION",
 			          notify,
 			          sizeof(DS4_REQUEST_NOTIFICATION)
 			);
 
+			BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, 1);
+
 			WdfRequestCompleteWithInformation(notifyRequest, status, notify->Size);
 		}
 		else
@@ -1072,11 +1204,11 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::UsbBulkOrInterruptTransfer(_UR
 		{
 			RtlCopyMemory(
 				clientBuffer,
-				&this->_OutputReport,
+				&outputReport,
 				DS4_OUTPUT_BUFFER_LENGTH
 			);
 
-			*static_cast<size_t*>(contextBuffer) = DS4_OUTPUT_BUFFER_LENGTH;
+			*static_cast<POUT_BUFFER_CONTEXT>(contextBuffer) = report;
 
 			TraceDbg(TRACE_USBPDO, "Queued %Iu bytes", DS4_OUTPUT_BUFFER_LENGTH);
 
@@ -1119,67 +1251,122 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 {
 	NTSTATUS				status;
 	WDFREQUEST				usbRequest;
+	KIRQL					irql;
 	
 	/*
 	 * The logic here is unusual to keep backwards compatibility with the 
 	 * original API that didn't allow submitting the full report.
 	 */
 
-	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
-
-	if (!NT_SUCCESS(status))
-		return status;
-
-	// Get pending IRP
-	PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
-
-	// Get USB request block
-	const auto urb = static_cast<PURB>(URB_FROM_IRP(pendingIrp));
-
-	// Get transfer buffer
-	const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
-
-	// Set correct buffer size
-	urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
-
 	// Cast to expected struct
 	const auto pSubmit = static_cast<PDS4_SUBMIT_REPORT>(NewReport);
+	bool changed = true, masked = false;
 
 	/*
 	 * Copy report to cache and transfer buffer
 	 * Skip first byte as it contains the never changing report ID
 	 */
 
+	//
+	// Timed variant is laid out like the extended one with timing appended
+	// 
+	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT_TIMED))
+	{
+		const auto pTimed = static_cast<PDS4_SUBMIT_REPORT_TIMED>(NewReport);
+
+		if (pTimed->Timing.Flags & VIGEM_REPORT_TIMING_FLAG_STAMP_DS4_TIMESTAMP)
+			StampReportTimestamp(&pTimed->Report, pTimed->Timing.Timestamp);
+	}
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
+
 	//
 	// "Old" API which only allows to update partial report
 	// 
 	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT))
 	{
 		TraceDbg(TRACE_DS4, "Received DS4_SUBMIT_REPORT update");
+
+		changed = this->IsReportChanged(
+			reinterpret_cast<const UCHAR*>(&pSubmit->Report),
+			sizeof(pSubmit->Report),
+			&masked
+		);
 		
 		RtlCopyBytes(
-			&this->_Report[1],
+			&this->_Report.BeginWrite()[1],
 			&(static_cast<PDS4_SUBMIT_REPORT>(NewReport))->Report,
 			sizeof((static_cast<PDS4_SUBMIT_REPORT>(NewReport))->Report)
 		);
+		this->_Report.EndWrite();
 	}
 
 	//
 	// "Extended" API allowing complete report update
 	// 
-	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT_EX))
+	if (pSubmit->Size == sizeof(DS4_SUBMIT_REPORT_EX) || pSubmit->Size == sizeof(DS4_SUBMIT_REPORT_TIMED))
 	{
 		TraceDbg(TRACE_DS4, "Received DS4_SUBMIT_REPORT_EX update");
+
+		changed = this->IsReportChanged(
+			(static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report.ReportBuffer,
+			sizeof((static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report),
+			&masked
+		);
 		
 		RtlCopyBytes(
-			&this->_Report[1],
+			&this->_Report.BeginWrite()[1],
 			&(static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report,
 			sizeof((static_cast<PDS4_SUBMIT_REPORT_EX>(NewReport))->Report)
 		);
+		this->_Report.EndWrite();
+	}
+
+	//
+	// Cache holds the latest timestamps and counters now, don't waste a
+	// pending IRP if nothing else changed; the timer keeps reports flowing
+	// 
+	if (!changed)
+	{
+		KeReleaseSpinLock(&this->_ReportLock, irql);
+
+		this->CountUnchangedReport(masked);
+
+		TraceDbg(TRACE_DS4, "Input report hasn't changed since last update");
+		return STATUS_SUCCESS;
 	}
 	
+	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
+
+	if (!NT_SUCCESS(status))
+	{
+		// Report is cached, hand it to the next arriving request
+		InterlockedExchange(&this->_ReportPending, TRUE);
+		KeReleaseSpinLock(&this->_ReportLock, irql);
+
+		this->CountMissingUsbInRequest(true);
+		return status;
+	}
+
+	// Get pending IRP
+	PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
+
+	// Get USB request block
+	const auto urb = static_cast<PURB>(URB_FROM_IRP(pendingIrp));
+
+	// Get transfer buffer
+	const auto buffer = static_cast<PUCHAR>(urb->UrbBulkOrInterruptTransfer.TransferBuffer);
+
+	// Set correct buffer size
+	urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
+
 	if (buffer)
-		RtlCopyBytes(buffer, this->_Report, DS4_REPORT_SIZE);
+		RtlCopyBytes(buffer, this->_Report.Value(), DS4_REPORT_SIZE);
+
+	// Completion may resubmit the URB right away, never complete under the lock
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+
+	this->RecordUsbInCompletion();
 
 	// Complete pending request
 	WdfRequestComplete(usbRequest, status);
@@ -1187,6 +1374,60 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitReportImpl(PVOID NewRepo
 	return status;
 }
 
+void ViGEm::Bus::Targets::EmulationTargetDS4::StampReportTimestamp(PDS4_REPORT_EX Report, LARGE_INTEGER Timestamp)
+{
+	LARGE_INTEGER frequency;
+
+	(void)KeQueryPerformanceCounter(&frequency);
+
+	const auto ticks = static_cast<ULONGLONG>(Timestamp.QuadPart);
+	const auto ticksPerSecond = static_cast<ULONGLONG>(frequency.QuadPart);
+
+	//
+	// The report counts in units of 16/3 microseconds and wraps at 16 bits;
+	// split to not overflow on large counter values
+	// 
+	const auto units = (ticks / ticksPerSecond) * DS4_TIMESTAMP_UNITS_PER_SECOND
+		+ ((ticks % ticksPerSecond) * DS4_TIMESTAMP_UNITS_PER_SECOND) / ticksPerSecond;
+
+	Report->Report.wTimestamp = static_cast<USHORT>(units);
+}
+
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::SubmitNeutralReport()
+{
+	DS4_SUBMIT_REPORT report;
+
+	DS4_SUBMIT_REPORT_INIT(&report, this->_SerialNo);
+
+	return this->SubmitReportImpl(&report);
+}
+
+bool ViGEm::Bus::Targets::EmulationTargetDS4::IsReportChanged(const UCHAR* Report, size_t Length, bool* Masked) const
+{
+	// Submitted reports skip the report ID
+	const auto cached = &this->_Report.Value()[1];
+	const auto mask = &_ReportChangeMask[1];
+
+	*Masked = false;
+
+	//
+	// Common case of identical reports handled by the fast compare,
+	// which also tells us where to continue from otherwise
+	// 
+	for (auto i = RtlCompareMemory(cached, Report, Length); i < Length; i++)
+	{
+		const UCHAR delta = cached[i] ^ Report[i];
+
+		if (delta & mask[i])
+			return true;
+
+		if (delta)
+			*Masked = true;
+	}
+
+	return false;
+}
+
 VOID ViGEm::Bus::Targets::EmulationTargetDS4::ReverseByteArray(PUCHAR Array, INT Length)
 {
 	const auto s = static_cast<PUCHAR>(ExAllocatePoolWithTag(
@@ -1236,6 +1477,21 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 	// 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
+		//
+		// Batch requests take all queued buffers at once
+		// 
+		if (IsNotificationBatchRequest(request))
+		{
+			this->CompleteNotificationBatch(request);
+
+			if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+			{
+				break;
+			}
+
+			continue;
+		}
+
 		status = DMF_BufferQueue_Dequeue(
 			this->_UsbInterruptOutBufferQueue,
 			&clientBuffer,
@@ -1272,6 +1528,8 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 				notify, 
 				sizeof(DS4_REQUEST_NOTIFICATION)
 			);
+
+			BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, 1);
 			
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
@@ -1290,6 +1548,25 @@ void ViGEm::Bus::Targets::EmulationTargetDS4::ProcessPendingNotification(WDFQUEU
 	TraceDbg(TRACE_USBPDO, "%!FUNC! Exit");
 }
 
+void ViGEm::Bus::Targets::EmulationTargetDS4::GetLatestNotificationEntry(PVIGEM_NOTIFICATION_ENTRY Entry)
+{
+	Entry->Report.Ds4 = this->_OutputReport;
+}
+
+bool ViGEm::Bus::Targets::EmulationTargetDS4::DecodeNotificationEntry(
+	PVOID Buffer,
+	size_t Length,
+	PVIGEM_NOTIFICATION_ENTRY Entry
+)
+{
+	if (Length < sizeof(DS4_OUTPUT_REPORT))
+		return false;
+
+	Entry->Report.Ds4 = *static_cast<PDS4_OUTPUT_REPORT>(Buffer);
+
+	return true;
+}
+
 VOID ViGEm::Bus::Targets::EmulationTargetDS4::PendingUsbRequestsTimerFunc(
 	_In_ WDFTIMER Timer
 )
@@ -1297,12 +1574,37 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::PendingUsbRequestsTimerFunc(
 	const auto ctx = reinterpret_cast<EmulationTargetDS4*>(Core::EmulationTargetPdoGetContext(
 		WdfTimerGetParentObject(Timer))->Target);
 
-	WDFREQUEST usbRequest;
-
 	TraceDbg(TRACE_DS4, "%!FUNC! Entry");
 
+	// Pick up report published through the ring since the last period
+	ctx->ProcessReportRing(FALSE);
+
+	const auto status = ctx->CompletePendingUsbInRequest();
+
+	//
+	// Nothing changes on a quiet target, stop re-completing the cached report
+	// until the next submission restarts the timer
+	// 
+	if (ctx->EnterIdle())
+	{
+		(void)WdfTimerStop(Timer, FALSE);
+
+		if (!ctx->ConfirmIdle())
+			ctx->IdleExited();
+	}
+
+	TraceDbg(TRACE_DS4, "%!FUNC! Exit with status %!STATUS!", status);
+}
+
+//
+// Completes one pending interrupt transfer with the cached report
+// 
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetDS4::CompletePendingUsbInRequest()
+{
+	WDFREQUEST usbRequest;
+
 	// Get pending USB request
-	const auto status = WdfIoQueueRetrieveNextRequest(ctx->_PendingUsbInRequests, &usbRequest);
+	const auto status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
 
 	if (NT_SUCCESS(status))
 	{
@@ -1320,13 +1622,75 @@ VOID ViGEm::Bus::Targets::EmulationTargetDS4::PendingUsbRequestsTimerFunc(
 		// Set buffer length to report size
 		urb->UrbBulkOrInterruptTransfer.TransferBufferLength = DS4_REPORT_SIZE;
 
-		// Copy cached report to transfer buffer 
+		// Copy snapshot of cached report to transfer buffer, submitters are never blocked
 		if (buffer)
-			RtlCopyBytes(buffer, ctx->_Report, DS4_REPORT_SIZE);
+			this->_Report.Read(buffer);
+
+		this->RecordUsbInCompletion();
 
 		// Complete pending request
 		WdfRequestComplete(usbRequest, status);
 	}
 
-	TraceDbg(TRACE_DS4, "%!FUNC! Exit with status %!STATUS!", status);
+	return status;
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::IdleExited()
+{
+	if (this->_PendingUsbInRequestsTimerPeriod > 0)
+		WdfTimerStart(this->_PendingUsbInRequestsTimer, WDF_REL_TIMEOUT_IN_MS(this->_PendingUsbInRequestsTimerPeriod));
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::SessionReleased()
+{
+	KIRQL irql;
+
+	// Lightbar and rumble state was meant for the previous session
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+	RtlZeroMemory(&this->_OutputReport, sizeof(DS4_OUTPUT_REPORT));
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::UsbInRequestQueued()
+{
+	// Deliver report which got submitted while no request was pending
+	if (this->_EventDrivenInput && InterlockedExchange(&this->_ReportPending, FALSE))
+		(void)this->CompletePendingUsbInRequest();
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetDS4::ProcessReportRing(BOOLEAN ArmDoorbell)
+{
+	VIGEM_REPORT_RING_SLOT slot;
+
+	if (!this->DequeueRingReport(&slot, ArmDoorbell))
+		return;
+
+	//
+	// Both report flavours are accepted, mirroring IOCTL_DS4_SUBMIT_REPORT
+	// 
+	if (slot.Length == sizeof(DS4_REPORT))
+	{
+		DS4_SUBMIT_REPORT submit;
+
+		DS4_SUBMIT_REPORT_INIT(&submit, this->_SerialNo);
+		RtlCopyMemory(&submit.Report, slot.Buffer, sizeof(DS4_REPORT));
+
+		(void)this->DispatchReport(&submit);
+	}
+	else if (slot.Length == sizeof(DS4_REPORT_EX))
+	{
+		DS4_SUBMIT_REPORT_EX submit;
+
+		DS4_SUBMIT_REPORT_EX_INIT(&submit, this->_SerialNo);
+		RtlCopyMemory(&submit.Report, slot.Buffer, sizeof(DS4_REPORT_EX));
+
+		(void)this->DispatchReport(&submit);
+	}
+	else
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_DS4,
+			"Dropping ring report of invalid length %d",
+			slot.Length);
+	}
 }
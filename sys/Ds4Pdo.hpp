@@ -41,6 +41,8 @@
 
 namespace ViGEm::Bus::Targets
 {
+	constexpr auto DS4_POOL_TAG = '4DiV';
+
 	//
 	// Represents a MAC address.
 	//
@@ -64,7 +66,8 @@ namespace ViGEm::Bus::Targets
 		return (pReq->Value >> 8) & 0xFF;
 	}
 
-	class EmulationTargetDS4 : public Core::EmulationTargetPDO
+	class EmulationTargetDS4 : public Core::EmulationTargetPDO,
+	                           public Core::LookasideAllocated<EmulationTargetDS4, DS4_POOL_TAG>
 	{
 	public:
 		EmulationTargetDS4(ULONG Serial, LONG SessionId, USHORT VendorId = 0x054C, USHORT ProductId = 0x05C4);
@@ -98,6 +101,8 @@ namespace ViGEm::Bus::Targets
 		NTSTATUS UsbControlTransfer(PURB Urb) override;
 		
 		NTSTATUS SubmitReportImpl(PVOID NewReport) override;
+
+		NTSTATUS SubmitNeutralReport() override;
 		
 	private:
 		static EVT_WDF_TIMER PendingUsbRequestsTimerFunc;
@@ -106,8 +111,28 @@ namespace ViGEm::Bus::Targets
 
 		static VOID GenerateRandomMacAddress(PMAC_ADDRESS Address);
 
+		NTSTATUS CompletePendingUsbInRequest();
+
+		bool IsReportChanged(const UCHAR* Report, size_t Length, bool* Masked) const;
+
+		static void StampReportTimestamp(PDS4_REPORT_EX Report, LARGE_INTEGER Timestamp);
+
+		static const ULONGLONG DS4_TIMESTAMP_UNITS_PER_SECOND = 187500;
+
 	protected:
 		void ProcessPendingNotification(WDFQUEUE Queue) override;
+
+		bool DecodeNotificationEntry(PVOID Buffer, size_t Length, PVIGEM_NOTIFICATION_ENTRY Entry) override;
+
+		void GetLatestNotificationEntry(PVIGEM_NOTIFICATION_ENTRY Entry) override;
+
+		VOID ProcessReportRing(BOOLEAN ArmDoorbell) override;
+
+		VOID UsbInRequestQueued() override;
+
+		VOID IdleExited() override;
+
+		VOID SessionReleased() override;
 	private:
 		static PCWSTR _deviceDescription;
 
@@ -128,6 +153,8 @@ namespace ViGEm::Bus::Targets
 		static const int DS4_CONFIGURATION_SIZE = 0x0070;
 #endif
 
+		static const int DS4_HID_REPORT_DESCRIPTOR_SIZE = 0x01D3;
+		static const int DS4_LANGUAGE_ID_LENGTH = 0x04;
 		static const int DS4_MANUFACTURER_NAME_LENGTH = 0x38;
 		static const int DS4_PRODUCT_NAME_LENGTH = 0x28;
 		static const int DS4_OUTPUT_BUFFER_OFFSET = 0x04;
@@ -135,11 +162,28 @@ namespace ViGEm::Bus::Targets
 
 		static const int DS4_REPORT_SIZE = 0x40;
 		static const int DS4_QUEUE_FLUSH_PERIOD = 0x05;
+		static const int DS4_INTERRUPT_IN_INTERVAL_OFFSET = 0x21;
+		static const ULONG DS4_DEFAULT_KEEP_ALIVE_INTERVAL = 100;
 
 		//
-		// HID Input Report buffer
+		// Bits of the input report considered for change detection
+		// 
+		static const UCHAR _ReportChangeMask[DS4_REPORT_SIZE];
+
 		//
-		UCHAR _Report[DS4_REPORT_SIZE];
+		// Descriptors, shared by all instances
+		// 
+		static const USB_DEVICE_DESCRIPTOR _DeviceDescriptor;
+		static const UCHAR _ConfigurationDescriptor[DS4_DESCRIPTOR_SIZE];
+		static const UCHAR _HidReportDescriptor[DS4_HID_REPORT_DESCRIPTOR_SIZE];
+		static const UCHAR _LanguageIdDescriptor[DS4_LANGUAGE_ID_LENGTH];
+		static const UCHAR _ManufacturerStringDescriptor[DS4_MANUFACTURER_NAME_LENGTH];
+		static const UCHAR _ProductStringDescriptor[DS4_PRODUCT_NAME_LENGTH];
+
+		//
+		// HID Input Report buffer, updated under _ReportLock
+		//
+		Core::SeqLocked<UCHAR[DS4_REPORT_SIZE]> _Report;
 
 		//
 		// Output report cache
@@ -151,6 +195,22 @@ namespace ViGEm::Bus::Targets
 		//
 		WDFTIMER _PendingUsbInRequestsTimer;
 
+		//
+		// If set, interrupt transfers are completed on report submission
+		// instead of on every timer period
+		//
+		BOOLEAN _EventDrivenInput{};
+
+		//
+		// Timer period (ms), keep-alive interval in event-driven mode (0 = off)
+		//
+		ULONG _PendingUsbInRequestsTimerPeriod{DS4_QUEUE_FLUSH_PERIOD};
+
+		//
+		// Set if a submitted report found no interrupt transfer to complete
+		//
+		LONG _ReportPending{};
+
 		//
 		// Auto-generated MAC address of the target device
 		//
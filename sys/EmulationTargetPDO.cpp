@@ -33,6 +33,7 @@
 */
 
 
+#include "Driver.h"
 #include "EmulationTargetPDO.hpp"
 #include "CRTCPP.hpp"
 #include "trace.h"
@@ -43,6 +44,7 @@
 #include <usbiodef.h>
 
 #include "Debugging.hpp"
+#include "BusEvents.hpp"
 
 
 PCWSTR ViGEm::Bus::Core::EmulationTargetPDO::_deviceLocation = L"Virtual Gamepad Emulation Bus";
@@ -58,6 +60,7 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_IO_QUEUE_CONFIG usbInQueueConfig;
 	WDF_IO_QUEUE_CONFIG notificationsQueueConfig;
+	WDF_IO_QUEUE_CONFIG reportRingQueueConfig;
 	PEMULATION_TARGET_PDO_CONTEXT pPdoContext;
 
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Entry");
@@ -96,8 +99,13 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			break;
 		}
 
-		// prepare instance id
-		status = RtlUnicodeStringPrintf(&buffer, L"%02d", this->_SerialNo);
+		//
+		// prepare instance id; a stable identity keeps it across replugs so PnP
+		// reuses the existing device node instead of installing a new one
+		// 
+		status = (this->_IdentityKey != 0)
+			? RtlUnicodeStringPrintf(&buffer, L"ID%08X", this->_IdentityKey)
+			: RtlUnicodeStringPrintf(&buffer, L"%02d", this->_SerialNo);
 		if (!NT_SUCCESS(status))
 		{
 			TraceEvents(TRACE_LEVEL_ERROR,
@@ -269,6 +277,30 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 			break;
 		}
 
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, EMULATION_TARGET_PDO_CONTEXT);
+
+		// Create and assign queue for the request keeping the report ring mapped
+		WDF_IO_QUEUE_CONFIG_INIT(&reportRingQueueConfig, WdfIoQueueDispatchManual);
+
+		reportRingQueueConfig.EvtIoCanceledOnQueue = EvtIoReportRingCanceledOnQueue;
+
+		status = WdfIoQueueCreate(
+			ParentDevice,
+			&reportRingQueueConfig,
+			&attributes,
+			&this->_ReportRingRequests
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSPDO,
+				"WdfIoQueueCreate (ReportRingRequests) failed with status %!STATUS!",
+				status);
+			break;
+		}
+
+		EmulationTargetPdoGetContext(this->_ReportRingRequests)->Target = this;
+
 #pragma endregion
 
 #pragma region Default I/O queue setup
@@ -321,6 +353,8 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoCreateDevice(WDFDEVICE ParentD
 #pragma endregion
 	} while (FALSE);
 
+	BusEvent_TargetPhase(this->_SerialNo, this->_TargetType, "DeviceCreated", status);
+
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 
 	return status;
@@ -334,40 +368,51 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 
 	const auto ctx = EmulationTargetPdoGetContext(Device);
 
+	BusEvent_TargetPhase(ctx->Target->_SerialNo, ctx->Target->_TargetType, "Removed", STATUS_SUCCESS);
+
+	//
+	// Revoke fast lookup and wait for I/O dispatch to let go of this object
+	// 
+	ctx->Target->RemoveFromLookupTable(WdfPdoGetParent(static_cast<WDFDEVICE>(Device)));
+	ExWaitForRundownProtectionRelease(&ctx->Target->_RundownProtection);
+
+	//
+	// Serial number may be handed out again
+	// 
+	Bus_ReleaseSerial(WdfPdoGetParent(static_cast<WDFDEVICE>(Device)), ctx->Target->_SerialNo);
+
+	//
+	// Instance ID is gone with the PDO, identity may be reclaimed
+	// 
+	if (ctx->Target->_IdentityKey != 0)
+		Bus_ReleaseIdentityKey(WdfPdoGetParent(static_cast<WDFDEVICE>(Device)), ctx->Target->_IdentityKey);
+
 	//
 	// This queues parent is the FDO so explicitly free memory
 	//
+	if (ctx->Target->_WaitDeviceReadyTimer)
+		WdfTimerStop(ctx->Target->_WaitDeviceReadyTimer, TRUE);
+
 	WdfIoQueuePurgeSynchronously(ctx->Target->_WaitDeviceReadyRequests);
 	WdfObjectDelete(ctx->Target->_WaitDeviceReadyRequests);
 
+	ctx->Target->PdoCleanup();
+
 	//
-	// Wait for thread to finish, if active
+	// Drop the ring mapping before the request backing it gets completed
 	// 
-	if (ctx->Target->_WaitDeviceReadyCompletionWorkerThreadHandle)
+	if (ctx->Target->_ReportRingRequests)
 	{
-		NTSTATUS status = KeWaitForSingleObject(
-			&ctx->Target->_WaitDeviceReadyCompletionWorkerThreadHandle,
-			Executive,
-			KernelMode,
-			FALSE,
-			nullptr
-		);
+		KIRQL irql;
 
-		if (NT_SUCCESS(status))
-		{
-			ZwClose(ctx->Target->_WaitDeviceReadyCompletionWorkerThreadHandle);
-			ctx->Target->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
-		}
-		else
-		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-				TRACE_BUSPDO,
-				"KeWaitForSingleObject failed with status %!STATUS!",
-				status
-			);
-		}
+		KeAcquireSpinLock(&ctx->Target->_ReportRingLock, &irql);
+		ctx->Target->_ReportRing = nullptr;
+		KeReleaseSpinLock(&ctx->Target->_ReportRingLock, irql);
+
+		WdfIoQueuePurgeSynchronously(ctx->Target->_ReportRingRequests);
+		WdfObjectDelete(ctx->Target->_ReportRingRequests);
 	}
-	
+
 	//
 	// PDO device object getting disposed, free context object 
 	// 
@@ -376,13 +421,168 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtDeviceContextCleanup(
 	TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_BUSPDO, "%!FUNC! Exit");
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SubmitReport(PVOID NewReport, const VIGEM_REPORT_TIMING* Timing)
 {
 	return (this->IsOwnerProcess())
-		? this->SubmitReportImpl(NewReport)
+		? this->DispatchReport(NewReport, Timing)
 		: STATUS_ACCESS_DENIED;
 }
 
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::DispatchReport(PVOID NewReport, const VIGEM_REPORT_TIMING* Timing)
+{
+	InterlockedIncrement64(&this->_ReportsSubmitted);
+
+	if (this->_IdleTimeout != 0)
+	{
+		const auto now = static_cast<LONG64>(KeQueryInterruptTime());
+		const auto last = InterlockedExchange64(&this->_LastReportTime, now);
+		const auto paused = ReadNoFence(&this->_Idle) && InterlockedExchange(&this->_Idle, FALSE);
+
+		//
+		// Targets without periodic work never get marked idle, the gap tells instead
+		// 
+		if (paused || (now - last) >= static_cast<LONG64>(this->_IdleTimeout) * 10000)
+		{
+			InterlockedIncrement64(&this->_IdleResumes);
+
+			BusEvent_TargetPhase(this->_SerialNo, this->_TargetType, "IdleExited", STATUS_SUCCESS);
+		}
+
+		// Resume delivery before the report gets processed
+		if (paused)
+			this->IdleExited();
+	}
+
+	//
+	// User-mode QPC is the same clock, so client timestamps yield end-to-end latency
+	// 
+	const auto submitted = (Timing != nullptr && Timing->Timestamp.QuadPart > 0)
+		? Timing->Timestamp.QuadPart
+		: KeQueryPerformanceCounter(nullptr).QuadPart;
+
+	// Latency is measured from the oldest report the host hasn't picked up yet
+	InterlockedCompareExchange64(
+		&this->_ReportSubmitTimestamp,
+		submitted,
+		0
+	);
+
+	if (Timing != nullptr && Timing->Sequence != 0)
+		InterlockedExchange(&this->_SubmittedSequence, static_cast<LONG>(Timing->Sequence));
+
+	BusEvent_ReportSubmitted(
+		this->_SerialNo,
+		this->_TargetType,
+		(Timing != nullptr) ? Timing->Sequence : 0,
+		submitted
+	);
+
+	return this->SubmitReportImpl(NewReport);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::CountUnchangedReport(bool Masked)
+{
+	InterlockedIncrement64(&this->_ReportsUnchanged);
+
+	// Host already has this state, the report doesn't count as skipped
+	InterlockedExchange(&this->_DeliveredSequence, ReadLongAcquire(&this->_SubmittedSequence));
+
+	if (Masked)
+		InterlockedIncrement64(&this->_ReportsUnchangedMasked);
+
+	// Nothing will be delivered for this one
+	InterlockedExchange64(&this->_ReportSubmitTimestamp, 0);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::CountMissingUsbInRequest(bool ReportCached)
+{
+	InterlockedIncrement64(&this->_ReportsWithoutPendingRequest);
+
+	// Cached reports get delivered later, keep measuring
+	if (!ReportCached)
+		InterlockedExchange64(&this->_ReportSubmitTimestamp, 0);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::RecordUsbInCompletion()
+{
+	LARGE_INTEGER frequency;
+
+	//
+	// Sequence numbers passed since the last delivery belong to reports the host never saw
+	// 
+	const auto sequence = static_cast<ULONG>(ReadLongAcquire(&this->_SubmittedSequence));
+	const auto delivered = static_cast<ULONG>(InterlockedExchange(&this->_DeliveredSequence, static_cast<LONG>(sequence)));
+	const auto gap = sequence - delivered;
+
+	if (delivered != 0 && gap > 1 && gap < MAXLONG)
+		InterlockedAdd64(&this->_ReportsSkipped, static_cast<LONG64>(gap - 1));
+
+	const auto submitted = InterlockedExchange64(&this->_ReportSubmitTimestamp, 0);
+
+	// Keep-alive or repeated report
+	if (submitted == 0)
+		return;
+
+	const auto now = KeQueryPerformanceCounter(&frequency);
+	const auto elapsed = static_cast<ULONGLONG>(now.QuadPart - submitted);
+	const auto ticksPerSecond = static_cast<ULONGLONG>(frequency.QuadPart);
+
+	// Split to not overflow on large intervals
+	const auto microseconds = (elapsed / ticksPerSecond) * 1000000
+		+ ((elapsed % ticksPerSecond) * 1000000) / ticksPerSecond;
+
+	ULONG bucket = 0;
+
+	while (bucket < VIGEM_TARGET_LATENCY_BUCKET_COUNT - 1 && (microseconds >> bucket) != 0)
+		bucket++;
+
+	InterlockedAdd64(&this->_LatencyTotalMicroseconds, static_cast<LONG64>(microseconds));
+	InterlockedIncrement64(&this->_LatencyHistogram[bucket]);
+
+	BusEvent_UsbInCompleted(this->_SerialNo, this->_TargetType, sequence, now.QuadPart, microseconds);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::QueryStatistics(PVIGEM_TARGET_STATISTICS Statistics) const
+{
+	ULONG queueRequests = 0;
+
+	if (!Statistics)
+		return STATUS_INVALID_PARAMETER;
+
+	// Other sessions' activity is none of the caller's business
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	//
+	// Exchange reads keep 64-bit values intact on 32-bit builds
+	// 
+	const auto read = [](volatile LONG64 const* Value)
+	{
+		return static_cast<ULONGLONG>(InterlockedCompareExchange64(
+			const_cast<volatile LONG64*>(Value), 0, 0));
+	};
+
+	Statistics->ReportsSubmitted = read(&this->_ReportsSubmitted);
+	Statistics->ReportsUnchanged = read(&this->_ReportsUnchanged);
+	Statistics->ReportsUnchangedMasked = read(&this->_ReportsUnchangedMasked);
+	Statistics->ReportsWithoutPendingRequest = read(&this->_ReportsWithoutPendingRequest);
+	Statistics->ReportsSkipped = read(&this->_ReportsSkipped);
+	Statistics->LatencyTotalMicroseconds = read(&this->_LatencyTotalMicroseconds);
+
+	for (ULONG i = 0; i < VIGEM_TARGET_LATENCY_BUCKET_COUNT; i++)
+		Statistics->LatencyHistogram[i] = read(&this->_LatencyHistogram[i]);
+
+	if (this->_PendingUsbInRequests)
+		(void)WdfIoQueueGetState(this->_PendingUsbInRequests, &queueRequests, nullptr);
+
+	Statistics->PendingUsbInRequests = queueRequests;
+
+	Statistics->Idle = (ReadNoFence(&this->_Idle) || this->IsQuiet()) ? TRUE : FALSE;
+	Statistics->IdleResumes = read(&this->_IdleResumes);
+
+	return STATUS_SUCCESS;
+}
+
 NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueNotification(WDFREQUEST Request) const
 {
 	return (this->IsOwnerProcess())
@@ -400,41 +600,158 @@ VIGEM_TARGET_TYPE ViGEm::Bus::Core::EmulationTargetPDO::GetType() const
 	return this->_TargetType;
 }
 
-NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::MapReportRing(WDFREQUEST Request)
 {
 	NTSTATUS status;
+	PVIGEM_REPORT_RING pRing = nullptr;
+	size_t length = 0;
+	KIRQL irql;
 
 	if (!this->IsOwnerProcess())
 		return STATUS_ACCESS_DENIED;
 
-	if (!this->_WaitDeviceReadyRequests)
-		return STATUS_INVALID_DEVICE_STATE;
+	//
+	// METHOD_OUT_DIRECT: the I/O manager keeps the buffer locked for as
+	// long as the request is alive and we get a system address for it
+	// 
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(VIGEM_REPORT_RING),
+		reinterpret_cast<PVOID*>(&pRing),
+		&length
+	);
 
-	if (this->_WaitDeviceReadyCompletionWorkerThreadHandle)
+	if (!NT_SUCCESS(status))
 	{
-		status = KeWaitForSingleObject(
-			&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-			Executive,
-			KernelMode,
-			FALSE,
-			nullptr
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+		            status
+		);
+
+		return status;
+	}
+
+	if (length != sizeof(VIGEM_REPORT_RING)
+		|| pRing->Size != sizeof(VIGEM_REPORT_RING)
+		|| pRing->SlotCount != VIGEM_REPORT_RING_SLOT_COUNT)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "Report ring size mismatch: %d (expected %d)",
+		            static_cast<ULONG>(length), static_cast<ULONG>(sizeof(VIGEM_REPORT_RING))
+		);
+
+		return STATUS_INVALID_BUFFER_SIZE;
+	}
+
+	KeAcquireSpinLock(&this->_ReportRingLock, &irql);
+
+	if (this->_ReportRing != nullptr)
+	{
+		KeReleaseSpinLock(&this->_ReportRingLock, irql);
+		return STATUS_DEVICE_BUSY;
+	}
+
+	//
+	// Ignore whatever got published before mapping
+	// 
+	this->_ReportRingSequence = static_cast<ULONG>(ReadAcquire(&pRing->WriteSequence));
+	this->_ReportRing = pRing;
+
+	KeReleaseSpinLock(&this->_ReportRingLock, irql);
+
+	//
+	// Forwarded outside of the lock, cancellation may run synchronously
+	// 
+	status = WdfRequestForwardToIoQueue(Request, this->_ReportRingRequests);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "WdfRequestForwardToIoQueue failed with status %!STATUS!",
+		            status
 		);
 
-		if (NT_SUCCESS(status))
+		KeAcquireSpinLock(&this->_ReportRingLock, &irql);
+		this->_ReportRing = nullptr;
+		KeReleaseSpinLock(&this->_ReportRingLock, irql);
+	}
+
+	return status;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::SignalReportRing()
+{
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	this->ProcessReportRing(TRUE);
+
+	return STATUS_SUCCESS;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::DequeueRingReport(PVIGEM_REPORT_RING_SLOT Slot, BOOLEAN ArmDoorbell)
+{
+	bool dequeued = false;
+	KIRQL irql;
+
+	KeAcquireSpinLock(&this->_ReportRingLock, &irql);
+
+	const auto pRing = this->_ReportRing;
+
+	//
+	// Second pass runs after announcing the waiting consumer so a report
+	// published in between isn't missed by both sides
+	// 
+	for (int pass = 0; pRing != nullptr && pass < 2 && !dequeued; pass++)
+	{
+		const auto sequence = static_cast<ULONG>(ReadAcquire(&pRing->WriteSequence));
+
+		if (sequence != this->_ReportRingSequence)
 		{
-			ZwClose(this->_WaitDeviceReadyCompletionWorkerThreadHandle);
-			this->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
+			RtlCopyMemory(
+				Slot,
+				&pRing->Slots[sequence % VIGEM_REPORT_RING_SLOT_COUNT],
+				sizeof(VIGEM_REPORT_RING_SLOT)
+			);
+
+			//
+			// Producer may have lapped us and be rewriting this very slot; drop the
+			// copy in this case, a newer report is available anyway
+			// 
+			if (static_cast<ULONG>(ReadAcquire(&pRing->WriteSequence)) - sequence < VIGEM_REPORT_RING_SLOT_COUNT - 1)
+			{
+				this->_ReportRingSequence = sequence;
+				dequeued = true;
+			}
 		}
-		else
+
+		if (!dequeued && pass == 0)
 		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-			            TRACE_BUSPDO,
-			            "KeWaitForSingleObject failed with status %!STATUS!",
-			            status
-			);
+			if (!ArmDoorbell)
+				break;
+
+			InterlockedExchange(&pRing->ConsumerWaiting, TRUE);
 		}
 	}
-	
+
+	KeReleaseSpinLock(&this->_ReportRingLock, irql);
+
+	return dequeued;
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST Request)
+{
+	NTSTATUS status;
+
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!this->_WaitDeviceReadyRequests || !this->_WaitDeviceReadyTimer)
+		return STATUS_INVALID_DEVICE_STATE;
+
 	status = WdfRequestForwardToIoQueue(Request, this->_WaitDeviceReadyRequests);
 
 	if (!NT_SUCCESS(status))
@@ -448,30 +765,60 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EnqueueWaitDeviceReady(WDFREQUEST
 		return status;
 	}
 
-	OBJECT_ATTRIBUTES threadOb;
-
-	InitializeObjectAttributes(&threadOb, NULL,
-	                           OBJ_KERNEL_HANDLE, NULL, NULL);
+	//
+	// Checked after queuing so a concurrent signal can't get missed
+	// 
+	if (InterlockedCompareExchange(&this->_PdoBootNotified, FALSE, FALSE))
+	{
+		this->CompleteWaitDeviceReadyRequests(STATUS_SUCCESS);
+		return STATUS_SUCCESS;
+	}
 
-	status = PsCreateSystemThread(&this->_WaitDeviceReadyCompletionWorkerThreadHandle,
-	                              static_cast<ACCESS_MASK>(0L),
-	                              &threadOb,
-	                              nullptr,
-	                              nullptr,
-	                              WaitDeviceReadyCompletionWorkerRoutine,
-	                              this
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+	            TRACE_BUSPDO,
+	            "Waiting for 1 second to complete PDO boot..."
 	);
 
-	if (!NT_SUCCESS(status))
+	//
+	// Restarting a pending timer would postpone the timeout of everyone queued,
+	// so only the first waiter arms it
+	// 
+	if (!InterlockedCompareExchange(&this->_WaitDeviceReadyTimerArmed, TRUE, FALSE))
+		(void)WdfTimerStart(this->_WaitDeviceReadyTimer, WDF_REL_TIMEOUT_IN_SEC(1));
+
+	return STATUS_SUCCESS;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::SignalDeviceReady()
+{
+	if (InterlockedExchange(&this->_PdoBootNotified, TRUE))
+		return;
+
+	if (this->_WaitDeviceReadyTimer)
+		(void)WdfTimerStop(this->_WaitDeviceReadyTimer, FALSE);
+
+	BusEvent_TargetPhase(this->_SerialNo, this->_TargetType, "DeviceReady", STATUS_SUCCESS);
+
+	this->CompleteWaitDeviceReadyRequests(STATUS_SUCCESS);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::CompleteWaitDeviceReadyRequests(NTSTATUS Status)
+{
+	WDFREQUEST waitRequest;
+
+	if (!this->_WaitDeviceReadyRequests)
+		return;
+
+	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(this->_WaitDeviceReadyRequests, &waitRequest)))
 	{
-		TraceEvents(TRACE_LEVEL_ERROR,
+		TraceEvents(TRACE_LEVEL_INFORMATION,
 		            TRACE_BUSPDO,
-		            "PsCreateSystemThread failed with status %!STATUS!",
-		            status
+		            "Completing device wait request with status %!STATUS!",
+		            Status
 		);
-	}
 
-	return status;
+		WdfRequestComplete(waitRequest, Status);
+	}
 }
 
 NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice)
@@ -485,6 +832,10 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice
 	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 	attributes.ParentObject = ParentDevice;
 
+	// Bus-wide setting, the quiet period starts with the plug-in
+	this->_IdleTimeout = FdoGetData(ParentDevice)->IdleTimeout;
+	InterlockedExchange64(&this->_LastReportTime, static_cast<LONG64>(KeQueryInterruptTime()));
+
 	// Create and assign queue for incoming interrupt transfer
 	WDF_IO_QUEUE_CONFIG_INIT(&plugInQueueConfig, WdfIoQueueDispatchManual);
 
@@ -501,6 +852,44 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice
 			"WdfIoQueueCreate (PendingPlugInRequests) failed with status %!STATUS!",
 			status);
 	}
+	else
+	{
+		WDF_TIMER_CONFIG timerConfig;
+		WDF_OBJECT_ATTRIBUTES timerAttributes;
+
+		// One-shot timeout of pending device wait requests
+		WDF_TIMER_CONFIG_INIT(&timerConfig, WaitDeviceReadyTimerFunc);
+		timerConfig.AutomaticSerialization = FALSE;
+
+		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&timerAttributes, EMULATION_TARGET_PDO_CONTEXT);
+		timerAttributes.ParentObject = this->_WaitDeviceReadyRequests;
+
+		// Deleted together with the queue
+		status = WdfTimerCreate(
+			&timerConfig,
+			&timerAttributes,
+			&this->_WaitDeviceReadyTimer
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSPDO,
+				"WdfTimerCreate failed with status %!STATUS!",
+				status);
+		}
+		else
+		{
+			EmulationTargetPdoGetContext(this->_WaitDeviceReadyTimer)->Target = this;
+		}
+	}
+
+	//
+	// Latest state lives in the derived objects, nothing to queue
+	// 
+	if (this->_CoalesceOutputReports)
+	{
+		return status;
+	}
 
 	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 	attributes.ParentObject = ParentDevice;
@@ -517,7 +906,7 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice
 	// Maximum byte count per buffer
 	dmfBufferCfg.SourceSettings.BufferSize = MAX_OUT_BUFFER_QUEUE_SIZE;
 	// Field to store real buffer content length
-	dmfBufferCfg.SourceSettings.BufferContextSize = sizeof(size_t);
+	dmfBufferCfg.SourceSettings.BufferContextSize = sizeof(OUT_BUFFER_CONTEXT);
 	// "Expensive" memory ;)
 	dmfBufferCfg.SourceSettings.PoolType = NonPagedPoolNx;
 
@@ -540,13 +929,32 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::PdoPrepare(WDFDEVICE ParentDevice
 	return status;
 }
 
-unsigned long ViGEm::Bus::Core::EmulationTargetPDO::current_process_id()
+void ViGEm::Bus::Core::EmulationTargetPDO::PdoUnprepare()
 {
-	return static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(PsGetCurrentProcessId()) & 0xFFFFFFFF);
-}
-
-#pragma region USB Interface Functions
-
+	//
+	// The timer is parented to the queue and goes with it
+	// 
+	if (this->_WaitDeviceReadyRequests)
+	{
+		WdfObjectDelete(this->_WaitDeviceReadyRequests);
+		this->_WaitDeviceReadyRequests = nullptr;
+		this->_WaitDeviceReadyTimer = nullptr;
+	}
+
+	if (this->_UsbInterruptOutBufferQueue)
+	{
+		WdfObjectDelete(this->_UsbInterruptOutBufferQueue);
+		this->_UsbInterruptOutBufferQueue = nullptr;
+	}
+}
+
+unsigned long ViGEm::Bus::Core::EmulationTargetPDO::current_process_id()
+{
+	return static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(PsGetCurrentProcessId()) & 0xFFFFFFFF);
+}
+
+#pragma region USB Interface Functions
+
 BOOLEAN USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceIsDeviceHighSpeed(IN PVOID BusContext)
 {
 	UNREFERENCED_PARAMETER(BusContext);
@@ -608,80 +1016,38 @@ VOID USB_BUSIFFN ViGEm::Bus::Core::EmulationTargetPDO::UsbInterfaceGetUSBDIVersi
 
 #pragma endregion
 
-VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext)
+VOID ViGEm::Bus::Core::EmulationTargetPDO::WaitDeviceReadyTimerFunc(
+	_In_ WDFTIMER Timer
+)
 {
-	const auto ctx = static_cast<EmulationTargetPDO*>(StartContext);
-
-	WDFREQUEST waitRequest;
-	LARGE_INTEGER timeout;
-	timeout.QuadPart = WDF_REL_TIMEOUT_IN_SEC(1);
-
-	TraceEvents(TRACE_LEVEL_INFORMATION,
-	            TRACE_BUSPDO,
-	            "Waiting for 1 second to complete PDO boot..."
-	);
+	const auto ctx = EmulationTargetPdoGetContext(Timer)->Target;
 
-	NTSTATUS status = KeWaitForSingleObject(
-		&ctx->_PdoBootNotificationEvent,
-		Executive,
-		KernelMode,
-		FALSE,
-		&timeout
-	);
+	//
+	// Cleared before draining, a waiter queued meanwhile arms the next timeout
+	// 
+	InterlockedExchange(&ctx->_WaitDeviceReadyTimerArmed, FALSE);
 
-	do
+	//
+	// Signal might have raced the timer, otherwise we haven't hit a path where
+	// the device was deemed operational and report an error
+	// 
+	if (InterlockedCompareExchange(&ctx->_PdoBootNotified, FALSE, FALSE))
 	{
-		//
-		// Fetch pending request (there has to be one at this point)
-		// 
-		if (!NT_SUCCESS(WdfIoQueueRetrieveNextRequest(ctx->_WaitDeviceReadyRequests, &waitRequest)))
-		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-			            TRACE_BUSPDO,
-			            "No pending device wait request available"
-			);
-			break;
-		}
-
-		if (status == STATUS_TIMEOUT)
-		{
-			TraceEvents(TRACE_LEVEL_WARNING,
-			            TRACE_BUSPDO,
-			            "Device wait request timed out, completing with error"
-			);
-
-			//
-			// We haven't hit a path where the event gets signaled, report error
-			// 
-			WdfRequestComplete(waitRequest, STATUS_DEVICE_HARDWARE_ERROR);
-			break;
-		}
-
-		if (NT_SUCCESS(status))
-		{
-			TraceEvents(TRACE_LEVEL_INFORMATION,
-			            TRACE_BUSPDO,
-			            "Device wait request completed successfully"
-			);
-
-			//
-			// Event triggered in time, complete with success
-			// 
-			WdfRequestComplete(waitRequest, STATUS_SUCCESS);
-			break;
-		}
+		ctx->CompleteWaitDeviceReadyRequests(STATUS_SUCCESS);
+		return;
 	}
-	while (FALSE);
 
-	ZwClose(ctx->_WaitDeviceReadyCompletionWorkerThreadHandle);
-	ctx->_WaitDeviceReadyCompletionWorkerThreadHandle = nullptr;
-	KeClearEvent(&ctx->_PdoBootNotificationEvent);
-	(void)PsTerminateSystemThread(0);
+	TraceEvents(TRACE_LEVEL_WARNING,
+	            TRACE_BUSPDO,
+	            "Device wait request timed out, completing with error"
+	);
+
+	ctx->CompleteWaitDeviceReadyRequests(STATUS_DEVICE_HARDWARE_ERROR);
 }
 
 VOID ViGEm::Bus::Core::EmulationTargetPDO::DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength)
 {
-#ifdef DBG
+#if DBG
 
 	size_t dumpBufferLength = ((BufferLength * sizeof(CHAR)) * 2) + 1;
 	PSTR dumpBuffer = static_cast<PSTR>(ExAllocatePoolWithTag(
@@ -774,7 +1140,10 @@ _VendorId(VendorId),
 _ProductId(ProductId)
 {
 	this->_OwnerProcessId = current_process_id();
-	KeInitializeEvent(&this->_PdoBootNotificationEvent, NotificationEvent, FALSE);
+	KeInitializeSpinLock(&this->_ReportRingLock);
+	KeInitializeSpinLock(&this->_OutputReportLock);
+	KeInitializeSpinLock(&this->_ReportLock);
+	ExInitializeRundownProtection(&this->_RundownProtection);
 
 	WDF_DEVICE_PNP_CAPABILITIES_INIT(&this->_PnpCapabilities);
 	WDF_DEVICE_POWER_CAPABILITIES_INIT(&this->_PowerCapabilities);
@@ -811,7 +1180,136 @@ bool ViGEm::Bus::Core::EmulationTargetPDO::GetPdoBySerial(
 bool ViGEm::Bus::Core::EmulationTargetPDO::GetPdoByTypeAndSerial(IN WDFDEVICE ParentDevice, IN VIGEM_TARGET_TYPE Type,
 	IN ULONG SerialNo, OUT EmulationTargetPDO** Object)
 {
-	return (GetPdoBySerial(ParentDevice, SerialNo, Object) && (*Object)->GetType() == Type);
+	EmulationTargetPDO* pdo = nullptr;
+
+	if (SerialNo < FDO_TARGET_TABLE_CAPACITY)
+	{
+		const auto pFdoData = FdoGetData(ParentDevice);
+
+		const auto irql = ExAcquireSpinLockShared(&pFdoData->TargetTableLock);
+
+		const auto page = pFdoData->TargetTable[SerialNo / FDO_TARGET_TABLE_PAGE_SIZE];
+
+		if (page != nullptr)
+			pdo = static_cast<EmulationTargetPDO*>(page[SerialNo % FDO_TARGET_TABLE_PAGE_SIZE]);
+
+		//
+		// Removal takes the lock exclusively, so the object can't vanish before
+		// we hold our reference on it
+		// 
+		if (pdo != nullptr && (pdo->GetType() != Type || !ExAcquireRundownProtection(&pdo->_RundownProtection)))
+			pdo = nullptr;
+
+		ExReleaseSpinLockShared(&pFdoData->TargetTableLock, irql);
+	}
+	else
+	{
+		//
+		// Serial out of table range, fall back to walking the child list
+		// 
+		if (!GetPdoBySerial(ParentDevice, SerialNo, &pdo)
+			|| pdo->GetType() != Type
+			|| !ExAcquireRundownProtection(&pdo->_RundownProtection))
+			pdo = nullptr;
+	}
+
+	if (pdo == nullptr)
+		return false;
+
+	*Object = pdo;
+
+	return true;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::ReleaseReference()
+{
+	ExReleaseRundownProtection(&this->_RundownProtection);
+}
+
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::InsertIntoLookupTable(WDFDEVICE ParentDevice)
+{
+	NTSTATUS status;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDFMEMORY pageMemory = nullptr;
+	PVOID* page = nullptr;
+	const auto pFdoData = FdoGetData(ParentDevice);
+	const auto directoryIndex = this->_SerialNo / FDO_TARGET_TABLE_PAGE_SIZE;
+
+	PAGED_CODE();
+
+	//
+	// Out of table range, lookup will use the child list
+	// 
+	if (this->_SerialNo >= FDO_TARGET_TABLE_CAPACITY)
+		return STATUS_SUCCESS;
+
+	//
+	// Allocate page outside of the lock, it lives as long as the FDO
+	// 
+	if (ReadPointerAcquire(reinterpret_cast<PVOID*>(&pFdoData->TargetTable[directoryIndex])) == nullptr)
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = ParentDevice;
+
+		status = WdfMemoryCreate(
+			&attributes,
+			NonPagedPoolNx,
+			TARGET_TABLE_POOL_TAG,
+			FDO_TARGET_TABLE_PAGE_SIZE * sizeof(PVOID),
+			&pageMemory,
+			reinterpret_cast<PVOID*>(&page)
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_BUSPDO,
+			            "WdfMemoryCreate failed with status %!STATUS!",
+			            status
+			);
+
+			return status;
+		}
+
+		RtlZeroMemory(page, FDO_TARGET_TABLE_PAGE_SIZE * sizeof(PVOID));
+	}
+
+	const auto irql = ExAcquireSpinLockExclusive(&pFdoData->TargetTableLock);
+
+	if (pFdoData->TargetTable[directoryIndex] == nullptr)
+	{
+		pFdoData->TargetTable[directoryIndex] = page;
+		pageMemory = nullptr;
+	}
+
+	pFdoData->TargetTable[directoryIndex][this->_SerialNo % FDO_TARGET_TABLE_PAGE_SIZE] = this;
+
+	ExReleaseSpinLockExclusive(&pFdoData->TargetTableLock, irql);
+
+	//
+	// Lost the race against a concurrent insert
+	// 
+	if (pageMemory != nullptr)
+		WdfObjectDelete(pageMemory);
+
+	return STATUS_SUCCESS;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::RemoveFromLookupTable(WDFDEVICE ParentDevice)
+{
+	if (this->_SerialNo >= FDO_TARGET_TABLE_CAPACITY)
+		return;
+
+	const auto pFdoData = FdoGetData(ParentDevice);
+
+	const auto irql = ExAcquireSpinLockExclusive(&pFdoData->TargetTableLock);
+
+	const auto page = pFdoData->TargetTable[this->_SerialNo / FDO_TARGET_TABLE_PAGE_SIZE];
+
+	if (page != nullptr && page[this->_SerialNo % FDO_TARGET_TABLE_PAGE_SIZE] == this)
+		page[this->_SerialNo % FDO_TARGET_TABLE_PAGE_SIZE] = nullptr;
+
+	ExReleaseSpinLockExclusive(&pFdoData->TargetTableLock, irql);
 }
 
 BOOLEAN ViGEm::Bus::Core::EmulationTargetPDO::EvtChildListIdentificationDescriptionCompare(
@@ -913,6 +1411,8 @@ NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::EvtDevicePrepareHardware(
 
 	NTSTATUS status = ctx->Target->PdoPrepareHardware();
 
+	BusEvent_TargetPhase(ctx->Target->_SerialNo, ctx->Target->_TargetType, "HardwarePrepared", status);
+
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 
 	return status;
@@ -936,10 +1436,31 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
 	PURB urb;
 	PIO_STACK_LOCATION irpStack;
 
-	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
-
 	// No help from the framework available from here on
 	irp = WdfRequestWdmGetIrp(Request);
+
+	//
+	// Fast path for the interrupt IN transfer polled on the data pipe
+	// 
+	if (IoControlCode == IOCTL_INTERNAL_USB_SUBMIT_URB)
+	{
+		urb = static_cast<PURB>(URB_FROM_IRP(irp));
+
+		if (ctx->Target->IsUsbInFastPathTransfer(urb))
+		{
+			status = ctx->Target->QueueUsbInRequest(Request);
+
+			if (status != STATUS_PENDING)
+			{
+				WdfRequestComplete(Request, status);
+			}
+
+			return;
+		}
+	}
+
+	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
+
 	irpStack = IoGetCurrentIrpStackLocation(irp);
 
 	switch (IoControlCode)
@@ -1169,6 +1690,24 @@ VOID ViGEm::Bus::Core::EmulationTargetPDO::EvtIoInternalDeviceControl(
 	TraceDbg(TRACE_BUSPDO, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
+NTSTATUS ViGEm::Bus::Core::EmulationTargetPDO::QueueUsbInRequest(WDFREQUEST Request)
+{
+	/* This request is sent periodically and relies on data the "feeder"
+	   has to supply, so we queue this request and return with STATUS_PENDING.
+	   The request gets completed as soon as the "feeder" sent an update. */
+	const NTSTATUS status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
+
+	if (!NT_SUCCESS(status))
+		return status;
+
+	// Answer right away if the report ring holds a newer report
+	this->ProcessReportRing(TRUE);
+
+	this->UsbInRequestQueued();
+
+	return STATUS_PENDING;
+}
+
 void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState(
   WDFQUEUE Queue,
   WDFCONTEXT Context
@@ -1176,6 +1715,12 @@ void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState
 {
 	const auto pThis = static_cast<EmulationTargetPDO*>(Context);
 
+	if (pThis->_CoalesceOutputReports)
+	{
+		pThis->ProcessCoalescedNotification();
+		return;
+	}
+
 	//
 	// No buffer available to answer the request with, leave queued
 	// 
@@ -1186,3 +1731,455 @@ void ViGEm::Bus::Core::EmulationTargetPDO::EvtWdfIoPendingNotificationQueueState
 	
 	pThis->ProcessPendingNotification(Queue);
 }
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsNotificationBatchRequest(WDFREQUEST Request)
+{
+	WDF_REQUEST_PARAMETERS params;
+
+	WDF_REQUEST_PARAMETERS_INIT(&params);
+	WdfRequestGetParameters(Request, &params);
+
+	return params.Parameters.DeviceIoControl.IoControlCode == IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::CompleteNotificationBatch(
+	WDFREQUEST Request,
+	PVOID Buffer,
+	const OUT_BUFFER_CONTEXT* Report
+)
+{
+	NTSTATUS status;
+	PVIGEM_REQUEST_NOTIFICATION_BATCH batch = nullptr;
+	PVOID clientBuffer, contextBuffer;
+	size_t length = 0;
+	ULONG count = 0;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(1),
+		reinterpret_cast<PVOID*>(&batch),
+		&length
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+		            status
+		);
+
+		WdfRequestComplete(Request, status);
+		return;
+	}
+
+	//
+	// Validated on arrival, clamp to what the buffer can actually hold anyway
+	// 
+	const auto capacity = min(
+		batch->MaxCount,
+		static_cast<ULONG>((length - FIELD_OFFSET(VIGEM_REQUEST_NOTIFICATION_BATCH, Entries))
+			/ sizeof(VIGEM_NOTIFICATION_ENTRY))
+	);
+
+	//
+	// The report that just arrived must never be the one left out. With a full
+	// backlog it queues up behind it, in order, for the next request to take
+	// along; failing a free buffer for it the oldest queued report gives way.
+	// 
+	if (Buffer
+		&& Report->Length <= MAX_OUT_BUFFER_QUEUE_SIZE
+		&& DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) >= capacity)
+	{
+		while (!NT_SUCCESS(DMF_BufferQueue_Fetch(
+			this->_UsbInterruptOutBufferQueue,
+			&clientBuffer,
+			&contextBuffer
+		)))
+		{
+			if (!NT_SUCCESS(DMF_BufferQueue_Dequeue(
+				this->_UsbInterruptOutBufferQueue,
+				&clientBuffer,
+				&contextBuffer
+			)))
+			{
+				break;
+			}
+
+			TraceEvents(TRACE_LEVEL_WARNING,
+			            TRACE_BUSPDO,
+			            "Notification backlog full, dropping oldest report %d",
+			            static_cast<POUT_BUFFER_CONTEXT>(contextBuffer)->Sequence);
+
+			DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
+			clientBuffer = nullptr;
+		}
+
+		if (clientBuffer)
+		{
+			RtlCopyMemory(clientBuffer, Buffer, Report->Length);
+			*static_cast<POUT_BUFFER_CONTEXT>(contextBuffer) = *Report;
+
+			DMF_BufferQueue_Enqueue(this->_UsbInterruptOutBufferQueue, clientBuffer);
+
+			Buffer = nullptr;
+		}
+	}
+
+	//
+	// Drain everything queued since the last request in one go
+	// 
+	while (count < capacity && NT_SUCCESS(DMF_BufferQueue_Dequeue(
+		this->_UsbInterruptOutBufferQueue,
+		&clientBuffer,
+		&contextBuffer
+	)))
+	{
+		const auto context = static_cast<POUT_BUFFER_CONTEXT>(contextBuffer);
+		const auto entry = &batch->Entries[count];
+
+		if (this->DecodeNotificationEntry(clientBuffer, context->Length, entry))
+		{
+			entry->Timestamp = context->Timestamp;
+			entry->Sequence = static_cast<ULONG>(context->Sequence);
+			count++;
+		}
+
+		DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
+	}
+
+	//
+	// Report that just arrived goes last
+	// 
+	if (Buffer && count < capacity
+		&& this->DecodeNotificationEntry(Buffer, Report->Length, &batch->Entries[count]))
+	{
+		batch->Entries[count].Timestamp = Report->Timestamp;
+		batch->Entries[count].Sequence = static_cast<ULONG>(Report->Sequence);
+		count++;
+	}
+
+	batch->Count = count;
+
+	TraceDbg(TRACE_BUSPDO, "Completing notification batch with %d entries", count);
+
+	BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, count);
+
+	WdfRequestCompleteWithInformation(
+		Request,
+		STATUS_SUCCESS,
+		VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(count)
+	);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::RecordOutputReport(POUT_BUFFER_CONTEXT Report, size_t Length)
+{
+	Report->Length = Length;
+	Report->Timestamp = KeQueryPerformanceCounter(nullptr);
+
+	this->_OutputReportTimestamp = Report->Timestamp;
+
+	// Published last, consumers compare against it
+	Report->Sequence = InterlockedIncrement(&this->_OutputReportSequence);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::CompleteNotification(
+	WDFREQUEST Request,
+	const VIGEM_NOTIFICATION_ENTRY* Entry
+) const
+{
+	NTSTATUS status;
+	PVOID buffer = nullptr;
+	size_t length;
+
+	if (IsNotificationBatchRequest(Request))
+		length = VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(1);
+	else if (this->_TargetType == DualShock4Wired)
+		length = sizeof(DS4_REQUEST_NOTIFICATION);
+	else
+		length = sizeof(XUSB_REQUEST_NOTIFICATION);
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		length,
+		&buffer,
+		nullptr
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_BUSPDO,
+		            "WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+		            status
+		);
+
+		WdfRequestComplete(Request, status);
+		return;
+	}
+
+	if (IsNotificationBatchRequest(Request))
+	{
+		const auto batch = static_cast<PVIGEM_REQUEST_NOTIFICATION_BATCH>(buffer);
+
+		batch->Count = 1;
+		batch->Entries[0] = *Entry;
+	}
+	else if (this->_TargetType == DualShock4Wired)
+	{
+		const auto notify = static_cast<PDS4_REQUEST_NOTIFICATION>(buffer);
+
+		notify->Size = sizeof(DS4_REQUEST_NOTIFICATION);
+		notify->SerialNo = this->_SerialNo;
+		notify->Report = Entry->Report.Ds4;
+	}
+	else
+	{
+		const auto notify = static_cast<PXUSB_REQUEST_NOTIFICATION>(buffer);
+
+		notify->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
+		notify->SerialNo = this->_SerialNo;
+		notify->LedNumber = Entry->Report.Xusb.LedNumber;
+		notify->LargeMotor = Entry->Report.Xusb.LargeMotor;
+		notify->SmallMotor = Entry->Report.Xusb.SmallMotor;
+	}
+
+	BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, 1);
+
+	WdfRequestCompleteWithInformation(Request, STATUS_SUCCESS, length);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::ProcessCoalescedNotification()
+{
+	KIRQL irql;
+	WDFREQUEST request = nullptr;
+	VIGEM_NOTIFICATION_ENTRY entry;
+
+	RtlZeroMemory(&entry, sizeof(VIGEM_NOTIFICATION_ENTRY));
+
+	//
+	// Claim the latest state together with a request, so concurrent producers
+	// and newly arriving requests can't hand out the same state twice
+	// 
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+
+	const auto sequence = InterlockedCompareExchange(&this->_OutputReportSequence, 0, 0);
+
+	if (sequence != this->_OutputReportDeliveredSequence
+		&& NT_SUCCESS(WdfIoQueueRetrieveNextRequest(this->_PendingNotificationRequests, &request)))
+	{
+		this->_OutputReportDeliveredSequence = sequence;
+
+		this->GetLatestNotificationEntry(&entry);
+		entry.Timestamp = this->_OutputReportTimestamp;
+		entry.Sequence = static_cast<ULONG>(sequence);
+	}
+
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+
+	//
+	// Nothing new or nobody waiting, next report or request picks it up
+	// 
+	if (!request)
+		return;
+
+	TraceDbg(TRACE_BUSPDO, "Completing coalesced notification %d", sequence);
+
+	this->CompleteNotification(request, &entry);
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::SetOutputReportCoalescing(BOOLEAN Enable)
+{
+	this->_CoalesceOutputReports = Enable;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::SetReportInterval(UCHAR Milliseconds)
+{
+	this->_ReportInterval = Milliseconds;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::SetIdentityKey(ULONG Key)
+{
+	this->_IdentityKey = Key;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsQuiet() const
+{
+	if (this->_IdleTimeout == 0)
+		return false;
+
+	const auto last = InterlockedCompareExchange64(
+		const_cast<volatile LONG64*>(&this->_LastReportTime), 0, 0);
+
+	return (static_cast<LONG64>(KeQueryInterruptTime()) - last) >= static_cast<LONG64>(this->_IdleTimeout) * 10000;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::EnterIdle()
+{
+	if (!this->IsQuiet() || InterlockedCompareExchange(&this->_Idle, TRUE, FALSE) != FALSE)
+		return false;
+
+	TraceDbg(TRACE_BUSPDO, "Target %d idle, pausing periodic work", this->_SerialNo);
+
+	BusEvent_TargetPhase(this->_SerialNo, this->_TargetType, "IdleEntered", STATUS_SUCCESS);
+
+	return true;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::ConfirmIdle()
+{
+	if (this->IsQuiet())
+		return true;
+
+	//
+	// The racing submission may have found the flag cleared already and
+	// resumed before the work got paused, so always resume here
+	// 
+	InterlockedExchange(&this->_Idle, FALSE);
+
+	return false;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::SetStandby()
+{
+	this->_IsStandby = TRUE;
+	this->_SessionId = FDO_STANDBY_SESSION_ID;
+	// Nobody may submit to a parked target
+	this->_OwnerProcessId = 0;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::IsStandby() const
+{
+	return this->_IsStandby == TRUE;
+}
+
+LONG ViGEm::Bus::Core::EmulationTargetPDO::GetSessionId() const
+{
+	return ReadLongAcquire(&this->_SessionId);
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::BindSession(LONG SessionId)
+{
+	if (!this->_IsStandby)
+		return false;
+
+	if (InterlockedCompareExchange(&this->_SessionId, SessionId, FDO_STANDBY_SESSION_ID) != FDO_STANDBY_SESSION_ID)
+		return false;
+
+	//
+	// Serial isn't known to the caller yet, so nothing can race this
+	// 
+	this->_OwnerProcessId = current_process_id();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+	            TRACE_BUSPDO,
+	            "Standby target with serial %d bound to session %d",
+	            this->_SerialNo,
+	            SessionId);
+
+	return true;
+}
+
+bool ViGEm::Bus::Core::EmulationTargetPDO::ReleaseSession(LONG SessionId)
+{
+	KIRQL irql;
+
+	PAGED_CODE();
+
+	if (!this->_IsStandby || SessionId == FDO_STANDBY_SESSION_ID)
+		return false;
+
+	//
+	// Unplug and handle close may race, only one of them parks the target
+	// 
+	if (InterlockedCompareExchange(&this->_SessionId, STANDBY_SESSION_RESETTING, SessionId) != SessionId)
+		return false;
+
+	this->_OwnerProcessId = 0;
+
+	//
+	// Requests of the previous owner must not receive anything meant for the next one
+	// 
+	WdfIoQueuePurgeSynchronously(this->_PendingNotificationRequests);
+	WdfIoQueueStart(this->_PendingNotificationRequests);
+
+	if (this->_UsbInterruptOutBufferQueue)
+		DMF_BufferQueue_Flush(this->_UsbInterruptOutBufferQueue);
+
+	if (this->_ReportRingRequests)
+	{
+		KeAcquireSpinLock(&this->_ReportRingLock, &irql);
+		this->_ReportRing = nullptr;
+		this->_ReportRingSequence = 0;
+		KeReleaseSpinLock(&this->_ReportRingLock, irql);
+
+		WdfIoQueuePurgeSynchronously(this->_ReportRingRequests);
+		WdfIoQueueStart(this->_ReportRingRequests);
+	}
+
+	if (this->_WaitDeviceReadyRequests)
+	{
+		WdfIoQueuePurgeSynchronously(this->_WaitDeviceReadyRequests);
+		WdfIoQueueStart(this->_WaitDeviceReadyRequests);
+	}
+
+	//
+	// Output reports received while bound are not handed out to the next owner
+	// 
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+	InterlockedExchange(&this->_OutputReportSequence, 0);
+	this->_OutputReportDeliveredSequence = 0;
+	this->_OutputReportTimestamp.QuadPart = 0;
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+
+	this->SessionReleased();
+
+	//
+	// Host sees the pad idle while parked
+	// 
+	(void)this->SubmitNeutralReport();
+
+	//
+	// Statistics start over with every session, the neutral report included
+	// 
+	InterlockedExchange64(&this->_ReportsSubmitted, 0);
+	InterlockedExchange64(&this->_ReportsUnchanged, 0);
+	InterlockedExchange64(&this->_ReportsUnchangedMasked, 0);
+	InterlockedExchange64(&this->_ReportsWithoutPendingRequest, 0);
+	InterlockedExchange64(&this->_ReportsSkipped, 0);
+	InterlockedExchange(&this->_SubmittedSequence, 0);
+	InterlockedExchange(&this->_DeliveredSequence, 0);
+	InterlockedExchange64(&this->_LatencyTotalMicroseconds, 0);
+	InterlockedExchange64(&this->_ReportSubmitTimestamp, 0);
+	InterlockedExchange64(&this->_IdleResumes, 0);
+
+	for (auto& bucket : this->_LatencyHistogram)
+		InterlockedExchange64(&bucket, 0);
+
+	InterlockedExchange(&this->_SessionId, FDO_STANDBY_SESSION_ID);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+	            TRACE_BUSPDO,
+	            "Standby target with serial %d released by session %d",
+	            this->_SerialNo,
+	            SessionId);
+
+	return true;
+}
+
+void ViGEm::Bus::Core::EmulationTargetPDO::EvtIoReportRingCanceledOnQueue(
+	WDFQUEUE Queue,
+	WDFREQUEST Request
+)
+{
+	const auto pThis = EmulationTargetPdoGetContext(Queue)->Target;
+	KIRQL irql;
+
+	TraceDbg(TRACE_BUSPDO, "%!FUNC! Entry");
+
+	KeAcquireSpinLock(&pThis->_ReportRingLock, &irql);
+	pThis->_ReportRing = nullptr;
+	KeReleaseSpinLock(&pThis->_ReportRingLock, irql);
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+}
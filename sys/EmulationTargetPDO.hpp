@@ -46,16 +46,135 @@
 #include <usbbusif.h>
 
 #include <ViGEm/Common.h>
-
-//
-// Some insane macro-magic =3
-// 
-#define P99_PROTECT(...) __VA_ARGS__
-#define COPY_BYTE_ARRAY(_dst_, _bytes_)   do {BYTE b[] = _bytes_; \
-                                            RtlCopyMemory(_dst_, b, RTL_NUMBER_OF_V1(b)); } while (0)
+#include <ViGEm/km/BusShared.h>
 
 namespace ViGEm::Bus::Core
 {
+	constexpr auto TARGET_TABLE_POOL_TAG = 'TLiV';
+
+	//
+	// Serves allocations of a target object type from a lookaside list, so
+	// constant plug-in and unplug doesn't fragment non-paged pool
+	// 
+	template <typename T, ULONG Tag>
+	class LookasideAllocated
+	{
+	public:
+		static NTSTATUS InitializeLookasideList()
+		{
+			const auto status = ExInitializeLookasideListEx(
+				&_LookasideList,
+				nullptr,
+				nullptr,
+				NonPagedPoolNx,
+				0,
+				sizeof(T),
+				Tag,
+				0
+			);
+
+			_LookasideListInitialized = NT_SUCCESS(status);
+
+			return status;
+		}
+
+		static void DeleteLookasideList()
+		{
+			if (!_LookasideListInitialized)
+				return;
+
+			_LookasideListInitialized = FALSE;
+			ExDeleteLookasideListEx(&_LookasideList);
+		}
+
+		static void* operator new(size_t Size) noexcept
+		{
+			// List only serves the exact object size
+			if (!_LookasideListInitialized || Size != sizeof(T))
+				return ExAllocatePoolWithTag(NonPagedPoolNx, Size, Tag);
+
+			return ExAllocateFromLookasideListEx(&_LookasideList);
+		}
+
+		static void operator delete(void* Ptr, size_t Size)
+		{
+			if (Ptr == nullptr)
+				return;
+
+			if (!_LookasideListInitialized || Size != sizeof(T))
+				ExFreePoolWithTag(Ptr, Tag);
+			else
+				ExFreeToLookasideListEx(&_LookasideList, Ptr);
+		}
+
+	private:
+		static LOOKASIDE_LIST_EX _LookasideList;
+
+		static BOOLEAN _LookasideListInitialized;
+	};
+
+	template <typename T, ULONG Tag>
+	LOOKASIDE_LIST_EX LookasideAllocated<T, Tag>::_LookasideList;
+
+	template <typename T, ULONG Tag>
+	BOOLEAN LookasideAllocated<T, Tag>::_LookasideListInitialized = FALSE;
+
+	//
+	// Value published by a single writer at a time, readers copy a
+	// consistent snapshot without blocking or being blocked by it
+	// 
+	template <typename T>
+	class SeqLocked
+	{
+	public:
+		//
+		// Writers have to be serialized by the caller
+		// 
+		T& BeginWrite()
+		{
+			// Odd sequence marks an update in progress
+			InterlockedIncrement(&this->_Sequence);
+
+			return this->_Value;
+		}
+
+		void EndWrite()
+		{
+			InterlockedIncrement(&this->_Sequence);
+		}
+
+		//
+		// Direct access, only valid for the current writer
+		// 
+		const T& Value() const
+		{
+			return this->_Value;
+		}
+
+		//
+		// Copies a snapshot, retrying if an update raced the copy
+		// 
+		void Read(PVOID Destination) const
+		{
+			LONG sequence;
+
+			do
+			{
+				while ((sequence = ReadLongAcquire(&this->_Sequence)) & 1)
+					YieldProcessor();
+
+				RtlCopyMemory(Destination, &this->_Value, sizeof(T));
+
+				KeMemoryBarrier();
+			} while (ReadLongNoFence(&this->_Sequence) != sequence);
+		}
+
+	private:
+		volatile LONG _Sequence{};
+
+		T _Value{};
+	};
+
 	typedef struct _PDO_IDENTIFICATION_DESCRIPTION* PPDO_IDENTIFICATION_DESCRIPTION;
 
 	class EmulationTargetPDO
@@ -65,6 +184,9 @@ namespace ViGEm::Bus::Core
 
 		virtual ~EmulationTargetPDO() = default;
 
+		//
+		// On success, the caller has to call ReleaseReference() on the returned object
+		// 
 		static bool GetPdoByTypeAndSerial(
 			IN WDFDEVICE ParentDevice,
 			IN VIGEM_TARGET_TYPE Type,
@@ -87,6 +209,11 @@ namespace ViGEm::Bus::Core
 
 		virtual NTSTATUS PdoInitContext() = 0;
 
+		//
+		// Called on removal once no more I/O references this object
+		// 
+		virtual VOID PdoCleanup() {}
+
 		NTSTATUS PdoCreateDevice(_In_ WDFDEVICE ParentDevice,
 			_In_ PWDFDEVICE_INIT DeviceInit);
 
@@ -114,9 +241,21 @@ namespace ViGEm::Bus::Core
 		virtual NTSTATUS UsbBulkOrInterruptTransfer(struct _URB_BULK_OR_INTERRUPT_TRANSFER* pTransfer,
 			WDFREQUEST Request) = 0;
 
+		//
+		// True for a steady-state interrupt IN transfer on the data pipe
+		// 
+		FORCEINLINE bool IsUsbInFastPathTransfer(PURB Urb) const
+		{
+			return Urb->UrbHeader.Function == URB_FUNCTION_BULK_OR_INTERRUPT_TRANSFER
+				&& (Urb->UrbBulkOrInterruptTransfer.TransferFlags & USBD_TRANSFER_DIRECTION_IN)
+				&& Urb->UrbBulkOrInterruptTransfer.PipeHandle == this->_UsbInDataPipe;
+		}
+
+		NTSTATUS QueueUsbInRequest(WDFREQUEST Request);
+
 		virtual NTSTATUS UsbControlTransfer(PURB Urb) = 0;
 
-		NTSTATUS SubmitReport(PVOID NewReport);
+		NTSTATUS SubmitReport(PVOID NewReport, const VIGEM_REPORT_TIMING* Timing = nullptr);
 
 		NTSTATUS EnqueueNotification(WDFREQUEST Request) const;
 
@@ -126,6 +265,58 @@ namespace ViGEm::Bus::Core
 
 		NTSTATUS PdoPrepare(WDFDEVICE ParentDevice);
 
+		//
+		// Frees the FDO-parented objects PdoPrepare created, for targets
+		// which never got a PDO to clean up after them
+		// 
+		void PdoUnprepare();
+
+		NTSTATUS MapReportRing(WDFREQUEST Request);
+
+		NTSTATUS SignalReportRing();
+
+		NTSTATUS InsertIntoLookupTable(WDFDEVICE ParentDevice);
+
+		void ReleaseReference();
+
+		NTSTATUS QueryStatistics(PVIGEM_TARGET_STATISTICS Statistics) const;
+
+		//
+		// Has to be called before PdoPrepare to take effect
+		// 
+		void SetOutputReportCoalescing(BOOLEAN Enable);
+
+		//
+		// Has to be called before PdoPrepare; zero keeps the target default
+		// 
+		void SetReportInterval(UCHAR Milliseconds);
+
+		//
+		// Has to be called before PdoPrepare; derives the instance ID from the
+		// (already claimed) key instead of the serial number, zero disables
+		// 
+		void SetIdentityKey(ULONG Key);
+
+		//
+		// Has to be called before PdoPrepare; marks the target as bus-owned
+		// standby pool member waiting to be bound to a session
+		// 
+		void SetStandby();
+
+		bool IsStandby() const;
+
+		LONG GetSessionId() const;
+
+		//
+		// Hands a parked standby target over to the given session
+		// 
+		bool BindSession(LONG SessionId);
+
+		//
+		// Detaches the given session and parks the target again
+		// 
+		bool ReleaseSession(LONG SessionId);
+
 	private:
 		static unsigned long current_process_id();
 
@@ -138,8 +329,25 @@ namespace ViGEm::Bus::Core
 		);
 
 		NTSTATUS EnqueueWaitDeviceReady(WDFREQUEST Request);
+
+		void RemoveFromLookupTable(WDFDEVICE ParentDevice);
+
+		void CompleteWaitDeviceReadyRequests(NTSTATUS Status);
+
+		//
+		// Session ID of a standby target while it is being parked again
+		// 
+		static const LONG STANDBY_SESSION_RESETTING = -1;
 		
-		HANDLE _WaitDeviceReadyCompletionWorkerThreadHandle{};
+		//
+		// Times out pending device wait requests
+		// 
+		WDFTIMER _WaitDeviceReadyTimer{};
+
+		//
+		// Set while the timer is pending, so later waiters don't push it back
+		// 
+		volatile LONG _WaitDeviceReadyTimerArmed{};
 
 	protected:
 		static const ULONG _maxHardwareIdLength = 0xFF;
@@ -150,6 +358,19 @@ namespace ViGEm::Bus::Core
 		
 		static const size_t MAX_OUT_BUFFER_QUEUE_SIZE = 128;
 
+		//
+		// Context stored alongside every buffer in the interrupt OUT queue
+		// 
+		typedef struct _OUT_BUFFER_CONTEXT
+		{
+			size_t Length;
+
+			LARGE_INTEGER Timestamp;
+
+			LONG Sequence;
+
+		} OUT_BUFFER_CONTEXT, *POUT_BUFFER_CONTEXT;
+
 		static PCWSTR _deviceLocation;
 
 		static BOOLEAN USB_BUSIFFN UsbInterfaceIsDeviceHighSpeed(IN PVOID BusContext);
@@ -178,7 +399,9 @@ namespace ViGEm::Bus::Core
 
 		static EVT_WDF_IO_QUEUE_STATE EvtWdfIoPendingNotificationQueueState;
 
-		static VOID WaitDeviceReadyCompletionWorkerRoutine(IN PVOID StartContext);
+		static EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE EvtIoReportRingCanceledOnQueue;
+
+		static EVT_WDF_TIMER WaitDeviceReadyTimerFunc;
 
 		static VOID DumpAsHex(PCSTR Prefix, PVOID Buffer, ULONG BufferLength);
 		
@@ -190,8 +413,105 @@ namespace ViGEm::Bus::Core
 
 		virtual NTSTATUS SubmitReportImpl(PVOID NewReport) = 0;
 
+		virtual NTSTATUS SubmitNeutralReport() = 0;
+
 		virtual VOID ProcessPendingNotification(WDFQUEUE Queue) = 0;
 
+		virtual bool DecodeNotificationEntry(PVOID Buffer, size_t Length, PVIGEM_NOTIFICATION_ENTRY Entry) = 0;
+
+		virtual void GetLatestNotificationEntry(PVIGEM_NOTIFICATION_ENTRY Entry) = 0;
+
+		static bool IsNotificationBatchRequest(WDFREQUEST Request);
+
+		void CompleteNotificationBatch(WDFREQUEST Request, PVOID Buffer = nullptr, const OUT_BUFFER_CONTEXT* Report = nullptr);
+
+		void RecordOutputReport(POUT_BUFFER_CONTEXT Report, size_t Length);
+
+		void CompleteNotification(WDFREQUEST Request, const VIGEM_NOTIFICATION_ENTRY* Entry) const;
+
+		void ProcessCoalescedNotification();
+
+		virtual VOID ProcessReportRing(BOOLEAN ArmDoorbell) = 0;
+
+		//
+		// Called after an interrupt IN request got queued
+		// 
+		virtual VOID UsbInRequestQueued() {}
+
+		//
+		// Interrupt IN polling interval in milliseconds requested at plug-in, or Default
+		// 
+		FORCEINLINE UCHAR GetReportInterval(UCHAR Default) const
+		{
+			return (this->_ReportInterval != 0) ? this->_ReportInterval : Default;
+		}
+
+		//
+		// Interrupt IN bInterval for the requested report interval, or Default.
+		// The PDO reports high speed where bInterval n means 2^(n-1) microframes,
+		// so the period gets rounded down to a power of two milliseconds.
+		// 
+		FORCEINLINE UCHAR GetInterruptInInterval(UCHAR Default) const
+		{
+			UCHAR exponent = 0;
+
+			if (this->_ReportInterval == 0)
+				return Default;
+
+			while ((this->_ReportInterval >> (exponent + 1)) != 0)
+				exponent++;
+
+			// 1 ms equals 8 microframes, bInterval 4
+			return static_cast<UCHAR>(min(4 + exponent, 16));
+		}
+
+		//
+		// Stable identity key requested at plug-in, zero if none
+		// 
+		FORCEINLINE ULONG GetIdentityKey() const
+		{
+			return this->_IdentityKey;
+		}
+
+		//
+		// True if idle detection is enabled and no report got submitted within the timeout
+		// 
+		bool IsQuiet() const;
+
+		//
+		// Marks a quiet target idle; true if the caller has to pause its periodic work
+		// 
+		bool EnterIdle();
+
+		//
+		// Re-checks after the periodic work got paused; false if a submission raced
+		// the transition and the work has to be resumed by the caller
+		// 
+		bool ConfirmIdle();
+
+		//
+		// Called when a submission ends an idle period entered through EnterIdle
+		// 
+		virtual VOID IdleExited() {}
+
+		//
+		// Called at PASSIVE_LEVEL when a standby target got parked again, so the
+		// derived class can forget state belonging to the previous session
+		// 
+		virtual VOID SessionReleased() {}
+
+		bool DequeueRingReport(PVIGEM_REPORT_RING_SLOT Slot, BOOLEAN ArmDoorbell);
+
+		void SignalDeviceReady();
+
+		NTSTATUS DispatchReport(PVOID NewReport, const VIGEM_REPORT_TIMING* Timing = nullptr);
+
+		void CountUnchangedReport(bool Masked = false);
+
+		void CountMissingUsbInRequest(bool ReportCached);
+
+		void RecordUsbInCompletion();
+
 		//
 		// PNP Capabilities may differ from device to device
 		// 
@@ -215,7 +535,12 @@ namespace ViGEm::Bus::Core
 		//
 		// File object session ID
 		// 
-		LONG _SessionId{};
+		volatile LONG _SessionId{};
+
+		//
+		// Bus-owned target which gets re-parked instead of unplugged
+		// 
+		BOOLEAN _IsStandby{};
 
 		//
 		// Device type this PDO is emulating
@@ -242,6 +567,12 @@ namespace ViGEm::Bus::Core
 		//
 		WDFQUEUE _PendingUsbInRequests{};
 
+		//
+		// Data pipe served by the interrupt IN fast path, set by the derived
+		// class once the pipe only carries input reports
+		// 
+		USBD_PIPE_HANDLE _UsbInDataPipe{};
+
 		//
 		// Queue for inverted calls
 		//
@@ -258,14 +589,150 @@ namespace ViGEm::Bus::Core
 		ULONG _UsbConfigurationDescriptionSize{};
 
 		//
-		// Signals the bus that PDO is ready to receive data
+		// Set once the PDO is ready to receive data
 		// 
-		KEVENT _PdoBootNotificationEvent;
+		volatile LONG _PdoBootNotified{};
 
 		//
 		// Queue for interrupt out requests delivered to user-land
 		// 
 		DMFMODULE _UsbInterruptOutBufferQueue{};
+
+		//
+		// Keep only the latest output report state instead of queuing
+		// 
+		BOOLEAN _CoalesceOutputReports{};
+
+		//
+		// Requested interrupt IN polling interval in milliseconds, zero for default
+		// 
+		UCHAR _ReportInterval{};
+
+		//
+		// Stable identity key the instance ID is derived from, zero to use the serial number
+		// 
+		ULONG _IdentityKey{};
+
+		//
+		// Incremented for every output report received from the host
+		// 
+		volatile LONG _OutputReportSequence{};
+
+		//
+		// Time the latest output report was received
+		// 
+		LARGE_INTEGER _OutputReportTimestamp{};
+
+		//
+		// Sequence number of the last coalesced output report handed out
+		// 
+		LONG _OutputReportDeliveredSequence{};
+
+		//
+		// Protects handing out coalesced output reports
+		// 
+		KSPIN_LOCK _OutputReportLock;
+
+		//
+		// Serializes writers of the cached input report of the derived class,
+		// submitters of different targets never contend on it
+		// 
+		KSPIN_LOCK _ReportLock;
+
+		//
+		// Queue holding the request which keeps the report ring mapped
+		// 
+		WDFQUEUE _ReportRingRequests{};
+
+		//
+		// Report ring shared with the owner process, if mapped
+		// 
+		PVIGEM_REPORT_RING _ReportRing{};
+
+		//
+		// Sequence number of the last report consumed from the ring
+		// 
+		ULONG _ReportRingSequence{};
+
+		//
+		// Protects the report ring mapping
+		// 
+		KSPIN_LOCK _ReportRingLock;
+
+		//
+		// Held by I/O dispatch while referencing this object after a lookup
+		// 
+		EX_RUNDOWN_REF _RundownProtection;
+
+		//
+		// Reports accepted from the owner process
+		// 
+		volatile LONG64 _ReportsSubmitted{};
+
+		//
+		// Reports dropped for not differing from the cached one
+		// 
+		volatile LONG64 _ReportsUnchanged{};
+
+		//
+		// Unchanged reports which differed in masked out bytes only
+		// 
+		volatile LONG64 _ReportsUnchangedMasked{};
+
+		//
+		// Reports which found no pending interrupt IN request
+		// 
+		volatile LONG64 _ReportsWithoutPendingRequest{};
+
+		//
+		// Intermediate reports overwritten or dropped before delivery
+		// 
+		volatile LONG64 _ReportsSkipped{};
+
+		//
+		// Sequence number of the latest timed report submitted
+		// 
+		volatile LONG _SubmittedSequence{};
+
+		//
+		// Sequence number of the latest report state delivered to the host
+		// 
+		volatile LONG _DeliveredSequence{};
+
+		//
+		// Sum of submit-to-completion latency samples (microseconds)
+		// 
+		volatile LONG64 _LatencyTotalMicroseconds{};
+
+		//
+		// Submit-to-completion latency histogram (log2 microseconds)
+		// 
+		volatile LONG64 _LatencyHistogram[VIGEM_TARGET_LATENCY_BUCKET_COUNT]{};
+
+		//
+		// QPC value of the oldest report not yet delivered to the host, zero if none
+		// 
+		volatile LONG64 _ReportSubmitTimestamp{};
+
+		//
+		// Quiet period (ms) after which periodic work gets paused, zero if disabled
+		// 
+		ULONG _IdleTimeout{};
+
+		//
+		// Interrupt time of the latest report submission
+		// 
+		volatile LONG64 _LastReportTime{};
+
+		//
+		// Set while the periodic work of the target is paused
+		// 
+		volatile LONG _Idle{};
+
+		//
+		// Idle periods ended by a report submission
+		// 
+		volatile LONG64 _IdleResumes{};
 	};
 
 	typedef struct _PDO_IDENTIFICATION_DESCRIPTION
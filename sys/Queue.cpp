@@ -72,6 +72,11 @@ VOID Bus_EvtIoDeviceControl(
 	PVIGEM_CHECK_VERSION pCheckVersion = nullptr;
 	PVIGEM_WAIT_DEVICE_READY pWaitDeviceReady = nullptr;
 	PXUSB_GET_USER_INDEX pXusbGetUserIndex = nullptr;
+	PVIGEM_MAP_REPORT_RING pMapReportRing = nullptr;
+	PVIGEM_SIGNAL_REPORT_RING pSignalReportRing = nullptr;
+	PVIGEM_SUBMIT_REPORT_BATCH pBatch = nullptr;
+	PVIGEM_QUERY_TARGET_STATS pQueryStats = nullptr;
+	PVIGEM_REQUEST_NOTIFICATION_BATCH pNotifyBatch = nullptr;
 	EmulationTargetPDO* pdo;
 
 	Device = WdfIoQueueGetDevice(Queue);
@@ -152,25 +157,22 @@ VOID Bus_EvtIoDeviceControl(
 
 #pragma endregion
 
-#pragma region IOCTL_VIGEM_PLUGIN_TARGET
+#pragma region Plug-in and unplug requests
 
 	case IOCTL_VIGEM_PLUGIN_TARGET:
-
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_PLUGIN_TARGET");
-
-		status = Bus_PlugInDevice(Device, Request, FALSE, &length);
-
-		break;
-
-#pragma endregion
-
-#pragma region IOCTL_VIGEM_UNPLUG_TARGET
-
 	case IOCTL_VIGEM_UNPLUG_TARGET:
+	case IOCTL_VIGEM_APPLY_TARGET_CHANGES:
 
-		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_UNPLUG_TARGET");
+		TraceDbg(TRACE_QUEUE, "Forwarding I/O control code 0x%X to PnP queue", IoControlCode);
 
-		status = Bus_UnPlugDevice(Device, Request, FALSE, &length);
+		//
+		// Handled one at a time on their own queue so PnP transitions
+		// never hold up report submission of other targets
+		// 
+		status = WdfRequestForwardToIoQueue(Request, FdoGetData(Device)->PnpQueue);
+
+		if (NT_SUCCESS(status))
+			status = STATUS_PENDING;
 
 		break;
 
@@ -198,7 +200,8 @@ VOID Bus_EvtIoDeviceControl(
 			break;
 		}
 
-		if ((sizeof(XUSB_SUBMIT_REPORT) == xusbSubmit->Size) && (length == InputBufferLength))
+		if ((sizeof(XUSB_SUBMIT_REPORT) == xusbSubmit->Size || sizeof(XUSB_SUBMIT_REPORT_TIMED) == xusbSubmit->Size)
+			&& (length == InputBufferLength) && (length == xusbSubmit->Size))
 		{
 			// This request only supports a single PDO at a time
 			if (xusbSubmit->SerialNo == 0)
@@ -214,7 +217,18 @@ VOID Bus_EvtIoDeviceControl(
 			if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, Xbox360Wired, xusbSubmit->SerialNo, &pdo))
 				status = STATUS_DEVICE_DOES_NOT_EXIST;
 			else
-				status = pdo->SubmitReport(xusbSubmit);
+			{
+				//
+				// Timed variant shares the leading layout, timing is appended
+				// 
+				status = (sizeof(XUSB_SUBMIT_REPORT_TIMED) == xusbSubmit->Size)
+					         ? pdo->SubmitReport(
+						         xusbSubmit,
+						         &reinterpret_cast<PXUSB_SUBMIT_REPORT_TIMED>(xusbSubmit)->Timing
+					         )
+					         : pdo->SubmitReport(xusbSubmit);
+				pdo->ReleaseReference();
+			}
 		}
 
 		break;
@@ -271,6 +285,7 @@ VOID Bus_EvtIoDeviceControl(
 			else
 			{
 				status = pdo->EnqueueNotification(Request);
+				pdo->ReleaseReference();
 
 				status = (NT_SUCCESS(status)) ? STATUS_PENDING : status;
 			}
@@ -305,7 +320,7 @@ VOID Bus_EvtIoDeviceControl(
 		//
 		// Check if buffer is within expected bounds
 		// 
-		if (length < sizeof(DS4_SUBMIT_REPORT) || length > sizeof(DS4_SUBMIT_REPORT_EX))
+		if (length < sizeof(DS4_SUBMIT_REPORT) || length > sizeof(DS4_SUBMIT_REPORT_TIMED))
 		{
 			TraceDbg(
 				TRACE_QUEUE,
@@ -348,7 +363,15 @@ VOID Bus_EvtIoDeviceControl(
 		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, DualShock4Wired, ds4Submit->SerialNo, &pdo))
 			status = STATUS_DEVICE_DOES_NOT_EXIST;
 		else
-			status = pdo->SubmitReport(ds4Submit);
+		{
+			status = (sizeof(DS4_SUBMIT_REPORT_TIMED) == ds4Submit->Size)
+				         ? pdo->SubmitReport(
+					         ds4Submit,
+					         &reinterpret_cast<PDS4_SUBMIT_REPORT_TIMED>(ds4Submit)->Timing
+				         )
+				         : pdo->SubmitReport(ds4Submit);
+			pdo->ReleaseReference();
+		}
 
 		break;
 
@@ -404,6 +427,7 @@ VOID Bus_EvtIoDeviceControl(
 			else
 			{
 				status = pdo->EnqueueNotification(Request);
+				pdo->ReleaseReference();
 
 				status = (NT_SUCCESS(status)) ? STATUS_PENDING : status;
 			}
@@ -454,10 +478,350 @@ VOID Bus_EvtIoDeviceControl(
 			}
 
 			status = static_cast<EmulationTargetXUSB*>(pdo)->GetUserIndex(&pXusbGetUserIndex->UserIndex);
+			pdo->ReleaseReference();
 		}
 
 		break;
 
+#pragma endregion
+
+#pragma region IOCTL_XUSB_WAIT_USER_INDEX
+
+	case IOCTL_XUSB_WAIT_USER_INDEX:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_XUSB_WAIT_USER_INDEX");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(XUSB_GET_USER_INDEX),
+			reinterpret_cast<PVOID*>(&pXusbGetUserIndex),
+			&length);
+
+		if (!NT_SUCCESS(status) || length != sizeof(XUSB_GET_USER_INDEX)
+			|| pXusbGetUserIndex->Size != sizeof(XUSB_GET_USER_INDEX))
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pXusbGetUserIndex->SerialNo == 0)
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, Xbox360Wired, pXusbGetUserIndex->SerialNo, &pdo))
+		{
+			length = 0;
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		//
+		// Completes right away if the index is known, once the LED set arrives otherwise
+		// 
+		status = static_cast<EmulationTargetXUSB*>(pdo)->EnqueueWaitUserIndex(Request);
+		pdo->ReleaseReference();
+
+		length = 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_XUSB_GET_SESSION_USER_INDICES
+
+	case IOCTL_XUSB_GET_SESSION_USER_INDICES:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_XUSB_GET_SESSION_USER_INDICES");
+
+		status = Bus_GetSessionUserIndices(Device, Request, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_MAP_REPORT_RING
+
+	case IOCTL_VIGEM_MAP_REPORT_RING:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_MAP_REPORT_RING");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_MAP_REPORT_RING),
+			reinterpret_cast<PVOID*>(&pMapReportRing),
+			&length
+		);
+
+		// Nothing gets returned in the (directly mapped) output buffer
+		length = 0;
+
+		if (!NT_SUCCESS(status) || pMapReportRing->Size != sizeof(VIGEM_MAP_REPORT_RING))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pMapReportRing->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pMapReportRing->TargetType, pMapReportRing->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->MapReportRing(Request);
+		pdo->ReleaseReference();
+
+		status = NT_SUCCESS(status) ? STATUS_PENDING : status;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SIGNAL_REPORT_RING
+
+	case IOCTL_VIGEM_SIGNAL_REPORT_RING:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SIGNAL_REPORT_RING");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_SIGNAL_REPORT_RING),
+			reinterpret_cast<PVOID*>(&pSignalReportRing),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pSignalReportRing->Size != sizeof(VIGEM_SIGNAL_REPORT_RING))
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pSignalReportRing->SerialNo == 0)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pSignalReportRing->TargetType, pSignalReportRing->SerialNo, &pdo))
+		{
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->SignalReportRing();
+		pdo->ReleaseReference();
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_SUBMIT_REPORT_BATCH
+
+	case IOCTL_VIGEM_SUBMIT_REPORT_BATCH:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_SUBMIT_REPORT_BATCH");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			VIGEM_SUBMIT_REPORT_BATCH_LENGTH(0),
+			reinterpret_cast<PVOID*>(&pBatch),
+			&length
+		);
+
+		if (!NT_SUCCESS(status)
+			|| pBatch->Size != sizeof(VIGEM_SUBMIT_REPORT_BATCH)
+			|| pBatch->Count == 0
+			|| pBatch->Count > VIGEM_SUBMIT_REPORT_BATCH_MAX_ENTRIES
+			|| length < VIGEM_SUBMIT_REPORT_BATCH_LENGTH(pBatch->Count)
+			|| OutputBufferLength < VIGEM_SUBMIT_REPORT_BATCH_LENGTH(pBatch->Count))
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		//
+		// Buffered I/O, input and output share the same system buffer
+		// 
+		for (ULONG i = 0; i < pBatch->Count; i++)
+		{
+			const auto pEntry = &pBatch->Entries[i];
+
+			if (pEntry->SerialNo == 0)
+			{
+				pEntry->Status = STATUS_INVALID_PARAMETER;
+				continue;
+			}
+
+			if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pEntry->TargetType, pEntry->SerialNo, &pdo))
+			{
+				pEntry->Status = STATUS_DEVICE_DOES_NOT_EXIST;
+				continue;
+			}
+
+			if (pEntry->TargetType == Xbox360Wired && pEntry->ReportSize == sizeof(XUSB_REPORT))
+			{
+				XUSB_SUBMIT_REPORT submit;
+				XUSB_SUBMIT_REPORT_INIT(&submit, pEntry->SerialNo);
+				submit.Report = pEntry->Report.Xusb;
+
+				pEntry->Status = pdo->SubmitReport(&submit);
+			}
+			else if (pEntry->TargetType == DualShock4Wired && pEntry->ReportSize == sizeof(DS4_REPORT))
+			{
+				DS4_SUBMIT_REPORT submit;
+				DS4_SUBMIT_REPORT_INIT(&submit, pEntry->SerialNo);
+				submit.Report = pEntry->Report.Ds4;
+
+				pEntry->Status = pdo->SubmitReport(&submit);
+			}
+			else if (pEntry->TargetType == DualShock4Wired && pEntry->ReportSize == sizeof(DS4_REPORT_EX))
+			{
+				DS4_SUBMIT_REPORT_EX submit;
+				DS4_SUBMIT_REPORT_EX_INIT(&submit, pEntry->SerialNo);
+				submit.Report = pEntry->Report.Ds4Ex;
+
+				pEntry->Status = pdo->SubmitReport(&submit);
+			}
+			else
+			{
+				pEntry->Status = STATUS_INVALID_PARAMETER;
+			}
+
+			pdo->ReleaseReference();
+		}
+
+		// Return entries with populated status
+		length = VIGEM_SUBMIT_REPORT_BATCH_LENGTH(pBatch->Count);
+		status = STATUS_SUCCESS;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_QUERY_TARGET_STATS
+
+	case IOCTL_VIGEM_QUERY_TARGET_STATS:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_QUERY_TARGET_STATS");
+
+		// Don't accept the request if the output buffer can't hold the results
+		if (OutputBufferLength < sizeof(VIGEM_QUERY_TARGET_STATS))
+		{
+			status = STATUS_BUFFER_TOO_SMALL;
+			break;
+		}
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			sizeof(VIGEM_QUERY_TARGET_STATS),
+			reinterpret_cast<PVOID*>(&pQueryStats),
+			&length
+		);
+
+		if (!NT_SUCCESS(status) || pQueryStats->Size != sizeof(VIGEM_QUERY_TARGET_STATS))
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pQueryStats->SerialNo == 0)
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pQueryStats->TargetType, pQueryStats->SerialNo, &pdo))
+		{
+			length = 0;
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->QueryStatistics(&pQueryStats->Statistics);
+		pdo->ReleaseReference();
+
+		length = NT_SUCCESS(status) ? sizeof(VIGEM_QUERY_TARGET_STATS) : 0;
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH
+
+	case IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_REQUEST_NOTIFICATION_BATCH");
+
+		status = WdfRequestRetrieveInputBuffer(
+			Request,
+			VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(0),
+			reinterpret_cast<PVOID*>(&pNotifyBatch),
+			&length
+		);
+
+		if (!NT_SUCCESS(status)
+			|| pNotifyBatch->Size != sizeof(VIGEM_REQUEST_NOTIFICATION_BATCH)
+			|| pNotifyBatch->MaxCount == 0
+			|| pNotifyBatch->MaxCount > VIGEM_REQUEST_NOTIFICATION_BATCH_MAX_ENTRIES)
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		// Don't accept the request if the output buffer can't hold the results
+		if (OutputBufferLength < VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(pNotifyBatch->MaxCount))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+			            TRACE_QUEUE,
+			            "Output buffer %d too small, require at least %d",
+			            static_cast<int>(OutputBufferLength),
+			            static_cast<int>(VIGEM_REQUEST_NOTIFICATION_BATCH_LENGTH(pNotifyBatch->MaxCount)));
+
+			length = 0;
+			status = STATUS_BUFFER_TOO_SMALL;
+			break;
+		}
+
+		// This request only supports a single PDO at a time
+		if (pNotifyBatch->SerialNo == 0)
+		{
+			length = 0;
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, pNotifyBatch->TargetType, pNotifyBatch->SerialNo, &pdo))
+		{
+			length = 0;
+			status = STATUS_DEVICE_DOES_NOT_EXIST;
+			break;
+		}
+
+		status = pdo->EnqueueNotification(Request);
+		pdo->ReleaseReference();
+
+		length = 0;
+		status = (NT_SUCCESS(status)) ? STATUS_PENDING : status;
+
+		break;
+
 #pragma endregion
 
 	default:
@@ -477,4 +841,126 @@ VOID Bus_EvtIoDeviceControl(
 	TraceDbg(TRACE_QUEUE, "%!FUNC! Exit with status %!STATUS!", status);
 }
 
+//
+// Responds to I/O control requests sent to the FDO by kernel-mode callers.
+// 
+VOID Bus_EvtIoInternalDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+{
+	//
+	// Same codes and buffer layouts as the user-mode interface, only
+	// plug-in and unplug handling tells both apart
+	// 
+	Bus_EvtIoDeviceControl(Queue, Request, OutputBufferLength, InputBufferLength, IoControlCode);
+}
+
+//
+// Handles a plug-in or unplug request on the PnP queue.
+// 
+static VOID Bus_DispatchPnpRequest(
+	_In_ WDFQUEUE Queue,
+	_In_ WDFREQUEST Request,
+	_In_ ULONG IoControlCode,
+	_In_ BOOLEAN IsInternal
+)
+{
+	NTSTATUS status = STATUS_INVALID_PARAMETER;
+	WDFDEVICE Device;
+	size_t length = 0;
+
+	Device = WdfIoQueueGetDevice(Queue);
+
+	TraceDbg(TRACE_QUEUE, "%!FUNC! Entry (device: 0x%p)", Device);
+
+	switch (IoControlCode)
+	{
+#pragma region IOCTL_VIGEM_PLUGIN_TARGET
+
+	case IOCTL_VIGEM_PLUGIN_TARGET:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_PLUGIN_TARGET");
+
+		status = Bus_PlugInDevice(Device, Request, IsInternal, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_UNPLUG_TARGET
+
+	case IOCTL_VIGEM_UNPLUG_TARGET:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_UNPLUG_TARGET");
+
+		status = Bus_UnPlugDevice(Device, Request, IsInternal, &length);
+
+		break;
+
+#pragma endregion
+
+#pragma region IOCTL_VIGEM_APPLY_TARGET_CHANGES
+
+	case IOCTL_VIGEM_APPLY_TARGET_CHANGES:
+
+		TraceDbg(TRACE_QUEUE, "IOCTL_VIGEM_APPLY_TARGET_CHANGES");
+
+		status = Bus_ApplyTargetChanges(Device, Request, &length);
+
+		break;
+
+#pragma endregion
+
+	default:
+
+		TraceEvents(TRACE_LEVEL_WARNING,
+		            TRACE_QUEUE,
+		            "Unknown I/O control code 0x%X", IoControlCode);
+
+		break; // default status is STATUS_INVALID_PARAMETER
+	}
+
+	WdfRequestCompleteWithInformation(Request, status, length);
+
+	TraceDbg(TRACE_QUEUE, "%!FUNC! Exit with status %!STATUS!", status);
+}
+
+//
+// Responds to plug-in and unplug requests forwarded from the default queue.
+// 
+VOID Bus_EvtIoPnpDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+{
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+
+	Bus_DispatchPnpRequest(Queue, Request, IoControlCode, FALSE);
+}
+
+//
+// Responds to plug-in and unplug requests of kernel-mode callers.
+// 
+VOID Bus_EvtIoPnpInternalDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+{
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+
+	Bus_DispatchPnpRequest(Queue, Request, IoControlCode, TRUE);
+}
+
 EXTERN_C_END
@@ -39,4 +39,10 @@ EXTERN_C_START
 
 EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL Bus_EvtIoDeviceControl;
 
+EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL Bus_EvtIoInternalDeviceControl;
+
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL Bus_EvtIoPnpDeviceControl;
+
+EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL Bus_EvtIoPnpInternalDeviceControl;
+
 EXTERN_C_END
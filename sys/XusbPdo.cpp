@@ -44,10 +44,198 @@
 
 #include <ViGEm/km/BusShared.h>
 #include "Debugging.hpp"
+#include "BusEvents.hpp"
 
 
 PCWSTR ViGEm::Bus::Targets::EmulationTargetXUSB::_deviceDescription = L"Virtual Xbox 360 Controller";
 
+#pragma region Descriptor tables
+
+//
+// Device descriptor template, VID and PID get patched in per instance
+// 
+const USB_DEVICE_DESCRIPTOR ViGEm::Bus::Targets::EmulationTargetXUSB::_DeviceDescriptor =
+{
+	0x12,                       // bLength
+	USB_DEVICE_DESCRIPTOR_TYPE, // bDescriptorType
+	0x0200,                     // bcdUSB USB v2.0
+	0xFF,                       // bDeviceClass
+	0xFF,                       // bDeviceSubClass
+	0xFF,                       // bDeviceProtocol
+	0x08,                       // bMaxPacketSize0
+	0x045E,                     // idVendor
+	0x028E,                     // idProduct
+	0x0114,                     // bcdDevice
+	0x01,                       // iManufacturer
+	0x02,                       // iProduct
+	0x03,                       // iSerialNumber
+	0x01                        // bNumConfigurations
+};
+
+const UCHAR ViGEm::Bus::Targets::EmulationTargetXUSB::_ConfigurationDescriptor[XUSB_DESCRIPTOR_SIZE] =
+{
+	0x09,        //   bLength
+	0x02,        //   bDescriptorType (Configuration)
+	0x99, 0x00,  //   wTotalLength 153
+	0x04,        //   bNumInterfaces 4
+	0x01,        //   bConfigurationValue
+	0x00,        //   iConfiguration (String Index)
+	0xA0,        //   bmAttributes Remote Wakeup
+	0xFA,        //   bMaxPower 500mA
+
+	0x09,        //   bLength
+	0x04,        //   bDescriptorType (Interface)
+	0x00,        //   bInterfaceNumber 0
+	0x00,        //   bAlternateSetting
+	0x02,        //   bNumEndpoints 2
+	0xFF,        //   bInterfaceClass
+	0x5D,        //   bInterfaceSubClass
+	0x01,        //   bInterfaceProtocol
+	0x00,        //   iInterface (String Index)
+
+	0x11,        //   bLength
+	0x21,        //   bDescriptorType (HID)
+	0x00, 0x01,  //   bcdHID 1.00
+	0x01,        //   bCountryCode
+	0x25,        //   bNumDescriptors
+	0x81,        //   bDescriptorType[0] (Unknown 0x81)
+	0x14, 0x00,  //   wDescriptorLength[0] 20
+	0x00,        //   bDescriptorType[1] (Unknown 0x00)
+	0x00, 0x00,  //   wDescriptorLength[1] 0
+	0x13,        //   bDescriptorType[2] (Unknown 0x13)
+	0x01, 0x08,  //   wDescriptorLength[2] 2049
+	0x00,        //   bDescriptorType[3] (Unknown 0x00)
+	0x00,
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x81,        //   bEndpointAddress (IN/D2H)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x04,        //   bInterval 4 (unit depends on device speed)
+
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x01,        //   bEndpointAddress (OUT/H2D)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x08,        //   bInterval 8 (unit depends on device speed)
+
+	0x09,        //   bLength
+	0x04,        //   bDescriptorType (Interface)
+	0x01,        //   bInterfaceNumber 1
+	0x00,        //   bAlternateSetting
+	0x04,        //   bNumEndpoints 4
+	0xFF,        //   bInterfaceClass
+	0x5D,        //   bInterfaceSubClass
+	0x03,        //   bInterfaceProtocol
+	0x00,        //   iInterface (String Index)
+
+	0x1B,        //   bLength
+	0x21,        //   bDescriptorType (HID)
+	0x00, 0x01,  //   bcdHID 1.00
+	0x01,        //   bCountryCode
+	0x01,        //   bNumDescriptors
+	0x82,        //   bDescriptorType[0] (Unknown 0x82)
+	0x40, 0x01,  //   wDescriptorLength[0] 320
+	0x02, 0x20, 0x16, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x82,        //   bEndpointAddress (IN/D2H)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x02,        //   bInterval 2 (unit depends on device speed)
+
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x02,        //   bEndpointAddress (OUT/H2D)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x04,        //   bInterval 4 (unit depends on device speed)
+
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x83,        //   bEndpointAddress (IN/D2H)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x40,        //   bInterval 64 (unit depends on device speed)
+
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x03,        //   bEndpointAddress (OUT/H2D)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x10,        //   bInterval 16 (unit depends on device speed)
+
+	0x09,        //   bLength
+	0x04,        //   bDescriptorType (Interface)
+	0x02,        //   bInterfaceNumber 2
+	0x00,        //   bAlternateSetting
+	0x01,        //   bNumEndpoints 1
+	0xFF,        //   bInterfaceClass
+	0x5D,        //   bInterfaceSubClass
+	0x02,        //   bInterfaceProtocol
+	0x00,        //   iInterface (String Index)
+
+	0x09,        //   bLength
+	0x21,        //   bDescriptorType (HID)
+	0x00, 0x01,  //   bcdHID 1.00
+	0x01,        //   bCountryCode
+	0x22,        //   bNumDescriptors
+	0x84,        //   bDescriptorType[0] (Unknown 0x84)
+	0x07, 0x00,  //   wDescriptorLength[0] 7
+
+	0x07,        //   bLength
+	0x05,        //   bDescriptorType (Endpoint)
+	0x84,        //   bEndpointAddress (IN/D2H)
+	0x03,        //   bmAttributes (Interrupt)
+	0x20, 0x00,  //   wMaxPacketSize 32
+	0x10,        //   bInterval 16 (unit depends on device speed)
+
+	0x09,        //   bLength
+	0x04,        //   bDescriptorType (Interface)
+	0x03,        //   bInterfaceNumber 3
+	0x00,        //   bAlternateSetting
+	0x00,        //   bNumEndpoints 0
+	0xFF,        //   bInterfaceClass
+	0xFD,        //   bInterfaceSubClass
+	0x13,        //   bInterfaceProtocol
+	0x04,        //   iInterface (String Index)
+
+	0x06,        //   bLength
+	0x41,        //   bDescriptorType (Unknown)
+	0x00, 0x01, 0x01, 0x03,
+	// 153 bytes
+
+	// best guess: USB Standard Descriptor
+};
+
+//
+// Binary blobs (packets) sent during PDO initialization
+// 
+const UCHAR ViGEm::Bus::Targets::EmulationTargetXUSB::_InterruptBlobs[XUSB_BLOB_STORAGE_SIZE] =
+{
+	// 0
+	0x01, 0x03, 0x0E,
+	// 1
+	0x02, 0x03, 0x00,
+	// 2
+	0x03, 0x03, 0x03,
+	// 3
+	0x08, 0x03, 0x00,
+	// 4
+	0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
+	0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00,
+	// 5
+	0x01, 0x03, 0x03,
+	// 6
+	0x05, 0x03, 0x00,
+	// 7
+	0x31, 0x3F, 0xCF, 0xDC
+};
+
+#pragma endregion
+
 ViGEm::Bus::Targets::EmulationTargetXUSB::EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId,
 	USHORT ProductId) : EmulationTargetPDO(
 		Serial, SessionId, VendorId, ProductId)
@@ -209,12 +397,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoPrepareHardware()
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 {
-	WDF_OBJECT_ATTRIBUTES attributes;
-	PUCHAR blobBuffer;
-
-	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
-	attributes.ParentObject = this->_PdoDevice;
-
 	TraceEvents(TRACE_LEVEL_VERBOSE, TRACE_XUSB, "Initializing XUSB context...");
 
 	RtlZeroMemory(this->_Rumble, ARRAYSIZE(this->_Rumble));
@@ -230,63 +412,43 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 
 	this->_InterruptInitStage = 0;
 
-	// Allocate blob storage
-	NTSTATUS status = WdfMemoryCreate(
-		&attributes,
-		NonPagedPoolNx,
-		XUSB_POOL_TAG,
-		XUSB_BLOB_STORAGE_SIZE,
-		&this->_InterruptBlobStorage,
-		reinterpret_cast<PVOID*>(&blobBuffer)
+	// I/O Queue for pending IRPs
+	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
+
+	// Create and assign queue for unhandled interrupt requests
+	WDF_IO_QUEUE_CONFIG_INIT(&holdingInQueueConfig, WdfIoQueueDispatchManual);
+
+	NTSTATUS status = WdfIoQueueCreate(
+		this->_PdoDevice,
+		&holdingInQueueConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&this->_HoldingUsbInRequests
 	);
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_XUSB,
-			"WdfMemoryCreate failed with status %!STATUS!",
+			"WdfIoQueueCreate (HoldingUsbInRequests) failed with status %!STATUS!",
 			status);
 		return status;
 	}
 
-	// Fill blob storage
-	COPY_BYTE_ARRAY(blobBuffer, P99_PROTECT({
-		// 0
-		0x01, 0x03, 0x0E,
-		// 1
-		0x02, 0x03, 0x00,
-		// 2
-		0x03, 0x03, 0x03,
-		// 3
-		0x08, 0x03, 0x00,
-		// 4
-		0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0xe4, 0xf2,
-		0xb3, 0xf8, 0x49, 0xf3, 0xb0, 0xfc, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00,
-		// 5
-		0x01, 0x03, 0x03,
-		// 6
-		0x05, 0x03, 0x00,
-		// 7
-		0x31, 0x3F, 0xCF, 0xDC
-		}));
+	WDF_IO_QUEUE_CONFIG waitUserIndexQueueConfig;
 
-	// I/O Queue for pending IRPs
-	WDF_IO_QUEUE_CONFIG holdingInQueueConfig;
-
-	// Create and assign queue for unhandled interrupt requests
-	WDF_IO_QUEUE_CONFIG_INIT(&holdingInQueueConfig, WdfIoQueueDispatchManual);
+	// Create and assign queue for user-land requests waiting for the user index
+	WDF_IO_QUEUE_CONFIG_INIT(&waitUserIndexQueueConfig, WdfIoQueueDispatchManual);
 
 	status = WdfIoQueueCreate(
-		this->_PdoDevice,
-		&holdingInQueueConfig,
+		WdfPdoGetParent(this->_PdoDevice),
+		&waitUserIndexQueueConfig,
 		WDF_NO_OBJECT_ATTRIBUTES,
-		&this->_HoldingUsbInRequests
+		&this->_WaitUserIndexRequests
 	);
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_XUSB,
-			"WdfIoQueueCreate (HoldingUsbInRequests) failed with status %!STATUS!",
+			"WdfIoQueueCreate (WaitUserIndexRequests) failed with status %!STATUS!",
 			status);
 		return status;
 	}
@@ -294,164 +456,32 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::PdoInitContext()
 	return STATUS_SUCCESS;
 }
 
-VOID ViGEm::Bus::Targets::EmulationTargetXUSB::GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length)
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::PdoCleanup()
 {
-	UCHAR XusbDescriptorData[XUSB_DESCRIPTOR_SIZE] =
+	//
+	// This queues parent is the FDO so explicitly free memory
+	//
+	if (this->_WaitUserIndexRequests)
 	{
-		0x09,        //   bLength
-		0x02,        //   bDescriptorType (Configuration)
-		0x99, 0x00,  //   wTotalLength 153
-		0x04,        //   bNumInterfaces 4
-		0x01,        //   bConfigurationValue
-		0x00,        //   iConfiguration (String Index)
-		0xA0,        //   bmAttributes Remote Wakeup
-		0xFA,        //   bMaxPower 500mA
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x00,        //   bInterfaceNumber 0
-		0x00,        //   bAlternateSetting
-		0x02,        //   bNumEndpoints 2
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x01,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x11,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x25,        //   bNumDescriptors
-		0x81,        //   bDescriptorType[0] (Unknown 0x81)
-		0x14, 0x00,  //   wDescriptorLength[0] 20
-		0x00,        //   bDescriptorType[1] (Unknown 0x00)
-		0x00, 0x00,  //   wDescriptorLength[1] 0
-		0x13,        //   bDescriptorType[2] (Unknown 0x13)
-		0x01, 0x08,  //   wDescriptorLength[2] 2049
-		0x00,        //   bDescriptorType[3] (Unknown 0x00)
-		0x00,
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x81,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x04,        //   bInterval 4 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x01,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x08,        //   bInterval 8 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x01,        //   bInterfaceNumber 1
-		0x00,        //   bAlternateSetting
-		0x04,        //   bNumEndpoints 4
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x03,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x1B,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x01,        //   bNumDescriptors
-		0x82,        //   bDescriptorType[0] (Unknown 0x82)
-		0x40, 0x01,  //   wDescriptorLength[0] 320
-		0x02, 0x20, 0x16, 0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x16, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x82,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x02,        //   bInterval 2 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x02,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x04,        //   bInterval 4 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x83,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x40,        //   bInterval 64 (unit depends on device speed)
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x03,        //   bEndpointAddress (OUT/H2D)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x10,        //   bInterval 16 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x02,        //   bInterfaceNumber 2
-		0x00,        //   bAlternateSetting
-		0x01,        //   bNumEndpoints 1
-		0xFF,        //   bInterfaceClass
-		0x5D,        //   bInterfaceSubClass
-		0x02,        //   bInterfaceProtocol
-		0x00,        //   iInterface (String Index)
-
-		0x09,        //   bLength
-		0x21,        //   bDescriptorType (HID)
-		0x00, 0x01,  //   bcdHID 1.00
-		0x01,        //   bCountryCode
-		0x22,        //   bNumDescriptors
-		0x84,        //   bDescriptorType[0] (Unknown 0x84)
-		0x07, 0x00,  //   wDescriptorLength[0] 7
-
-		0x07,        //   bLength
-		0x05,        //   bDescriptorType (Endpoint)
-		0x84,        //   bEndpointAddress (IN/D2H)
-		0x03,        //   bmAttributes (Interrupt)
-		0x20, 0x00,  //   wMaxPacketSize 32
-		0x10,        //   bInterval 16 (unit depends on device speed)
-
-		0x09,        //   bLength
-		0x04,        //   bDescriptorType (Interface)
-		0x03,        //   bInterfaceNumber 3
-		0x00,        //   bAlternateSetting
-		0x00,        //   bNumEndpoints 0
-		0xFF,        //   bInterfaceClass
-		0xFD,        //   bInterfaceSubClass
-		0x13,        //   bInterfaceProtocol
-		0x04,        //   iInterface (String Index)
-
-		0x06,        //   bLength
-		0x41,        //   bDescriptorType (Unknown)
-		0x00, 0x01, 0x01, 0x03,
-		// 153 bytes
-
-		// best guess: USB Standard Descriptor
-	};
-
-	RtlCopyBytes(Buffer, XusbDescriptorData, Length);
+		WdfIoQueuePurgeSynchronously(this->_WaitUserIndexRequests);
+		WdfObjectDelete(this->_WaitUserIndexRequests);
+	}
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::GetConfigurationDescriptorType(PUCHAR Buffer, ULONG Length)
+{
+	RtlCopyMemory(Buffer, _ConfigurationDescriptor, min(Length, sizeof(_ConfigurationDescriptor)));
+
+	// Interrupt IN bInterval may be overridden per target
+	if (Length > XUSB_INTERRUPT_IN_INTERVAL_OFFSET)
+		Buffer[XUSB_INTERRUPT_IN_INTERVAL_OFFSET] = this->GetInterruptInInterval(XUSB_INTERRUPT_IN_INTERVAL);
 }
 
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbGetDeviceDescriptorType(PUSB_DEVICE_DESCRIPTOR pDescriptor)
 {
-	pDescriptor->bLength = 0x12;
-	pDescriptor->bDescriptorType = USB_DEVICE_DESCRIPTOR_TYPE;
-	pDescriptor->bcdUSB = 0x0200; // USB v2.0
-	pDescriptor->bDeviceClass = 0xFF;
-	pDescriptor->bDeviceSubClass = 0xFF;
-	pDescriptor->bDeviceProtocol = 0xFF;
-	pDescriptor->bMaxPacketSize0 = 0x08;
+	*pDescriptor = _DeviceDescriptor;
 	pDescriptor->idVendor = this->_VendorId;
 	pDescriptor->idProduct = this->_ProductId;
-	pDescriptor->bcdDevice = 0x0114;
-	pDescriptor->iManufacturer = 0x01;
-	pDescriptor->iProduct = 0x02;
-	pDescriptor->iSerialNumber = 0x03;
-	pDescriptor->bNumConfigurations = 0x01;
 
 	return STATUS_SUCCESS;
 }
@@ -485,7 +515,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SelectConfiguration(PURB Urb)
 	pInfo->Pipes[0].MaximumTransferSize = 0x00400000;
 	pInfo->Pipes[0].MaximumPacketSize = 0x20;
 	pInfo->Pipes[0].EndpointAddress = 0x81;
-	pInfo->Pipes[0].Interval = 0x04;
+	pInfo->Pipes[0].Interval = this->GetInterruptInInterval(XUSB_INTERRUPT_IN_INTERVAL);
 	pInfo->Pipes[0].PipeType = (USBD_PIPE_TYPE)0x03;
 	pInfo->Pipes[0].PipeHandle = (USBD_PIPE_HANDLE)0xFFFF0081;
 	pInfo->Pipes[0].PipeFlags = 0x00;
@@ -704,6 +734,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 {
 	NTSTATUS     status = STATUS_SUCCESS;
 	WDFREQUEST   notifyRequest;
+	KIRQL        irql;
 
 	// Data coming FROM us TO higher driver
 	if (pTransfer->TransferFlags & USBD_TRANSFER_DIRECTION_IN)
@@ -712,8 +743,6 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			TRACE_USBPDO,
 			">> >> >> Incoming request, queuing...");
 
-		auto blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
-
 		if (xusb_is_data_pipe(pTransfer))
 		{
 			//
@@ -726,7 +755,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_00_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_00_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
 				return STATUS_SUCCESS;
@@ -735,7 +764,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_01_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_01_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
 				return STATUS_SUCCESS;
@@ -744,7 +773,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_02_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_02_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
 				return STATUS_SUCCESS;
@@ -753,7 +782,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_03_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_03_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
 				return STATUS_SUCCESS;
@@ -762,7 +791,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_04_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_04_OFFSET],
 					sizeof(XUSB_INTERRUPT_IN_PACKET)
 				);
 				return STATUS_SUCCESS;
@@ -771,17 +800,18 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				this->_InterruptInitStage++;
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_05_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_05_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
+
+				//
+				// Boot sequence done, the data pipe only carries inputs from now on
+				// 
+				this->_UsbInDataPipe = pTransfer->PipeHandle;
+
 				return STATUS_SUCCESS;
 			default:
-				/* This request is sent periodically and relies on data the "feeder"
-				* has to supply, so we queue this request and return with STATUS_PENDING.
-				* The request gets completed as soon as the "feeder" sent an update. */
-				status = WdfRequestForwardToIoQueue(Request, this->_PendingUsbInRequests);
-
-				return (NT_SUCCESS(status)) ? STATUS_PENDING : status;
+				return this->QueueUsbInRequest(Request);
 			}
 		}
 
@@ -791,7 +821,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			{
 				RtlCopyMemory(
 					pTransfer->TransferBuffer,
-					&blobBuffer[XUSB_BLOB_06_OFFSET],
+					&_InterruptBlobs[XUSB_BLOB_06_OFFSET],
 					XUSB_INIT_STAGE_SIZE
 				);
 
@@ -826,23 +856,24 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			Buffer[0], Buffer[1], Buffer[2]);
 
 		// extract LED byte to get controller slot
-		if (Buffer[0] == 0x01 && Buffer[1] == 0x03 && Buffer[2] >= 0x02)
+		if (Buffer[0] == 0x01 && Buffer[1] == 0x03 && xusb_led_user_index(Buffer[2]) >= 0)
 		{
-			if (Buffer[2] == 0x02)this->_LedNumber = 0;
-			if (Buffer[2] == 0x03)this->_LedNumber = 1;
-			if (Buffer[2] == 0x04)this->_LedNumber = 2;
-			if (Buffer[2] == 0x05)this->_LedNumber = 3;
+			KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+			this->_LedNumber = xusb_led_user_index(Buffer[2]);
+			KeReleaseSpinLock(&this->_OutputReportLock, irql);
 
 			TraceDbg(
 				TRACE_USBPDO,
 				"-- LED Number: %d",
 				this->_LedNumber);
+
+			this->CompleteWaitUserIndexRequests();
 		}
 
 		//
 		// Notify client library that PDO is ready
 		// 
-		KeSetEvent(&this->_PdoBootNotificationEvent, 0, FALSE);
+		this->SignalDeviceReady();
 	}
 
 	// Extract rumble (vibration) information
@@ -862,11 +893,32 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			Buffer[6],
 			Buffer[7]);
 
+		KeAcquireSpinLock(&this->_OutputReportLock, &irql);
 		RtlCopyBytes(this->_Rumble, Buffer, pTransfer->TransferBufferLength);
+		KeReleaseSpinLock(&this->_OutputReportLock, irql);
 	}
 
 #pragma endregion
 
+	OUT_BUFFER_CONTEXT report;
+
+	//
+	// Coalescing consumers read the timestamp under this lock
+	// 
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+	this->RecordOutputReport(&report, pTransfer->TransferBufferLength);
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+
+	//
+	// Only the latest LED and rumble state gets handed out
+	// 
+	if (this->_CoalesceOutputReports)
+	{
+		this->ProcessCoalescedNotification();
+
+		return status;
+	}
+
 	if (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(
 		this->_PendingNotificationRequests,
 		&notifyRequest
@@ -874,6 +926,20 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 	{
 		PXUSB_REQUEST_NOTIFICATION notify = nullptr;
 
+		//
+		// Batch requests take this report along with anything still queued
+		// 
+		if (IsNotificationBatchRequest(notifyRequest))
+		{
+			this->CompleteNotificationBatch(
+				notifyRequest,
+				pTransfer->TransferBuffer,
+				&report
+			);
+
+			return status;
+		}
+
 		status = WdfRequestRetrieveOutputBuffer(
 			notifyRequest,
 			sizeof(XUSB_REQUEST_NOTIFICATION),
@@ -895,6 +961,8 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 			          sizeof(XUSB_REQUEST_NOTIFICATION)
 			);
 
+			BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, 1);
+
 			WdfRequestCompleteWithInformation(notifyRequest, status, notify->Size);
 		}
 		else
@@ -921,7 +989,7 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 				pTransfer->TransferBufferLength
 			);
 
-			*static_cast<size_t*>(contextBuffer) = pTransfer->TransferBufferLength;
+			*static_cast<POUT_BUFFER_CONTEXT>(contextBuffer) = report;
 
 			TraceDbg(TRACE_USBPDO, "Queued %Iu bytes", pTransfer->TransferBufferLength);
 
@@ -935,19 +1003,17 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbBulkOrInterruptTransfer(_U
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::UsbControlTransfer(PURB Urb)
 {
 	NTSTATUS status;
-	PUCHAR   blobBuffer;
 
 	switch (Urb->UrbControlTransfer.SetupPacket[6])
 	{
 	case 0x04:
 
-		blobBuffer = static_cast<PUCHAR>(WdfMemoryGetBuffer(this->_InterruptBlobStorage, nullptr));
 		//
 		// Xenon magic
 		// 
 		RtlCopyMemory(
 			Urb->UrbControlTransfer.TransferBuffer,
-			&blobBuffer[XUSB_BLOB_07_OFFSET],
+			&_InterruptBlobs[XUSB_BLOB_07_OFFSET],
 			0x04
 		);
 		status = STATUS_SUCCESS;
@@ -982,6 +1048,9 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	NTSTATUS    status = STATUS_SUCCESS;
 	BOOLEAN     changed;
 	WDFREQUEST  usbRequest;
+	KIRQL       irql;
+
+	KeAcquireSpinLock(&this->_ReportLock, &irql);
 
 	changed = (RtlCompareMemory(&this->_Packet.Report,
 		&static_cast<PXUSB_SUBMIT_REPORT>(NewReport)->Report,
@@ -990,6 +1059,10 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	// Don't waste pending IRP if input hasn't changed
 	if (!changed)
 	{
+		KeReleaseSpinLock(&this->_ReportLock, irql);
+
+		this->CountUnchangedReport();
+
 		TraceDbg(
 			TRACE_BUSENUM,
 			"Input report hasn't changed since last update, aborting with %!STATUS!",
@@ -1004,7 +1077,12 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	status = WdfIoQueueRetrieveNextRequest(this->_PendingUsbInRequests, &usbRequest);
 
 	if (!NT_SUCCESS(status))
+	{
+		KeReleaseSpinLock(&this->_ReportLock, irql);
+
+		this->CountMissingUsbInRequest(false);
 		return status;
+	}
 
 	// Get pending IRP
 	PIRP pendingIrp = WdfRequestWdmGetIrp(usbRequest);
@@ -1022,6 +1100,11 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	// Copy cached report to URB transfer buffer
 	RtlCopyBytes(Buffer, &this->_Packet, sizeof(XUSB_INTERRUPT_IN_PACKET));
 
+	// Completion may resubmit the URB right away, never complete under the lock
+	KeReleaseSpinLock(&this->_ReportLock, irql);
+
+	this->RecordUsbInCompletion();
+
 	// Complete pending request
 	WdfRequestComplete(usbRequest, status);
 
@@ -1030,6 +1113,15 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitReportImpl(PVOID NewRep
 	return status;
 }
 
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::SubmitNeutralReport()
+{
+	XUSB_SUBMIT_REPORT report;
+
+	XUSB_SUBMIT_REPORT_INIT(&report, this->_SerialNo);
+
+	return this->SubmitReportImpl(&report);
+}
+
 NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex) const
 {
 	if (!this->IsOwnerProcess())
@@ -1049,6 +1141,69 @@ NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::GetUserIndex(PULONG UserIndex
 	return STATUS_INVALID_DEVICE_OBJECT_PARAMETER;
 }
 
+NTSTATUS ViGEm::Bus::Targets::EmulationTargetXUSB::EnqueueWaitUserIndex(WDFREQUEST Request)
+{
+	if (!this->IsOwnerProcess())
+		return STATUS_ACCESS_DENIED;
+
+	if (!this->_WaitUserIndexRequests)
+		return STATUS_INVALID_DEVICE_STATE;
+
+	const NTSTATUS status = WdfRequestForwardToIoQueue(Request, this->_WaitUserIndexRequests);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+		            TRACE_XUSB,
+		            "WdfRequestForwardToIoQueue failed with status %!STATUS!",
+		            status
+		);
+
+		return status;
+	}
+
+	//
+	// Checked after queuing so a concurrent LED update can't get missed
+	// 
+	if (this->_LedNumber >= 0)
+		this->CompleteWaitUserIndexRequests();
+
+	return STATUS_PENDING;
+}
+
+void ViGEm::Bus::Targets::EmulationTargetXUSB::CompleteWaitUserIndexRequests()
+{
+	WDFREQUEST waitRequest;
+	PXUSB_GET_USER_INDEX pGetUserIndex;
+
+	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(this->_WaitUserIndexRequests, &waitRequest)))
+	{
+		NTSTATUS status = WdfRequestRetrieveOutputBuffer(
+			waitRequest,
+			sizeof(XUSB_GET_USER_INDEX),
+			reinterpret_cast<PVOID*>(&pGetUserIndex),
+			nullptr
+		);
+
+		if (NT_SUCCESS(status))
+		{
+			pGetUserIndex->UserIndex = static_cast<ULONG>(this->_LedNumber);
+
+			TraceEvents(TRACE_LEVEL_INFORMATION,
+			            TRACE_XUSB,
+			            "Completing user index wait request with index %d",
+			            this->_LedNumber
+			);
+		}
+
+		WdfRequestCompleteWithInformation(
+			waitRequest,
+			status,
+			NT_SUCCESS(status) ? sizeof(XUSB_GET_USER_INDEX) : 0
+		);
+	}
+}
+
 void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUEUE Queue)
 {
 	NTSTATUS status;
@@ -1056,6 +1211,7 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 	PVOID clientBuffer, contextBuffer;
 	size_t bufferLength;
 	PXUSB_REQUEST_NOTIFICATION notify = nullptr;
+	VIGEM_NOTIFICATION_ENTRY entry;
 
 	TraceDbg(TRACE_BUSENUM, "%!FUNC! Entry");
 	
@@ -1064,6 +1220,21 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 	// 
 	while (NT_SUCCESS(WdfIoQueueRetrieveNextRequest(Queue, &request)))
 	{
+		//
+		// Batch requests take all queued buffers at once
+		// 
+		if (IsNotificationBatchRequest(request))
+		{
+			this->CompleteNotificationBatch(request);
+
+			if (DMF_BufferQueue_Count(this->_UsbInterruptOutBufferQueue) == 0)
+			{
+				break;
+			}
+
+			continue;
+		}
+
 		status = DMF_BufferQueue_Dequeue(
 			this->_UsbInterruptOutBufferQueue,
 			&clientBuffer,
@@ -1085,12 +1256,12 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 		//
 		// Actual buffer length
 		// 
-		bufferLength = *static_cast<size_t*>(contextBuffer);
+		bufferLength = static_cast<POUT_BUFFER_CONTEXT>(contextBuffer)->Length;
 
 		//
 		// Validate packet
 		// 
-		if (bufferLength != XUSB_RUMBLE_SIZE && bufferLength != XUSB_LEDSET_SIZE)
+		if (!this->DecodeNotificationEntry(clientBuffer, bufferLength, &entry))
 		{
 			DMF_BufferQueue_Reuse(this->_UsbInterruptOutBufferQueue, clientBuffer);
 			WdfRequestComplete(request, STATUS_INVALID_BUFFER_SIZE);
@@ -1106,23 +1277,16 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 		{			
 			notify->Size = sizeof(XUSB_REQUEST_NOTIFICATION);
 			notify->SerialNo = this->_SerialNo;
-			notify->LedNumber = this->_LedNumber; // Report last cached value
-
-			if (bufferLength == XUSB_RUMBLE_SIZE)
-			{
-				notify->LargeMotor = static_cast<PUCHAR>(clientBuffer)[3];
-				notify->SmallMotor = static_cast<PUCHAR>(clientBuffer)[4];
-			}
-			else
-			{
-				notify->LargeMotor = this->_Rumble[3]; // Cached value
-				notify->SmallMotor = this->_Rumble[4]; // Cached value
-			}
+			notify->LedNumber = entry.Report.Xusb.LedNumber;
+			notify->LargeMotor = entry.Report.Xusb.LargeMotor;
+			notify->SmallMotor = entry.Report.Xusb.SmallMotor;
 
 			DumpAsHex("!! XUSB_REQUEST_NOTIFICATION", 
 				notify, 
 				sizeof(XUSB_REQUEST_NOTIFICATION)
 			);
+
+			BusEvent_NotificationCompleted(this->_SerialNo, this->_TargetType, 1);
 			
 			WdfRequestCompleteWithInformation(request, status, notify->Size);
 		}
@@ -1140,3 +1304,78 @@ void ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessPendingNotification(WDFQUE
 
 	TraceDbg(TRACE_BUSENUM, "%!FUNC! Exit");
 }
+
+bool ViGEm::Bus::Targets::EmulationTargetXUSB::DecodeNotificationEntry(
+	PVOID Buffer,
+	size_t Length,
+	PVIGEM_NOTIFICATION_ENTRY Entry
+)
+{
+	if (Length != XUSB_RUMBLE_SIZE && Length != XUSB_LEDSET_SIZE)
+		return false;
+
+	Entry->Report.Xusb.LedNumber = static_cast<UCHAR>(this->_LedNumber); // Report last cached value
+
+	if (Length == XUSB_RUMBLE_SIZE)
+	{
+		Entry->Report.Xusb.LargeMotor = static_cast<PUCHAR>(Buffer)[3];
+		Entry->Report.Xusb.SmallMotor = static_cast<PUCHAR>(Buffer)[4];
+	}
+	else
+	{
+		Entry->Report.Xusb.LargeMotor = this->_Rumble[3]; // Cached value
+		Entry->Report.Xusb.SmallMotor = this->_Rumble[4]; // Cached value
+	}
+
+	return true;
+}
+
+void ViGEm::Bus::Targets::EmulationTargetXUSB::GetLatestNotificationEntry(PVIGEM_NOTIFICATION_ENTRY Entry)
+{
+	Entry->Report.Xusb.LedNumber = static_cast<UCHAR>(this->_LedNumber);
+	Entry->Report.Xusb.LargeMotor = this->_Rumble[3];
+	Entry->Report.Xusb.SmallMotor = this->_Rumble[4];
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::SessionReleased()
+{
+	KIRQL irql;
+
+	//
+	// Rumble was meant for the previous session, the LED number stays
+	// assigned by the host
+	// 
+	KeAcquireSpinLock(&this->_OutputReportLock, &irql);
+	RtlZeroMemory(this->_Rumble, ARRAYSIZE(this->_Rumble));
+	KeReleaseSpinLock(&this->_OutputReportLock, irql);
+
+	// Previous owner's waiters must not learn the next owner's index
+	if (this->_WaitUserIndexRequests)
+	{
+		WdfIoQueuePurgeSynchronously(this->_WaitUserIndexRequests);
+		WdfIoQueueStart(this->_WaitUserIndexRequests);
+	}
+}
+
+VOID ViGEm::Bus::Targets::EmulationTargetXUSB::ProcessReportRing(BOOLEAN ArmDoorbell)
+{
+	VIGEM_REPORT_RING_SLOT slot;
+	XUSB_SUBMIT_REPORT submit;
+
+	if (!this->DequeueRingReport(&slot, ArmDoorbell))
+		return;
+
+	if (slot.Length != sizeof(XUSB_REPORT))
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_XUSB,
+			"Dropping ring report of invalid length %d",
+			slot.Length);
+		return;
+	}
+
+	XUSB_SUBMIT_REPORT_INIT(&submit, this->_SerialNo);
+	RtlCopyMemory(&submit.Report, slot.Buffer, sizeof(XUSB_REPORT));
+
+	(void)this->DispatchReport(&submit);
+}
@@ -60,7 +60,25 @@ namespace ViGEm::Bus::Targets
 		return (pTransfer->PipeHandle == reinterpret_cast<USBD_PIPE_HANDLE>(0xFFFF0083));
 	}
 
-	class EmulationTargetXUSB : public Core::EmulationTargetPDO
+	//
+	// Maps an LED pattern to the XInput slot it represents, -1 for patterns
+	// not tied to a slot (off, blinking, rotating, ...)
+	// 
+	constexpr CHAR xusb_led_user_index(UCHAR Pattern)
+	{
+		// Flashes, then on
+		if (Pattern >= 0x02 && Pattern <= 0x05)
+			return static_cast<CHAR>(Pattern - 0x02);
+
+		// On
+		if (Pattern >= 0x06 && Pattern <= 0x09)
+			return static_cast<CHAR>(Pattern - 0x06);
+
+		return -1;
+	}
+
+	class EmulationTargetXUSB : public Core::EmulationTargetPDO,
+	                            public Core::LookasideAllocated<EmulationTargetXUSB, XUSB_POOL_TAG>
 	{
 	public:
 		EmulationTargetXUSB(ULONG Serial, LONG SessionId, USHORT VendorId = 0x045E, USHORT ProductId = 0x028E);
@@ -95,19 +113,37 @@ namespace ViGEm::Bus::Targets
 		
 		NTSTATUS SubmitReportImpl(PVOID NewReport) override;
 
+		NTSTATUS SubmitNeutralReport() override;
+
 		NTSTATUS GetUserIndex(PULONG UserIndex) const;
 
+		NTSTATUS EnqueueWaitUserIndex(WDFREQUEST Request);
+
+		VOID PdoCleanup() override;
+
 	protected:
 		void ProcessPendingNotification(WDFQUEUE Queue) override;
+
+		bool DecodeNotificationEntry(PVOID Buffer, size_t Length, PVIGEM_NOTIFICATION_ENTRY Entry) override;
+
+		void GetLatestNotificationEntry(PVIGEM_NOTIFICATION_ENTRY Entry) override;
+
+		VOID ProcessReportRing(BOOLEAN ArmDoorbell) override;
+
+		VOID SessionReleased() override;
 	private:
 		static PCWSTR _deviceDescription;
 
+		void CompleteWaitUserIndexRequests();
+
 #if defined(_X86_)
 		static const int XUSB_CONFIGURATION_SIZE = 0x00E4;
 #else
 		static const int XUSB_CONFIGURATION_SIZE = 0x0130;
 #endif
 		static const int XUSB_DESCRIPTOR_SIZE = 0x0099;
+		static const int XUSB_INTERRUPT_IN_INTERVAL = 0x04;
+		static const int XUSB_INTERRUPT_IN_INTERVAL_OFFSET = 0x29;
 		static const int XUSB_RUMBLE_SIZE = 0x08;
 		static const int XUSB_LEDSET_SIZE = 0x03;
 		static const int XUSB_LEDNUM_SIZE = 0x01;
@@ -123,6 +159,13 @@ namespace ViGEm::Bus::Targets
 		static const int XUSB_BLOB_06_OFFSET = 0x23;
 		static const int XUSB_BLOB_07_OFFSET = 0x26;
 
+		//
+		// Descriptors and initialization blobs, shared by all instances
+		// 
+		static const USB_DEVICE_DESCRIPTOR _DeviceDescriptor;
+		static const UCHAR _ConfigurationDescriptor[XUSB_DESCRIPTOR_SIZE];
+		static const UCHAR _InterruptBlobs[XUSB_BLOB_STORAGE_SIZE];
+
 		//
 		// Rumble buffer
 		//
@@ -134,7 +177,7 @@ namespace ViGEm::Bus::Targets
 		CHAR _LedNumber;
 
 		//
-		// Report packet
+		// Report packet, only ever accessed under _ReportLock
 		//
 		XUSB_INTERRUPT_IN_PACKET _Packet;
 
@@ -144,18 +187,18 @@ namespace ViGEm::Bus::Targets
 		WDFQUEUE _HoldingUsbInRequests;
 
 		//
-		// Required for XInputGetCapabilities to work
+		// Queue for requests waiting for the user index to become known
 		// 
-		BOOLEAN _ReportedCapabilities;
+		WDFQUEUE _WaitUserIndexRequests{};
 
 		//
 		// Required for XInputGetCapabilities to work
 		// 
-		ULONG _InterruptInitStage;
+		BOOLEAN _ReportedCapabilities;
 
 		//
-		// Storage of binary blobs (packets) for PDO initialization
+		// Required for XInputGetCapabilities to work
 		// 
-		WDFMEMORY _InterruptBlobStorage;
+		ULONG _InterruptInitStage;
 	};
 }
@@ -42,10 +42,14 @@
 #include "Ds4Pdo.hpp"
 
 #include "Debugging.hpp"
+#include "BusEvents.hpp"
 
 #ifdef ALLOC_PRAGMA
 #pragma alloc_text (PAGE, Bus_PlugInDevice)
 #pragma alloc_text (PAGE, Bus_UnPlugDevice)
+#pragma alloc_text (PAGE, Bus_ApplyTargetChanges)
+#pragma alloc_text (PAGE, Bus_CreateStandbyTargets)
+#pragma alloc_text (PAGE, Bus_UnPlugSessionTargets)
 #endif
 
 using ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION;
@@ -53,80 +57,228 @@ using ViGEm::Bus::Core::EmulationTargetPDO;
 using ViGEm::Bus::Targets::EmulationTargetXUSB;
 using ViGEm::Bus::Targets::EmulationTargetDS4;
 
+static NTSTATUS Bus_BindStandbyTarget(
+	_In_ WDFDEVICE Device,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ LONG SessionId,
+	_Out_ PULONG SerialNo);
+
+static PFDO_SESSION_TARGET Bus_DetachSessionTarget(
+	_In_ WDFDEVICE Device,
+	_Inout_ PLONG SessionId,
+	_In_ ULONG SerialNo);
+
+static VOID Bus_ForgetSessionTarget(
+	_In_ WDFDEVICE Device,
+	_In_ LONG SessionId,
+	_In_ ULONG SerialNo);
+
+static VOID Bus_UnPlugSessionTarget(
+	_In_ WDFDEVICE Device,
+	_In_ LONG SessionId,
+	_In_ PFDO_SESSION_TARGET SessionTarget);
+
 //
-// Simulates a device plug-in event.
+// Binds a parked standby target to the given session, if the requested one qualifies.
 // 
-EXTERN_C NTSTATUS Bus_PlugInDevice(
+static NTSTATUS Bus_PlugInStandbyTarget(
 	_In_ WDFDEVICE Device,
-	_In_ WDFREQUEST Request,
-	_In_ BOOLEAN IsInternal,
-	_Out_ size_t* Transferred)
+	_In_ PFDO_FILE_DATA FileData,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId,
+	_In_ ULONG Flags,
+	_In_ ULONG ReportInterval,
+	_In_ ULONG IdentityKey,
+	_Inout_ PULONG SerialNo)
 {
-	PDO_IDENTIFICATION_DESCRIPTION  description;
-	NTSTATUS                        status;
-	PVIGEM_PLUGIN_TARGET            plugIn;
-	WDFFILEOBJECT                   fileObject;
-	PFDO_FILE_DATA                  pFileData;
-	size_t                          length = 0;
-
-	UNREFERENCED_PARAMETER(IsInternal);
+	ULONG                           serialNo;
+	PFDO_SESSION_TARGET             sessionTarget;
+	KIRQL                           irql;
 
 	PAGED_CODE();
 
+	//
+	// A parked standby target skips PnP entirely, only default ones qualify
+	// 
+	if (*SerialNo != 0
+		|| (VendorId != 0 && ProductId != 0)
+		|| Flags != 0
+		|| ReportInterval != 0
+		|| IdentityKey != 0)
+	{
+		return STATUS_NOT_FOUND;
+	}
 
-	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
-
-	status = WdfRequestRetrieveInputBuffer(
-		Request,
-		sizeof(VIGEM_PLUGIN_TARGET),
-		reinterpret_cast<PVOID*>(&plugIn),
-		&length
-	);
-	if (!NT_SUCCESS(status))
+	//
+	// Allocated up front so a successful bind can't fail to be tracked
+	// 
+	sessionTarget = static_cast<PFDO_SESSION_TARGET>(ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(FDO_SESSION_TARGET),
+		SESSION_TARGET_POOL_TAG
+	));
+	if (sessionTarget == nullptr)
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!", status);
-		return status;
+			"Failed to allocate session target entry");
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	if (!NT_SUCCESS(Bus_BindStandbyTarget(Device, TargetType, FileData->SessionId, &serialNo)))
+	{
+		ExFreePoolWithTag(sessionTarget, SESSION_TARGET_POOL_TAG);
+		return STATUS_NOT_FOUND;
 	}
 
-	if ((sizeof(VIGEM_PLUGIN_TARGET) != plugIn->Size) || (length != plugIn->Size))
+	sessionTarget->TargetType = TargetType;
+	sessionTarget->SerialNo = serialNo;
+	sessionTarget->IsStandby = TRUE;
+
+	KeAcquireSpinLock(&FileData->TargetsLock, &irql);
+	InsertTailList(&FileData->Targets, &sessionTarget->Link);
+	KeReleaseSpinLock(&FileData->TargetsLock, irql);
+
+	*SerialNo = serialNo;
+
+	BusEvent_TargetPhase(serialNo, TargetType, "StandbyBound", STATUS_SUCCESS);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Plugs in a new target (or binds a parked standby one) owned by the given session.
+// BindStandby must be FALSE while a child list iteration is open, as binding
+// iterates the child list itself.
+// 
+static NTSTATUS Bus_PlugInTarget(
+	_In_ WDFDEVICE Device,
+	_In_ PFDO_FILE_DATA FileData,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ USHORT VendorId,
+	_In_ USHORT ProductId,
+	_In_ ULONG Flags,
+	_In_ ULONG ReportInterval,
+	_In_ ULONG IdentityKey,
+	_In_ BOOLEAN BindStandby,
+	_Inout_ PULONG SerialNo)
+{
+	PDO_IDENTIFICATION_DESCRIPTION  description;
+	NTSTATUS                        status;
+	ULONG                           serialNo;
+	BOOLEAN                         serialAcquired = FALSE;
+	BOOLEAN                         identityAcquired = FALSE;
+	BOOLEAN                         targetAdopted = FALSE;
+	PFDO_SESSION_TARGET             sessionTarget;
+	KIRQL                           irql;
+
+	PAGED_CODE();
+
+	description.Target = nullptr;
+
+	if (Flags & ~VIGEM_TARGET_FLAG_COALESCE_OUTPUT_REPORTS)
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"sizeof(VIGEM_PLUGIN_TARGET) buffer size mismatch [%d != %d]",
-			sizeof(VIGEM_PLUGIN_TARGET), plugIn->Size);
+			"Unsupported target flags 0x%X",
+			Flags);
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	if (plugIn->SerialNo == 0)
+	if (ReportInterval != 0
+		&& (ReportInterval < VIGEM_REPORT_INTERVAL_MIN || ReportInterval > VIGEM_REPORT_INTERVAL_MAX))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"Serial no. 0 not allowed");
+			"Unsupported report interval %d ms",
+			ReportInterval);
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	*Transferred = length;
+	if (BindStandby)
+	{
+		status = Bus_PlugInStandbyTarget(
+			Device,
+			FileData,
+			TargetType,
+			VendorId,
+			ProductId,
+			Flags,
+			ReportInterval,
+			IdentityKey,
+			SerialNo
+		);
 
-	fileObject = WdfRequestGetFileObject(Request);
-	if (fileObject == NULL)
+		if (status != STATUS_NOT_FOUND)
+		{
+			return status;
+		}
+	}
+
+	//
+	// Allocated up front so a successful plug-in can't fail to be tracked
+	// 
+	sessionTarget = static_cast<PFDO_SESSION_TARGET>(ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(FDO_SESSION_TARGET),
+		SESSION_TARGET_POOL_TAG
+	));
+	if (sessionTarget == nullptr)
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"WdfRequestGetFileObject failed to fetch WDFFILEOBJECT from request 0x%p",
-			Request);
-		return STATUS_INVALID_PARAMETER;
+			"Failed to allocate session target entry");
+		return STATUS_INSUFFICIENT_RESOURCES;
 	}
 
-	pFileData = FileObjectGetData(fileObject);
-	if (pFileData == NULL)
+	sessionTarget->TargetType = TargetType;
+	sessionTarget->IsStandby = FALSE;
+
+	//
+	// Allocate (or reserve the requested) serial number
+	// 
+	serialNo = *SerialNo;
+
+	status = Bus_AcquireSerial(Device, &serialNo);
+	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"FileObjectGetData failed to get context data for 0x%p",
-			fileObject);
-		return STATUS_INVALID_PARAMETER;
+			"Bus_AcquireSerial failed with status %!STATUS!",
+			status);
+
+		//
+		// Same result as a duplicate description, callers probe serials on it
+		// 
+		if (status == STATUS_OBJECT_NAME_COLLISION)
+			status = STATUS_INVALID_PARAMETER;
+
+		ExFreePoolWithTag(sessionTarget, SESSION_TARGET_POOL_TAG);
+		return status;
+	}
+
+	//
+	// Set by this call, so it's this call's to give back on failure
+	// 
+	serialAcquired = TRUE;
+
+	//
+	// Only one PDO may carry an instance ID at a time, including one still being removed
+	// 
+	if (IdentityKey != 0)
+	{
+		status = Bus_AcquireIdentityKey(Device, IdentityKey);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSENUM,
+				"Bus_AcquireIdentityKey failed with status %!STATUS!",
+				status);
+			goto pluginEnd;
+		}
+
+		identityAcquired = TRUE;
 	}
 
 	//
@@ -135,58 +287,79 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 	//
 	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
 
-	description.SerialNo = plugIn->SerialNo;
-	description.SessionId = pFileData->SessionId;
+	description.SerialNo = serialNo;
+	description.SessionId = FileData->SessionId;
 
 	// Set default IDs if supplied values are invalid
-	if (plugIn->VendorId == 0 || plugIn->ProductId == 0)
+	if (VendorId == 0 || ProductId == 0)
 	{
-		switch (plugIn->TargetType)
+		switch (TargetType)
 		{
 		case Xbox360Wired:
 
-			description.Target = new EmulationTargetXUSB(plugIn->SerialNo, pFileData->SessionId);
+			description.Target = new EmulationTargetXUSB(serialNo, FileData->SessionId);
 
 			break;
 		case DualShock4Wired:
 
-			description.Target = new EmulationTargetDS4(plugIn->SerialNo, pFileData->SessionId);
+			description.Target = new EmulationTargetDS4(serialNo, FileData->SessionId);
 
 			break;
 		default:
-			return STATUS_NOT_SUPPORTED;
+			status = STATUS_NOT_SUPPORTED;
+			goto pluginEnd;
 		}
 	}
 	else
 	{
-		switch (plugIn->TargetType)
+		switch (TargetType)
 		{
 		case Xbox360Wired:
 
 			description.Target = new EmulationTargetXUSB(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
+				serialNo,
+				FileData->SessionId,
+				VendorId,
+				ProductId
 			);
 
 			break;
 		case DualShock4Wired:
 
 			description.Target = new EmulationTargetDS4(
-				plugIn->SerialNo,
-				pFileData->SessionId,
-				plugIn->VendorId,
-				plugIn->ProductId
+				serialNo,
+				FileData->SessionId,
+				VendorId,
+				ProductId
 			);
 
 			break;
 		default:
-			return STATUS_NOT_SUPPORTED;
+			status = STATUS_NOT_SUPPORTED;
+			goto pluginEnd;
 		}
 	}
 
-	if (!NT_SUCCESS(description.Target->PdoPrepare(Device)))
+	if (description.Target == nullptr)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"Failed to allocate target object");
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto pluginEnd;
+	}
+
+	description.Target->SetOutputReportCoalescing(
+		(Flags & VIGEM_TARGET_FLAG_COALESCE_OUTPUT_REPORTS) ? TRUE : FALSE
+	);
+
+	description.Target->SetReportInterval(static_cast<UCHAR>(ReportInterval));
+
+	description.Target->SetIdentityKey(IdentityKey);
+
+	status = description.Target->PdoPrepare(Device);
+
+	if (!NT_SUCCESS(status))
 	{
 		goto pluginEnd;
 	}
@@ -222,65 +395,152 @@ EXTERN_C NTSTATUS Bus_PlugInDevice(
 		goto pluginEnd;
 	}
 
+	*SerialNo = serialNo;
+
+	//
+	// Released by the PDO from now on
+	// 
+	serialAcquired = FALSE;
+	identityAcquired = FALSE;
+	targetAdopted = TRUE;
+
+	//
+	// Remember ownership so unplug and close don't need to walk the child list
+	// 
+	sessionTarget->SerialNo = serialNo;
+
+	KeAcquireSpinLock(&FileData->TargetsLock, &irql);
+	InsertTailList(&FileData->Targets, &sessionTarget->Link);
+	KeReleaseSpinLock(&FileData->TargetsLock, irql);
+
+	sessionTarget = nullptr;
+
 pluginEnd:
 
-	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
+	if (serialAcquired)
+	{
+		Bus_ReleaseSerial(Device, serialNo);
+	}
+
+	if (identityAcquired)
+	{
+		Bus_ReleaseIdentityKey(Device, IdentityKey);
+	}
+
+	if (sessionTarget != nullptr)
+	{
+		ExFreePoolWithTag(sessionTarget, SESSION_TARGET_POOL_TAG);
+	}
+
+	//
+	// No PDO will ever clean up a target the child list didn't take over
+	// 
+	if (!targetAdopted && description.Target != nullptr)
+	{
+		description.Target->PdoUnprepare();
+		delete description.Target;
+	}
+
+	BusEvent_TargetPhase(serialNo, TargetType, "PlugInRequested", status);
 
 	return status;
 }
 
 //
-// Simulates a device unplug event.
+// Simulates a device plug-in event.
 // 
-EXTERN_C NTSTATUS Bus_UnPlugDevice(
+EXTERN_C NTSTATUS Bus_PlugInDevice(
 	_In_ WDFDEVICE Device,
 	_In_ WDFREQUEST Request,
 	_In_ BOOLEAN IsInternal,
 	_Out_ size_t* Transferred)
 {
-	NTSTATUS                            status;
-	WDFDEVICE                           hChild;
-	WDFCHILDLIST                        list;
-	WDF_CHILD_LIST_ITERATOR             iterator;
-	WDF_CHILD_RETRIEVE_INFO             childInfo;
-	PDO_IDENTIFICATION_DESCRIPTION      description;
-	BOOLEAN                             unplugAll;
-	PVIGEM_UNPLUG_TARGET                unPlug;
-	WDFFILEOBJECT                       fileObject;
-	PFDO_FILE_DATA                      pFileData = NULL;
-	size_t                              length = 0;
+	NTSTATUS                        status;
+	PVIGEM_PLUGIN_TARGET            plugIn;
+	WDFFILEOBJECT                   fileObject;
+	PFDO_FILE_DATA                  pFileData;
+	size_t                          length = 0;
+	PVIGEM_PLUGIN_TARGET            plugInOut = nullptr;
+	ULONG                           serialNo;
+	ULONG                           flags = 0;
+	ULONG                           reportInterval = 0;
+	ULONG                           identityKey = 0;
+
+	UNREFERENCED_PARAMETER(IsInternal);
 
 	PAGED_CODE();
 
+
 	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
 
 	status = WdfRequestRetrieveInputBuffer(
 		Request,
-		sizeof(VIGEM_UNPLUG_TARGET),
-		(PVOID*)&unPlug,
+		sizeof(VIGEM_PLUGIN_TARGET),
+		reinterpret_cast<PVOID*>(&plugIn),
 		&length
 	);
-
 	if (!NT_SUCCESS(status))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
-			status);
+			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!", status);
 		return status;
 	}
 
-	if ((sizeof(VIGEM_UNPLUG_TARGET) != unPlug->Size) || (length != unPlug->Size))
+	if ((sizeof(VIGEM_PLUGIN_TARGET) != plugIn->Size
+			&& sizeof(VIGEM_PLUGIN_TARGET_EX) != plugIn->Size
+			&& sizeof(VIGEM_PLUGIN_TARGET_EX2) != plugIn->Size
+			&& sizeof(VIGEM_PLUGIN_TARGET_EX3) != plugIn->Size)
+		|| (length != plugIn->Size))
 	{
 		TraceEvents(TRACE_LEVEL_ERROR,
 			TRACE_BUSENUM,
-			"sizeof(VIGEM_UNPLUG_TARGET) buffer size mismatch [%d != %d]",
-			sizeof(VIGEM_UNPLUG_TARGET), unPlug->Size);
+			"sizeof(VIGEM_PLUGIN_TARGET) buffer size mismatch [%d != %d]",
+			sizeof(VIGEM_PLUGIN_TARGET), plugIn->Size);
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	//
+	// Extended request carries per-target options
+	// 
+	if (plugIn->Size == sizeof(VIGEM_PLUGIN_TARGET_EX))
+	{
+		flags = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX>(plugIn)->Flags;
+	}
+	else if (plugIn->Size == sizeof(VIGEM_PLUGIN_TARGET_EX2))
+	{
+		flags = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX2>(plugIn)->Flags;
+		reportInterval = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX2>(plugIn)->ReportInterval;
+	}
+	else if (plugIn->Size == sizeof(VIGEM_PLUGIN_TARGET_EX3))
+	{
+		flags = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX3>(plugIn)->Flags;
+		reportInterval = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX3>(plugIn)->ReportInterval;
+		identityKey = reinterpret_cast<PVIGEM_PLUGIN_TARGET_EX3>(plugIn)->IdentityKey;
+	}
+
+	//
+	// Bus-assigned serial requested, caller needs to receive it
+	// 
+	if (plugIn->SerialNo == 0)
+	{
+		status = WdfRequestRetrieveOutputBuffer(
+			Request,
+			sizeof(VIGEM_PLUGIN_TARGET),
+			reinterpret_cast<PVOID*>(&plugInOut),
+			nullptr
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSENUM,
+				"Serial no. 0 requires an output buffer, WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+				status);
+			return STATUS_INVALID_PARAMETER;
+		}
+	}
+
 	*Transferred = length;
-	unplugAll = (unPlug->SerialNo == 0);
 
 	fileObject = WdfRequestGetFileObject(Request);
 	if (fileObject == NULL)
@@ -302,63 +562,346 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	TraceEvents(TRACE_LEVEL_VERBOSE,
-		TRACE_BUSENUM,
-		"Starting child list traversal");
+	serialNo = plugIn->SerialNo;
 
-	list = WdfFdoGetDefaultChildList(Device);
+	status = Bus_PlugInTarget(
+		Device,
+		pFileData,
+		plugIn->TargetType,
+		plugIn->VendorId,
+		plugIn->ProductId,
+		flags,
+		reportInterval,
+		identityKey,
+		TRUE,
+		&serialNo
+	);
 
-	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+	//
+	// Report assigned serial back to caller
+	// 
+	if (NT_SUCCESS(status) && plugInOut != nullptr)
+	{
+		plugInOut->SerialNo = serialNo;
+		*Transferred = sizeof(VIGEM_PLUGIN_TARGET);
+	}
 
-	WdfChildListBeginIteration(list, &iterator);
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", status);
 
-	for (;;)
-	{
-		WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
-		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+	return status;
+}
 
-		status = WdfChildListRetrieveNextDevice(list, &iterator, &hChild, &childInfo);
+//
+// Allocates the next free serial number if SerialNo is zero, otherwise
+// marks the requested one as used or fails if it already is.
+// 
+EXTERN_C NTSTATUS Bus_AcquireSerial(
+	_In_ WDFDEVICE Device,
+	_Inout_ PULONG SerialNo)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	KIRQL irql;
+	const auto pFdoData = FdoGetData(Device);
 
-		// Error or no more children, end loop
-		if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
+	KeAcquireSpinLock(&pFdoData->SerialBitmapLock, &irql);
+
+	if (*SerialNo == 0)
+	{
+		//
+		// Continue after the last assigned one so serials of targets
+		// currently being removed aren't reused right away
+		// 
+		const auto index = RtlFindClearBitsAndSet(&pFdoData->SerialBitmap, 1, pFdoData->NextSerialHint);
+
+		if (index == 0xFFFFFFFF)
 		{
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSENUM,
-				"WdfChildListRetrieveNextDevice returned with status %!STATUS!",
-				status);
-			break;
+			status = STATUS_INSUFFICIENT_RESOURCES;
 		}
-
-		// If unable to retrieve device
-		if (childInfo.Status != WdfChildListRetrieveDeviceSuccess)
+		else
 		{
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSENUM,
-				"childInfo.Status = %d",
-				childInfo.Status);
-			continue;
+			*SerialNo = index;
+			pFdoData->NextSerialHint = (index + 1) % FDO_TARGET_TABLE_CAPACITY;
 		}
-
-		// Child isn't the one we looked for, skip
-		if (!unplugAll && description.SerialNo != unPlug->SerialNo)
+	}
+	else if (*SerialNo < FDO_TARGET_TABLE_CAPACITY)
+	{
+		//
+		// Held by a living (or not yet cleaned up) PDO, must not be claimed twice
+		// 
+		if (RtlTestBit(&pFdoData->SerialBitmap, *SerialNo))
 		{
-			TraceEvents(TRACE_LEVEL_VERBOSE,
-				TRACE_BUSENUM,
-				"Seeking serial mismatch: %d != %d",
-				description.SerialNo,
-				unPlug->SerialNo);
-			continue;
+			status = STATUS_OBJECT_NAME_COLLISION;
+		}
+		else
+		{
+			RtlSetBit(&pFdoData->SerialBitmap, *SerialNo);
 		}
+	}
 
-		TraceEvents(TRACE_LEVEL_VERBOSE,
-			TRACE_BUSENUM,
-			"description.SessionId = %d, pFileData->SessionId = %d",
-			description.SessionId,
-			pFileData->SessionId);
+	KeReleaseSpinLock(&pFdoData->SerialBitmapLock, irql);
 
-		// Only unplug owned children
-		if (IsInternal || description.SessionId == pFileData->SessionId)
-		{
+	return status;
+}
+
+//
+// Returns a serial number to the pool of free ones.
+// 
+EXTERN_C VOID Bus_ReleaseSerial(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG SerialNo)
+{
+	KIRQL irql;
+	const auto pFdoData = FdoGetData(Device);
+
+	if (SerialNo == 0 || SerialNo >= FDO_TARGET_TABLE_CAPACITY)
+		return;
+
+	KeAcquireSpinLock(&pFdoData->SerialBitmapLock, &irql);
+	RtlClearBit(&pFdoData->SerialBitmap, SerialNo);
+	KeReleaseSpinLock(&pFdoData->SerialBitmapLock, irql);
+}
+
+//
+// Claims a stable identity key, fails if a target holding it still exists.
+// 
+EXTERN_C NTSTATUS Bus_AcquireIdentityKey(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG Key)
+{
+	KIRQL irql;
+	const auto pFdoData = FdoGetData(Device);
+
+	const auto identity = static_cast<PFDO_IDENTITY_KEY>(ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(FDO_IDENTITY_KEY),
+		IDENTITY_KEY_POOL_TAG
+	));
+	if (identity == nullptr)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	identity->Key = Key;
+
+	KeAcquireSpinLock(&pFdoData->IdentityKeysLock, &irql);
+
+	for (auto entry = pFdoData->IdentityKeys.Flink; entry != &pFdoData->IdentityKeys; entry = entry->Flink)
+	{
+		if (CONTAINING_RECORD(entry, FDO_IDENTITY_KEY, Link)->Key == Key)
+		{
+			KeReleaseSpinLock(&pFdoData->IdentityKeysLock, irql);
+			ExFreePoolWithTag(identity, IDENTITY_KEY_POOL_TAG);
+			return STATUS_DEVICE_ALREADY_ATTACHED;
+		}
+	}
+
+	InsertTailList(&pFdoData->IdentityKeys, &identity->Link);
+
+	KeReleaseSpinLock(&pFdoData->IdentityKeysLock, irql);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Makes a stable identity key available to be claimed again.
+// 
+EXTERN_C VOID Bus_ReleaseIdentityKey(
+	_In_ WDFDEVICE Device,
+	_In_ ULONG Key)
+{
+	KIRQL irql;
+	PFDO_IDENTITY_KEY identity = nullptr;
+	const auto pFdoData = FdoGetData(Device);
+
+	KeAcquireSpinLock(&pFdoData->IdentityKeysLock, &irql);
+
+	for (auto entry = pFdoData->IdentityKeys.Flink; entry != &pFdoData->IdentityKeys; entry = entry->Flink)
+	{
+		if (CONTAINING_RECORD(entry, FDO_IDENTITY_KEY, Link)->Key == Key)
+		{
+			identity = CONTAINING_RECORD(entry, FDO_IDENTITY_KEY, Link);
+			RemoveEntryList(&identity->Link);
+			break;
+		}
+	}
+
+	KeReleaseSpinLock(&pFdoData->IdentityKeysLock, irql);
+
+	if (identity != nullptr)
+		ExFreePoolWithTag(identity, IDENTITY_KEY_POOL_TAG);
+}
+
+//
+// Simulates a device unplug event.
+// 
+EXTERN_C NTSTATUS Bus_UnPlugDevice(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request,
+	_In_ BOOLEAN IsInternal,
+	_Out_ size_t* Transferred)
+{
+	NTSTATUS                            status;
+	WDFDEVICE                           hChild;
+	WDFCHILDLIST                        list;
+	WDF_CHILD_LIST_ITERATOR             iterator;
+	WDF_CHILD_RETRIEVE_INFO             childInfo;
+	PDO_IDENTIFICATION_DESCRIPTION      description;
+	BOOLEAN                             unplugAll;
+	PVIGEM_UNPLUG_TARGET                unPlug;
+	WDFFILEOBJECT                       fileObject;
+	PFDO_FILE_DATA                      pFileData = NULL;
+	size_t                              length = 0;
+
+	PAGED_CODE();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		sizeof(VIGEM_UNPLUG_TARGET),
+		(PVOID*)&unPlug,
+		&length
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	if ((sizeof(VIGEM_UNPLUG_TARGET) != unPlug->Size) || (length != unPlug->Size))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"sizeof(VIGEM_UNPLUG_TARGET) buffer size mismatch [%d != %d]",
+			sizeof(VIGEM_UNPLUG_TARGET), unPlug->Size);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	*Transferred = length;
+	unplugAll = (unPlug->SerialNo == 0);
+
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestGetFileObject failed to fetch WDFFILEOBJECT from request 0x%p",
+			Request);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pFileData = FileObjectGetData(fileObject);
+	if (pFileData == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"FileObjectGetData failed to get context data for 0x%p",
+			fileObject);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	//
+	// Regular requests only ever affect their own session
+	// 
+	if (!IsInternal)
+	{
+		(void)Bus_UnPlugSessionTargets(Device, pFileData, unPlug->SerialNo);
+
+		TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
+
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// A single target is unplugged through its owner's entry, whichever session
+	// that is, so no session is left tracking a serial that may get reused
+	// 
+	if (!unplugAll)
+	{
+		LONG ownerSessionId = FDO_STANDBY_SESSION_ID;
+		const auto sessionTarget = Bus_DetachSessionTarget(Device, &ownerSessionId, unPlug->SerialNo);
+
+		if (sessionTarget != nullptr)
+		{
+			Bus_UnPlugSessionTarget(Device, ownerSessionId, sessionTarget);
+
+			TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
+
+			return STATUS_SUCCESS;
+		}
+	}
+
+	TraceEvents(TRACE_LEVEL_VERBOSE,
+		TRACE_BUSENUM,
+		"Starting child list traversal");
+
+	list = WdfFdoGetDefaultChildList(Device);
+
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	for (;;)
+	{
+		WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+		status = WdfChildListRetrieveNextDevice(list, &iterator, &hChild, &childInfo);
+
+		// Error or no more children, end loop
+		if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
+		{
+			TraceEvents(TRACE_LEVEL_VERBOSE,
+				TRACE_BUSENUM,
+				"WdfChildListRetrieveNextDevice returned with status %!STATUS!",
+				status);
+			break;
+		}
+
+		// If unable to retrieve device
+		if (childInfo.Status != WdfChildListRetrieveDeviceSuccess)
+		{
+			TraceEvents(TRACE_LEVEL_VERBOSE,
+				TRACE_BUSENUM,
+				"childInfo.Status = %d",
+				childInfo.Status);
+			continue;
+		}
+
+		// Child isn't the one we looked for, skip
+		if (!unplugAll && description.SerialNo != unPlug->SerialNo)
+		{
+			TraceEvents(TRACE_LEVEL_VERBOSE,
+				TRACE_BUSENUM,
+				"Seeking serial mismatch: %d != %d",
+				description.SerialNo,
+				unPlug->SerialNo);
+			continue;
+		}
+
+		//
+		// Standby targets never leave the bus, they get parked for the next session
+		// 
+		if (description.Target->IsStandby())
+		{
+			const LONG boundSessionId = IsInternal ? description.Target->GetSessionId() : pFileData->SessionId;
+
+			if (description.Target->ReleaseSession(boundSessionId))
+				Bus_ForgetSessionTarget(Device, boundSessionId, description.SerialNo);
+			continue;
+		}
+
+		TraceEvents(TRACE_LEVEL_VERBOSE,
+			TRACE_BUSENUM,
+			"description.SessionId = %d, pFileData->SessionId = %d",
+			description.SessionId,
+			pFileData->SessionId);
+
+		// Only unplug owned children
+		if (IsInternal || description.SessionId == pFileData->SessionId)
+		{
 			// Unplug child
 			status = WdfChildListUpdateChildDescriptionAsMissing(list, &description.Header);
 			if (!NT_SUCCESS(status))
@@ -368,6 +911,11 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 					"WdfChildListUpdateChildDescriptionAsMissing failed with status %!STATUS!",
 					status);
 			}
+
+			//
+			// Owner must not unplug whatever gets this serial next
+			// 
+			Bus_ForgetSessionTarget(Device, description.SessionId, description.SerialNo);
 		}
 	}
 
@@ -381,3 +929,652 @@ EXTERN_C NTSTATUS Bus_UnPlugDevice(
 
 	return STATUS_SUCCESS;
 }
+
+//
+// Applies a set of target removals and additions as one child list update each.
+// 
+EXTERN_C NTSTATUS Bus_ApplyTargetChanges(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request,
+	_Out_ size_t* Transferred)
+{
+	NTSTATUS                            status;
+	PVIGEM_TARGET_CHANGE_SET            changeSet;
+	WDFFILEOBJECT                       fileObject;
+	PFDO_FILE_DATA                      pFileData;
+	WDFCHILDLIST                        list;
+	WDF_CHILD_LIST_ITERATOR             iterator;
+	size_t                              length = 0;
+	size_t                              outLength = 0;
+
+	PAGED_CODE();
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Entry");
+
+	*Transferred = 0;
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		VIGEM_TARGET_CHANGE_SET_LENGTH(0),
+		reinterpret_cast<PVOID*>(&changeSet),
+		&length
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		VIGEM_TARGET_CHANGE_SET_LENGTH(0),
+		nullptr,
+		&outLength
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!",
+			status);
+		return status;
+	}
+
+	if (changeSet->Size != sizeof(VIGEM_TARGET_CHANGE_SET)
+		|| changeSet->Count == 0
+		|| changeSet->Count > VIGEM_TARGET_CHANGE_SET_MAX_ENTRIES
+		|| length < VIGEM_TARGET_CHANGE_SET_LENGTH(changeSet->Count)
+		|| outLength < VIGEM_TARGET_CHANGE_SET_LENGTH(changeSet->Count))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"Invalid VIGEM_TARGET_CHANGE_SET (size %d, count %d, length %d)",
+			changeSet->Size, changeSet->Count, (int)length);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestGetFileObject failed to fetch WDFFILEOBJECT from request 0x%p",
+			Request);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pFileData = FileObjectGetData(fileObject);
+	if (pFileData == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"FileObjectGetData failed to get context data for 0x%p",
+			fileObject);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	list = WdfFdoGetDefaultChildList(Device);
+
+	//
+	// Child list changes made while iterating are reported to PnP as a
+	// single update on EndIteration. BeginScan isn't used here as it would
+	// drop every child not re-reported, including other sessions' ones.
+	// 
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	//
+	// Removals first so their serials and standby targets become available
+	// 
+	for (ULONG i = 0; i < changeSet->Count; i++)
+	{
+		const auto pEntry = &changeSet->Entries[i];
+
+		if (pEntry->Operation == VIGEM_TARGET_CHANGE_REMOVE)
+		{
+			pEntry->Status = Bus_UnPlugSessionTargets(Device, pFileData, pEntry->SerialNo);
+		}
+		else if (pEntry->Operation != VIGEM_TARGET_CHANGE_ADD)
+		{
+			pEntry->Status = STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	WdfChildListEndIteration(list, &iterator);
+
+	//
+	// Binding standby targets iterates the child list itself, so it happens
+	// in between the removal and addition updates, never nested in either
+	// 
+	for (ULONG i = 0; i < changeSet->Count; i++)
+	{
+		const auto pEntry = &changeSet->Entries[i];
+
+		if (pEntry->Operation != VIGEM_TARGET_CHANGE_ADD)
+		{
+			continue;
+		}
+
+		pEntry->Status = Bus_PlugInStandbyTarget(
+			Device,
+			pFileData,
+			pEntry->TargetType,
+			pEntry->VendorId,
+			pEntry->ProductId,
+			pEntry->Flags,
+			pEntry->ReportInterval,
+			pEntry->IdentityKey,
+			&pEntry->SerialNo
+		);
+	}
+
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	for (ULONG i = 0; i < changeSet->Count; i++)
+	{
+		const auto pEntry = &changeSet->Entries[i];
+
+		if (pEntry->Operation != VIGEM_TARGET_CHANGE_ADD
+			|| pEntry->Status != STATUS_NOT_FOUND)
+		{
+			continue;
+		}
+
+		pEntry->Status = Bus_PlugInTarget(
+			Device,
+			pFileData,
+			pEntry->TargetType,
+			pEntry->VendorId,
+			pEntry->ProductId,
+			pEntry->Flags,
+			pEntry->ReportInterval,
+			pEntry->IdentityKey,
+			FALSE,
+			&pEntry->SerialNo
+		);
+	}
+
+	WdfChildListEndIteration(list, &iterator);
+
+	// Return entries with populated status
+	*Transferred = VIGEM_TARGET_CHANGE_SET_LENGTH(changeSet->Count);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_BUSENUM, "%!FUNC! Exit with status %!STATUS!", STATUS_SUCCESS);
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Unplugs the target with the given serial (or all if zero) owned by a session.
+// 
+EXTERN_C NTSTATUS Bus_UnPlugSessionTargets(
+	_In_ WDFDEVICE Device,
+	_In_ PFDO_FILE_DATA FileData,
+	_In_ ULONG SerialNo)
+{
+	KIRQL                               irql;
+	LIST_ENTRY                          detached;
+	PLIST_ENTRY                         entry;
+	PLIST_ENTRY                         next;
+	PFDO_SESSION_TARGET                 sessionTarget;
+	NTSTATUS                            result = STATUS_NOT_FOUND;
+
+	PAGED_CODE();
+
+	InitializeListHead(&detached);
+
+	//
+	// Move matching entries out under the lock, PnP work happens without it
+	// 
+	KeAcquireSpinLock(&FileData->TargetsLock, &irql);
+
+	for (entry = FileData->Targets.Flink; entry != &FileData->Targets; entry = next)
+	{
+		next = entry->Flink;
+		sessionTarget = CONTAINING_RECORD(entry, FDO_SESSION_TARGET, Link);
+
+		if (SerialNo == 0 || sessionTarget->SerialNo == SerialNo)
+		{
+			RemoveEntryList(entry);
+			InsertTailList(&detached, entry);
+		}
+	}
+
+	KeReleaseSpinLock(&FileData->TargetsLock, irql);
+
+	while (!IsListEmpty(&detached))
+	{
+		sessionTarget = CONTAINING_RECORD(RemoveHeadList(&detached), FDO_SESSION_TARGET, Link);
+		result = STATUS_SUCCESS;
+
+		Bus_UnPlugSessionTarget(Device, FileData->SessionId, sessionTarget);
+	}
+
+	return result;
+}
+
+//
+// Unplugs (or parks) the target of a detached session entry and frees the entry.
+// 
+static VOID Bus_UnPlugSessionTarget(
+	_In_ WDFDEVICE Device,
+	_In_ LONG SessionId,
+	_In_ PFDO_SESSION_TARGET SessionTarget)
+{
+	NTSTATUS                            status;
+	PDO_IDENTIFICATION_DESCRIPTION      description;
+	EmulationTargetPDO*                 pdo;
+
+	PAGED_CODE();
+
+	if (SessionTarget->IsStandby)
+	{
+		if (EmulationTargetPDO::GetPdoByTypeAndSerial(Device, SessionTarget->TargetType, SessionTarget->SerialNo, &pdo))
+		{
+			(void)pdo->ReleaseSession(SessionId);
+			pdo->ReleaseReference();
+		}
+	}
+	else
+	{
+		TraceEvents(TRACE_LEVEL_INFORMATION,
+			TRACE_BUSENUM,
+			"Unplugging device with serial %d",
+			SessionTarget->SerialNo);
+
+		//
+		// Entry is proof of ownership, the PDO may not even be created yet
+		// 
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+		description.SerialNo = SessionTarget->SerialNo;
+
+		status = WdfChildListUpdateChildDescriptionAsMissing(
+			WdfFdoGetDefaultChildList(Device),
+			&description.Header
+		);
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_ERROR,
+				TRACE_BUSENUM,
+				"WdfChildListUpdateChildDescriptionAsMissing failed with status %!STATUS!",
+				status);
+		}
+	}
+
+	ExFreePoolWithTag(SessionTarget, SESSION_TARGET_POOL_TAG);
+}
+
+//
+// Removes a target's entry from its owner's list, FDO_STANDBY_SESSION_ID searches
+// every session and returns the owning one.
+// 
+static PFDO_SESSION_TARGET Bus_DetachSessionTarget(
+	_In_ WDFDEVICE Device,
+	_Inout_ PLONG SessionId,
+	_In_ ULONG SerialNo)
+{
+	KIRQL                               irql;
+	PLIST_ENTRY                         session;
+	PLIST_ENTRY                         entry;
+	PFDO_FILE_DATA                      pFileData;
+	PFDO_SESSION_TARGET                 sessionTarget = nullptr;
+	const auto                          pFdoData = FdoGetData(Device);
+
+	KeAcquireSpinLock(&pFdoData->SessionsLock, &irql);
+
+	for (session = pFdoData->Sessions.Flink;
+	     session != &pFdoData->Sessions && sessionTarget == nullptr;
+	     session = session->Flink)
+	{
+		pFileData = CONTAINING_RECORD(session, FDO_FILE_DATA, Link);
+
+		if (*SessionId != FDO_STANDBY_SESSION_ID && pFileData->SessionId != *SessionId)
+			continue;
+
+		KeAcquireSpinLockAtDpcLevel(&pFileData->TargetsLock);
+
+		for (entry = pFileData->Targets.Flink; entry != &pFileData->Targets; entry = entry->Flink)
+		{
+			if (CONTAINING_RECORD(entry, FDO_SESSION_TARGET, Link)->SerialNo == SerialNo)
+			{
+				sessionTarget = CONTAINING_RECORD(entry, FDO_SESSION_TARGET, Link);
+				RemoveEntryList(entry);
+				*SessionId = pFileData->SessionId;
+				break;
+			}
+		}
+
+		KeReleaseSpinLockFromDpcLevel(&pFileData->TargetsLock);
+	}
+
+	KeReleaseSpinLock(&pFdoData->SessionsLock, irql);
+
+	return sessionTarget;
+}
+
+//
+// Drops the entry of a target unplugged behind its owning session's back.
+// 
+static VOID Bus_ForgetSessionTarget(
+	_In_ WDFDEVICE Device,
+	_In_ LONG SessionId,
+	_In_ ULONG SerialNo)
+{
+	const auto sessionTarget = Bus_DetachSessionTarget(Device, &SessionId, SerialNo);
+
+	if (sessionTarget != nullptr)
+		ExFreePoolWithTag(sessionTarget, SESSION_TARGET_POOL_TAG);
+}
+
+//
+// Reports the user index of every wired Xbox 360 target owned by the requesting session.
+// 
+EXTERN_C NTSTATUS Bus_GetSessionUserIndices(
+	_In_ WDFDEVICE Device,
+	_In_ WDFREQUEST Request,
+	_Out_ size_t* Transferred)
+{
+	NTSTATUS                            status;
+	KIRQL                               irql;
+	PLIST_ENTRY                         entry;
+	PFDO_SESSION_TARGET                 sessionTarget;
+	PXUSB_GET_SESSION_USER_INDICES      getIndices;
+	PVOID                               outBuffer;
+	WDFFILEOBJECT                       fileObject;
+	PFDO_FILE_DATA                      pFileData;
+	EmulationTargetPDO*                 pdo;
+	size_t                              length = 0;
+	ULONG                               count = 0;
+
+	*Transferred = 0;
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		XUSB_GET_SESSION_USER_INDICES_LENGTH(1),
+		reinterpret_cast<PVOID*>(&getIndices),
+		&length
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveInputBuffer failed with status %!STATUS!", status);
+		return status;
+	}
+
+	if (getIndices->Size != sizeof(XUSB_GET_SESSION_USER_INDICES)
+		|| getIndices->Capacity == 0
+		|| getIndices->Capacity > XUSB_SESSION_USER_INDICES_MAX_ENTRIES
+		|| length < XUSB_GET_SESSION_USER_INDICES_LENGTH(getIndices->Capacity))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"Invalid XUSB_GET_SESSION_USER_INDICES request");
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	// Same buffer is used for in- and output
+	length = XUSB_GET_SESSION_USER_INDICES_LENGTH(getIndices->Capacity);
+
+	status = WdfRequestRetrieveOutputBuffer(Request, length, &outBuffer, nullptr);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestRetrieveOutputBuffer failed with status %!STATUS!", status);
+		return status;
+	}
+
+	fileObject = WdfRequestGetFileObject(Request);
+	if (fileObject == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"WdfRequestGetFileObject failed to fetch WDFFILEOBJECT from request 0x%p",
+			Request);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	pFileData = FileObjectGetData(fileObject);
+	if (pFileData == NULL)
+	{
+		TraceEvents(TRACE_LEVEL_ERROR,
+			TRACE_BUSENUM,
+			"FileObjectGetData failed to get context data for 0x%p",
+			fileObject);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	//
+	// Collect the serials under the lock, resolve them without it
+	// 
+	KeAcquireSpinLock(&pFileData->TargetsLock, &irql);
+
+	for (entry = pFileData->Targets.Flink;
+	     entry != &pFileData->Targets && count < getIndices->Capacity;
+	     entry = entry->Flink)
+	{
+		sessionTarget = CONTAINING_RECORD(entry, FDO_SESSION_TARGET, Link);
+
+		if (sessionTarget->TargetType != Xbox360Wired)
+			continue;
+
+		getIndices->Entries[count++].SerialNo = sessionTarget->SerialNo;
+	}
+
+	KeReleaseSpinLock(&pFileData->TargetsLock, irql);
+
+	for (ULONG i = 0; i < count; i++)
+	{
+		const auto pEntry = &getIndices->Entries[i];
+
+		pEntry->UserIndex = XUSB_USER_INDEX_NONE;
+
+		// Target may not have been created by PnP yet
+		if (!EmulationTargetPDO::GetPdoByTypeAndSerial(Device, Xbox360Wired, pEntry->SerialNo, &pdo))
+			continue;
+
+		if (!NT_SUCCESS(static_cast<EmulationTargetXUSB*>(pdo)->GetUserIndex(&pEntry->UserIndex)))
+			pEntry->UserIndex = XUSB_USER_INDEX_NONE;
+
+		pdo->ReleaseReference();
+	}
+
+	getIndices->Count = count;
+
+	*Transferred = length;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Binds the first parked standby target of the given type to a session.
+// 
+static NTSTATUS Bus_BindStandbyTarget(
+	_In_ WDFDEVICE Device,
+	_In_ VIGEM_TARGET_TYPE TargetType,
+	_In_ LONG SessionId,
+	_Out_ PULONG SerialNo)
+{
+	NTSTATUS                            status;
+	WDFDEVICE                           hChild;
+	WDF_CHILD_LIST_ITERATOR             iterator;
+	WDF_CHILD_RETRIEVE_INFO             childInfo;
+	PDO_IDENTIFICATION_DESCRIPTION      description;
+	NTSTATUS                            result = STATUS_NOT_FOUND;
+
+	const WDFCHILDLIST list = WdfFdoGetDefaultChildList(Device);
+
+	WDF_CHILD_LIST_ITERATOR_INIT(&iterator, WdfRetrievePresentChildren);
+
+	WdfChildListBeginIteration(list, &iterator);
+
+	for (;;)
+	{
+		WDF_CHILD_RETRIEVE_INFO_INIT(&childInfo, &description.Header);
+		WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+		status = WdfChildListRetrieveNextDevice(list, &iterator, &hChild, &childInfo);
+
+		if (!NT_SUCCESS(status) || status == STATUS_NO_MORE_ENTRIES)
+		{
+			break;
+		}
+
+		if (childInfo.Status != WdfChildListRetrieveDeviceSuccess
+			|| !description.Target->IsStandby()
+			|| description.Target->GetType() != TargetType)
+		{
+			continue;
+		}
+
+		if (description.Target->BindSession(SessionId))
+		{
+			*SerialNo = description.SerialNo;
+			result = STATUS_SUCCESS;
+			break;
+		}
+	}
+
+	WdfChildListEndIteration(list, &iterator);
+
+	return result;
+}
+
+//
+// Creates and enumerates a single bus-owned standby target.
+// 
+static NTSTATUS Bus_AddStandbyTarget(
+	_In_ WDFDEVICE Device,
+	_In_ VIGEM_TARGET_TYPE TargetType)
+{
+	PDO_IDENTIFICATION_DESCRIPTION  description;
+	NTSTATUS                        status;
+	ULONG                           serialNo = 0;
+
+	status = Bus_AcquireSerial(Device, &serialNo);
+	if (!NT_SUCCESS(status))
+	{
+		return status;
+	}
+
+	WDF_CHILD_IDENTIFICATION_DESCRIPTION_HEADER_INIT(&description.Header, sizeof(description));
+
+	description.SerialNo = serialNo;
+	description.SessionId = FDO_STANDBY_SESSION_ID;
+
+	switch (TargetType)
+	{
+	case Xbox360Wired:
+		description.Target = new EmulationTargetXUSB(serialNo, FDO_STANDBY_SESSION_ID);
+		break;
+	case DualShock4Wired:
+		description.Target = new EmulationTargetDS4(serialNo, FDO_STANDBY_SESSION_ID);
+		break;
+	default:
+		description.Target = nullptr;
+		break;
+	}
+
+	if (description.Target == nullptr)
+	{
+		Bus_ReleaseSerial(Device, serialNo);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	description.Target->SetStandby();
+
+	status = description.Target->PdoPrepare(Device);
+
+	if (NT_SUCCESS(status))
+	{
+		status = WdfChildListAddOrUpdateChildDescriptionAsPresent(
+			WdfFdoGetDefaultChildList(Device),
+			&description.Header,
+			NULL
+		);
+	}
+
+	//
+	// No PDO will ever clean up a target the child list didn't take over
+	// 
+	if (!NT_SUCCESS(status) || status == STATUS_OBJECT_NAME_EXISTS)
+	{
+		description.Target->PdoUnprepare();
+		delete description.Target;
+
+		Bus_ReleaseSerial(Device, serialNo);
+
+		if (NT_SUCCESS(status))
+			status = STATUS_OBJECT_NAME_COLLISION;
+	}
+
+	return status;
+}
+
+//
+// Populates the warm pool of standby targets configured in the registry.
+// 
+EXTERN_C VOID Bus_CreateStandbyTargets(
+	_In_ WDFDEVICE Device)
+{
+	NTSTATUS        status;
+	WDFKEY          keyParams;
+	UNICODE_STRING  valueName;
+	ULONG           xusbCount = 0;
+	ULONG           ds4Count = 0;
+
+	PAGED_CODE();
+
+	status = WdfDriverOpenParametersRegistryKey(
+		WdfGetDriver(),
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&keyParams
+	);
+	if (!NT_SUCCESS(status))
+	{
+		TraceEvents(TRACE_LEVEL_WARNING,
+			TRACE_BUSENUM,
+			"WdfDriverOpenParametersRegistryKey failed with status %!STATUS!",
+			status);
+		return;
+	}
+
+	RtlUnicodeStringInit(&valueName, L"StandbyXusbTargets");
+	(void)WdfRegistryQueryULong(keyParams, &valueName, &xusbCount);
+
+	RtlUnicodeStringInit(&valueName, L"StandbyDs4Targets");
+	(void)WdfRegistryQueryULong(keyParams, &valueName, &ds4Count);
+
+	WdfRegistryClose(keyParams);
+
+	xusbCount = min(xusbCount, FDO_STANDBY_TARGETS_MAX);
+	ds4Count = min(ds4Count, FDO_STANDBY_TARGETS_MAX);
+
+	TraceEvents(TRACE_LEVEL_INFORMATION,
+		TRACE_BUSENUM,
+		"Creating %d XUSB and %d DS4 standby targets",
+		xusbCount,
+		ds4Count);
+
+	for (ULONG i = 0; i < xusbCount + ds4Count; i++)
+	{
+		status = Bus_AddStandbyTarget(Device, (i < xusbCount) ? Xbox360Wired : DualShock4Wired);
+
+		if (!NT_SUCCESS(status))
+		{
+			TraceEvents(TRACE_LEVEL_WARNING,
+				TRACE_BUSENUM,
+				"Bus_AddStandbyTarget failed with status %!STATUS!",
+				status);
+			break;
+		}
+	}
+}
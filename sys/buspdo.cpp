@@ -53,5 +53,15 @@ EXTERN_C NTSTATUS Bus_EvtDeviceListCreatePdo(
 
     pDesc = CONTAINING_RECORD(IdentificationDescription, ViGEm::Bus::Core::PDO_IDENTIFICATION_DESCRIPTION, Header);
 
-    return pDesc->Target->PdoCreateDevice(WdfChildListGetDevice(DeviceList), ChildInit);
+    const auto parentDevice = WdfChildListGetDevice(DeviceList);
+
+    const auto status = pDesc->Target->PdoCreateDevice(parentDevice, ChildInit);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    //
+    // Make target available to fast serial lookup on I/O dispatch
+    // 
+    return pDesc->Target->InsertIntoLookupTable(parentDevice);
 }